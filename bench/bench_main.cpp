@@ -0,0 +1,216 @@
+// Host microbenchmark for the command hot path: MQTT payload parsing (with
+// chunked reassembly), the /led query parser and channel dispatch into the
+// LEDC/GPIO stand-ins from lib/host_mock.
+//
+//   pio run -e native_bench -t exec              default iteration count
+//   .pio/build/native_bench/program 1000000      custom iteration count
+//
+// Reports ns per command, heap allocations per command (glibc only, counted
+// by lib/host_mock) and throughput for each payload mix. Compare against a
+// previous run before flashing; the absolute numbers are host numbers, the
+// ratios carry over.
+
+#include "command_parser.h"
+#include "http_query.h"
+#include "led_channels.h"
+#include "mqtt_reassembly.h"
+#include "host_mock.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    PAYLOAD_MQTT,          // one C2D message in one MQTT_EVENT_DATA
+    PAYLOAD_MQTT_CHUNKED,  // one C2D message split over several events
+    PAYLOAD_HTTP,          // /led query string
+} payload_kind_t;
+
+typedef struct {
+    payload_kind_t kind;
+    const char* text;
+} payload_t;
+
+typedef struct {
+    const char* name;
+    const payload_t* payloads;
+    size_t count;
+} payload_mix_t;
+
+#define MIX(name, array) { name, array, sizeof(array) / sizeof(array[0]) }
+
+static const payload_t mqtt_single[] = {
+    { PAYLOAD_MQTT, "RGB:ON" },
+    { PAYLOAD_MQTT, "WHITE:OFF" },
+    { PAYLOAD_MQTT, "VERDE:128" },
+    { PAYLOAD_MQTT, "ON" },
+};
+
+static const payload_t mqtt_batch[] = {
+    { PAYLOAD_MQTT, "RGB:ON,WHITE:128,VERDE:OFF,FAR_RED:255" },
+    { PAYLOAD_MQTT, "ALL:OFF" },
+    { PAYLOAD_MQTT, "MASK:0B" },
+    { PAYLOAD_MQTT, "RGB:64;WHITE:ON" },
+};
+
+static const payload_t mqtt_json[] = {
+    { PAYLOAD_MQTT, "{\"RGB\":\"ON\",\"WHITE\":128,\"VERDE\":false,\"FAR_RED\":255}" },
+    { PAYLOAD_MQTT, "{ \"RGB\": \"OFF\" }" },
+};
+
+static const payload_t mqtt_chunked[] = {
+    { PAYLOAD_MQTT_CHUNKED, "RGB:ON,WHITE:128,VERDE:OFF,FAR_RED:255" },
+    { PAYLOAD_MQTT_CHUNKED, "{\"RGB\":\"ON\",\"WHITE\":128,\"VERDE\":false,\"FAR_RED\":255}" },
+};
+
+static const payload_t mqtt_malformed[] = {
+    { PAYLOAD_MQTT, "RGB:MAYBE" },
+    { PAYLOAD_MQTT, "PURPLE:ON" },
+    { PAYLOAD_MQTT, "RGB:ON,WHITE" },
+    { PAYLOAD_MQTT, "{\"RGB\":" },
+    { PAYLOAD_MQTT, "" },
+};
+
+static const payload_t http_single[] = {
+    { PAYLOAD_HTTP, "channel=RGB&state=ON" },
+    { PAYLOAD_HTTP, "channel=FAR_RED&state=OFF" },
+    { PAYLOAD_HTTP, "state=200&channel=WHITE" },
+};
+
+static const payload_t http_batch[] = {
+    { PAYLOAD_HTTP, "cmd=RGB:ON,WHITE:OFF,VERDE:128" },
+    { PAYLOAD_HTTP, "cmd=ALL:OFF" },
+};
+
+static const payload_t http_malformed[] = {
+    { PAYLOAD_HTTP, "channel=RGB" },
+    { PAYLOAD_HTTP, "channel=PURPLE&state=ON" },
+    { PAYLOAD_HTTP, "channel=RGB&state=300" },
+    { PAYLOAD_HTTP, "cmd=RGB:FOO" },
+};
+
+// Roughly what a site sees: mostly single-channel MQTT, some batches and web clicks
+static const payload_t realistic[] = {
+    { PAYLOAD_MQTT, "RGB:ON" },
+    { PAYLOAD_MQTT, "WHITE:OFF" },
+    { PAYLOAD_MQTT, "VERDE:128" },
+    { PAYLOAD_MQTT, "FAR_RED:ON" },
+    { PAYLOAD_MQTT, "RGB:ON,WHITE:128,VERDE:OFF,FAR_RED:255" },
+    { PAYLOAD_MQTT, "ALL:OFF" },
+    { PAYLOAD_MQTT, "{\"RGB\":\"ON\",\"WHITE\":128}" },
+    { PAYLOAD_MQTT_CHUNKED, "RGB:ON,WHITE:128,VERDE:OFF,FAR_RED:255" },
+    { PAYLOAD_HTTP, "channel=RGB&state=ON" },
+    { PAYLOAD_HTTP, "cmd=RGB:ON,WHITE:OFF" },
+    { PAYLOAD_MQTT, "RGB:MAYBE" },
+};
+
+static const payload_mix_t mixes[] = {
+    MIX("mqtt single", mqtt_single),
+    MIX("mqtt batch", mqtt_batch),
+    MIX("mqtt json", mqtt_json),
+    MIX("mqtt chunked x3", mqtt_chunked),
+    MIX("mqtt malformed", mqtt_malformed),
+    MIX("http single", http_single),
+    MIX("http batch", http_batch),
+    MIX("http malformed", http_malformed),
+    MIX("realistic mix", realistic),
+};
+
+static const char c2d_topic[] = "devices/ESP32_001/messages/devicebound/%24.to=%2Fdevices%2FESP32_001%2Fmessages%2FdeviceBound";
+
+static mqtt_reassembly_t rx;
+static uint32_t applied;
+static uint32_t rejected;
+
+static void dispatch(const led_batch_t* batch) {
+    // What the actuator task does with a popped record
+    led_channels_apply(batch);
+    applied++;
+}
+
+static void run_payload(const payload_t* p, int msg_id) {
+    size_t len = strlen(p->text);
+    led_batch_t batch;
+    cmd_token_t bad;
+
+    switch (p->kind) {
+        case PAYLOAD_MQTT:
+        case PAYLOAD_MQTT_CHUNKED: {
+            // Same event sequence the MQTT client produces: the topic only on the first fragment
+            size_t chunks = p->kind == PAYLOAD_MQTT_CHUNKED ? 3 : 1;
+            size_t step = len / chunks + 1;
+            size_t off = 0;
+            mqtt_reassembly_status_t status;
+            do {
+                size_t n = len - off < step ? len - off : step;
+                status = mqtt_reassembly_feed(&rx, msg_id, off ? NULL : c2d_topic, off ? 0 : sizeof(c2d_topic) - 1,
+                                              p->text + off, n, off, len);
+                off += n;
+            } while (off < len);
+            if (status != MQTT_REASSEMBLY_COMPLETE ||
+                command_parse(rx.data, rx.data_len, &batch, &bad) != CMD_PARSE_OK) {
+                rejected++;
+                return;
+            }
+            dispatch(&batch);
+            return;
+        }
+        case PAYLOAD_HTTP: {
+            led_query_t q;
+            if (led_query_parse(p->text, len, &q) != LED_QUERY_OK) {
+                rejected++;
+                return;
+            }
+            dispatch(&q.batch);
+            return;
+        }
+    }
+}
+
+static void run_mix(const payload_mix_t* mix, uint32_t iterations) {
+    // Warm up caches and the branch predictor
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++) {
+        run_payload(&mix->payloads[i % mix->count], (int)i);
+    }
+
+    applied = 0;
+    rejected = 0;
+    uint64_t allocs_before = mock_heap_allocations();
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        run_payload(&mix->payloads[i % mix->count], (int)i);
+        if ((i & 511) == 511) {
+            // Keep the LEDC recorder from filling up; cost is amortised over 512 commands
+            mock_ledc_reset();
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t allocs = mock_heap_allocations() - allocs_before;
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+
+    printf("%-18s %10.1f %12.3f %12.0f %9u %9u\n", mix->name, ns, (double)allocs / iterations, 1e9 / ns,
+           applied, rejected);
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 200000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    mock_gpio_reset();
+    mock_ledc_reset();
+    led_channels_init();
+    mqtt_reassembly_reset(&rx);
+
+    printf("\ncommand hot path, %u commands per mix%s\n\n", iterations,
+           mock_heap_tracking() ? "" : " (allocations not counted on this host)");
+    printf("%-18s %10s %12s %12s %9s %9s\n", "mix", "ns/cmd", "allocs/cmd", "cmd/s", "applied", "rejected");
+    for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+        run_mix(&mixes[i], iterations);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include "cmd_ring.h"
+#include "esp_err.h"
+#include <stdint.h>
+
+// Single owner of the LED hardware. Network tasks parse commands and push them
+// here; the actuator task applies them in order, so the MQTT and httpd tasks
+// return immediately and never race on the pins.
+//
+// Two lanes feed the task. A batch that turns every channel OFF is a safety
+// command and goes through the priority lane: it is applied before anything
+// queued in the normal lane, and normal commands queued before it are dropped.
+
+#define ACTUATOR_QUEUE_DEPTH     32   // normal lane, power of two
+#define ACTUATOR_PRIORITY_DEPTH  4    // safety lane, power of two
+#define ACTUATOR_MAX_LISTENERS   8
+#define ACTUATOR_MAX_DISCARD_LISTENERS 2
+#define ACTUATOR_TAG_TRACE       0x80000000u
+#define ACTUATOR_LATENCY_BUCKETS 8    // finite histogram bounds; one more bucket above the last
+
+// Called from the actuator task right after each hardware write with the
+// record that was applied (channels, source, enqueue time, tag). Must return
+// quickly: hand the work to another task.
+typedef void (*actuator_listener_fn)(const cmd_record_t* record);
+
+typedef struct {
+    uint32_t applied;              // commands applied to the hardware
+    uint32_t priority;             // of which came through the safety lane
+    uint32_t dropped;              // rejected because a lane was full
+    uint32_t superseded;           // normal commands discarded by a later safety command
+    uint32_t last_latency_us;      // enqueue -> hardware write, most recent command
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;     // divide by applied for the mean
+    uint32_t applied_by_source[CMD_SOURCE_COUNT];
+    // Enqueue -> hardware write: bucket i counts latencies <= ACTUATOR_LATENCY_BOUNDS_US[i]
+    // and above the previous bound; the last bucket is everything slower
+    uint32_t latency_buckets[ACTUATOR_LATENCY_BUCKETS + 1];
+} actuator_stats_t;
+
+extern const uint32_t ACTUATOR_LATENCY_BOUNDS_US[ACTUATOR_LATENCY_BUCKETS];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t actuator_start(void);
+
+// Queue a batch for the actuator task. Returns ESP_ERR_NO_MEM if the lane is full.
+esp_err_t actuator_submit(const led_batch_t* batch, cmd_source_t source);
+
+// As actuator_submit, with a tag handed back to the listeners once applied.
+// Tags with ACTUATOR_TAG_TRACE set belong to latency_trace; 0 is untagged.
+esp_err_t actuator_submit_tagged(const led_batch_t* batch, cmd_source_t source, uint32_t tag);
+
+// Queue hardware fades of the batch channels to their levels over fade_ms.
+// Always the normal lane: fading to OFF is not a safety command.
+esp_err_t actuator_submit_fade(const led_batch_t* batch, uint32_t fade_ms, cmd_source_t source);
+
+// Queue an all-channels-OFF command in the priority lane.
+esp_err_t actuator_all_off(cmd_source_t source);
+
+void actuator_get_stats(actuator_stats_t* stats);
+
+// Register a state-change listener. Returns ESP_ERR_NO_MEM when all slots are taken.
+esp_err_t actuator_add_listener(actuator_listener_fn listener);
+
+// Register a listener for normal commands discarded unapplied because a
+// safety command superseded them. Same task and contract as above.
+esp_err_t actuator_add_discard_listener(actuator_listener_fn listener);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ACTUATOR_H
@@ -0,0 +1,49 @@
+#ifndef APP_EVENTS_H
+#define APP_EVENTS_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include <stdint.h>
+
+// Application state as one FreeRTOS event group. Each bit is set by the
+// module that owns it. Other tasks block on the bits they need instead of
+// polling flags, so nothing waits longer than the event itself takes.
+//
+// The first time a bit is set is also a boot phase: its time since boot is
+// recorded and logged, and app_events_print_boot_profile() shows the cold-start
+// timeline. Connectivity bits are cleared again when the link drops.
+
+#define APP_EVENT_LEDS_READY      (1u << 0)   // last LED state restored, actuator running
+#define APP_EVENT_WEB_READY       (1u << 1)   // HTTP server listening
+#define APP_EVENT_WIFI_STARTED    (1u << 2)   // station started, association in progress
+#define APP_EVENT_WIFI_CONNECTED  (1u << 3)   // got an IP; cleared on disconnect
+#define APP_EVENT_MQTT_CONNECTED  (1u << 4)   // IoT Hub session up; cleared on disconnect
+#define APP_EVENT_FIRST_COMMAND   (1u << 5)   // first network command reached the LEDs
+#define APP_EVENT_TIME_SYNCED     (1u << 6)   // wall clock set by SNTP
+#define APP_EVENT_COUNT           7
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Create the event group. First thing in app_main; the boot clock starts here.
+void app_events_init(void);
+
+void app_events_set(EventBits_t bits);
+void app_events_clear(EventBits_t bits);
+EventBits_t app_events_get(void);
+
+// Block until all of bits are set. Returns the bits at that moment; check them on timeout.
+EventBits_t app_events_wait(EventBits_t bits, TickType_t timeout);
+
+// Microseconds since boot when the bit was first set, or -1 if it never was.
+int64_t app_events_first_set_us(EventBits_t bit);
+
+// One line per boot phase reached so far, with the time since boot and since the previous phase.
+void app_events_print_boot_profile(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // APP_EVENTS_H
@@ -5,6 +5,12 @@
 #define WIFI_SSID "Odido-474830"
 #define WIFI_PASSWORD "D5ETT9WPRW7MPJAK"
 
+// Optional static IP: skips DHCP entirely on every (re)connect
+// #define WIFI_STATIC_IP      "192.168.1.50"
+// #define WIFI_STATIC_NETMASK "255.255.255.0"
+// #define WIFI_STATIC_GATEWAY "192.168.1.1"
+// #define WIFI_STATIC_DNS     "192.168.1.1"
+
 // Azure IoT Hub Configuration
 // Replace with your IoT Hub hostname (e.g., "myhub.azure-devices.net")
 // Example: If your IoT Hub is named "mi-hub-test", use "mi-hub-test.azure-devices.net"
@@ -15,7 +21,12 @@
 // IMPORTANT: Authentication Type in Azure must be "Symmetric Key" (not X.509)
 #define DEVICE_ID "ESP32_001"
 
-// Shared Access Signature (SAS) Token
+// Device symmetric key ("Primary key" in the portal), base64. Stored in NVS on
+// first boot; with a key in NVS the device signs and renews its own SAS tokens
+// and SAS_TOKEN below is not used. See AZURE_IOT_SETUP.md.
+// #define DEVICE_KEY "..."
+
+// Shared Access Signature (SAS) Token, used when there is no device key
 // Generate this using Azure CLI: az iot hub generate-sas-token --hub-name <HUB_NAME> --device-id <DEVICE_ID> --duration 3600
 // Format: SharedAccessSignature sr={hub-name}.azure-devices.net%2Fdevices%2F{device-id}&sig={signature}&se={expiry}
 // Example: "SharedAccessSignature sr=mi-hub-test.azure-devices.net%2Fdevices%2FESP32_001&sig=ABC123...&se=1735689600"
@@ -3,14 +3,53 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Credentials: with a device key in NVS (see sas_token.h) the SAS token is
+// signed on the device, valid SAS_TOKEN_TTL_S, and renewed at
+// SAS_RENEW_PERCENT of its life. The new token is signed first and the
+// session is then dropped and reopened at once, so the only gap is the
+// reconnect itself. The renewal waits for SAS_QUIET_MS without incoming
+// messages, but not past SAS_RENEW_DEADLINE_PERCENT; C2D messages sent during
+// the gap wait in the hub. Without a key the static SAS_TOKEN from
+// azure_config.h is used as is.
+
+#ifndef SAS_TOKEN_TTL_S
+#define SAS_TOKEN_TTL_S             3600
+#endif
+#define SAS_RENEW_PERCENT           80
+#define SAS_RENEW_DEADLINE_PERCENT  90
+#define SAS_QUIET_MS                2000
+#define SAS_CLOCK_WAIT_MS           15000   // start waits this long for SNTP before signing
+
+typedef struct {
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t published;            // QoS 1 publishes acknowledged by the hub (PUBACK)
+    uint32_t token_renewals;       // proactive reconnects with a new token
+    uint32_t forced_renewals;      // of which at the deadline, without a quiet window
+    uint32_t token_expiry;         // se of the token in use, 0 with the static SAS_TOKEN
+    uint32_t last_blackout_us;     // renewal: disconnect -> connected again
+    uint32_t max_blackout_us;
+    uint32_t last_connect_ms;      // BEFORE_CONNECT -> CONNECTED: TCP, TLS and CONNACK
+    uint32_t max_connect_ms;
+} azure_iot_stats_t;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Create the client and register its handlers; needs no network, so it can
+// run while WiFi is still associating. azure_iot_mqtt_start() connects.
 esp_err_t azure_iot_mqtt_init(void);
+esp_err_t azure_iot_mqtt_start(void);
 esp_err_t azure_iot_send_telemetry(const char* data);
+// Publish a binary-safe payload. content_type (e.g. "application/cbor") is sent
+// as the $.ct message property; NULL leaves it unset.
+esp_err_t azure_iot_send_telemetry_bytes(const void* data, size_t len, const char* content_type);
 bool azure_iot_is_connected(void);
+void azure_iot_get_stats(azure_iot_stats_t* stats);
 
 #ifdef __cplusplus
 }
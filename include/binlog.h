@@ -0,0 +1,105 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Deferred binary logging for hot paths.
+// A log call stores the format string pointer, the tag and up to four 32-bit
+// arguments in a RAM ring - a few dozen cycles, no formatting and no UART wait.
+// A low-priority task formats and prints the records later, and /logs serves
+// the most recent history.
+//
+// Formats and string arguments are stored by pointer, so they must outlive the
+// record: string literals, registry names and other static data only. Every
+// argument must fit in 32 bits (%d, %u, %x, %c, %s, %p; no %lld or %f).
+
+#define BINLOG_LEVEL_NONE    0
+#define BINLOG_LEVEL_ERROR   1
+#define BINLOG_LEVEL_WARN    2
+#define BINLOG_LEVEL_INFO    3
+#define BINLOG_LEVEL_DEBUG   4
+
+// Calls above this level compile to nothing
+#ifndef BINLOG_LEVEL
+#define BINLOG_LEVEL BINLOG_LEVEL_INFO
+#endif
+
+#define BINLOG_MAX_ARGS      4
+#define BINLOG_CAPACITY      128   // records kept, power of two
+
+typedef struct {
+    uint32_t time_ms;
+    const char* tag;
+    const char* fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uintptr_t args[BINLOG_MAX_ARGS];
+} binlog_record_t;
+
+typedef void (*binlog_emit_fn)(const char* line, size_t len, void* ctx);
+
+void binlog_start(void);
+void binlog_write(uint8_t level, const char* tag, const char* fmt, const uintptr_t* args, uint8_t nargs);
+
+// Format the last records (oldest first) into lines for emit. Returns the number emitted.
+size_t binlog_dump(binlog_emit_fn emit, void* ctx);
+
+// Records overwritten before the drain task printed them
+uint32_t binlog_lost(void);
+
+template <typename T>
+static inline uintptr_t binlog_arg(T value) {
+    static_assert(sizeof(T) <= sizeof(uint32_t) || std::is_pointer<T>::value,
+                  "binlog arguments must fit in 32 bits");
+    if constexpr (std::is_pointer<T>::value) {
+        return (uintptr_t)value;
+    } else {
+        return (uintptr_t)(uint32_t)value;
+    }
+}
+
+template <typename... Args>
+static inline void binlog(uint8_t level, const char* tag, const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= BINLOG_MAX_ARGS, "too many binlog arguments");
+    const uintptr_t packed[BINLOG_MAX_ARGS + 1] = { binlog_arg(args)..., 0 };
+    binlog_write(level, tag, fmt, packed, (uint8_t)sizeof...(Args));
+}
+
+// Never called: lets the compiler check every BLOGx format against its
+// arguments (-Wformat), which it cannot do through the template above
+static inline void binlog_format_check(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void binlog_format_check(const char*, ...) {}
+
+#define BINLOG(level, tag, fmt, ...)                                 \
+    do {                                                             \
+        if (0) binlog_format_check(fmt, ##__VA_ARGS__);              \
+        binlog(level, tag, fmt, ##__VA_ARGS__);                      \
+    } while (0)
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_ERROR
+#define BLOGE(tag, fmt, ...) BINLOG(BINLOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define BLOGE(tag, fmt, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_WARN
+#define BLOGW(tag, fmt, ...) BINLOG(BINLOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define BLOGW(tag, fmt, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_INFO
+#define BLOGI(tag, fmt, ...) BINLOG(BINLOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define BLOGI(tag, fmt, ...) do {} while (0)
+#endif
+
+#if BINLOG_LEVEL >= BINLOG_LEVEL_DEBUG
+#define BLOGD(tag, fmt, ...) BINLOG(BINLOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define BLOGD(tag, fmt, ...) do {} while (0)
+#endif
+
+#endif // BINLOG_H
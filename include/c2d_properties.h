@@ -0,0 +1,26 @@
+#ifndef C2D_PROPERTIES_H
+#define C2D_PROPERTIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// IoT Hub C2D messages carry their system and application properties as a
+// URL-encoded bag after the topic:
+//   devices/{id}/messages/devicebound/%24.mid=...&iothub-enqueuedtime=...&type=schedule
+// System property names keep their "%24." ($.) prefix.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Value of property name, still URL-encoded. Returns false if the topic has no such property.
+bool c2d_property_find(const char* topic, size_t len, const char* name, const char** value, size_t* value_len);
+
+// Whether property name is present with exactly this (encoded) value
+bool c2d_property_equals(const char* topic, size_t len, const char* name, const char* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // C2D_PROPERTIES_H
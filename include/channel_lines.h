@@ -0,0 +1,70 @@
+#ifndef CHANNEL_LINES_H
+#define CHANNEL_LINES_H
+
+#include "command_parser.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The "CHANNEL KEY=STATE KEY=STATE ...; CHANNEL ..." grammar shared by
+// schedule uploads (KEY is a time of day) and ramps (KEY is an offset).
+// Lines end at '\n' or ';'; blank lines are skipped. A channel's first
+// mention in an upload clears what it had, so a bare name empties it.
+// STATE is ON, OFF or 0-255 (command_parse_level). The caller supplies the
+// KEY parser and the storage.
+
+// Same order as schedule_parse_result_t and ramp_parse_result_t
+typedef enum {
+    CHANNEL_LINES_OK = 0,
+    CHANNEL_LINES_EMPTY,
+    CHANNEL_LINES_UNKNOWN_CHANNEL,
+    CHANNEL_LINES_BAD_KEY,
+    CHANNEL_LINES_BAD_STATE,
+    CHANNEL_LINES_TOO_MANY,
+    CHANNEL_LINES_SYNTAX,
+} channel_lines_result_t;
+
+typedef struct {
+    int (*parse_key)(const char* token, size_t len, uint32_t* key);   // 0 on success
+    void (*clear)(void* ctx, int channel);
+    bool (*insert)(void* ctx, int channel, uint32_t key, uint8_t level);   // false when full
+    void* ctx;
+} channel_lines_ops_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *mask gets a bit per channel named. On failure error_token points at the offending token.
+channel_lines_result_t channel_lines_parse(const char* data, size_t len, const channel_lines_ops_t* ops,
+                                           uint32_t* mask, cmd_token_t* error_token);
+
+#ifdef __cplusplus
+}
+
+// Insert keeping entries sorted by their key member; a repeated key replaces
+// the earlier level. False when count is already max.
+template <typename Entry>
+static inline bool channel_lines_insert(Entry* entries, uint8_t* count, int max, uint32_t Entry::*key_member,
+                                        uint32_t key, uint8_t level) {
+    int i = 0;
+    while (i < *count && entries[i].*key_member < key) {
+        i++;
+    }
+    if (i < *count && entries[i].*key_member == key) {
+        entries[i].level = level;
+        return true;
+    }
+    if (*count >= max) {
+        return false;
+    }
+    memmove(&entries[i + 1], &entries[i], (*count - i) * sizeof(Entry));
+    entries[i].*key_member = key;
+    entries[i].level = level;
+    (*count)++;
+    return true;
+}
+#endif
+
+#endif // CHANNEL_LINES_H
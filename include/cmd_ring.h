@@ -0,0 +1,53 @@
+#ifndef CMD_RING_H
+#define CMD_RING_H
+
+#include "led_channels.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bounded lock-free queue of fixed-size command records.
+// Any number of producers (MQTT task, httpd task, timers) may push concurrently;
+// exactly one consumer pops. Each slot carries a sequence number that tells
+// producers and the consumer whose turn it is, so neither side ever blocks or
+// takes a lock - a full ring simply rejects the push.
+
+typedef enum {
+    CMD_SOURCE_MQTT = 0,
+    CMD_SOURCE_HTTP,
+    CMD_SOURCE_LOCAL,
+    CMD_SOURCE_SCHEDULE,
+    CMD_SOURCE_RAMP,
+    CMD_SOURCE_COUNT,
+} cmd_source_t;
+
+typedef struct {
+    led_batch_t batch;
+    int64_t enqueue_us;   // esp_timer_get_time() when the record was pushed
+    uint32_t fade_ms;     // 0 = set now, otherwise hardware fade to the batch levels
+    uint32_t tag;         // submitter's correlation id, 0 = none
+    uint8_t source;       // cmd_source_t
+} cmd_record_t;
+
+typedef struct {
+    std::atomic<size_t> seq;
+    cmd_record_t record;
+} cmd_ring_slot_t;
+
+typedef struct {
+    cmd_ring_slot_t* slots;
+    size_t mask;                   // capacity - 1, capacity is a power of two
+    std::atomic<size_t> tail;      // next position producers claim
+    size_t head;                   // next position the consumer reads
+} cmd_ring_t;
+
+// capacity must be a power of two and match the length of slots
+void cmd_ring_init(cmd_ring_t* ring, cmd_ring_slot_t* slots, size_t capacity);
+
+// Producer side, safe from any task. Returns false when the ring is full.
+bool cmd_ring_push(cmd_ring_t* ring, const cmd_record_t* record);
+
+// Consumer side, single task only. Returns false when the ring is empty.
+bool cmd_ring_pop(cmd_ring_t* ring, cmd_record_t* record);
+
+#endif // CMD_RING_H
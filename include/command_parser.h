@@ -0,0 +1,57 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include "led_channels.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Channel command parser shared by the MQTT and HTTP front ends.
+// Parsing works directly on the received bytes: tokens are (pointer, length)
+// slices of the input, nothing is copied and the input is never modified.
+//
+// Every message parses into one batch that can address any subset of channels.
+// Accepted forms:
+//   CHANNEL:STATE[,CHANNEL:STATE...]   e.g. "RGB:ON", "RGB:ON,WHITE:OFF,VERDE:128"
+//   ALL:STATE                          every channel, e.g. "ALL:OFF"
+//   MASK:<hex>                         every channel, bit i = channel i ON, e.g. "MASK:0B"
+//   {"CHANNEL": STATE, ...}            JSON object, STATE as "ON"/"OFF", 0-255 or true/false
+//   STATE                              bare ON/OFF/level, applies to the default (RGB) channel
+// STATE is ON, OFF or a brightness level 0-255. ',' and ';' both separate entries.
+
+typedef enum {
+    CMD_PARSE_OK = 0,
+    CMD_PARSE_EMPTY,
+    CMD_PARSE_UNKNOWN_CHANNEL,
+    CMD_PARSE_BAD_STATE,
+    CMD_PARSE_SYNTAX,
+    CMD_PARSE_RESULT_COUNT,
+} cmd_parse_result_t;
+
+// Slice of the input that caused a parse error
+typedef struct {
+    const char* ptr;
+    size_t len;
+} cmd_token_t;
+
+typedef struct {
+    uint32_t errors[CMD_PARSE_RESULT_COUNT];   // failed parses by result; [CMD_PARSE_OK] stays 0
+} cmd_parse_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+cmd_parse_result_t command_parse(const char* data, size_t len, led_batch_t* batch, cmd_token_t* error_token);
+
+// Parse a STATE token (ON, OFF or 0-255). Returns 0 on success.
+int command_parse_level(const char* token, size_t len, uint8_t* level);
+
+const char* command_parse_result_str(cmd_parse_result_t result);
+
+void command_parse_get_stats(cmd_parse_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_PARSER_H
@@ -0,0 +1,59 @@
+#ifndef DEVICE_TWIN_H
+#define DEVICE_TWIN_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Azure IoT Hub device twin: channel state lives in the cloud as properties.
+//
+//   desired   {"channels": {"RGB": 128, "WHITE": "ON", "VERDE": false}}
+//   reported  {"channels": {"RGB": 128, ...}, "desired_version": 7}
+//
+// A desired patch is applied as one batch; channels set to null (removed
+// from the twin) are left alone. On every connect the full twin is fetched
+// and its desired channels applied only if their $version differs from the
+// last one applied (kept in NVS), so a reconnect does not undo local changes.
+//
+// Reported properties follow the actuator. Changes only mark channels dirty;
+// a low-priority task sends one patch with all of them, then waits
+// TWIN_REPORT_INTERVAL_MS before the next, so bursts of commands cost at
+// most one reported patch per interval. Changes made offline go out on
+// reconnect.
+
+#define TWIN_REPORT_INTERVAL_MS  5000
+#define TWIN_TOPIC_PREFIX        "$iothub/twin/"
+
+// Publish hook: enqueue data on topic. Returns a message id, or -1 if it was not accepted.
+typedef int (*device_twin_publish_fn)(const char* topic, const char* data, size_t len);
+
+typedef struct {
+    uint32_t desired_patches;      // desired batches applied (patches and full twins)
+    uint32_t desired_version;      // last desired $version applied
+    uint32_t desired_errors;       // desired documents that did not parse
+    uint32_t reported_patches;     // reported patches handed to MQTT
+    uint32_t reported_changes;     // actuator writes folded into them
+    uint32_t reported_errors;      // patches the hub answered with an error status
+} device_twin_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t device_twin_start(device_twin_publish_fn publish);
+
+// Connection state from the MQTT event handler, after the twin topics are subscribed
+void device_twin_on_connected(void);
+void device_twin_on_disconnected(void);
+
+// A complete message on a $iothub/twin/ topic
+void device_twin_on_message(const char* topic, size_t topic_len, const char* data, size_t len);
+
+void device_twin_get_stats(device_twin_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEVICE_TWIN_H
@@ -0,0 +1,57 @@
+#ifndef DIRECT_METHODS_H
+#define DIRECT_METHODS_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Azure IoT Hub direct methods: synchronous commands that the caller sees
+// answered, unlike C2D messages.
+//
+//   setChannels  payload: any command form (JSON object or "RGB:ON,WHITE:128")
+//   allOff       no payload, safety lane
+//   getChannels  current levels
+//
+// Requests arrive on $iothub/methods/POST/{method}/?$rid={rid}; the answer
+// goes to $iothub/methods/res/{status}/?$rid={rid}. Commands are answered
+// from the actuation point: the actuator listener stamps the request when
+// its batch reaches the GPIO/LEDC registers and a responder task publishes
+//   {"ok":true,"channels":2,"latency_us":850,"queue_us":40}
+// where latency_us runs from the request reaching the device to the
+// hardware write and queue_us is the part spent in the actuator queue.
+// A command superseded by an ALL:OFF, or not applied within
+// METHOD_TIMEOUT_MS, is answered 504.
+
+#define METHOD_MAX_PENDING    8
+#define METHOD_TIMEOUT_MS     5000
+#define METHOD_TOPIC_PREFIX   "$iothub/methods/"
+
+// Publish hook: enqueue data on topic. Returns a message id, or -1 if it was not accepted.
+typedef int (*direct_methods_publish_fn)(const char* topic, const char* data, size_t len);
+
+typedef struct {
+    uint32_t requests;
+    uint32_t commands;             // batches handed to the actuator
+    uint32_t applied;              // commands answered from the actuator
+    uint32_t errors;               // answered 4xx/5xx
+    uint32_t timeouts;             // of which 504 (superseded or timed out)
+    uint32_t last_latency_us;      // request -> hardware write
+    uint32_t max_latency_us;
+} direct_methods_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t direct_methods_start(direct_methods_publish_fn publish);
+
+// A complete message on a $iothub/methods/POST/ topic. Runs on the MQTT task.
+void direct_methods_on_request(const char* topic, size_t topic_len, const char* data, size_t len);
+
+void direct_methods_get_stats(direct_methods_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRECT_METHODS_H
@@ -0,0 +1,54 @@
+#ifndef HTTP_QUERY_H
+#define HTTP_QUERY_H
+
+#include "command_parser.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Query string handling for GET /led, kept free of esp_http_server so it also
+// builds on the host. Values are percent-decoded ('%XX', '+' for space) into
+// the led_query_t before parsing, so browsers and curl can send any syntax
+// the command parser accepts.
+//
+//   ?cmd=<command>                  any form command_parse accepts
+//   ?channel=<name>&state=<STATE>   one channel, STATE as ON, OFF or 0-255
+
+#define HTTP_QUERY_MAX 256         // longest query string /led accepts
+
+typedef enum {
+    LED_QUERY_OK = 0,
+    LED_QUERY_NO_CHANNEL,        // neither cmd nor channel present
+    LED_QUERY_NO_STATE,
+    LED_QUERY_UNKNOWN_CHANNEL,   // token = channel value
+    LED_QUERY_BAD_STATE,         // token = state value
+    LED_QUERY_BAD_COMMAND,       // cmd form; cmd_result and token from command_parse
+} led_query_result_t;
+
+typedef struct {
+    led_batch_t batch;
+    bool batch_form;             // ?cmd= rather than ?channel=&state=
+    int channel;                 // single-channel form: registry index
+    cmd_parse_result_t cmd_result;
+    cmd_token_t token;           // points into decoded
+    char decoded[HTTP_QUERY_MAX];
+} led_query_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Value of `key` in a query string (without the leading '?'). Returns false if absent.
+bool http_query_find(const char* query, size_t len, const char* key, cmd_token_t* value);
+
+// Percent-decodes `len` bytes of a query value into `out` ('+' becomes a space,
+// malformed escapes are kept as they are). Returns the decoded length, or -1
+// if it does not fit in out_size.
+int http_query_decode(const char* value, size_t len, char* out, size_t out_size);
+
+led_query_result_t led_query_parse(const char* query, size_t len, led_query_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HTTP_QUERY_H
@@ -0,0 +1,87 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// End-to-end latency of C2D commands, from IoT Hub to the LED hardware.
+// Each command is stamped along the way and split into stages:
+//
+//   cloud     hub enqueue time (topic property) -> TLS read on the device
+//   mqtt      TLS read -> MQTT_EVENT_DATA (esp-mqtt parsing and dispatch)
+//   handler   MQTT_EVENT_DATA -> parsed and queued for the actuator
+//   actuator  queued -> GPIO/LEDC write
+//   total     hub enqueue -> GPIO/LEDC write
+//
+// The enqueue time is read from iothub-enqueuedtime, or else $.ctime (the
+// sender's creation time), as ISO 8601 UTC or epoch milliseconds. cloud and
+// total compare it with the device clock, so they only exist once SNTP has
+// set it and include its error (tens of ms). mqtt uses the last TLS read
+// before the event, which for messages that arrive back to back may belong
+// to an earlier one; without a read time (esp-mqtt's own transport) there is
+// no mqtt stage and cloud runs to MQTT_EVENT_DATA.
+//
+// Every stage has a fixed-bucket histogram. Every LATENCY_TRACE_SAMPLE_EVERY
+// traced command, one record is kept for the telemetry task to publish:
+//   {"type":"trace","mid":"...","cloud_ms":120,"mqtt_us":310,"handler_us":45,
+//    "actuator_us":80,"total_ms":121}
+// The MQTT task stamps and the actuator listener finishes a trace, and
+// the telemetry task publishes it. None of them block; all state is in atomics.
+
+#define LATENCY_TRACE_SLOTS         8       // commands in flight between parser and hardware
+#define LATENCY_TRACE_TIMEOUT_MS    5000    // slot of a command never applied is reclaimed
+#define LATENCY_TRACE_SAMPLE_EVERY  16
+#define LATENCY_TRACE_BUCKETS       9       // finite bounds; one more bucket above the last
+#define LATENCY_TRACE_MID_MAX       40
+#define LATENCY_TRACE_JSON_MAX      192
+
+typedef enum {
+    TRACE_STAGE_CLOUD = 0,
+    TRACE_STAGE_MQTT,
+    TRACE_STAGE_HANDLER,
+    TRACE_STAGE_ACTUATOR,
+    TRACE_STAGE_TOTAL,
+    TRACE_STAGE_COUNT,
+} trace_stage_t;
+
+typedef struct {
+    uint32_t traced;               // commands followed to the hardware write
+    uint32_t untraced;             // no free slot, not queued, or never applied
+    uint32_t sampled;              // records handed to telemetry
+    // Per stage: bucket i counts latencies <= LATENCY_TRACE_BOUNDS_US[i] and
+    // above the previous bound; the last bucket is everything slower
+    uint32_t buckets[TRACE_STAGE_COUNT][LATENCY_TRACE_BUCKETS + 1];
+    uint64_t sum_us[TRACE_STAGE_COUNT];
+} latency_trace_stats_t;
+
+extern const uint32_t LATENCY_TRACE_BOUNDS_US[LATENCY_TRACE_BUCKETS];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t latency_trace_start(void);
+
+// A C2D command parsed on the MQTT task. topic carries the message
+// properties; tls_rx_us and event_us are esp_timer times of the TLS read
+// (0 if unknown) and of MQTT_EVENT_DATA. Returns the actuator tag to submit
+// the batch with, 0 when the command is not traced.
+uint32_t latency_trace_begin(const char* topic, size_t topic_len, int64_t tls_rx_us, int64_t event_us);
+
+// The batch tagged by latency_trace_begin() was not queued
+void latency_trace_cancel(uint32_t tag);
+
+// Telemetry task: copies a pending sample record as JSON. Returns its length, 0 if none.
+size_t latency_trace_take_sample(char* out, size_t size);
+
+// Stage names ("cloud", "mqtt", ...) for reports and metrics
+const char* latency_trace_stage_name(trace_stage_t stage);
+
+void latency_trace_get_stats(latency_trace_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_TRACE_H
@@ -2,6 +2,10 @@
 #define LED_CHANNELS_H
 
 #include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
 
 // LED Channel definitions
 #define CHANNEL_RGB_PIN     GPIO_NUM_17
@@ -15,17 +19,192 @@
 #define CHANNEL_VERDE_NAME   "VERDE"
 #define CHANNEL_FAR_RED_NAME "FAR_RED"
 
+// PWM configuration
+// Levels are perceptual brightness steps (0 = off, LED_LEVEL_MAX = full on).
+// They go through a CIE 1931 lightness table before reaching the LEDC duty register.
+#define LED_LEVEL_MAX              255
+#define LED_PWM_SPEED_MODE         LEDC_HIGH_SPEED_MODE
+#define LED_PWM_DEFAULT_FREQ_HZ    5000
+#define LED_PWM_DEFAULT_RESOLUTION LEDC_TIMER_13_BIT
+
+// Channel registry entry
+typedef struct {
+    const char* name;
+    gpio_num_t pin;
+    ledc_channel_t ledc_channel;
+    ledc_timer_t ledc_timer;
+} led_channel_def_t;
+
+// Target levels for a set of channels, applied as one unit
+#define LED_BATCH_MAX_CHANNELS 32
+
+typedef struct {
+    uint32_t mask;                          // bit i set = channel i (index into LED_CHANNELS) addressed
+    uint8_t level[LED_BATCH_MAX_CHANNELS];  // 0 = off, LED_LEVEL_MAX = full on
+} led_batch_t;
+
 #ifdef __cplusplus
+
+// Channel registry - the single source for names, pins and LEDC routing.
+// HTTP, MQTT and the web UI are all generated from this table; adding a
+// channel is one line here. Channels sharing an LEDC timer share its
+// frequency and resolution.
+static constexpr led_channel_def_t LED_CHANNELS[] = {
+    { CHANNEL_RGB_NAME,     CHANNEL_RGB_PIN,     LEDC_CHANNEL_0, LEDC_TIMER_0 },
+    { CHANNEL_WHITE_NAME,   CHANNEL_WHITE_PIN,   LEDC_CHANNEL_1, LEDC_TIMER_1 },
+    { CHANNEL_VERDE_NAME,   CHANNEL_VERDE_PIN,   LEDC_CHANNEL_2, LEDC_TIMER_2 },
+    { CHANNEL_FAR_RED_NAME, CHANNEL_FAR_RED_PIN, LEDC_CHANNEL_3, LEDC_TIMER_3 },
+};
+
+static constexpr int LED_CHANNEL_COUNT = sizeof(LED_CHANNELS) / sizeof(LED_CHANNELS[0]);
+
+constexpr size_t led_name_length(const char* s) {
+    size_t len = 0;
+    while (s[len] != '\0') {
+        len++;
+    }
+    return len;
+}
+
+constexpr bool led_name_equals(const char* a, size_t a_len, const char* b) {
+    for (size_t i = 0; i < a_len; i++) {
+        if (b[i] == '\0' || a[i] != b[i]) {
+            return false;
+        }
+    }
+    return b[a_len] == '\0';
+}
+
+// Seeded FNV-1a over (pointer, length) so tokens can be looked up in place
+constexpr uint32_t led_name_hash(const char* s, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Lookup slots: next power of two with at least 2x headroom over the channel count
+constexpr size_t led_lookup_slot_count(size_t n) {
+    size_t slots = 1;
+    while (slots < 2 * n) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+static constexpr size_t LED_LOOKUP_SLOTS = led_lookup_slot_count(LED_CHANNEL_COUNT);
+
+typedef struct {
+    uint32_t seed;
+    int8_t slot[LED_LOOKUP_SLOTS];
+} led_lookup_table_t;
+
+// Search for a seed that maps every channel name to its own slot (perfect hash)
+constexpr led_lookup_table_t led_build_lookup_table(void) {
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        led_lookup_table_t table = {};
+        table.seed = seed;
+        for (size_t s = 0; s < LED_LOOKUP_SLOTS; s++) {
+            table.slot[s] = -1;
+        }
+        bool collision = false;
+        for (int i = 0; i < LED_CHANNEL_COUNT && !collision; i++) {
+            const char* name = LED_CHANNELS[i].name;
+            size_t s = led_name_hash(name, led_name_length(name), seed) & (LED_LOOKUP_SLOTS - 1);
+            if (table.slot[s] >= 0) {
+                collision = true;
+            } else {
+                table.slot[s] = (int8_t)i;
+            }
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+    return led_lookup_table_t{ 0xFFFFFFFFu, {} };
+}
+
+static constexpr led_lookup_table_t LED_LOOKUP = led_build_lookup_table();
+
+static_assert(LED_LOOKUP.seed != 0xFFFFFFFFu, "no perfect hash seed for the channel names");
+
+// Channel index for a name, or -1. One hash plus one compare regardless of channel count.
+constexpr int led_channel_find(const char* name, size_t len) {
+    int i = LED_LOOKUP.slot[led_name_hash(name, len, LED_LOOKUP.seed) & (LED_LOOKUP_SLOTS - 1)];
+    return (i >= 0 && led_name_equals(name, len, LED_CHANNELS[i].name)) ? i : -1;
+}
+
+constexpr uint64_t led_channel_pin_mask(int channel) {
+    return 1ULL << LED_CHANNELS[channel].pin;
+}
+
+constexpr uint64_t led_channels_pin_mask(void) {
+    uint64_t mask = 0;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        mask |= led_channel_pin_mask(i);
+    }
+    return mask;
+}
+
+// All channel pins, one bit per GPIO
+static constexpr uint64_t LED_CHANNELS_PIN_MASK = led_channels_pin_mask();
+
+constexpr bool led_channels_unique(void) {
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        for (int j = i + 1; j < LED_CHANNEL_COUNT; j++) {
+            const char* name = LED_CHANNELS[i].name;
+            if (LED_CHANNELS[i].pin == LED_CHANNELS[j].pin ||
+                LED_CHANNELS[i].ledc_channel == LED_CHANNELS[j].ledc_channel ||
+                led_name_equals(name, led_name_length(name), LED_CHANNELS[j].name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(led_channels_unique(), "channel names, pins and LEDC channels must be unique");
+static_assert(LED_CHANNEL_COUNT <= LEDC_CHANNEL_MAX, "more channels than LEDC channels");
+static_assert(LED_CHANNEL_COUNT <= LED_BATCH_MAX_CHANNELS, "batch mask too narrow for the channel registry");
+static_assert(LED_CHANNELS_PIN_MASK >> 32 == 0, "ON/OFF edges use GPIO_OUT_W1TS/W1TC, which cover GPIO 0-31");
+
+// Batch mask addressing every channel
+static constexpr uint32_t LED_CHANNELS_ALL =
+    (LED_CHANNEL_COUNT >= 32) ? 0xFFFFFFFFu : ((1u << LED_CHANNEL_COUNT) - 1);
+
+// Channel driven by the legacy bare "ON"/"OFF" command
+static constexpr int LED_CHANNEL_DEFAULT = led_channel_find(CHANNEL_RGB_NAME, sizeof(CHANNEL_RGB_NAME) - 1);
+
 extern "C" {
 #endif
 
+// Channels are addressed by their index in LED_CHANNELS.
 void led_channels_init(void);
-void led_channel_set(gpio_num_t pin, int level);
-int led_channel_get(gpio_num_t pin);
+
+// Reconfigure the PWM timer that drives a channel. The current level is kept.
+esp_err_t led_channel_configure(int channel, uint32_t freq_hz, ledc_timer_bit_t resolution);
+
+// Apply a batch of levels. Channels switched fully ON/OFF are driven straight from
+// the GPIO output register, and all their edges land with one W1TS and one W1TC
+// write; intermediate levels go through LEDC. Cancels fades on addressed channels.
+esp_err_t led_channels_apply(const led_batch_t* batch);
+
+// Set a channel to a brightness level immediately (cancels any fade in progress).
+esp_err_t led_channel_set_level(int channel, uint8_t level);
+
+// Fade a channel to a brightness level in hardware. Returns without waiting.
+esp_err_t led_channel_fade_to(int channel, uint8_t level, uint32_t fade_ms);
+
+// Last level requested for a channel (the fade target while a fade is running).
+uint8_t led_channel_get_level(int channel);
+
+// Map a perceptual level to the raw duty value for a given timer resolution.
+uint32_t led_level_to_duty(uint8_t level, ledc_timer_bit_t resolution);
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif // LED_CHANNELS_H
-
@@ -0,0 +1,28 @@
+#ifndef LED_STATE_H
+#define LED_STATE_H
+
+#include "esp_err.h"
+
+// Last LED levels, kept in NVS so the lights come back as they were after a
+// power cut instead of waiting for the network. Saving is debounced: a burst
+// of commands (a slider being dragged) costs one flash write once it settles.
+
+#define LED_STATE_SAVE_DELAY_MS   5000    // quiet time before a change is written
+#define LED_STATE_SAVE_MAX_MS     30000   // upper bound while changes keep coming
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Queue the saved levels to the actuator. Needs NVS and a running actuator.
+// Returns ESP_ERR_NOT_FOUND when nothing was saved yet (first boot).
+esp_err_t led_state_restore(void);
+
+// Start following the actuator and saving changes.
+esp_err_t led_state_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_STATE_H
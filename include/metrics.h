@@ -0,0 +1,35 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+// Runtime counters in the Prometheus text format (0.0.4), served on GET
+// /metrics. Every value is read from a module's *_get_stats() snapshot, which
+// only loads the atomics the module already updates; nothing on the command,
+// MQTT or LED paths waits for a scrape. The one lock a scrape takes is the
+// telemetry spool's, to copy its four counters.
+//
+// The text is never assembled in full: lines go into a METRICS_CHUNK_SIZE
+// buffer on the caller's stack that is handed to the writer each time it
+// fills (httpd_resp_send_chunk on the web server).
+
+#define METRICS_CHUNK_SIZE  512
+#define METRICS_LINE_MAX    160
+
+typedef void (*metrics_write_fn)(const char* text, size_t len, void* ctx);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resolves the task handles for the per-task stack series. Call once every
+// task exists; scrapes before that leave the series out.
+void metrics_init(void);
+
+void metrics_format(metrics_write_fn write, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METRICS_H
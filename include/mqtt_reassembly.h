@@ -0,0 +1,61 @@
+#ifndef MQTT_REASSEMBLY_H
+#define MQTT_REASSEMBLY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Reassembles MQTT_EVENT_DATA fragments into one contiguous message.
+// ESP-MQTT delivers payloads larger than its receive buffer as several events
+// that share msg_id; the first carries the topic and current_data_offset 0,
+// the rest continue at increasing offsets. Fragments are copied once into a
+// preallocated buffer, so message size is bounded and nothing lands on the
+// MQTT task stack.
+
+#ifndef MQTT_REASSEMBLY_MAX_MESSAGE
+#define MQTT_REASSEMBLY_MAX_MESSAGE 2048
+#endif
+
+// IoT Hub C2D topics carry the message's system and application properties
+// ($.mid, $.to, $.ct, iothub-enqueuedtime, type=...): a few hundred bytes
+#ifndef MQTT_REASSEMBLY_MAX_TOPIC
+#define MQTT_REASSEMBLY_MAX_TOPIC 512
+#endif
+
+typedef enum {
+    MQTT_REASSEMBLY_COMPLETE = 0,   // whole message available
+    MQTT_REASSEMBLY_PENDING,        // fragment stored, more to come
+    MQTT_REASSEMBLY_TOO_LARGE,      // message exceeds the buffer; its fragments are discarded
+    MQTT_REASSEMBLY_OUT_OF_ORDER,   // fragment does not continue the current message
+} mqtt_reassembly_status_t;
+
+typedef struct {
+    char data[MQTT_REASSEMBLY_MAX_MESSAGE + 1];   // +1 keeps the message NUL-terminated for logging
+    char topic[MQTT_REASSEMBLY_MAX_TOPIC + 1];
+    size_t data_len;
+    size_t topic_len;
+    size_t total_len;
+    int msg_id;
+    bool in_progress;
+    bool discarding;
+    bool topic_truncated;   // topic longer than MQTT_REASSEMBLY_MAX_TOPIC: only its start is kept
+} mqtt_reassembly_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void mqtt_reassembly_reset(mqtt_reassembly_t* r);
+
+// Feed one MQTT_EVENT_DATA event. On MQTT_REASSEMBLY_COMPLETE the message is in
+// r->data / r->data_len and its topic in r->topic / r->topic_len; both stay valid
+// until the next call. Check r->topic_truncated before routing on the topic.
+mqtt_reassembly_status_t mqtt_reassembly_feed(mqtt_reassembly_t* r, int msg_id,
+                                              const char* topic, size_t topic_len,
+                                              const char* data, size_t data_len,
+                                              size_t offset, size_t total_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MQTT_REASSEMBLY_H
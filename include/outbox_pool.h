@@ -0,0 +1,55 @@
+#ifndef OUTBOX_POOL_H
+#define OUTBOX_POOL_H
+
+#include <stdint.h>
+
+// esp-mqtt outbox (CONFIG_MQTT_CUSTOM_OUTBOX) in a fixed static pool instead
+// of the heap, so a slow broker can no longer grow it without limit.
+//
+// Messages are copied into slots of three sizes (small for twin patches,
+// method answers and subscriptions, medium for telemetry batches, large for
+// the odd oversized record); a message takes the smallest free slot that
+// fits. Queued bytes are held to OUTBOX_BUDGET_BYTES:
+//   - telemetry (devices/{id}/messages/events/) evicts the oldest telemetry
+//     still QUEUED to make room, and is refused when there is none left to
+//     evict; the caller then spools it to flash. Telemetry already sent and
+//     waiting for its PUBACK is never evicted, so the spool's in-flight
+//     records are always acked or failed over by esp-mqtt itself
+//   - everything else (twin, method answers, subscriptions, acks) is never
+//     evicted and may use the pool beyond the budget
+// The pool itself is the hard limit.
+//
+// esp-mqtt calls the outbox with its client lock held; only the stats are
+// read from other tasks.
+
+#define OUTBOX_SMALL_SLOT       256
+#define OUTBOX_SMALL_SLOTS      16
+#define OUTBOX_MEDIUM_SLOT      1280     // TELEMETRY_BUFFER_SIZE payload plus topic and header
+#define OUTBOX_MEDIUM_SLOTS     6
+#define OUTBOX_LARGE_SLOT       2304     // a full TELEMETRY_SPOOL_RECORD_MAX record
+#define OUTBOX_LARGE_SLOTS      1
+#ifndef OUTBOX_BUDGET_BYTES
+#define OUTBOX_BUDGET_BYTES     8192
+#endif
+
+typedef struct {
+    uint32_t items;                // messages held now
+    uint32_t bytes;                // message bytes held now (esp_mqtt_client_get_outbox_size)
+    uint32_t peak_bytes;
+    uint32_t slots_free;           // over all sizes
+    uint32_t evicted;              // telemetry dropped to make room
+    uint32_t evicted_bytes;
+    uint32_t refused;              // enqueues that found neither budget nor a slot
+} outbox_pool_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void outbox_pool_get_stats(outbox_pool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OUTBOX_POOL_H
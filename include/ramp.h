@@ -0,0 +1,90 @@
+#ifndef RAMP_H
+#define RAMP_H
+
+#include "command_parser.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Keyframe ramps: slow, coordinated level changes (sunrise, sunset) computed
+// on the device, so the cloud sends one message instead of streaming steps.
+//
+// Upload format, one channel per line or ';'-separated:
+//   FAR_RED 0=0 20m=255
+//   WHITE 5m=0 30m=200 45m=180
+//   VERDE                          (no keyframes: stop after the fade in progress)
+// OFFSET=STATE pairs, offsets from the moment the upload is applied in plain
+// seconds or with an ms/s/m/h suffix, levels ON, OFF or 0-255. A channel
+// whose first keyframe is after 0 starts from its current level. Levels are
+// interpolated linearly in Q16 fixed point.
+//
+// The engine never steps levels itself. Each segment is handed to the LEDC
+// hardware fade in chunks of at most RAMP_CHUNK_LEVELS levels (the CIE duty
+// curve is close to a straight line over that span), and one one-shot
+// esp_timer shared by all channels wakes at the earliest chunk end: a 0-255
+// sunrise over 30 minutes is 16 fades and 16 wakeups. Any other command to a
+// ramping channel ends its ramp there.
+
+#define RAMP_MAX_KEYFRAMES  8
+#define RAMP_MAX_MS         86400000u   // last keyframe at most a day out
+#define RAMP_CHUNK_LEVELS   16          // levels per hardware fade
+#define RAMP_MIN_CHUNK_MS   250         // fast ramps move more levels per fade instead
+#define RAMP_COALESCE_MS    100         // chunks ending this close share a wakeup
+
+typedef struct {
+    uint32_t offset_ms;                 // from the start of the ramp
+    uint8_t level;
+} ramp_keyframe_t;
+
+typedef struct {
+    uint8_t count;
+    ramp_keyframe_t key[RAMP_MAX_KEYFRAMES + 1];    // +1 for the implicit starting point
+} ramp_track_t;
+
+typedef enum {
+    RAMP_PARSE_OK = 0,
+    RAMP_PARSE_EMPTY,
+    RAMP_PARSE_UNKNOWN_CHANNEL,
+    RAMP_PARSE_BAD_OFFSET,
+    RAMP_PARSE_BAD_STATE,
+    RAMP_PARSE_TOO_MANY,
+    RAMP_PARSE_SYNTAX,
+} ramp_parse_result_t;
+
+typedef struct {
+    uint32_t uploads;                   // ramps accepted
+    uint32_t fades;                     // hardware fades handed to the actuator
+    uint32_t wakeups;                   // timer callbacks
+    uint32_t finished;                  // channel ramps that reached their last keyframe
+    uint32_t cancelled;                 // channel ramps ended by another command
+    uint32_t active_mask;               // channels ramping now
+} ramp_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Parse an upload into tracks (indexed like LED_CHANNELS), keyframes sorted by
+// offset. Bit i of *mask is set for every channel the upload names.
+ramp_parse_result_t ramp_parse(const char* data, size_t len, ramp_track_t* tracks, uint32_t* mask,
+                               cmd_token_t* error_token);
+const char* ramp_parse_result_str(ramp_parse_result_t result);
+
+// Level at offset_ms in Q16 (level << 16); the last keyframe's level past the end
+uint32_t ramp_level_q16(const ramp_track_t* track, uint32_t offset_ms);
+
+// End of the hardware fade that starts at offset_ms, or UINT32_MAX past the last keyframe
+uint32_t ramp_chunk_end(const ramp_track_t* track, uint32_t offset_ms);
+
+esp_err_t ramp_start(void);
+
+// Start the ramps of the channels named in an upload, replacing running ones
+esp_err_t ramp_set(const char* data, size_t len);
+
+void ramp_get_stats(ramp_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAMP_H
@@ -0,0 +1,40 @@
+#ifndef SAS_TOKEN_H
+#define SAS_TOKEN_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// IoT Hub Shared Access Signatures signed on the device, so no token with a
+// fixed expiry has to be compiled in:
+//
+//   SharedAccessSignature sr={resource}&sig={signature}&se={expiry}
+//
+// resource is "{hub hostname}/devices/{device id}" URL-encoded, signature the
+// base64 HMAC-SHA256 of "{resource}\n{expiry}" under the device's symmetric
+// key, expiry in Unix seconds. The key is kept in NVS as raw bytes.
+
+#define SAS_KEY_MAX        64      // IoT Hub symmetric keys are 16-64 bytes
+#define SAS_TOKEN_MAX      256
+#define SAS_NAMESPACE      "picapica"
+#define SAS_KEY_NVS_KEY    "device_key"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sign a token for resource_uri (not yet encoded) valid until expiry
+esp_err_t sas_token_build(const char* resource_uri, const uint8_t* key, size_t key_len, uint32_t expiry,
+                          char* out, size_t size);
+
+// Device key from NVS. ESP_ERR_NVS_NOT_FOUND if it was never provisioned.
+esp_err_t sas_token_load_key(uint8_t* key, size_t* key_len);
+
+// Store a base64 key (the "Primary key" shown by the portal) in NVS
+esp_err_t sas_token_provision_key(const char* key_base64);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAS_TOKEN_H
@@ -0,0 +1,94 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "command_parser.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// On-device photoperiod scheduler. Each channel has a daily table of
+// (time of day, level) edges in local time. The tables are kept in NVS and
+// run locally once the clock is set (time_sync.h), so light changes neither
+// wait for nor depend on the cloud; MQTT only uploads new tables.
+//
+// Upload format, one channel per line or ';'-separated:
+//   FAR_RED 06:00=ON 19:45=255 20:00=OFF
+//   WHITE 07:00:30=128 21:00=0
+//   VERDE                                  (no edges: channel unscheduled)
+// Times are HH:MM[:SS[.mmm]], levels ON, OFF or 0-255. Channels not named in
+// an upload keep their table. Edges within the same millisecond are applied
+// as one batch.
+//
+// The next edge of all channels is armed on a single one-shot esp_timer, so
+// the scheduler costs one wakeup per edge and fires within the millisecond.
+// A manual command holds until the channel's next edge. When the timer finds
+// the local clock more than a second off (DST change, clock step) it applies
+// the levels in effect at that moment instead of the edge it was armed for.
+
+#define SCHEDULE_MAX_ENTRIES  16            // edges per channel and day
+#define SCHEDULE_DAY_MS       86400000u
+
+typedef struct {
+    uint32_t time_ms;                       // milliseconds since local midnight
+    uint8_t level;
+} schedule_entry_t;
+
+typedef struct {
+    uint8_t count;
+    schedule_entry_t entry[SCHEDULE_MAX_ENTRIES];   // sorted by time_ms, unique times
+} schedule_table_t;
+
+typedef enum {
+    SCHEDULE_PARSE_OK = 0,
+    SCHEDULE_PARSE_EMPTY,
+    SCHEDULE_PARSE_UNKNOWN_CHANNEL,
+    SCHEDULE_PARSE_BAD_TIME,
+    SCHEDULE_PARSE_BAD_STATE,
+    SCHEDULE_PARSE_TOO_MANY,
+    SCHEDULE_PARSE_SYNTAX,
+} schedule_parse_result_t;
+
+typedef struct {
+    uint32_t edges;                         // edge batches applied
+    uint32_t uploads;                       // tables accepted over MQTT
+    int32_t last_error_ms;                  // wall clock at firing minus edge time, most recent edge
+    int32_t max_error_ms;                   // largest magnitude seen
+    uint32_t resyncs;                       // timer found the clock moved under it
+    uint32_t scheduled_mask;                // channels with a non-empty table
+} schedule_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Parse an upload into tables (indexed like LED_CHANNELS). Bit i of *mask is
+// set for every channel the upload names. Nothing is applied.
+schedule_parse_result_t schedule_parse(const char* data, size_t len, schedule_table_t* tables,
+                                       uint32_t* mask, cmd_token_t* error_token);
+const char* schedule_parse_result_str(schedule_parse_result_t result);
+
+// Level in effect at time_ms: the last edge at or before it, wrapping to the
+// previous day's last edge. -1 for an empty table.
+int schedule_level_at(const schedule_table_t* table, uint32_t time_ms);
+
+// Milliseconds from time_ms to the table's next edge strictly after it
+// (wrapping past midnight), or UINT32_MAX for an empty table.
+uint32_t schedule_ms_until_next(const schedule_table_t* table, uint32_t time_ms);
+
+// Load the tables from NVS. Nothing runs until schedule_on_time_set().
+esp_err_t schedule_start(void);
+
+// Replace the tables of the channels named in an upload, persist and apply them.
+esp_err_t schedule_set(const char* data, size_t len);
+
+// The wall clock was set (first call: apply the levels in effect now) or
+// corrected by a later sync (re-arm only).
+void schedule_on_time_set(void);
+
+void schedule_get_stats(schedule_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHEDULE_H
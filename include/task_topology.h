@@ -0,0 +1,105 @@
+#ifndef TASK_TOPOLOGY_H
+#define TASK_TOPOLOGY_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
+
+// Where every firmware task runs: stack, priority and core, in one table.
+// Modules create their tasks through task_topology_create() instead of
+// carrying their own numbers; esp-mqtt and httpd are configured from the
+// same table.
+//
+// Profiles (TASK_TOPOLOGY_PROFILE, a build flag):
+//   SHARED  no task is pinned; the scheduler spreads them over both cores,
+//           so TLS, HTTP parsing and LED writes compete wherever they land
+//   SPLIT   core 0 keeps the network: WiFi, lwIP and esp_timer (pinned there
+//           by sdkconfig), MQTT/TLS, httpd and the tasks that feed them.
+//           Core 1 only runs the actuator, so a TLS record being decrypted
+//           never delays an LED write.
+//
+// esp-mqtt takes its core from sdkconfig only, not from the client config, so
+// each profile builds with its own sdkconfig: SPLIT pins the MQTT and lwIP
+// tcpip tasks to core 0 (sdkconfig.esp32doit-devkit-v1), SHARED leaves them
+// unpinned (sdkconfig.esp32doit-devkit-v1-shared, env esp32doit-devkit-v1-shared).
+// task_topology_check() reports any task that ended up somewhere else than
+// the table says.
+//
+// A probe task at actuator priority on the actuator's core wakes every
+// TOPOLOGY_PROBE_PERIOD_MS and records how far each wakeup strays from the
+// period: the scheduling jitter an LED write sees under the current profile,
+// exported on /metrics next to the profile name.
+
+#define TASK_TOPOLOGY_SHARED 0
+#define TASK_TOPOLOGY_SPLIT  1
+
+#ifndef TASK_TOPOLOGY_PROFILE
+#define TASK_TOPOLOGY_PROFILE TASK_TOPOLOGY_SPLIT
+#endif
+
+#define TOPOLOGY_NETWORK_CORE     0      // PRO_CPU, where sdkconfig pins WiFi
+#define TOPOLOGY_CONTROL_CORE     1      // APP_CPU
+#define TOPOLOGY_PROBE_PERIOD_MS  10     // one tick at CONFIG_FREERTOS_HZ=100
+#define TOPOLOGY_JITTER_BUCKETS   7      // finite bounds; one more bucket above the last
+
+typedef enum {
+    TASK_ROLE_ACTUATOR = 0,
+    TASK_ROLE_JITTER_PROBE,
+    TASK_ROLE_MQTT,
+    TASK_ROLE_HTTPD,
+    TASK_ROLE_METHODS,
+    TASK_ROLE_TWIN,
+    TASK_ROLE_SAS_RENEW,
+    TASK_ROLE_TELEMETRY,
+    TASK_ROLE_SPOOL,
+    TASK_ROLE_LED_STATE,
+    TASK_ROLE_BINLOG,
+    TASK_ROLE_COUNT,
+} task_role_t;
+
+typedef struct {
+    const char* name;
+    uint32_t stack;                // bytes
+    UBaseType_t priority;
+    BaseType_t core;               // tskNO_AFFINITY when not pinned
+} task_spec_t;
+
+typedef struct {
+    uint32_t samples;              // probe wakeups measured
+    uint32_t last_us;              // |interval - period|, most recent wakeup
+    uint32_t max_us;
+    uint64_t total_us;             // divide by samples for the mean
+    // Bucket i counts jitter <= TOPOLOGY_JITTER_BOUNDS_US[i] and above the
+    // previous bound; the last bucket is everything worse
+    uint32_t buckets[TOPOLOGY_JITTER_BUCKETS + 1];
+} task_topology_stats_t;
+
+extern const uint32_t TOPOLOGY_JITTER_BOUNDS_US[TOPOLOGY_JITTER_BUCKETS];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const task_spec_t* task_topology_spec(task_role_t role);
+
+// xTaskCreatePinnedToCore() with the role's name, stack, priority and core
+BaseType_t task_topology_create(task_role_t role, TaskFunction_t fn, void* arg, TaskHandle_t* handle);
+
+// "shared" or "split"
+const char* task_topology_profile_name(void);
+
+// Starts the jitter probe
+esp_err_t task_topology_start(void);
+
+// Logs each running task whose priority or core differs from the table.
+// Returns the number of mismatches.
+int task_topology_check(void);
+
+void task_topology_get_stats(task_topology_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TASK_TOPOLOGY_H
@@ -0,0 +1,33 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "telemetry_encoder.h"
+#include "esp_err.h"
+#include <stdint.h>
+
+// Periodic telemetry. A low-priority task samples the channel levels every
+// sample period and publishes them in batches, so the message count grows
+// with the publish interval rather than the sampling rate. Payloads are
+// encoded into a static buffer; the telemetry path never allocates.
+// Batches published while offline go to the flash spool (telemetry_spool.h).
+
+#define TELEMETRY_SAMPLE_PERIOD_MS    5000
+#define TELEMETRY_SAMPLES_PER_PUBLISH 6      // one message every 30 s by default
+#define TELEMETRY_MAX_SAMPLES         32     // samples held if a batch can be neither sent nor spooled
+#define TELEMETRY_BUFFER_SIZE         1024   // payload buffer; a larger batch is split across messages
+#define TELEMETRY_FORMAT              TELEMETRY_FORMAT_JSON
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t telemetry_start(void);
+
+// Change the sampling rate and batch size at runtime. Takes effect on the next sample.
+esp_err_t telemetry_set_rate(uint32_t sample_period_ms, uint8_t samples_per_publish);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,44 @@
+#ifndef TELEMETRY_ENCODER_H
+#define TELEMETRY_ENCODER_H
+
+#include "led_channels.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation-free telemetry serializer. Samples are written straight into a
+// caller-provided buffer as compact JSON or CBOR; nothing touches the heap.
+//
+// JSON: {"device_id":"ESP32_001","samples":[{"t":1234,"seq":7,"heap":81234,"ch":[255,0,0,128]},...]}
+// CBOR: the same structure - a map with "device_id" and an indefinite-length
+//       "samples" array of maps keyed "t", "seq", "heap" and "ch".
+
+typedef enum {
+    TELEMETRY_FORMAT_JSON = 0,
+    TELEMETRY_FORMAT_CBOR,
+} telemetry_format_t;
+
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t seq;
+    uint32_t free_heap;
+    uint8_t level[LED_BATCH_MAX_CHANNELS];   // first channel_count entries are valid
+    uint8_t channel_count;
+} telemetry_sample_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Encode as many samples as fit in buf. Returns the number of samples encoded
+// (0 if not even one fits) and the payload size in *out_len.
+size_t telemetry_encode(telemetry_format_t format, const char* device_id,
+                        const telemetry_sample_t* samples, size_t count,
+                        uint8_t* buf, size_t size, size_t* out_len);
+
+const char* telemetry_content_type(telemetry_format_t format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_ENCODER_H
@@ -0,0 +1,68 @@
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include "esp_err.h"
+#include "outbox_pool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Store-and-forward telemetry. Payloads that cannot be published go into an
+// append-only ring log on the "tlm_spool" flash partition and are replayed
+// once MQTT reconnects.
+//
+// Sectors are filled in order and erased only when the ring wraps around, so
+// every sector sees the same number of erase cycles. A record stays in flash
+// until the hub acknowledges it (PUBACK), which makes replay at-least-once.
+// When the ring is full the oldest sector is reused and its records are
+// counted as dropped.
+//
+// Replay runs in its own low-priority task and goes through the MQTT outbox
+// with a bounded number of unacknowledged records, so a reconnect after a
+// long outage never crowds out C2D commands.
+
+#define TELEMETRY_SPOOL_PARTITION      "tlm_spool"
+#define TELEMETRY_SPOOL_MAX_SECTORS    128
+#define TELEMETRY_SPOOL_RECORD_MAX     2048    // content type + payload
+#define TELEMETRY_SPOOL_CONTENT_TYPE_MAX 63
+#define TELEMETRY_SPOOL_INFLIGHT       4       // replayed records awaiting PUBACK
+#define TELEMETRY_SPOOL_OUTBOX_BUDGET  (OUTBOX_BUDGET_BYTES / 2)   // replay pauses while the MQTT outbox holds more bytes
+#define TELEMETRY_SPOOL_ACK_TIMEOUT_MS 30000   // no PUBACK for this long: resend from the oldest record
+
+// Returned by the publish hook when the outbox is over budget; replay retries later
+#define TELEMETRY_SPOOL_BUSY (-2)
+
+// Queue one replayed payload for publishing. Returns the MQTT msg_id,
+// TELEMETRY_SPOOL_BUSY, or -1 when the connection is gone.
+typedef int (*telemetry_spool_publish_fn)(const void* data, size_t len, const char* content_type);
+
+typedef struct {
+    uint32_t stored;     // records written to flash
+    uint32_t replayed;   // records acknowledged by the hub after replay
+    uint32_t dropped;    // records overwritten before they could be sent
+    uint32_t pending;    // records in flash awaiting acknowledgement
+} telemetry_spool_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Find the partition and recover the read and write positions from flash.
+esp_err_t telemetry_spool_init(void);
+
+// Start the replay task. Called once the MQTT client exists.
+esp_err_t telemetry_spool_start(telemetry_spool_publish_fn publish);
+
+esp_err_t telemetry_spool_append(const void* data, size_t len, const char* content_type);
+
+// MQTT event hooks, called from the MQTT task
+void telemetry_spool_on_connected(void);
+void telemetry_spool_on_disconnected(void);
+void telemetry_spool_on_published(int msg_id);
+
+void telemetry_spool_get_stats(telemetry_spool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_SPOOL_H
@@ -0,0 +1,30 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+// Wall clock from SNTP. The first sync sets APP_EVENT_TIME_SYNCED and starts
+// the scheduler; later syncs (every CONFIG_LWIP_SNTP_UPDATE_DELAY) correct
+// drift. Schedules run in local time, TIME_SYNC_TIMEZONE in POSIX TZ format.
+
+#define TIME_SYNC_SERVER   "pool.ntp.org"
+#define CLOCK_VALID_AFTER  1700000000   // earlier than Nov 2023: SNTP has not run yet
+#ifndef TIME_SYNC_TIMEZONE
+#define TIME_SYNC_TIMEZONE "CET-1CEST,M3.5.0,M10.5.0/3"   // Europe/Amsterdam
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start SNTP. Can run before WiFi is up; requests are retried until a server answers.
+esp_err_t time_sync_start(void);
+
+bool time_sync_is_valid(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIME_SYNC_H
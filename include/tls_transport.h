@@ -0,0 +1,46 @@
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include "esp_transport.h"
+#include <stdint.h>
+
+// TLS transport for the MQTT client that keeps the session across
+// reconnects. esp-mqtt's own SSL transport starts every connection with a
+// full handshake (certificate chain, ECDHE, RSA verify: seconds of CPU on
+// the ESP32); this one hands the session ticket of the last connection back
+// to esp-tls, so a reconnect to the same hub is an abbreviated handshake.
+//
+// The server is verified against the ESP x509 certificate bundle. The
+// session lives in RAM only: it survives reconnects, not a reset. A handshake
+// that fails with a cached session drops it, so the next attempt is a full
+// one.
+
+#define TLS_TRANSPORT_DEFAULT_PORT 8883
+
+typedef struct {
+    uint32_t handshakes;           // successful, full or resumed
+    uint32_t resumed;              // of which the server resumed the cached session
+    uint32_t failures;
+    uint32_t last_full_ms;         // connect() incl. DNS and TCP, full handshake
+    uint32_t last_resumed_ms;      // same, resumed handshake
+} tls_transport_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A transport for esp_mqtt_client_config_t.network.transport. The client
+// takes ownership and destroys it with itself.
+esp_transport_handle_t tls_transport_create(void);
+
+void tls_transport_get_stats(tls_transport_stats_t* stats);
+
+// esp_timer_get_time() of the last read that returned data, 0 before any.
+// For latency tracing: the moment a message left the TLS layer.
+int64_t tls_transport_last_rx_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLS_TRANSPORT_H
@@ -3,13 +3,39 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+// Reconnects back off exponentially with jitter, starting at
+// WIFI_BACKOFF_FIRST_MS so a short outage is bridged in well under a second.
+// The AP we last got an IP from (BSSID and channel) is cached in NVS and
+// joined directly, without a scan, until it fails WIFI_FAST_CONNECT_ATTEMPTS
+// times in a row. For a static address define WIFI_STATIC_IP, _NETMASK,
+// _GATEWAY and _DNS in azure_config.h; otherwise lwIP re-requests the last
+// DHCP lease (CONFIG_LWIP_DHCP_RESTORE_LAST_IP).
+
+#define WIFI_BACKOFF_FIRST_MS       250
+#define WIFI_BACKOFF_MAX_MS         60000
+#define WIFI_FAST_CONNECT_ATTEMPTS  2
+
+typedef struct {
+    uint32_t connects;           // IPs obtained
+    uint32_t fast_connects;      // of which through the cached AP
+    uint32_t disconnects;        // links lost (an outage counts once, however many retries)
+    uint32_t first_connect_ms;   // station start -> first IP
+    uint32_t last_reconnect_ms;  // link lost -> IP, most recent outage
+    uint32_t max_reconnect_ms;
+} wifi_stats_t;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Start the station and return; association runs in the background and is
+// reported through APP_EVENT_WIFI_CONNECTED. Expects NVS, esp_netif and the
+// default event loop to be initialized.
 esp_err_t wifi_init_sta(const char* ssid, const char* password);
 bool wifi_is_connected(void);
+void wifi_get_stats(wifi_stats_t* stats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,16 @@
+#ifndef HOST_MOCK_ESP_CRT_BUNDLE_H
+#define HOST_MOCK_ESP_CRT_BUNDLE_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_crt_bundle_attach(void* conf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_ESP_CRT_BUNDLE_H
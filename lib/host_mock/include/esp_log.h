@@ -0,0 +1,13 @@
+#ifndef HOST_MOCK_ESP_LOG_H
+#define HOST_MOCK_ESP_LOG_H
+
+#include <stdio.h>
+
+// Host builds keep errors and warnings on stderr and drop the rest.
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif // HOST_MOCK_ESP_LOG_H
@@ -0,0 +1,14 @@
+#ifndef HOST_MOCK_ESP_NETIF_IP_ADDR_H
+#define HOST_MOCK_ESP_NETIF_IP_ADDR_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) (int)((ipaddr)->addr & 0xff), (int)(((ipaddr)->addr >> 8) & 0xff), \
+                       (int)(((ipaddr)->addr >> 16) & 0xff), (int)(((ipaddr)->addr >> 24) & 0xff)
+
+#endif // HOST_MOCK_ESP_NETIF_IP_ADDR_H
@@ -0,0 +1,17 @@
+#ifndef HOST_MOCK_ESP_ROM_GPIO_H
+#define HOST_MOCK_ESP_ROM_GPIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_rom_gpio_connect_out_signal(uint32_t gpio_num, uint32_t signal_idx, bool out_inv, bool oen_inv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_ESP_ROM_GPIO_H
@@ -0,0 +1,21 @@
+#ifndef HOST_MOCK_ESP_SYSTEM_H
+#define HOST_MOCK_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Free heap as MOCK_HEAP_CAPACITY minus what the process has allocated (see host_mock.h)
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+// Exits the host process
+void esp_restart(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_ESP_SYSTEM_H
@@ -0,0 +1,49 @@
+#ifndef HOST_MOCK_ESP_TLS_H
+#define HOST_MOCK_ESP_TLS_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+// esp-tls surface used by the MQTT TLS transport. There is no TLS on the
+// host: a connection is a plaintext local socket pair (see mock_tls.cpp), with
+// no SSL context and no session to resume.
+
+typedef struct esp_tls esp_tls_t;
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+
+#define ESP_TLS_ERR_SSL_WANT_READ   -0x6900
+#define ESP_TLS_ERR_SSL_WANT_WRITE  -0x6880
+
+typedef struct esp_tls_cfg {
+    const char** alpn_protos;
+    const unsigned char* cacert_buf;
+    unsigned int cacert_bytes;
+    int timeout_ms;
+    bool use_global_ca_store;
+    const char* common_name;
+    bool skip_common_name;
+    esp_err_t (*crt_bundle_attach)(void* conf);
+    esp_tls_client_session_t* client_session;
+} esp_tls_cfg_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_tls_t* esp_tls_init(void);
+int esp_tls_conn_new_sync(const char* hostname, int hostlen, int port, const esp_tls_cfg_t* cfg, esp_tls_t* tls);
+int esp_tls_conn_destroy(esp_tls_t* tls);
+ssize_t esp_tls_conn_read(esp_tls_t* tls, void* data, size_t datalen);
+ssize_t esp_tls_conn_write(esp_tls_t* tls, const void* data, size_t datalen);
+ssize_t esp_tls_get_bytes_avail(esp_tls_t* tls);
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t* tls, int* sockfd);
+void* esp_tls_get_ssl_context(esp_tls_t* tls);   // mbedtls_ssl_context*
+esp_tls_client_session_t* esp_tls_get_client_session(esp_tls_t* tls);
+void esp_tls_free_client_session(esp_tls_client_session_t* client_session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_ESP_TLS_H
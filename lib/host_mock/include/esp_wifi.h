@@ -0,0 +1,29 @@
+#ifndef HOST_MOCK_ESP_WIFI_H
+#define HOST_MOCK_ESP_WIFI_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// Station queries only. The host has no radio: the station is never associated.
+
+#define ESP_ERR_WIFI_BASE           0x3000
+#define ESP_ERR_WIFI_NOT_CONNECT    (ESP_ERR_WIFI_BASE + 15)
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+} wifi_ap_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_ESP_WIFI_H
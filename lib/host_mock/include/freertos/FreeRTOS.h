@@ -0,0 +1,49 @@
+#ifndef HOST_MOCK_FREERTOS_H
+#define HOST_MOCK_FREERTOS_H
+
+#include <stdint.h>
+
+// FreeRTOS on host threads: tasks are std::threads, ticks follow the wall
+// clock at configTICK_RATE_HZ, and every critical section shares one
+// recursive lock (the host has no interrupts to mask).
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define configTICK_RATE_HZ 100
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFu)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define tskNO_AFFINITY     0x7FFFFFFF
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void mock_port_enter_critical(portMUX_TYPE* mux);
+void mock_port_exit_critical(portMUX_TYPE* mux);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define portENTER_CRITICAL(mux)      mock_port_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)       mock_port_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux)  mock_port_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux)   mock_port_exit_critical(mux)
+#define portENTER_CRITICAL_SAFE(mux) mock_port_enter_critical(mux)
+#define portEXIT_CRITICAL_SAFE(mux)  mock_port_exit_critical(mux)
+
+#endif // HOST_MOCK_FREERTOS_H
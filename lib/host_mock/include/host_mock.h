@@ -0,0 +1,133 @@
+#ifndef HOST_MOCK_H
+#define HOST_MOCK_H
+
+#include "driver/ledc.h"
+#include "esp_partition.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Controls and inspection hooks for the host stand-ins of the ESP-IDF drivers.
+
+#define MOCK_LEDC_TIMELINE_MAX 1024
+
+// One entry per duty change the firmware asked the LEDC peripheral for.
+// fade_ms is 0 for immediate updates; otherwise the duty ramps linearly from
+// the duty in effect at time_us to `duty` over fade_ms.
+typedef struct {
+    int64_t time_us;
+    ledc_channel_t channel;
+    uint32_t duty;
+    uint32_t fade_ms;
+} mock_ledc_event_t;
+
+// Heap size esp_get_free_heap_size() reports against: what an ESP32 has
+// left for the application once WiFi and lwIP are up
+#define MOCK_HEAP_CAPACITY (200 * 1024)
+
+typedef struct {
+    uint32_t delivered;          // C2D messages handed to the client
+    uint32_t fragments;          // MQTT_EVENT_DATA events they arrived in
+    uint32_t refused;            // deliveries while disconnected
+    uint32_t published;          // device-to-cloud publishes
+    uint64_t published_bytes;
+    uint32_t acked;              // PUBACKs dispatched
+    size_t inbox_peak;           // most events waiting for the MQTT task
+    size_t outbox_bytes;         // bytes awaiting PUBACK now
+    size_t outbox_peak_bytes;
+    uint32_t connects;           // CONNECTs, the first one included
+    uint32_t password_changes;   // esp_mqtt_set_config() with new credentials
+    uint32_t reconnects_rejected;   // esp_mqtt_client_reconnect() outside WAIT_RECONNECT
+} mock_mqtt_stats_t;
+
+typedef struct {
+    uint32_t handshakes;         // connections opened
+    uint32_t offered;            // of which the client offered a cached session
+    uint32_t resumed;            // of which the server resumed it
+} mock_tls_stats_t;
+
+typedef struct {
+    uint32_t accepted;           // connections taken off the listen backlog
+    uint32_t requests;           // requests handed to a URI handler
+    uint32_t rejected;           // malformed, oversized, 404/405/501
+    uint32_t handler_errors;     // handlers that returned an error (socket closed)
+    uint16_t open_peak;          // most sockets open at once
+    uint32_t work_items;         // httpd_queue_work() items run
+} mock_httpd_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Mock clock behind esp_timer_get_time(). Starts at 0 and only moves when
+// told to, unless switched to the host's monotonic clock. FreeRTOS ticks
+// always follow the host clock.
+void mock_clock_set_us(int64_t now_us);
+void mock_clock_advance_us(int64_t delta_us);
+void mock_clock_use_wall_time(void);
+
+// Heap accounting (glibc hosts; see mock_heap.cpp)
+bool mock_heap_tracking(void);
+uint64_t mock_heap_allocations(void);
+size_t mock_heap_in_use(void);
+size_t mock_heap_peak(void);
+void mock_heap_reset_peak(void);
+
+// Flash partitions (RAM backed, NOR semantics)
+const esp_partition_t* mock_partition_add(const char* label, uint32_t size);
+uint32_t mock_partition_erase_count(const esp_partition_t* partition);
+
+// NVS (in memory): set_* calls and commits since start, to watch flash wear
+uint32_t mock_nvs_write_count(void);
+uint32_t mock_nvs_commit_count(void);
+
+// MQTT broker stand-in (see mqtt_client.h)
+// deliver() splits a C2D message into MQTT_EVENT_DATA fragments of the
+// client's buffer size and blocks while the client's inbox is full. The
+// ingest hook runs on the MQTT task once the last fragment was handled.
+bool mock_mqtt_deliver(const char* topic, const void* data, size_t len);
+void mock_mqtt_set_fragment_size(int bytes);
+void mock_mqtt_set_inbox_limit(size_t events);
+void mock_mqtt_set_ingest_hook(void (*hook)(int64_t latency_us));
+// The broker goes away (the client enters WAIT_RECONNECT) until restored;
+// restoring lets the client's pending retry through immediately
+void mock_mqtt_drop_connection(void);
+void mock_mqtt_restore_connection(void);
+// While held, PUBACKs are kept back and the outbox fills like behind a slow broker
+void mock_mqtt_hold_acks(bool hold);
+void mock_mqtt_get_stats(mock_mqtt_stats_t* stats);
+
+// esp-tls stand-in: queues bytes for the open connection's next read, as if
+// they came off the network. False when no connection is open.
+bool mock_tls_inject(const void* data, size_t len);
+// Whether the server resumes a session the client offers (the default) or
+// answers with a full handshake and a new session
+void mock_tls_set_resumption(bool resume);
+void mock_tls_get_stats(mock_tls_stats_t* stats);
+
+// HTTP server on loopback (see esp_http_server.h)
+// Port 0 binds an ephemeral port instead of the configured one.
+void mock_httpd_set_port(int port);
+uint16_t mock_httpd_bound_port(void);
+void mock_httpd_get_stats(mock_httpd_stats_t* stats);
+
+// LEDC backend
+void mock_ledc_reset(void);
+const mock_ledc_event_t* mock_ledc_timeline(size_t* count);
+uint32_t mock_ledc_duty_at(ledc_channel_t channel, int64_t time_us);
+uint32_t mock_ledc_frequency(ledc_timer_t timer);
+ledc_timer_bit_t mock_ledc_resolution(ledc_timer_t timer);
+
+// GPIO backend
+// Output levels are the GPIO output register; pins routed to a peripheral
+// signal (e.g. LEDC) ignore it until they are routed back.
+void mock_gpio_reset(void);
+uint64_t mock_gpio_output_levels(void);
+uint32_t mock_gpio_register_writes(void);
+uint32_t mock_gpio_signal(gpio_num_t pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_H
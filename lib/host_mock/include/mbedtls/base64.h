@@ -0,0 +1,23 @@
+#ifndef HOST_MOCK_MBEDTLS_BASE64_H
+#define HOST_MOCK_MBEDTLS_BASE64_H
+
+#include <stddef.h>
+
+// Same contract as mbedTLS: *olen gets the bytes written, or the size needed
+// when dst is too small. The encoder NUL-terminates.
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL     -0x002A
+#define MBEDTLS_ERR_BASE64_INVALID_CHARACTER    -0x002C
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen);
+int mbedtls_base64_decode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_MBEDTLS_BASE64_H
@@ -0,0 +1,32 @@
+#ifndef HOST_MOCK_MBEDTLS_MD_H
+#define HOST_MOCK_MBEDTLS_MD_H
+
+#include <stddef.h>
+
+// The slice of mbedTLS message digests the firmware uses: one-shot SHA-256
+// and HMAC-SHA256. A real implementation, so host builds sign the same tokens
+// the device does.
+
+typedef enum {
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA256 = 9,
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+#define MBEDTLS_ERR_MD_BAD_INPUT_DATA -0x5100
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t md_type);
+int mbedtls_md(const mbedtls_md_info_t* md_info, const unsigned char* input, size_t ilen, unsigned char* output);
+int mbedtls_md_hmac(const mbedtls_md_info_t* md_info, const unsigned char* key, size_t keylen,
+                    const unsigned char* input, size_t ilen, unsigned char* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_MBEDTLS_MD_H
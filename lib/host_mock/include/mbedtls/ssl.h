@@ -0,0 +1,18 @@
+#ifndef HOST_MOCK_MBEDTLS_SSL_H
+#define HOST_MOCK_MBEDTLS_SSL_H
+
+// The slice of the mbedTLS SSL context the TLS transport reads after a
+// handshake: the negotiated session's master secret. The esp-tls stand-in
+// hands one out per connection.
+
+#define MBEDTLS_PRIVATE(member) member
+
+typedef struct mbedtls_ssl_session {
+    unsigned char master[48];
+} mbedtls_ssl_session;
+
+typedef struct mbedtls_ssl_context {
+    mbedtls_ssl_session* session;
+} mbedtls_ssl_context;
+
+#endif // HOST_MOCK_MBEDTLS_SSL_H
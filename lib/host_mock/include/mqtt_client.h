@@ -0,0 +1,140 @@
+#ifndef HOST_MOCK_MQTT_CLIENT_H
+#define HOST_MOCK_MQTT_CLIENT_H
+
+#include "esp_err.h"
+#include "esp_transport.h"
+#include "esp_event.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// esp-mqtt client connected to an in-process broker stand-in. Events are
+// dispatched on a dedicated "mqtt_task" thread, one at a time, as on target.
+// The broker side (delivering C2D messages, dropping the connection) is
+// driven through the mock_mqtt_* hooks in host_mock.h.
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+    MQTT_USER_EVENT,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+} esp_mqtt_error_type_t;
+
+typedef struct {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    int esp_tls_cert_verify_flags;
+    esp_mqtt_error_type_t error_type;
+    int connect_return_code;
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+typedef struct esp_mqtt_event {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char* topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    esp_mqtt_error_codes_t* error_handle;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char* uri;
+            const char* hostname;
+            uint32_t port;
+        } address;
+        struct {
+            bool use_global_ca_store;
+            esp_err_t (*crt_bundle_attach)(void* conf);
+            const char* certificate;
+            size_t certificate_len;
+            bool skip_cert_common_name_check;
+            const char* common_name;
+        } verification;
+    } broker;
+    struct {
+        const char* username;
+        const char* client_id;
+        bool set_null_client_id;
+        struct {
+            const char* password;
+        } authentication;
+    } credentials;
+    struct {
+        int keepalive;
+        bool disable_keepalive;
+        int protocol_ver;
+        int message_retransmit_timeout;
+    } session;
+    struct {
+        int reconnect_timeout_ms;
+        int timeout_ms;
+        int refresh_connection_after_ms;
+        bool disable_auto_reconnect;
+        esp_transport_handle_t transport;   // connected and read by the MQTT task
+    } network;
+    struct {
+        int priority;
+        int stack_size;
+    } task;
+    struct {
+        int size;       // receive buffer; larger messages arrive in several MQTT_EVENT_DATA
+        int out_size;
+    } buffer;
+    struct {
+        int limit;
+    } outbox;
+} esp_mqtt_client_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t* config);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos);
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain, bool store);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void* event_handler_arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_MQTT_CLIENT_H
@@ -0,0 +1,61 @@
+#ifndef HOST_MOCK_MQTT_OUTBOX_H
+#define HOST_MOCK_MQTT_OUTBOX_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// esp-mqtt's outbox interface (esp-mqtt/lib/include/mqtt_outbox.h). With
+// CONFIG_MQTT_CUSTOM_OUTBOX the component leaves it to the application; the
+// mock client stores its QoS>0 publishes through it the same way, so the
+// host build runs the firmware's implementation (src/outbox_pool.cpp).
+
+struct outbox_item;
+
+typedef struct outbox_t* outbox_handle_t;
+typedef struct outbox_item* outbox_item_handle_t;
+typedef struct outbox_message* outbox_message_handle_t;
+typedef long long outbox_tick_t;
+
+typedef struct outbox_message {
+    uint8_t* data;
+    int len;
+    int msg_id;
+    int msg_qos;
+    int msg_type;
+    uint8_t* remaining_data;
+    int remaining_len;
+} outbox_message_t;
+
+typedef enum pending_state {
+    QUEUED,
+    TRANSMITTED,
+    ACKNOWLEDGED,
+    CONFIRMED
+} pending_state_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+outbox_handle_t outbox_init(void);
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, outbox_tick_t tick);
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, outbox_tick_t* tick);
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id);
+uint8_t* outbox_item_get_data(outbox_item_handle_t item, size_t* len, uint16_t* msg_id, int* msg_type, int* qos);
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item);
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type);
+int outbox_delete_single_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout);
+int outbox_delete_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout);
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending);
+pending_state_t outbox_item_get_pending(outbox_item_handle_t item);
+esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, outbox_tick_t tick);
+uint64_t outbox_get_size(outbox_handle_t outbox);
+void outbox_delete_all_items(outbox_handle_t outbox);
+void outbox_destroy(outbox_handle_t outbox);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_MQTT_OUTBOX_H
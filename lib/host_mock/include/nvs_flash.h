@@ -0,0 +1,17 @@
+#ifndef HOST_MOCK_NVS_FLASH_H
+#define HOST_MOCK_NVS_FLASH_H
+
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_NVS_FLASH_H
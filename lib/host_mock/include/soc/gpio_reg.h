@@ -0,0 +1,9 @@
+#ifndef HOST_MOCK_SOC_GPIO_REG_H
+#define HOST_MOCK_SOC_GPIO_REG_H
+
+// ESP32 GPIO output registers (same addresses as the real part)
+#define GPIO_OUT_REG       0x3FF44004
+#define GPIO_OUT_W1TS_REG  0x3FF44008
+#define GPIO_OUT_W1TC_REG  0x3FF4400C
+
+#endif // HOST_MOCK_SOC_GPIO_REG_H
@@ -0,0 +1,7 @@
+#ifndef HOST_MOCK_SOC_GPIO_SIG_MAP_H
+#define HOST_MOCK_SOC_GPIO_SIG_MAP_H
+
+#define LEDC_HS_SIG_OUT0_IDX 71
+#define SIG_GPIO_OUT_IDX     256
+
+#endif // HOST_MOCK_SOC_GPIO_SIG_MAP_H
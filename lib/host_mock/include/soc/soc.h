@@ -0,0 +1,19 @@
+#ifndef HOST_MOCK_SOC_SOC_H
+#define HOST_MOCK_SOC_SOC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Peripheral register writes land in the mock GPIO backend
+void mock_reg_write(uint32_t addr, uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define REG_WRITE(addr, value) mock_reg_write((uint32_t)(addr), (uint32_t)(value))
+
+#endif // HOST_MOCK_SOC_SOC_H
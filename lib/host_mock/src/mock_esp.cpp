@@ -0,0 +1,65 @@
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "host_mock.h"
+#include <atomic>
+#include <chrono>
+
+static std::atomic<int64_t> mock_now_us{0};
+static std::atomic<bool> mock_wall_time{false};
+
+void mock_clock_set_us(int64_t now_us) {
+    mock_now_us = now_us;
+}
+
+void mock_clock_advance_us(int64_t delta_us) {
+    mock_now_us += delta_us;
+}
+
+void mock_clock_use_wall_time(void) {
+    mock_wall_time = true;
+}
+
+int64_t esp_timer_get_time(void) {
+    if (mock_wall_time.load(std::memory_order_relaxed)) {
+        static const auto origin = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::now() - origin;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    return mock_now_us.load(std::memory_order_relaxed);
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    size_t used = mock_heap_in_use();
+    return used < MOCK_HEAP_CAPACITY ? (uint32_t)(MOCK_HEAP_CAPACITY - used) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    size_t peak = mock_heap_peak();
+    return peak < MOCK_HEAP_CAPACITY ? (uint32_t)(MOCK_HEAP_CAPACITY - peak) : 0;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* ap_info) {
+    return ESP_ERR_WIFI_NOT_CONNECT;
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() called\n");
+    exit(1);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,135 @@
+#include "esp_timer.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+typedef std::chrono::steady_clock mock_timer_clock;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t period_us;                       // 0 for one-shot
+    bool active;
+    mock_timer_clock::time_point due;
+};
+
+// Armed timers by due time. One dispatcher thread, started with the first timer.
+static std::mutex timer_lock;
+static std::condition_variable timer_changed;
+static std::multimap<mock_timer_clock::time_point, esp_timer*> armed;
+static bool dispatcher_running = false;
+
+static void unlink_locked(esp_timer* timer) {
+    auto range = armed.equal_range(timer->due);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == timer) {
+            armed.erase(it);
+            break;
+        }
+    }
+    timer->active = false;
+}
+
+static void arm_locked(esp_timer* timer, mock_timer_clock::time_point due) {
+    timer->due = due;
+    timer->active = true;
+    armed.emplace(due, timer);
+    timer_changed.notify_all();
+}
+
+static void dispatcher(void) {
+    std::unique_lock<std::mutex> guard(timer_lock);
+    for (;;) {
+        if (armed.empty()) {
+            timer_changed.wait(guard);
+            continue;
+        }
+        auto next = armed.begin();
+        if (mock_timer_clock::now() < next->first) {
+            timer_changed.wait_until(guard, next->first);
+            continue;
+        }
+        esp_timer* timer = next->second;
+        armed.erase(next);
+        timer->active = false;
+        if (timer->period_us > 0) {
+            arm_locked(timer, timer->due + std::chrono::microseconds(timer->period_us));
+        }
+        esp_timer_cb_t callback = timer->callback;
+        void* arg = timer->arg;
+        // Callbacks may start or stop timers, including their own
+        guard.unlock();
+        callback(arg);
+        guard.lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(timer_lock);
+    if (!dispatcher_running) {
+        std::thread(dispatcher).detach();
+        dispatcher_running = true;
+    }
+    *out_handle = new esp_timer{ create_args->callback, create_args->arg, 0, false, {} };
+    return ESP_OK;
+}
+
+static esp_err_t start(esp_timer_handle_t timer, uint64_t us, uint64_t period_us, bool restart) {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    if (timer->active) {
+        if (!restart) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        unlink_locked(timer);
+    } else if (restart) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = period_us;
+    arm_locked(timer, mock_timer_clock::now() + std::chrono::microseconds(us));
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return start(timer, timeout_us, 0, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return start(timer, period_us, period_us, false);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us) {
+    uint64_t period_us;
+    {
+        std::lock_guard<std::mutex> guard(timer_lock);
+        period_us = timer->period_us;
+    }
+    return start(timer, timeout_us, period_us > 0 ? timeout_us : 0, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    unlink_locked(timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(timer_lock);
+    return timer->active;
+}
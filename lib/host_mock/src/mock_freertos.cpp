@@ -0,0 +1,316 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+struct mock_task {
+    std::string name;
+    UBaseType_t priority;
+    BaseType_t core_id;
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t notify_count = 0;
+};
+
+struct mock_queue {
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+struct mock_mutex {
+    std::timed_mutex lock;
+};
+
+struct mock_event_group {
+    std::mutex lock;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+static std::recursive_mutex critical_lock;
+static const auto tick_origin = std::chrono::steady_clock::now();
+static thread_local mock_task* current_task = NULL;
+
+static std::chrono::milliseconds ticks_to_ms(TickType_t ticks) {
+    return std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS);
+}
+
+void mock_port_enter_critical(portMUX_TYPE* mux) {
+    critical_lock.lock();
+}
+
+void mock_port_exit_critical(portMUX_TYPE* mux) {
+    critical_lock.unlock();
+}
+
+// Tasks
+
+// Every task ever created, for xTaskGetHandle()
+static std::mutex task_list_lock;
+static std::vector<mock_task*> task_list;
+
+static mock_task* this_task(void) {
+    if (current_task == NULL) {
+        // A thread the mock did not start (e.g. main) still gets a notification slot
+        current_task = new mock_task();
+        current_task->name = "main";
+        current_task->priority = 1;
+        current_task->core_id = 0;
+    }
+    return current_task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core_id) {
+    mock_task* task = new mock_task();
+    task->name = name ? name : "";
+    task->priority = priority;
+    task->core_id = core_id;
+    if (handle) {
+        *handle = task;
+    }
+    {
+        std::lock_guard<std::mutex> guard(task_list_lock);
+        task_list.push_back(task);
+    }
+    std::thread([task, fn, arg]() {
+        current_task = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        // Deleting yourself ends the thread; the handle stays valid for late notifications
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(ticks_to_ms(ticks));
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    auto elapsed = std::chrono::steady_clock::now() - tick_origin;
+    return (TickType_t)(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t period) {
+    TickType_t wake = *previous_wake + period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0) {
+        std::this_thread::sleep_for(ticks_to_ms(wake - now));
+    }
+    *previous_wake = wake;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return this_task();
+}
+
+TaskHandle_t xTaskGetHandle(const char* name) {
+    std::lock_guard<std::mutex> guard(task_list_lock);
+    for (mock_task* task : task_list) {
+        if (task->name == name) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : this_task())->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 0;   // host threads have no fixed stack to watch
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    return (task ? task : this_task())->priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+    (task ? task : this_task())->priority = priority;
+}
+
+BaseType_t xTaskGetCoreID(TaskHandle_t task) {
+    return (task ? task : this_task())->core_id;
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notify_count++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    mock_task* task = this_task();
+    std::unique_lock<std::mutex> guard(task->lock);
+    auto ready = [task]() { return task->notify_count != 0; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        task->cv.wait(guard, ready);
+    } else {
+        task->cv.wait_for(guard, ticks_to_ms(ticks_to_wait), ready);
+    }
+    uint32_t count = task->notify_count;
+    if (count) {
+        task->notify_count = clear_on_exit ? 0 : count - 1;
+    }
+    return count;
+}
+
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    mock_queue* queue = new mock_queue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    auto has_room = [queue]() { return queue->items.size() < queue->length; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        queue->not_full.wait(guard, has_room);
+    } else if (!queue->not_full.wait_for(guard, ticks_to_ms(ticks_to_wait), has_room)) {
+        return pdFAIL;
+    }
+    const uint8_t* bytes = (const uint8_t*)item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->not_empty.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    auto has_item = [queue]() { return !queue->items.empty(); };
+    if (ticks_to_wait == portMAX_DELAY) {
+        queue->not_empty.wait(guard, has_item);
+    } else if (!queue->not_empty.wait_for(guard, ticks_to_ms(ticks_to_wait), has_item)) {
+        return pdFAIL;
+    }
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->not_full.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    queue->not_full.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+// Mutexes
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return new mock_mutex();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait) {
+    if (ticks_to_wait == portMAX_DELAY) {
+        sem->lock.lock();
+        return pdPASS;
+    }
+    return sem->lock.try_lock_for(ticks_to_ms(ticks_to_wait)) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    sem->lock.unlock();
+    return pdPASS;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return new mock_event_group();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> guard(group->lock);
+    auto satisfied = [group, bits, wait_for_all]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool met;
+    if (ticks_to_wait == portMAX_DELAY) {
+        group->changed.wait(guard, satisfied);
+        met = true;
+    } else {
+        met = group->changed.wait_for(guard, ticks_to_ms(ticks_to_wait), satisfied);
+    }
+    EventBits_t result = group->bits;
+    if (met && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
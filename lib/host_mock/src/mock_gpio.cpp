@@ -0,0 +1,103 @@
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_rom_gpio.h"
+#include "host_mock.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/soc.h"
+
+static uint64_t gpio_output_mask = 0;
+static uint64_t gpio_levels = 0;
+static uint32_t register_writes = 0;
+static uint32_t pin_signal[GPIO_NUM_MAX];   // 0 = never routed, plain GPIO
+
+static bool valid_pin(int gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+void mock_gpio_reset(void) {
+    gpio_output_mask = 0;
+    gpio_levels = 0;
+    register_writes = 0;
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        pin_signal[i] = SIG_GPIO_OUT_IDX;
+    }
+}
+
+uint64_t mock_gpio_output_levels(void) {
+    return gpio_levels;
+}
+
+uint32_t mock_gpio_register_writes(void) {
+    return register_writes;
+}
+
+uint32_t mock_gpio_signal(gpio_num_t pin) {
+    return valid_pin(pin) && pin_signal[pin] ? pin_signal[pin] : SIG_GPIO_OUT_IDX;
+}
+
+void mock_reg_write(uint32_t addr, uint32_t value) {
+    register_writes++;
+    switch (addr) {
+        case GPIO_OUT_REG:
+            gpio_levels = (gpio_levels & ~0xFFFFFFFFULL) | value;
+            break;
+        case GPIO_OUT_W1TS_REG:
+            gpio_levels |= value;
+            break;
+        case GPIO_OUT_W1TC_REG:
+            gpio_levels &= ~(uint64_t)value;
+            break;
+        default:
+            break;
+    }
+}
+
+void esp_rom_gpio_connect_out_signal(uint32_t gpio_num, uint32_t signal_idx, bool out_inv, bool oen_inv) {
+    (void)out_inv;
+    (void)oen_inv;
+    if (valid_pin((int)gpio_num)) {
+        pin_signal[gpio_num] = signal_idx;
+        gpio_output_mask |= 1ULL << gpio_num;
+    }
+}
+
+esp_err_t ledc_set_pin(int gpio_num, ledc_mode_t speed_mode, ledc_channel_t ledc_channel) {
+    (void)speed_mode;
+    if (!valid_pin(gpio_num) || ledc_channel >= LEDC_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rom_gpio_connect_out_signal((uint32_t)gpio_num, LEDC_HS_SIG_OUT0_IDX + ledc_channel, false, false);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mode & GPIO_MODE_OUTPUT) {
+        gpio_output_mask |= 1ULL << gpio_num;
+    } else {
+        gpio_output_mask &= ~(1ULL << gpio_num);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (level) {
+        gpio_levels |= 1ULL << gpio_num;
+    } else {
+        gpio_levels &= ~(1ULL << gpio_num);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (!valid_pin(gpio_num)) {
+        return 0;
+    }
+    return (gpio_levels >> gpio_num) & 1;
+}
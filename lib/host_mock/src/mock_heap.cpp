@@ -0,0 +1,118 @@
+#include "host_mock.h"
+#include <atomic>
+#include <stdlib.h>
+
+// Heap accounting for host runs. On glibc the allocator entry points are
+// interposed, so every allocation is seen (C code, operator new, std::thread
+// bookkeeping), and freed blocks are subtracted by their usable size.
+// Elsewhere nothing is tracked and all values stay 0.
+
+static std::atomic<uint64_t> alloc_count{0};
+static std::atomic<int64_t> bytes_in_use{0};
+static std::atomic<int64_t> bytes_peak{0};
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+static void track_alloc(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    int64_t now = bytes_in_use.fetch_add((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed) +
+                  (int64_t)malloc_usable_size(ptr);
+    int64_t peak = bytes_peak.load(std::memory_order_relaxed);
+    while (now > peak && !bytes_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+static void track_free(void* ptr) {
+    if (ptr != NULL) {
+        bytes_in_use.fetch_sub((int64_t)malloc_usable_size(ptr), std::memory_order_relaxed);
+    }
+}
+
+extern "C" {
+void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    track_alloc(p);
+    return p;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* p = __libc_calloc(n, size);
+    track_alloc(p);
+    return p;
+}
+
+void* realloc(void* ptr, size_t size) {
+    track_free(ptr);
+    void* p = __libc_realloc(ptr, size);
+    if (p == NULL && size != 0) {
+        track_alloc(ptr);   // failed: the old block is still live
+        alloc_count.fetch_sub(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    track_alloc(p);
+    return p;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void* p = __libc_memalign(alignment, size);
+    track_alloc(p);
+    return p;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    void* p = memalign(alignment, size);
+    if (p == NULL) {
+        return 12;   // ENOMEM
+    }
+    *out = p;
+    return 0;
+}
+
+void free(void* ptr) {
+    track_free(ptr);
+    __libc_free(ptr);
+}
+}
+#endif
+
+uint64_t mock_heap_allocations(void) {
+    return alloc_count.load(std::memory_order_relaxed);
+}
+
+size_t mock_heap_in_use(void) {
+    int64_t v = bytes_in_use.load(std::memory_order_relaxed);
+    return v > 0 ? (size_t)v : 0;
+}
+
+size_t mock_heap_peak(void) {
+    int64_t v = bytes_peak.load(std::memory_order_relaxed);
+    return v > 0 ? (size_t)v : 0;
+}
+
+void mock_heap_reset_peak(void) {
+    bytes_peak.store(bytes_in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+bool mock_heap_tracking(void) {
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
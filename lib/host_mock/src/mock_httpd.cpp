@@ -0,0 +1,667 @@
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_mock.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <string.h>
+
+// esp_http_server on loopback sockets. One "httpd" task owns the listen
+// socket, every session and the work queue, as on target; everything the
+// firmware handlers can observe (single-threaded dispatch, the socket limit,
+// keep-alive, receive timeouts) behaves the same way.
+
+#define MOCK_HTTPD_MAX_HDR_LEN 1024   // CONFIG_HTTPD_MAX_REQ_HDR_LEN
+#define MOCK_HTTPD_RX_CHUNK    1024
+
+typedef struct {
+    int fd;
+    std::string rx;       // bytes received but not yet consumed by a request
+    uint64_t last_used;   // for LRU purge
+} mock_session_t;
+
+typedef struct {
+    std::string uri;
+    httpd_uri_t def;
+} mock_handler_t;
+
+typedef struct {
+    httpd_config_t config;
+    std::vector<mock_handler_t> handlers;
+    std::vector<mock_session_t> sessions;
+    std::mutex work_lock;
+    std::deque<std::pair<httpd_work_fn_t, void*>> work;
+    int listen_fd;
+    int wake[2];
+    std::atomic<bool> stopping;
+    std::atomic<bool> stopped;
+    uint64_t use_counter;
+} mock_server_t;
+
+// Per-request state behind httpd_req_t::aux
+typedef struct {
+    mock_server_t* server;
+    mock_session_t* session;
+    std::string query;
+    bool has_query;
+    std::vector<std::pair<std::string, std::string>> headers;
+    size_t body_left;      // request body bytes not yet handed to the handler
+    std::string status;
+    std::string type;
+    std::vector<std::pair<std::string, std::string>> resp_headers;
+    bool headers_sent;
+    bool chunked;
+    bool send_failed;
+} mock_request_t;
+
+static int port_override = -1;
+static uint16_t bound_port = 0;
+static mock_httpd_stats_t stats;
+
+void mock_httpd_set_port(int port) {
+    port_override = port;
+}
+
+uint16_t mock_httpd_bound_port(void) {
+    return bound_port;
+}
+
+void mock_httpd_get_stats(mock_httpd_stats_t* out) {
+    *out = stats;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static mock_request_t* ctx(httpd_req_t* r) {
+    return (mock_request_t*)r->aux;
+}
+
+static bool send_headers(httpd_req_t* r, const char* length_header) {
+    mock_request_t* q = ctx(r);
+    std::string head = "HTTP/1.1 " + q->status + "\r\nContent-Type: " + q->type + "\r\n" + length_header;
+    for (const auto& h : q->resp_headers) {
+        head += h.first + ": " + h.second + "\r\n";
+    }
+    head += "\r\n";
+    q->headers_sent = true;
+    if (!send_all(q->session->fd, head.data(), head.size())) {
+        q->send_failed = true;
+    }
+    return !q->send_failed;
+}
+
+// Request handling
+
+static const char* method_name(int method) {
+    switch (method) {
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_GET:    return "GET";
+        case HTTP_HEAD:   return "HEAD";
+        case HTTP_POST:   return "POST";
+        case HTTP_PUT:    return "PUT";
+        default:          return "";
+    }
+}
+
+static int parse_method(const std::string& name) {
+    for (int m = HTTP_DELETE; m <= HTTP_PUT; m++) {
+        if (name == method_name(m)) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+static void send_status_only(int fd, const char* status) {
+    char buf[160];
+    int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n\r\n%s",
+                     status, (int)strlen(status), status);
+    send_all(fd, buf, (size_t)n);
+}
+
+static const mock_handler_t* find_handler(mock_server_t* s, const std::string& path, int method, bool* path_known) {
+    *path_known = false;
+    for (const mock_handler_t& h : s->handlers) {
+        if (h.uri == path) {
+            *path_known = true;
+            if ((int)h.def.method == method) {
+                return &h;
+            }
+        }
+    }
+    return NULL;
+}
+
+static std::string header_value(const mock_request_t* q, const char* field) {
+    for (const auto& h : q->headers) {
+        if (strcasecmp(h.first.c_str(), field) == 0) {
+            return h.second;
+        }
+    }
+    return std::string();
+}
+
+// Handles one complete request at the front of session->rx. Returns false if
+// the session must be closed.
+static bool serve_request(mock_server_t* s, mock_session_t* session, size_t header_len) {
+    std::string head = session->rx.substr(0, header_len);
+    session->rx.erase(0, header_len + 4);
+
+    mock_request_t q = {};
+    q.server = s;
+    q.session = session;
+    q.status = HTTPD_200;
+    q.type = "text/html";
+
+    // Request line
+    size_t line_end = head.find("\r\n");
+    std::string line = head.substr(0, line_end);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1) {
+        stats.rejected++;
+        send_status_only(session->fd, "400 Bad Request");
+        return false;
+    }
+    int method = parse_method(line.substr(0, sp1));
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    bool http10 = line.compare(sp2 + 1, std::string::npos, "HTTP/1.0") == 0;
+    if (target.size() > HTTPD_MAX_URI_LEN) {
+        stats.rejected++;
+        send_status_only(session->fd, "414 URI Too Long");
+        return false;
+    }
+
+    // Headers
+    size_t pos = line_end == std::string::npos ? head.size() : line_end + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos) {
+            end = head.size();
+        }
+        size_t colon = head.find(':', pos);
+        if (colon != std::string::npos && colon < end) {
+            size_t v = colon + 1;
+            while (v < end && head[v] == ' ') {
+                v++;
+            }
+            q.headers.emplace_back(head.substr(pos, colon - pos), head.substr(v, end - v));
+        }
+        pos = end + 2;
+    }
+
+    std::string connection = header_value(&q, "Connection");
+    bool keep_alive = http10 ? strcasecmp(connection.c_str(), "keep-alive") == 0
+                             : strcasecmp(connection.c_str(), "close") != 0;
+    std::string length = header_value(&q, "Content-Length");
+    size_t content_len = length.empty() ? 0 : strtoul(length.c_str(), NULL, 10);
+
+    size_t qmark = target.find('?');
+    std::string path = target.substr(0, qmark);
+    if (qmark != std::string::npos) {
+        q.query = target.substr(qmark + 1);
+        q.has_query = true;
+    }
+
+    bool path_known;
+    const mock_handler_t* h = method < 0 ? NULL : find_handler(s, path, method, &path_known);
+    if (h == NULL || h->def.is_websocket) {
+        stats.rejected++;
+        const char* status = h != NULL ? "501 Not Implemented"
+                             : (method >= 0 && path_known) ? "405 Method Not Allowed" : "404 Not Found";
+        send_status_only(session->fd, status);
+        // The unread body would be parsed as the next request
+        return keep_alive && content_len == 0 && h == NULL;
+    }
+
+    httpd_req_t req = {};
+    req.handle = s;
+    req.method = method;
+    memcpy((char*)req.uri, target.c_str(), target.size() + 1);
+    req.content_len = content_len;
+    req.aux = &q;
+    req.user_ctx = h->def.user_ctx;
+    q.body_left = content_len;
+
+    stats.requests++;
+    esp_err_t err = h->def.handler(&req);
+    if (err != ESP_OK) {
+        stats.handler_errors++;
+        return false;
+    }
+    if (q.send_failed) {
+        return false;
+    }
+
+    // Skip whatever part of the body the handler did not read
+    char sink[256];
+    while (q.body_left > 0) {
+        int n = httpd_req_recv(&req, sink, sizeof(sink));
+        if (n <= 0) {
+            return false;
+        }
+    }
+    return keep_alive;
+}
+
+// Reads what is available on a session and serves every complete request in
+// it. Returns false if the session must be closed.
+static bool serve_session(mock_server_t* s, mock_session_t* session) {
+    char buf[MOCK_HTTPD_RX_CHUNK];
+    ssize_t n = recv(session->fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return false;
+    }
+    session->rx.append(buf, (size_t)n);
+    session->last_used = ++s->use_counter;
+
+    for (;;) {
+        size_t header_len = session->rx.find("\r\n\r\n");
+        if (header_len == std::string::npos) {
+            if (session->rx.size() > MOCK_HTTPD_MAX_HDR_LEN) {
+                stats.rejected++;
+                send_status_only(session->fd, "431 Request Header Fields Too Large");
+                return false;
+            }
+            return true;
+        }
+        if (header_len > MOCK_HTTPD_MAX_HDR_LEN) {
+            stats.rejected++;
+            send_status_only(session->fd, "431 Request Header Fields Too Large");
+            return false;
+        }
+        if (!serve_request(s, session, header_len)) {
+            return false;
+        }
+    }
+}
+
+static void close_session(mock_server_t* s, size_t index) {
+    close(s->sessions[index].fd);
+    s->sessions.erase(s->sessions.begin() + (long)index);
+}
+
+static void accept_session(mock_server_t* s) {
+    if (s->sessions.size() >= s->config.max_open_sockets) {
+        // Only reached with lru_purge_enable: make room by dropping the idlest client
+        size_t lru = 0;
+        for (size_t i = 1; i < s->sessions.size(); i++) {
+            if (s->sessions[i].last_used < s->sessions[lru].last_used) {
+                lru = i;
+            }
+        }
+        close_session(s, lru);
+    }
+
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    struct timeval rx_timeout = { s->config.recv_wait_timeout, 0 };
+    struct timeval tx_timeout = { s->config.send_wait_timeout, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rx_timeout, sizeof(rx_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tx_timeout, sizeof(tx_timeout));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    mock_session_t session;
+    session.fd = fd;
+    session.last_used = ++s->use_counter;
+    s->sessions.push_back(std::move(session));
+    stats.accepted++;
+    if (s->sessions.size() > stats.open_peak) {
+        stats.open_peak = (uint16_t)s->sessions.size();
+    }
+}
+
+static void run_work(mock_server_t* s) {
+    char drain[64];
+    while (read(s->wake[0], drain, sizeof(drain)) > 0) {
+    }
+    std::deque<std::pair<httpd_work_fn_t, void*>> items;
+    {
+        std::lock_guard<std::mutex> guard(s->work_lock);
+        items.swap(s->work);
+    }
+    for (const auto& item : items) {
+        item.first(item.second);
+        stats.work_items++;
+    }
+}
+
+static void httpd_task(void* arg) {
+    mock_server_t* s = (mock_server_t*)arg;
+
+    while (!s->stopping.load()) {
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(s->wake[0], &read_set);
+        int max_fd = s->wake[0];
+        // Same rule as the target server: new clients wait in the backlog while every socket is taken
+        if (s->config.lru_purge_enable || s->sessions.size() < s->config.max_open_sockets) {
+            FD_SET(s->listen_fd, &read_set);
+            max_fd = s->listen_fd > max_fd ? s->listen_fd : max_fd;
+        }
+        for (const mock_session_t& session : s->sessions) {
+            FD_SET(session.fd, &read_set);
+            max_fd = session.fd > max_fd ? session.fd : max_fd;
+        }
+
+        if (select(max_fd + 1, &read_set, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (FD_ISSET(s->wake[0], &read_set)) {
+            run_work(s);
+        }
+        for (size_t i = 0; i < s->sessions.size();) {
+            if (FD_ISSET(s->sessions[i].fd, &read_set) && !serve_session(s, &s->sessions[i])) {
+                close_session(s, i);
+                continue;
+            }
+            i++;
+        }
+        if (FD_ISSET(s->listen_fd, &read_set)) {
+            accept_session(s);
+        }
+    }
+
+    while (!s->sessions.empty()) {
+        close_session(s, s->sessions.size() - 1);
+    }
+    s->stopped.store(true);
+}
+
+// Server control
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config) {
+    mock_server_t* s = new mock_server_t();
+    s->config = *config;
+    s->stopping = false;
+    s->stopped = false;
+    s->use_counter = 0;
+
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->listen_fd < 0) {
+        delete s;
+        return ESP_FAIL;
+    }
+    int one = 1;
+    setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)(port_override >= 0 ? port_override : config->server_port));
+    if (bind(s->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(s->listen_fd, config->backlog_conn) != 0 || pipe(s->wake) != 0) {
+        fprintf(stderr, "httpd: cannot listen on port %d: %s\n", ntohs(addr.sin_port), strerror(errno));
+        close(s->listen_fd);
+        delete s;
+        return ESP_FAIL;
+    }
+    fcntl(s->wake[0], F_SETFL, O_NONBLOCK);
+
+    socklen_t addr_len = sizeof(addr);
+    getsockname(s->listen_fd, (struct sockaddr*)&addr, &addr_len);
+    bound_port = ntohs(addr.sin_port);
+
+    xTaskCreatePinnedToCore(httpd_task, "httpd", (uint32_t)config->stack_size, s, config->task_priority, NULL,
+                            config->core_id);
+    *handle = s;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    mock_server_t* s = (mock_server_t*)handle;
+    if (s == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s->stopping.store(true);
+    if (write(s->wake[1], "x", 1) < 0) {
+        return ESP_FAIL;
+    }
+    while (!s->stopped.load()) {
+        vTaskDelay(1);
+    }
+    close(s->listen_fd);
+    close(s->wake[0]);
+    close(s->wake[1]);
+    delete s;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {
+    mock_server_t* s = (mock_server_t*)handle;
+    if (s->handlers.size() >= s->config.max_uri_handlers) {
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+    for (const mock_handler_t& h : s->handlers) {
+        if (h.uri == uri_handler->uri && h.def.method == uri_handler->method) {
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    }
+    mock_handler_t h;
+    h.uri = uri_handler->uri;
+    h.def = *uri_handler;
+    s->handlers.push_back(h);
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg) {
+    mock_server_t* s = (mock_server_t*)handle;
+    if (s == NULL || s->stopping.load()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    {
+        std::lock_guard<std::mutex> guard(s->work_lock);
+        s->work.emplace_back(work, arg);
+    }
+    return write(s->wake[1], "w", 1) == 1 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t* fds, int* client_fds) {
+    mock_server_t* s = (mock_server_t*)handle;
+    if (s->sessions.size() > *fds) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *fds = s->sessions.size();
+    for (size_t i = 0; i < s->sessions.size(); i++) {
+        client_fds[i] = s->sessions[i].fd;
+    }
+    return ESP_OK;
+}
+
+// Responses
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+    ctx(r)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+    ctx(r)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {
+    mock_request_t* q = ctx(r);
+    if (q->resp_headers.size() >= q->server->config.max_resp_headers) {
+        return ESP_ERR_HTTPD_RESP_HDR;
+    }
+    q->resp_headers.emplace_back(field, value);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    mock_request_t* q = ctx(r);
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    char length_header[48];
+    snprintf(length_header, sizeof(length_header), "Content-Length: %zu\r\n", len);
+    if (!send_headers(r, length_header) || (len && !send_all(q->session->fd, buf, len))) {
+        q->send_failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t buf_len) {
+    mock_request_t* q = ctx(r);
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    if (!q->headers_sent && !send_headers(r, "Transfer-Encoding: chunked\r\n")) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    char size_line[16];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+    if (!send_all(q->session->fd, size_line, (size_t)n) || (len && !send_all(q->session->fd, buf, len)) ||
+        !send_all(q->session->fd, "\r\n", 2)) {
+        q->send_failed = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* r, httpd_err_code_t error, const char* msg) {
+    static const char* const statuses[] = {
+        "500 Internal Server Error", "501 Method Not Implemented", "505 Version Not Supported",
+        "400 Bad Request", "401 Unauthorized", "403 Forbidden", "404 Not Found", "405 Method Not Allowed",
+        "408 Request Timeout", "411 Length Required", "413 Content Too Large", "414 URI Too Long",
+        "431 Request Header Fields Too Large",
+    };
+    const char* status = (size_t)error < sizeof(statuses) / sizeof(statuses[0]) ? statuses[error] : statuses[0];
+    httpd_resp_set_status(r, status);
+    httpd_resp_set_type(r, "text/html");
+    return httpd_resp_send(r, msg ? msg : status, HTTPD_RESP_USE_STRLEN);
+}
+
+// Request accessors
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+    mock_request_t* q = ctx(r);
+    if (q->body_left == 0) {
+        return 0;
+    }
+    size_t want = buf_len < q->body_left ? buf_len : q->body_left;
+
+    // Bytes that arrived together with the headers come first
+    std::string& rx = q->session->rx;
+    if (!rx.empty()) {
+        size_t n = want < rx.size() ? want : rx.size();
+        memcpy(buf, rx.data(), n);
+        rx.erase(0, n);
+        q->body_left -= n;
+        return (int)n;
+    }
+
+    ssize_t n = recv(q->session->fd, buf, want, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    }
+    if (n <= 0) {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    q->body_left -= (size_t)n;
+    return (int)n;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r) {
+    return ctx(r)->session->fd;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {
+    return header_value(ctx(r), field).size();
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {
+    mock_request_t* q = ctx(r);
+    for (const auto& h : q->headers) {
+        if (strcasecmp(h.first.c_str(), field) == 0) {
+            snprintf(val, val_size, "%s", h.second.c_str());
+            return h.second.size() < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r) {
+    return ctx(r)->query.size();
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {
+    mock_request_t* q = ctx(r);
+    if (!q->has_query) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    snprintf(buf, buf_len, "%s", q->query.c_str());
+    return q->query.size() < buf_len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+    size_t key_len = strlen(key);
+    const char* p = qry;
+    while (*p) {
+        const char* end = strchr(p, '&');
+        if (end == NULL) {
+            end = p + strlen(p);
+        }
+        if ((size_t)(end - p) > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            const char* v = p + key_len + 1;
+            size_t len = (size_t)(end - v);
+            snprintf(val, val_size, "%.*s", (int)len, v);
+            return len < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+        }
+        p = *end ? end + 1 : end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// WebSocket: upgrades are refused (501), so there is never a WebSocket session
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t* req, httpd_ws_frame_t* pkt, size_t max_len) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t* req, httpd_ws_frame_t* pkt) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t* frame) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd) {
+    mock_server_t* s = (mock_server_t*)hd;
+    for (const mock_session_t& session : s->sessions) {
+        if (session.fd == fd) {
+            return HTTPD_WS_CLIENT_HTTP;
+        }
+    }
+    return HTTPD_WS_CLIENT_INVALID;
+}
@@ -0,0 +1,188 @@
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "host_mock.h"
+#include <string.h>
+
+// Records every duty change as it would reach the peripheral, so host builds can
+// check dimming behaviour (gamma mapping, fade targets and timing) without hardware.
+
+typedef struct {
+    bool configured;
+    ledc_timer_t timer;
+    uint32_t pending_duty;
+    uint32_t pending_fade_ms;
+    bool fade_pending;
+} mock_channel_t;
+
+typedef struct {
+    uint32_t freq_hz;
+    ledc_timer_bit_t resolution;
+} mock_timer_t;
+
+static mock_ledc_event_t timeline[MOCK_LEDC_TIMELINE_MAX];
+static size_t timeline_count = 0;
+static mock_channel_t channels[LEDC_CHANNEL_MAX];
+static mock_timer_t timers[LEDC_TIMER_MAX];
+static bool fade_installed = false;
+
+static void record(ledc_channel_t channel, uint32_t duty, uint32_t fade_ms) {
+    if (timeline_count < MOCK_LEDC_TIMELINE_MAX) {
+        mock_ledc_event_t* ev = &timeline[timeline_count++];
+        ev->time_us = esp_timer_get_time();
+        ev->channel = channel;
+        ev->duty = duty;
+        ev->fade_ms = fade_ms;
+    }
+}
+
+static bool valid_channel(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    return speed_mode < LEDC_SPEED_MODE_MAX && channel >= 0 && channel < LEDC_CHANNEL_MAX &&
+           channels[channel].configured;
+}
+
+void mock_ledc_reset(void) {
+    timeline_count = 0;
+    memset(channels, 0, sizeof(channels));
+    memset(timers, 0, sizeof(timers));
+    fade_installed = false;
+}
+
+const mock_ledc_event_t* mock_ledc_timeline(size_t* count) {
+    *count = timeline_count;
+    return timeline;
+}
+
+uint32_t mock_ledc_duty_at(ledc_channel_t channel, int64_t time_us) {
+    uint32_t from = 0;
+    uint32_t to = 0;
+    int64_t start_us = 0;
+    int64_t fade_us = 0;
+
+    for (size_t i = 0; i < timeline_count && timeline[i].time_us <= time_us; i++) {
+        const mock_ledc_event_t* ev = &timeline[i];
+        if (ev->channel != channel) {
+            continue;
+        }
+        // Duty at the moment this event lands, given the previous segment
+        uint32_t current = to;
+        if (fade_us > 0 && ev->time_us < start_us + fade_us) {
+            current = from + (uint32_t)(((int64_t)to - (int64_t)from) * (ev->time_us - start_us) / fade_us);
+        }
+        from = current;
+        to = ev->duty;
+        start_us = ev->time_us;
+        fade_us = (int64_t)ev->fade_ms * 1000;
+    }
+
+    if (fade_us > 0 && time_us < start_us + fade_us) {
+        return from + (uint32_t)(((int64_t)to - (int64_t)from) * (time_us - start_us) / fade_us);
+    }
+    return to;
+}
+
+uint32_t mock_ledc_frequency(ledc_timer_t timer) {
+    return timer < LEDC_TIMER_MAX ? timers[timer].freq_hz : 0;
+}
+
+ledc_timer_bit_t mock_ledc_resolution(ledc_timer_t timer) {
+    return timer < LEDC_TIMER_MAX ? timers[timer].resolution : LEDC_TIMER_1_BIT;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* timer_conf) {
+    if (timer_conf == NULL || timer_conf->timer_num >= LEDC_TIMER_MAX ||
+        timer_conf->duty_resolution >= LEDC_TIMER_BIT_MAX || timer_conf->freq_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Same divider limit as the ESP32: 80 MHz APB must cover freq * 2^resolution
+    if ((uint64_t)timer_conf->freq_hz << timer_conf->duty_resolution > 80000000ULL) {
+        return ESP_FAIL;
+    }
+    timers[timer_conf->timer_num].freq_hz = timer_conf->freq_hz;
+    timers[timer_conf->timer_num].resolution = timer_conf->duty_resolution;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* ledc_conf) {
+    if (ledc_conf == NULL || ledc_conf->channel >= LEDC_CHANNEL_MAX || ledc_conf->timer_sel >= LEDC_TIMER_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mock_channel_t* ch = &channels[ledc_conf->channel];
+    ch->configured = true;
+    ch->timer = ledc_conf->timer_sel;
+    ch->fade_pending = false;
+    record(ledc_conf->channel, ledc_conf->duty, 0);
+    return ledc_set_pin(ledc_conf->gpio_num, ledc_conf->speed_mode, ledc_conf->channel);
+}
+
+esp_err_t ledc_fade_func_install(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    if (fade_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    fade_installed = true;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty_and_update(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty, uint32_t hpoint) {
+    (void)hpoint;
+    if (!fade_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!valid_channel(speed_mode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    record(channel, duty, 0);
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t target_duty, int max_fade_time_ms) {
+    if (!fade_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!valid_channel(speed_mode, channel) || max_fade_time_ms < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    channels[channel].pending_duty = target_duty;
+    channels[channel].pending_fade_ms = (uint32_t)max_fade_time_ms;
+    channels[channel].fade_pending = true;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode) {
+    if (!valid_channel(speed_mode, channel) || !channels[channel].fade_pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    mock_channel_t* ch = &channels[channel];
+    ch->fade_pending = false;
+    record(channel, ch->pending_duty, ch->pending_fade_ms);
+    if (fade_mode == LEDC_FADE_WAIT_DONE) {
+        mock_clock_advance_us((int64_t)ch->pending_fade_ms * 1000);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_stop(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if (!valid_channel(speed_mode, channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Freeze the output at wherever a running fade has got to
+    int64_t now = esp_timer_get_time();
+    for (size_t i = timeline_count; i > 0; i--) {
+        const mock_ledc_event_t* ev = &timeline[i - 1];
+        if (ev->channel != channel) {
+            continue;
+        }
+        if (ev->fade_ms > 0 && now < ev->time_us + (int64_t)ev->fade_ms * 1000) {
+            record(channel, mock_ledc_duty_at(channel, now), 0);
+        }
+        break;
+    }
+    return ESP_OK;
+}
+
+uint32_t ledc_get_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+    if (!valid_channel(speed_mode, channel)) {
+        return 0;
+    }
+    return mock_ledc_duty_at(channel, esp_timer_get_time());
+}
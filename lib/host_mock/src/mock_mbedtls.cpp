@@ -0,0 +1,231 @@
+#include "mbedtls/base64.h"
+#include "mbedtls/md.h"
+#include <stdint.h>
+#include <string.h>
+
+// SHA-256 (FIPS 180-4) and HMAC (RFC 2104), straightforward rather than fast
+
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t sha256_info = {MBEDTLS_MD_SHA256};
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t used;
+} sha256_t;
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_block(sha256_t* ctx, const uint8_t* p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+static void sha256_init(sha256_t* ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(sha256_t* ctx, const uint8_t* data, size_t len) {
+    ctx->length += len;
+    while (len > 0) {
+        size_t n = sizeof(ctx->block) - ctx->used;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->block + ctx->used, data, n);
+        ctx->used += n;
+        data += n;
+        len -= n;
+        if (ctx->used == sizeof(ctx->block)) {
+            sha256_block(ctx, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256_finish(sha256_t* ctx, uint8_t out[32]) {
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) {
+        sha256_update(ctx, &pad, 1);
+    }
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    sha256_update(ctx, length, sizeof(length));
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        out[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t md_type) {
+    return md_type == MBEDTLS_MD_SHA256 ? &sha256_info : NULL;
+}
+
+int mbedtls_md(const mbedtls_md_info_t* md_info, const unsigned char* input, size_t ilen, unsigned char* output) {
+    if (md_info != &sha256_info) {
+        return MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+    }
+    sha256_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, input, ilen);
+    sha256_finish(&ctx, output);
+    return 0;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t* md_info, const unsigned char* key, size_t keylen,
+                    const unsigned char* input, size_t ilen, unsigned char* output) {
+    if (md_info != &sha256_info) {
+        return MBEDTLS_ERR_MD_BAD_INPUT_DATA;
+    }
+    uint8_t block_key[64] = {};
+    sha256_t ctx;
+    if (keylen > sizeof(block_key)) {
+        sha256_init(&ctx);
+        sha256_update(&ctx, key, keylen);
+        sha256_finish(&ctx, block_key);
+    } else {
+        memcpy(block_key, key, keylen);
+    }
+
+    uint8_t pad[64];
+    uint8_t inner[32];
+    for (int i = 0; i < 64; i++) {
+        pad[i] = block_key[i] ^ 0x36;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, input, ilen);
+    sha256_finish(&ctx, inner);
+
+    for (int i = 0; i < 64; i++) {
+        pad[i] = block_key[i] ^ 0x5c;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, inner, sizeof(inner));
+    sha256_finish(&ctx, output);
+    return 0;
+}
+
+static const char b64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+    size_t needed = (slen + 2) / 3 * 4 + 1;
+    if (dst == NULL || dlen < needed) {
+        *olen = needed;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < slen) {
+            v |= (uint32_t)src[i + 1] << 8;
+        }
+        if (i + 2 < slen) {
+            v |= src[i + 2];
+        }
+        dst[n++] = b64_alphabet[(v >> 18) & 0x3f];
+        dst[n++] = b64_alphabet[(v >> 12) & 0x3f];
+        dst[n++] = i + 1 < slen ? b64_alphabet[(v >> 6) & 0x3f] : '=';
+        dst[n++] = i + 2 < slen ? b64_alphabet[v & 0x3f] : '=';
+    }
+    dst[n] = '\0';
+    *olen = n;
+    return 0;
+}
+
+int mbedtls_base64_decode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+    uint8_t digits[4];
+    int count = 0;
+    int padding = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < slen; i++) {
+        const char* pos = strchr(b64_alphabet, src[i]);
+        if (src[i] == '=') {
+            padding++;
+            digits[count++] = 0;
+        } else if (src[i] != '\0' && pos != NULL && padding == 0) {
+            digits[count++] = (uint8_t)(pos - b64_alphabet);
+        } else {
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+        }
+        if (count == 4) {
+            uint32_t v = (uint32_t)digits[0] << 18 | (uint32_t)digits[1] << 12 | (uint32_t)digits[2] << 6 | digits[3];
+            int bytes = 3 - padding;
+            if (bytes < 1) {
+                return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+            }
+            for (int b = 0; b < bytes; b++) {
+                if (dst == NULL || n >= dlen) {
+                    *olen = (slen / 4) * 3;
+                    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+                }
+                dst[n++] = (uint8_t)(v >> (16 - 8 * b));
+            }
+            count = 0;
+        }
+    }
+    if (count != 0) {
+        return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+    }
+    *olen = n;
+    return 0;
+}
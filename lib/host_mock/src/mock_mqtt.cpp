@@ -0,0 +1,574 @@
+#include "mqtt_client.h"
+#include "mqtt_outbox.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_mock.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+// In-process broker stand-in for esp-mqtt. The broker side pushes events into
+// the client's inbox; the client's "mqtt_task" pops them one at a time and
+// runs the registered handlers, exactly as the esp-mqtt task does. A full
+// inbox blocks the broker side, which is how TCP backpressure looks to a
+// publisher when the device falls behind.
+//
+// Connection state follows esp-mqtt's: esp_mqtt_client_disconnect() only
+// asks the MQTT task to drop the session, and the task enters
+// WAIT_RECONNECT when it dispatches MQTT_EVENT_DISCONNECTED. The next connect
+// happens network.reconnect_timeout_ms later, or as soon as
+// esp_mqtt_client_reconnect() is called in that state; called in any other
+// state it fails, as on target. mock_mqtt_drop_connection() takes the broker
+// away until mock_mqtt_restore_connection(), which lets the pending retry
+// through right away.
+//
+// With a custom transport (network.transport) the MQTT task connects and
+// closes it around each session and reads every MQTT_EVENT_DATA fragment's
+// bytes through it before dispatching, so the transport's read hooks run as
+// on target.
+//
+// QoS>0 publishes are encoded as MQTT PUBLISH packets and held in the outbox
+// (the mqtt_outbox.h interface, CONFIG_MQTT_CUSTOM_OUTBOX) until their PUBACK
+// reaches the MQTT task. A message the outbox no longer holds is not
+// reported as published, as in esp-mqtt.
+
+#define MOCK_MQTT_DEFAULT_BUFFER 1024   // esp-mqtt default receive buffer
+#define MOCK_MQTT_DEFAULT_INBOX  64
+#define MOCK_MQTT_DEFAULT_RECONNECT_MS 10000   // esp-mqtt MQTT_RECON_DEFAULT_MS
+#define MQTT_MSG_TYPE_PUBLISH    3
+
+static const char* const MQTT_EVENTS = "MQTT_EVENTS";
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    int msg_id;
+    std::string topic;
+    std::string data;
+    int offset;
+    int total;
+    int64_t deliver_us;
+} mock_mqtt_item_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_event_handler_t handler;
+    void* arg;
+} mock_mqtt_handler_t;
+
+struct esp_mqtt_client {
+    std::vector<mock_mqtt_handler_t> handlers;
+    std::mutex lock;
+    std::condition_variable has_items;
+    std::condition_variable has_space;
+    std::deque<mock_mqtt_item_t> inbox;
+    outbox_handle_t outbox = NULL;
+    esp_transport_handle_t transport = NULL;
+    std::string host;               // from broker.address
+    int port = 0;
+    std::vector<int> held_acks;     // PUBACKs the broker is sitting on
+    int buffer_size = MOCK_MQTT_DEFAULT_BUFFER;
+    int task_priority = 5;          // esp-mqtt defaults
+    int task_stack = 6144;
+    std::string password;           // sent with the next CONNECT
+    int next_msg_id = 1;
+    int reconnect_timeout_ms = MOCK_MQTT_DEFAULT_RECONNECT_MS;
+    bool started = false;
+    bool stopping = false;
+    bool connected = false;
+    bool disconnect_requested = false;   // esp-mqtt's DISCONNECT_BIT
+    bool wait_reconnect = false;         // MQTT_STATE_WAIT_RECONNECT
+    bool reconnect_now = false;          // esp_mqtt_client_reconnect() or the broker came back
+    bool broker_down = false;
+    std::chrono::steady_clock::time_point reconnect_at;
+};
+
+static esp_mqtt_client* active_client = NULL;
+static int fragment_override = 0;
+static size_t inbox_limit = MOCK_MQTT_DEFAULT_INBOX;
+static void (*ingest_hook)(int64_t latency_us) = NULL;
+static bool hold_acks = false;
+static mock_mqtt_stats_t stats;
+
+// Packet identifiers are 16 bits and never 0
+static int next_id_locked(esp_mqtt_client* c) {
+    int msg_id = c->next_msg_id;
+    c->next_msg_id = msg_id == 0xffff ? 1 : msg_id + 1;
+    return msg_id;
+}
+
+static void push_locked(esp_mqtt_client* c, mock_mqtt_item_t&& item) {
+    c->inbox.push_back(std::move(item));
+    if (c->inbox.size() > stats.inbox_peak) {
+        stats.inbox_peak = c->inbox.size();
+    }
+    c->has_items.notify_one();
+}
+
+static void push_event_locked(esp_mqtt_client* c, esp_mqtt_event_id_t id, int msg_id) {
+    mock_mqtt_item_t item;
+    item.event_id = id;
+    item.msg_id = msg_id;
+    item.offset = 0;
+    item.total = 0;
+    item.deliver_us = 0;
+    push_locked(c, std::move(item));
+}
+
+static void dispatch(esp_mqtt_client* c, mock_mqtt_item_t* item) {
+    esp_mqtt_event_t event = {};
+    event.event_id = item->event_id;
+    event.client = c;
+    event.msg_id = item->msg_id;
+    event.topic = item->topic.empty() ? NULL : &item->topic[0];
+    event.topic_len = (int)item->topic.size();
+    event.data = item->data.empty() ? NULL : &item->data[0];
+    event.data_len = (int)item->data.size();
+    event.current_data_offset = item->offset;
+    event.total_data_len = item->total;
+    event.qos = 1;
+
+    for (const mock_mqtt_handler_t& h : c->handlers) {
+        if (h.event_id == MQTT_EVENT_ANY || h.event_id == item->event_id) {
+            h.handler(h.arg, MQTT_EVENTS, item->event_id, &event);
+        }
+    }
+}
+
+// The fragment's bytes off the "network": into the transport and back out
+static void read_through_transport(esp_mqtt_client* c, const std::string& data) {
+    if (c->transport == NULL || data.empty() || !mock_tls_inject(data.data(), data.size())) {
+        return;
+    }
+    char buf[256];
+    for (size_t got = 0; got < data.size(); ) {
+        size_t want = data.size() - got < sizeof(buf) ? data.size() - got : sizeof(buf);
+        int n = esp_transport_read(c->transport, buf, (int)want, 0);
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+}
+
+static void ack_locked(esp_mqtt_client* c, int msg_id);
+
+// CONNECT accepted: BEFORE_CONNECT and CONNECTED, then what was queued offline goes out
+static void connect_locked(esp_mqtt_client* c) {
+    c->connected = true;
+    c->wait_reconnect = false;
+    c->reconnect_now = false;
+    push_event_locked(c, MQTT_EVENT_BEFORE_CONNECT, 0);
+    push_event_locked(c, MQTT_EVENT_CONNECTED, 0);
+    stats.connects++;
+    outbox_item_handle_t item;
+    while ((item = outbox_dequeue(c->outbox, QUEUED, NULL)) != NULL) {
+        size_t len;
+        uint16_t msg_id;
+        int msg_type, qos;
+        outbox_item_get_data(item, &len, &msg_id, &msg_type, &qos);
+        outbox_set_pending(c->outbox, msg_id, TRANSMITTED);
+        ack_locked(c, msg_id);
+    }
+}
+
+// The next item for the MQTT task, reconnecting when the wait is over.
+// False when the client is stopping.
+static bool next_item_locked(esp_mqtt_client* c, std::unique_lock<std::mutex>& guard, mock_mqtt_item_t* item) {
+    for (;;) {
+        if (c->stopping) {
+            return false;
+        }
+        if (c->disconnect_requested) {
+            c->disconnect_requested = false;
+            if (c->connected) {
+                c->connected = false;
+                push_event_locked(c, MQTT_EVENT_DISCONNECTED, 0);
+            }
+        }
+        if (!c->inbox.empty()) {
+            *item = std::move(c->inbox.front());
+            c->inbox.pop_front();
+            c->has_space.notify_one();
+            return true;
+        }
+        if (c->wait_reconnect && !c->broker_down) {
+            if (c->reconnect_now || std::chrono::steady_clock::now() >= c->reconnect_at) {
+                connect_locked(c);
+                continue;
+            }
+            c->has_items.wait_until(guard, c->reconnect_at);
+        } else {
+            c->has_items.wait(guard);
+        }
+    }
+}
+
+static void mqtt_task(void* arg) {
+    esp_mqtt_client* c = (esp_mqtt_client*)arg;
+    for (;;) {
+        mock_mqtt_item_t item;
+        {
+            std::unique_lock<std::mutex> guard(c->lock);
+            if (!next_item_locked(c, guard, &item)) {
+                return;
+            }
+            if (item.event_id == MQTT_EVENT_PUBLISHED) {
+                if (outbox_delete(c->outbox, item.msg_id, MQTT_MSG_TYPE_PUBLISH) != ESP_OK) {
+                    continue;   // evicted, or a duplicate PUBACK
+                }
+                stats.acked++;
+            }
+            if (item.event_id == MQTT_EVENT_DISCONNECTED) {
+                // Set before the event goes out, so its handlers may call esp_mqtt_client_reconnect()
+                c->wait_reconnect = true;
+                c->reconnect_at = std::chrono::steady_clock::now() +
+                                  std::chrono::milliseconds(c->reconnect_timeout_ms);
+            }
+        }
+
+        if (item.event_id == MQTT_EVENT_DISCONNECTED && c->transport != NULL) {
+            esp_transport_close(c->transport);
+        } else if (item.event_id == MQTT_EVENT_DATA) {
+            read_through_transport(c, item.data);
+        }
+
+        dispatch(c, &item);
+
+        // esp-mqtt signals BEFORE_CONNECT, then opens the transport
+        if (item.event_id == MQTT_EVENT_BEFORE_CONNECT && c->transport != NULL) {
+            esp_transport_close(c->transport);
+            esp_transport_connect(c->transport, c->host.c_str(), c->port, 10000);
+        }
+
+        if (item.event_id == MQTT_EVENT_DATA && item.offset + (int)item.data.size() >= item.total) {
+            if (ingest_hook != NULL) {
+                ingest_hook(esp_timer_get_time() - item.deliver_us);
+            }
+        }
+    }
+}
+
+// Client side
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config) {
+    esp_mqtt_client* c = new esp_mqtt_client();
+    c->outbox = outbox_init();
+    if (config->buffer.size > 0) {
+        c->buffer_size = config->buffer.size;
+    }
+    if (config->task.priority > 0) {
+        c->task_priority = config->task.priority;
+    }
+    if (config->task.stack_size > 0) {
+        c->task_stack = config->task.stack_size;
+    }
+    if (config->credentials.authentication.password != NULL) {
+        c->password = config->credentials.authentication.password;
+    }
+    c->transport = config->network.transport;
+    if (config->network.reconnect_timeout_ms > 0) {
+        c->reconnect_timeout_ms = config->network.reconnect_timeout_ms;
+    }
+    if (config->broker.address.hostname != NULL) {
+        c->host = config->broker.address.hostname;
+        c->port = (int)config->broker.address.port;
+    } else if (config->broker.address.uri != NULL) {
+        // scheme://host[:port][/path]
+        std::string uri = config->broker.address.uri;
+        size_t start = uri.find("://");
+        start = start == std::string::npos ? 0 : start + 3;
+        size_t end = uri.find_first_of(":/", start);
+        c->host = uri.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (end != std::string::npos && uri[end] == ':') {
+            c->port = atoi(uri.c_str() + end + 1);
+        }
+    }
+    return c;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void* event_handler_arg) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    client->handlers.push_back({ event, event_handler, event_handler_arg });
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (client->started) {
+        return ESP_FAIL;
+    }
+    client->started = true;
+    client->connected = true;
+    active_client = client;
+    push_event_locked(client, MQTT_EVENT_BEFORE_CONNECT, 0);
+    push_event_locked(client, MQTT_EVENT_CONNECTED, 0);
+    stats.connects++;
+    // Placed as esp-mqtt places it: on the sdkconfig core when core selection
+    // is enabled (the CONFIG_MQTT_* build flags stand in for sdkconfig), else unpinned
+#if CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED && defined(CONFIG_MQTT_USE_CORE_1)
+    xTaskCreatePinnedToCore(mqtt_task, "mqtt_task", client->task_stack, client, client->task_priority, NULL, 1);
+#elif CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED
+    xTaskCreatePinnedToCore(mqtt_task, "mqtt_task", client->task_stack, client, client->task_priority, NULL, 0);
+#else
+    xTaskCreate(mqtt_task, "mqtt_task", client->task_stack, client, client->task_priority, NULL);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    client->stopping = true;
+    client->connected = false;
+    client->has_items.notify_all();
+    client->has_space.notify_all();
+    if (active_client == client) {
+        active_client = NULL;
+    }
+    return ESP_OK;
+}
+
+// Only in WAIT_RECONNECT, like esp-mqtt: cuts the wait short
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (!client->wait_reconnect) {
+        stats.reconnects_rejected++;
+        return ESP_FAIL;
+    }
+    client->reconnect_now = true;
+    client->has_items.notify_all();
+    return ESP_OK;
+}
+
+// Asynchronous: the session stays up until the MQTT task gets to it
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    client->disconnect_requested = true;
+    client->has_items.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t* config) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (config->buffer.size > 0) {
+        client->buffer_size = config->buffer.size;
+    }
+    const char* password = config->credentials.authentication.password;
+    if (password != NULL && client->password != password) {
+        client->password = password;
+        stats.password_changes++;
+    }
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (!client->connected) {
+        return -1;
+    }
+    int msg_id = next_id_locked(client);
+    push_event_locked(client, MQTT_EVENT_SUBSCRIBED, msg_id);
+    return msg_id;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (!client->connected) {
+        return -1;
+    }
+    int msg_id = next_id_locked(client);
+    push_event_locked(client, MQTT_EVENT_UNSUBSCRIBED, msg_id);
+    return msg_id;
+}
+
+// The PUBACK for msg_id, unless the broker is holding them
+static void ack_locked(esp_mqtt_client* c, int msg_id) {
+    if (hold_acks) {
+        c->held_acks.push_back(msg_id);
+    } else {
+        push_event_locked(c, MQTT_EVENT_PUBLISHED, msg_id);
+    }
+}
+
+// MQTT 3.1.1 PUBLISH: fixed header, remaining length, topic, packet id, payload
+static std::string encode_publish(const char* topic, const char* data, int len, int qos, int msg_id) {
+    size_t topic_len = strlen(topic);
+    size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + (size_t)len;
+    std::string packet(1, (char)(0x30 | (qos << 1)));
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        packet += (char)(remaining > 0 ? digit | 0x80 : digit);
+    } while (remaining > 0);
+    packet += (char)(topic_len >> 8);
+    packet += (char)(topic_len & 0xff);
+    packet.append(topic, topic_len);
+    if (qos > 0) {
+        packet += (char)(msg_id >> 8);
+        packet += (char)(msg_id & 0xff);
+    }
+    packet.append(data, (size_t)len);
+    return packet;
+}
+
+static int publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos,
+                   bool store) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    if (!client->connected && !(store && qos > 0)) {
+        return -1;
+    }
+    int msg_id = next_id_locked(client);
+    if (qos > 0) {
+        // Held in the outbox until the broker's PUBACK reaches the MQTT task
+        std::string packet = encode_publish(topic, data, len, qos, msg_id);
+        outbox_message_t message = {};
+        message.data = (uint8_t*)&packet[0];
+        message.len = (int)packet.size();
+        message.msg_id = msg_id;
+        message.msg_qos = qos;
+        message.msg_type = MQTT_MSG_TYPE_PUBLISH;
+        if (outbox_enqueue(client->outbox, &message, esp_timer_get_time() / 1000) == NULL) {
+            return -1;
+        }
+        size_t held = (size_t)outbox_get_size(client->outbox);
+        if (held > stats.outbox_peak_bytes) {
+            stats.outbox_peak_bytes = held;
+        }
+        if (client->connected) {
+            outbox_set_pending(client->outbox, msg_id, TRANSMITTED);
+            ack_locked(client, msg_id);
+        }
+    }
+    stats.published++;
+    stats.published_bytes += len;
+    return msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain) {
+    return publish(client, topic, data, len, qos, qos > 0);
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len,
+                            int qos, int retain, bool store) {
+    return publish(client, topic, data, len, qos, store);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client) {
+    std::lock_guard<std::mutex> guard(client->lock);
+    return (int)outbox_get_size(client->outbox);
+}
+
+// Broker side
+
+void mock_mqtt_set_fragment_size(int bytes) {
+    fragment_override = bytes;
+}
+
+void mock_mqtt_set_inbox_limit(size_t events) {
+    inbox_limit = events ? events : 1;
+}
+
+void mock_mqtt_set_ingest_hook(void (*hook)(int64_t latency_us)) {
+    ingest_hook = hook;
+}
+
+bool mock_mqtt_deliver(const char* topic, const void* data, size_t len) {
+    esp_mqtt_client* c = active_client;
+    if (c == NULL) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> guard(c->lock);
+    if (!c->connected) {
+        stats.refused++;
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    int msg_id = next_id_locked(c);
+    size_t step = (size_t)(fragment_override > 0 ? fragment_override : c->buffer_size);
+    size_t off = 0;
+    do {
+        c->has_space.wait(guard, [c]() { return c->stopping || c->inbox.size() < inbox_limit; });
+        if (c->stopping || !c->connected) {
+            stats.refused++;
+            return false;
+        }
+        // Same shape as esp-mqtt: the topic only travels with the first fragment
+        size_t n = len - off < step ? len - off : step;
+        mock_mqtt_item_t item;
+        item.event_id = MQTT_EVENT_DATA;
+        item.msg_id = msg_id;
+        if (off == 0) {
+            item.topic = topic;
+        }
+        item.data.assign((const char*)data + off, n);
+        item.offset = (int)off;
+        item.total = (int)len;
+        item.deliver_us = now;
+        push_locked(c, std::move(item));
+        stats.fragments++;
+        off += n;
+    } while (off < len);
+    stats.delivered++;
+    return true;
+}
+
+void mock_mqtt_drop_connection(void) {
+    esp_mqtt_client* c = active_client;
+    if (c == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(c->lock);
+    c->broker_down = true;
+    if (c->connected) {
+        c->connected = false;
+        push_event_locked(c, MQTT_EVENT_DISCONNECTED, 0);
+    }
+}
+
+void mock_mqtt_restore_connection(void) {
+    esp_mqtt_client* c = active_client;
+    if (c == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(c->lock);
+    if (c->broker_down) {
+        c->broker_down = false;
+        c->reconnect_now = true;
+        c->has_items.notify_all();
+    }
+}
+
+void mock_mqtt_hold_acks(bool hold) {
+    esp_mqtt_client* c = active_client;
+    if (c == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(c->lock);
+    hold_acks = hold;
+    if (!hold) {
+        for (int msg_id : c->held_acks) {
+            push_event_locked(c, MQTT_EVENT_PUBLISHED, msg_id);
+        }
+        c->held_acks.clear();
+    }
+}
+
+void mock_mqtt_get_stats(mock_mqtt_stats_t* out) {
+    esp_mqtt_client* c = active_client;
+    if (c != NULL) {
+        std::lock_guard<std::mutex> guard(c->lock);
+        *out = stats;
+        out->outbox_bytes = (size_t)outbox_get_size(c->outbox);
+        return;
+    }
+    *out = stats;
+}
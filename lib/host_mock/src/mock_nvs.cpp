@@ -0,0 +1,199 @@
+#include "nvs_flash.h"
+#include "host_mock.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <string.h>
+
+typedef enum {
+    MOCK_NVS_U8,
+    MOCK_NVS_U32,
+    MOCK_NVS_STR,
+    MOCK_NVS_BLOB,
+} mock_nvs_type_t;
+
+typedef struct {
+    mock_nvs_type_t type;
+    std::string bytes;
+} mock_nvs_entry_t;
+
+typedef struct {
+    std::string ns;
+    bool writable;
+} mock_nvs_handle_t;
+
+static std::mutex nvs_lock;
+static bool initialized = false;
+static std::map<std::string, mock_nvs_entry_t> entries;   // "namespace/key"
+static std::map<nvs_handle_t, mock_nvs_handle_t> handles;
+static nvs_handle_t next_handle = 1;
+static uint32_t commits = 0;
+static uint32_t writes = 0;
+
+esp_err_t nvs_flash_init(void) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    entries.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    if (!initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (name == NULL || strlen(name) > 15) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t h = next_handle++;
+    handles[h] = { name, open_mode == NVS_READWRITE };
+    *out_handle = h;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    if (handles.find(handle) == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    commits++;
+    return ESP_OK;
+}
+
+static esp_err_t entry_key(nvs_handle_t handle, const char* key, bool write, std::string* out) {
+    auto it = handles.find(handle);
+    if (it == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (write && !it->second.writable) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (key == NULL || strlen(key) > 15) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = it->second.ns + "/" + key;
+    return ESP_OK;
+}
+
+static esp_err_t set_entry(nvs_handle_t handle, const char* key, mock_nvs_type_t type,
+                           const void* data, size_t len) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    std::string k;
+    esp_err_t err = entry_key(handle, key, true, &k);
+    if (err != ESP_OK) {
+        return err;
+    }
+    entries[k] = { type, std::string((const char*)data, len) };
+    writes++;
+    return ESP_OK;
+}
+
+static esp_err_t get_entry(nvs_handle_t handle, const char* key, mock_nvs_type_t type, std::string* out) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    std::string k;
+    esp_err_t err = entry_key(handle, key, false, &k);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto it = entries.find(k);
+    if (it == entries.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (it->second.type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    *out = it->second.bytes;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    std::string k;
+    esp_err_t err = entry_key(handle, key, true, &k);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return entries.erase(k) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return set_entry(handle, key, MOCK_NVS_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    std::string bytes;
+    esp_err_t err = get_entry(handle, key, MOCK_NVS_U8, &bytes);
+    if (err == ESP_OK) {
+        memcpy(out_value, bytes.data(), sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return set_entry(handle, key, MOCK_NVS_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    std::string bytes;
+    esp_err_t err = get_entry(handle, key, MOCK_NVS_U32, &bytes);
+    if (err == ESP_OK) {
+        memcpy(out_value, bytes.data(), sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return set_entry(handle, key, MOCK_NVS_STR, value, strlen(value) + 1);
+}
+
+// Same contract as the real API for both: NULL out_value queries the length,
+// a short buffer fails with ESP_ERR_NVS_INVALID_LENGTH.
+static esp_err_t copy_out(const std::string& bytes, void* out_value, size_t* length) {
+    if (out_value == NULL) {
+        *length = bytes.size();
+        return ESP_OK;
+    }
+    if (*length < bytes.size()) {
+        *length = bytes.size();
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, bytes.data(), bytes.size());
+    *length = bytes.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    std::string bytes;
+    esp_err_t err = get_entry(handle, key, MOCK_NVS_STR, &bytes);
+    return err == ESP_OK ? copy_out(bytes, out_value, length) : err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return set_entry(handle, key, MOCK_NVS_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    std::string bytes;
+    esp_err_t err = get_entry(handle, key, MOCK_NVS_BLOB, &bytes);
+    return err == ESP_OK ? copy_out(bytes, out_value, length) : err;
+}
+
+uint32_t mock_nvs_write_count(void) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    return writes;
+}
+
+uint32_t mock_nvs_commit_count(void) {
+    std::lock_guard<std::mutex> guard(nvs_lock);
+    return commits;
+}
@@ -0,0 +1,100 @@
+#include "esp_partition.h"
+#include "host_mock.h"
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOCK_PARTITION_MAX    4
+#define MOCK_PARTITION_SECTOR 4096
+
+typedef struct {
+    esp_partition_t info;
+    uint8_t* data;
+    uint32_t erase_count;
+} mock_partition_t;
+
+static mock_partition_t partitions[MOCK_PARTITION_MAX];
+static size_t partition_count = 0;
+static std::mutex partition_lock;
+
+static mock_partition_t* find(const esp_partition_t* p) {
+    for (size_t i = 0; i < partition_count; i++) {
+        if (&partitions[i].info == p) {
+            return &partitions[i];
+        }
+    }
+    return NULL;
+}
+
+const esp_partition_t* mock_partition_add(const char* label, uint32_t size) {
+    if (partition_count >= MOCK_PARTITION_MAX || size % MOCK_PARTITION_SECTOR != 0) {
+        return NULL;
+    }
+    mock_partition_t* p = &partitions[partition_count];
+    memset(&p->info, 0, sizeof(p->info));
+    p->info.type = ESP_PARTITION_TYPE_DATA;
+    p->info.subtype = (esp_partition_subtype_t)0x40;
+    p->info.address = 0x110000 + partition_count * 0x100000;
+    p->info.size = size;
+    p->info.erase_size = MOCK_PARTITION_SECTOR;
+    strncpy(p->info.label, label, sizeof(p->info.label) - 1);
+    p->data = (uint8_t*)malloc(size);
+    if (p->data == NULL) {
+        return NULL;
+    }
+    memset(p->data, 0xFF, size);
+    p->erase_count = 0;
+    partition_count++;
+    return &p->info;
+}
+
+uint32_t mock_partition_erase_count(const esp_partition_t* partition) {
+    mock_partition_t* p = find(partition);
+    return p ? p->erase_count : 0;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                 const char* label) {
+    for (size_t i = 0; i < partition_count; i++) {
+        const esp_partition_t* info = &partitions[i].info;
+        if (info->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || info->subtype == subtype) &&
+            (label == NULL || strcmp(info->label, label) == 0)) {
+            return info;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    mock_partition_t* p = find(partition);
+    if (p == NULL || src_offset + size > p->info.size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(partition_lock);
+    memcpy(dst, p->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    mock_partition_t* p = find(partition);
+    if (p == NULL || dst_offset + size > p->info.size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // NOR flash: programming only turns 1 bits into 0
+    std::lock_guard<std::mutex> guard(partition_lock);
+    for (size_t i = 0; i < size; i++) {
+        p->data[dst_offset + i] &= ((const uint8_t*)src)[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    mock_partition_t* p = find(partition);
+    if (p == NULL || offset + size > p->info.size || offset % MOCK_PARTITION_SECTOR || size % MOCK_PARTITION_SECTOR) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> guard(partition_lock);
+    memset(p->data + offset, 0xFF, size);
+    p->erase_count += size / MOCK_PARTITION_SECTOR;
+    return ESP_OK;
+}
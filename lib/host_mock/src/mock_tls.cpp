@@ -0,0 +1,263 @@
+#include "esp_crt_bundle.h"
+#include "esp_tls.h"
+#include "esp_transport.h"
+#include "host_mock.h"
+#include "mbedtls/ssl.h"
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// esp-tls without TLS: a connection is a local socket pair. The firmware's
+// transport reads and selects on one end; the broker stand-in writes what
+// "arrives from the network" into the other with mock_tls_inject(). Writes
+// are accepted and discarded.
+//
+// Each connection still ends with an mbedTLS session. A full handshake gets a
+// master secret never used before; a resumed one keeps the secret of the
+// session the client offered, as in TLS 1.2. Whether the server resumes is
+// set with mock_tls_set_resumption().
+
+struct esp_transport_item_t {
+    connect_func connect;
+    io_read_func read;
+    io_func write;
+    trans_func close;
+    poll_func poll_read;
+    poll_func poll_write;
+    trans_func destroy;
+    void* context;
+    int default_port;
+};
+
+struct esp_tls {
+    int sockfd;
+    int peerfd;   // broker end
+    mbedtls_ssl_session session;
+    mbedtls_ssl_context ssl;
+};
+
+struct esp_tls_client_session {
+    mbedtls_ssl_session saved;
+};
+
+// The connection mock_tls_inject() feeds: the most recent one still open
+static std::mutex open_lock;
+static esp_tls_t* open_tls = NULL;
+
+static std::atomic<bool> server_resumes{true};
+static std::atomic<uint32_t> next_secret{0};
+static std::atomic<uint32_t> stat_handshakes{0};
+static std::atomic<uint32_t> stat_offered{0};
+static std::atomic<uint32_t> stat_resumed{0};
+
+esp_transport_handle_t esp_transport_init(void) {
+    return (esp_transport_handle_t)calloc(1, sizeof(esp_transport_item_t));
+}
+
+esp_err_t esp_transport_destroy(esp_transport_handle_t t) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (t->destroy) {
+        t->destroy(t);
+    }
+    free(t);
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_set_func(esp_transport_handle_t t, connect_func _connect, io_read_func _read,
+                                 io_func _write, trans_func _close, poll_func _poll_read, poll_func _poll_write,
+                                 trans_func _destroy) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->connect = _connect;
+    t->read = _read;
+    t->write = _write;
+    t->close = _close;
+    t->poll_read = _poll_read;
+    t->poll_write = _poll_write;
+    t->destroy = _destroy;
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_set_context_data(esp_transport_handle_t t, void* data) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->context = data;
+    return ESP_OK;
+}
+
+void* esp_transport_get_context_data(esp_transport_handle_t t) {
+    return t ? t->context : NULL;
+}
+
+esp_err_t esp_transport_set_default_port(esp_transport_handle_t t, int port) {
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    t->default_port = port;
+    return ESP_OK;
+}
+
+int esp_transport_connect(esp_transport_handle_t t, const char* host, int port, int timeout_ms) {
+    if (t == NULL || t->connect == NULL) {
+        return -1;
+    }
+    return t->connect(t, host, port > 0 ? port : t->default_port, timeout_ms);
+}
+
+int esp_transport_read(esp_transport_handle_t t, char* buffer, int len, int timeout_ms) {
+    if (t == NULL || t->read == NULL) {
+        return -1;
+    }
+    return t->read(t, buffer, len, timeout_ms);
+}
+
+int esp_transport_close(esp_transport_handle_t t) {
+    if (t == NULL || t->close == NULL) {
+        return -1;
+    }
+    return t->close(t);
+}
+
+esp_tls_t* esp_tls_init(void) {
+    esp_tls_t* tls = (esp_tls_t*)calloc(1, sizeof(esp_tls_t));
+    if (tls) {
+        tls->sockfd = -1;
+        tls->peerfd = -1;
+        tls->ssl.session = &tls->session;
+    }
+    return tls;
+}
+
+int esp_tls_conn_new_sync(const char* hostname, int hostlen, int port, const esp_tls_cfg_t* cfg, esp_tls_t* tls) {
+    (void)hostname;
+    (void)hostlen;
+    (void)port;
+    int fds[2];
+    if (tls == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return -1;
+    }
+    tls->sockfd = fds[0];
+    tls->peerfd = fds[1];
+
+    stat_handshakes.fetch_add(1, std::memory_order_relaxed);
+    const esp_tls_client_session_t* offered = cfg != NULL ? cfg->client_session : NULL;
+    if (offered != NULL) {
+        stat_offered.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (offered != NULL && server_resumes.load(std::memory_order_relaxed)) {
+        stat_resumed.fetch_add(1, std::memory_order_relaxed);
+        tls->session = offered->saved;
+    } else {
+        uint32_t secret = next_secret.fetch_add(1, std::memory_order_relaxed) + 1;
+        memset(tls->session.master, 0, sizeof(tls->session.master));
+        memcpy(tls->session.master, &secret, sizeof(secret));
+    }
+    std::lock_guard<std::mutex> guard(open_lock);
+    open_tls = tls;
+    return 1;
+}
+
+int esp_tls_conn_destroy(esp_tls_t* tls) {
+    if (tls == NULL) {
+        return -1;
+    }
+    {
+        std::lock_guard<std::mutex> guard(open_lock);
+        if (open_tls == tls) {
+            open_tls = NULL;
+        }
+    }
+    if (tls->sockfd >= 0) {
+        close(tls->sockfd);
+        close(tls->peerfd);
+    }
+    free(tls);
+    return 0;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t* tls, void* data, size_t datalen) {
+    if (tls == NULL || tls->sockfd < 0) {
+        return -1;
+    }
+    return read(tls->sockfd, data, datalen);
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t* tls, const void* data, size_t datalen) {
+    (void)data;
+    if (tls == NULL || tls->sockfd < 0) {
+        return -1;
+    }
+    return (ssize_t)datalen;
+}
+
+bool mock_tls_inject(const void* data, size_t len) {
+    std::lock_guard<std::mutex> guard(open_lock);
+    if (open_tls == NULL) {
+        return false;
+    }
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(open_tls->peerfd, p, len);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+ssize_t esp_tls_get_bytes_avail(esp_tls_t* tls) {
+    (void)tls;
+    return 0;
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t* tls, int* sockfd) {
+    if (tls == NULL || sockfd == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *sockfd = tls->sockfd;
+    return ESP_OK;
+}
+
+void* esp_tls_get_ssl_context(esp_tls_t* tls) {
+    return tls != NULL ? &tls->ssl : NULL;
+}
+
+// Like esp-tls, a copy the caller frees
+esp_tls_client_session_t* esp_tls_get_client_session(esp_tls_t* tls) {
+    if (tls == NULL) {
+        return NULL;
+    }
+    esp_tls_client_session_t* session = (esp_tls_client_session_t*)calloc(1, sizeof(esp_tls_client_session_t));
+    if (session != NULL) {
+        session->saved = tls->session;
+    }
+    return session;
+}
+
+void esp_tls_free_client_session(esp_tls_client_session_t* client_session) {
+    free(client_session);
+}
+
+void mock_tls_set_resumption(bool resume) {
+    server_resumes.store(resume, std::memory_order_relaxed);
+}
+
+void mock_tls_get_stats(mock_tls_stats_t* stats) {
+    stats->handshakes = stat_handshakes.load(std::memory_order_relaxed);
+    stats->offered = stat_offered.load(std::memory_order_relaxed);
+    stats->resumed = stat_resumed.load(std::memory_order_relaxed);
+}
+
+esp_err_t esp_crt_bundle_attach(void* conf) {
+    (void)conf;
+    return ESP_OK;
+}
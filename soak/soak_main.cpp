@@ -0,0 +1,661 @@
+// Host soak/load harness: the firmware's command, telemetry and web paths
+// (everything in src/ except main.cpp, wifi_manager.cpp and time_sync.cpp) running on the
+// FreeRTOS, MQTT, httpd and flash stand-ins from lib/host_mock.
+//
+//   pio run -e native_soak -t exec
+//   .pio/build/native_soak/program [seconds] [c2d/s] [http clients] [mqtt buffer bytes]
+//
+// A broker thread pushes bursts of C2D commands through mqtt_event_handler
+// (including malformed ones and messages large enough to arrive in several
+// MQTT_EVENT_DATA fragments) while HTTP clients hammer web_server_start's
+// server over loopback, so its 7-socket limit is actually hit. Midway the
+// broker drops the connection for a while so telemetry goes through the flash
+// spool and is replayed; before that it sits on its PUBACKs for a while, so
+// the MQTT outbox fills up against its budget. SAS tokens are signed with a test key and live
+// SAS_TOKEN_TTL_S (a few seconds here, see platformio.ini), so token renewals
+// and their reconnects happen under load. The report has p50/p99 latencies per stage, every
+// place a command can be dropped, and heap high-water marks.
+//
+// The run fails (exit status 1, with a FAIL line per check) if a command went
+// missing between the parsers and the actuator, if the /metrics latency
+// histogram disagrees with the actuator's count, if the flash spool did not
+// drain once the connection came back, or if a token renewal kept the session
+// down longer than SOAK_MAX_BLACKOUT_MS (esp-mqtt's reconnect timeout is 10 s).
+//
+// Firmware console output goes to soak_console.log; the report to stdout.
+// Host numbers: compare runs against each other, not against the board.
+
+#include "actuator.h"
+#include "app_events.h"
+#include "azure_config.h"
+#include "azure_iot_mqtt.h"
+#include "binlog.h"
+#include "host_mock.h"
+#include "latency_trace.h"
+#include "led_channels.h"
+#include "led_state.h"
+#include "metrics.h"
+#include "outbox_pool.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "ramp.h"
+#include "sas_token.h"
+#include "schedule.h"
+#include "task_topology.h"
+#include "telemetry.h"
+#include "telemetry_spool.h"
+#include "web_server.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stand-in for the gzipped UI that the firmware build links from web/dist
+asm(".section .rodata\n"
+    ".global _binary_index_html_gz_start\n"
+    "_binary_index_html_gz_start:\n"
+    ".ascii \"<!doctype html><title>PicaPica soak</title>\"\n"
+    ".global _binary_index_html_gz_end\n"
+    "_binary_index_html_gz_end:\n"
+    ".previous\n");
+
+#define SOAK_SPOOL_SIZE      (64 * 1024)
+#define SOAK_BURSTS_PER_SEC  50           // the broker sends in bursts, not evenly
+#define SOAK_HTTP_TIMEOUT_S  5
+#define SOAK_METHOD_PERIOD_MS 20          // direct method calls alongside the C2D load
+#define SOAK_MAX_BLACKOUT_MS 1000         // token renewal, disconnect to CONNECTED
+#define SOAK_DEVICE_KEY      "dGhpcyBpcyBhIDMyIGJ5dGUgc2VjcmV0IGtleSEhIQ=="   // 32 bytes, test only
+
+// Latency histogram: 16 linear buckets, then 16 per power of two (<= 6% error)
+#define HIST_SUB     16
+#define HIST_BUCKETS (HIST_SUB + 40 * HIST_SUB)
+
+typedef struct {
+    std::atomic<uint32_t> buckets[HIST_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> max;
+} latency_hist_t;
+
+static int hist_index(int64_t v) {
+    if (v < HIST_SUB) {
+        return v < 0 ? 0 : (int)v;
+    }
+    int msb = 63 - __builtin_clzll((uint64_t)v);
+    int shift = msb - 4;
+    int idx = HIST_SUB + shift * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+static int64_t hist_value(int idx) {
+    if (idx < HIST_SUB) {
+        return idx;
+    }
+    int shift = (idx - HIST_SUB) / HIST_SUB;
+    return (int64_t)((idx - HIST_SUB) % HIST_SUB + HIST_SUB) << shift;
+}
+
+static void hist_add(latency_hist_t* h, int64_t v) {
+    h->buckets[hist_index(v)].fetch_add(1, std::memory_order_relaxed);
+    h->count.fetch_add(1, std::memory_order_relaxed);
+    int64_t max = h->max.load(std::memory_order_relaxed);
+    while (v > max && !h->max.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+    }
+}
+
+static int64_t hist_percentile(const latency_hist_t* h, double p) {
+    uint64_t total = h->count.load();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i].load();
+        if (seen > rank) {
+            return hist_value(i);
+        }
+    }
+    return h->max.load();
+}
+
+static latency_hist_t ingest_latency;      // broker -> mqtt_event_handler done (queued to the actuator)
+static latency_hist_t actuation_latency;   // actuator_submit -> hardware write
+static latency_hist_t http_latency;        // connect -> full response, client side
+
+// Load
+typedef struct {
+    const char* text;
+    bool valid;
+} c2d_payload_t;
+
+static const c2d_payload_t c2d_mix[] = {
+    { "RGB:ON", true },
+    { "WHITE:OFF", true },
+    { "VERDE:128", true },
+    { "FAR_RED:ON", true },
+    { "RGB:ON,WHITE:128,VERDE:OFF,FAR_RED:255", true },
+    { "{\"RGB\":\"ON\",\"WHITE\":128}", true },
+    { "MASK:0B", true },
+    { "RGB:64;WHITE:ON", true },
+    { "ALL:OFF", true },
+    { "RGB:MAYBE", false },
+    { "PURPLE:ON", false },
+    { "{\"RGB\":", false },
+};
+
+static const char c2d_topic[] = "devices/" DEVICE_ID "/messages/devicebound/%24.to=%2Fdevices%2F" DEVICE_ID
+                                "%2Fmessages%2FdeviceBound";
+
+// The hub stamps its enqueue time as a topic property; alternately as ISO 8601 and epoch ms
+static void stamp_c2d_topic(char* topic, size_t size, size_t i) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (i % 2) {
+        snprintf(topic, size, "%s&iothub-enqueuedtime=%lld", c2d_topic,
+                 (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+        return;
+    }
+    struct tm utc;
+    gmtime_r(&tv.tv_sec, &utc);
+    snprintf(topic, size, "%s&iothub-enqueuedtime=%04d-%02d-%02dT%02d%%3A%02d%%3A%02d.%03dZ", c2d_topic,
+             utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+             (int)(tv.tv_usec / 1000));
+}
+
+static const char schedule_topic[] = "devices/" DEVICE_ID "/messages/devicebound/%24.to=%2Fdevices%2F" DEVICE_ID
+                                    "%2Fmessages%2FdeviceBound&type=schedule";
+
+static const char ramp_topic[] = "devices/" DEVICE_ID "/messages/devicebound/%24.to=%2Fdevices%2F" DEVICE_ID
+                                "%2Fmessages%2FdeviceBound&type=ramp";
+
+// Runs once the load stops, so no command cuts it short
+static const char ramp_text[] = "WHITE 2s=255 4s=0; VERDE 1500ms=0 3s=200";
+#define SOAK_RAMP_MS 4000
+
+// Desired property patch from the backend, delivered with the load running
+static const char twin_desired_topic[] = "$iothub/twin/PATCH/properties/desired/?$version=2";
+static const char twin_desired[] = "{\"channels\":{\"RGB\":64,\"WHITE\":\"ON\",\"VERDE\":null},\"$version\":2}";
+
+static std::atomic<bool> load_running{true};
+static std::atomic<uint32_t> c2d_sent{0};
+static std::atomic<uint32_t> c2d_valid{0};
+static std::atomic<uint32_t> c2d_refused{0};
+
+// FAR_RED edges spread over the run, alternating ON/OFF. Returns the edge count.
+static int upload_schedule(unsigned seconds) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    time_t now = tv.tv_sec;
+    struct tm local;
+    localtime_r(&now, &local);
+    uint32_t now_ms = (uint32_t)((local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec) * 1000 +
+                                 tv.tv_usec / 1000);
+
+    uint32_t step_ms = seconds * 1000 / (SCHEDULE_MAX_ENTRIES + 1);
+    char text[SCHEDULE_MAX_ENTRIES * 20 + 16];
+    int n = snprintf(text, sizeof(text), "FAR_RED");
+    for (int i = 1; i <= SCHEDULE_MAX_ENTRIES; i++) {
+        uint32_t t = (now_ms + i * step_ms) % SCHEDULE_DAY_MS;
+        n += snprintf(text + n, sizeof(text) - n, " %02u:%02u:%02u.%03u=%s", t / 3600000, t / 60000 % 60,
+                      t / 1000 % 60, t % 1000, i % 2 ? "ON" : "OFF");
+    }
+    return mock_mqtt_deliver(schedule_topic, text, (size_t)n) ? SCHEDULE_MAX_ENTRIES : 0;
+}
+
+typedef enum {
+    HTTP_REQ_LED,
+    HTTP_REQ_LED_BATCH,
+    HTTP_REQ_API_GET,
+    HTTP_REQ_API_POST,
+    HTTP_REQ_CHANNELS,
+    HTTP_REQ_METRICS,
+    HTTP_REQ_COUNT,
+} http_req_kind_t;
+
+static std::atomic<uint32_t> http_ok{0};
+static std::atomic<uint32_t> http_status_errors{0};
+static std::atomic<uint32_t> http_io_errors{0};
+static std::atomic<uint32_t> http_commands{0};   // command requests answered, accepted or not
+static std::atomic<uint32_t> http_commands_unanswered{0};   // sent, then the connection failed: applied or not
+
+static void actuation_listener(const cmd_record_t* record) {
+    hist_add(&actuation_latency, esp_timer_get_time() - record->enqueue_us);
+}
+
+static void ingest_hook(int64_t latency_us) {
+    hist_add(&ingest_latency, latency_us);
+}
+
+static void broker_thread(uint32_t rate, std::string* large) {
+    uint32_t burst = rate / SOAK_BURSTS_PER_SEC ? rate / SOAK_BURSTS_PER_SEC : 1;
+    int64_t interval_us = 1000000LL * burst / (rate ? rate : 1);
+    int64_t next = esp_timer_get_time();
+    size_t i = 0;
+    char topic[sizeof(c2d_topic) + 128];
+
+    while (load_running.load()) {
+        for (uint32_t b = 0; b < burst; b++, i++) {
+            // One in 64 messages is the large one, which arrives fragmented
+            const char* text = (i % 64 == 63) ? large->c_str() : c2d_mix[i % (sizeof(c2d_mix) / sizeof(c2d_mix[0]))].text;
+            bool valid = (i % 64 == 63) || c2d_mix[i % (sizeof(c2d_mix) / sizeof(c2d_mix[0]))].valid;
+            stamp_c2d_topic(topic, sizeof(topic), i);
+            if (mock_mqtt_deliver(topic, text, strlen(text))) {
+                c2d_sent++;
+                if (valid) {
+                    c2d_valid++;
+                }
+            } else {
+                c2d_refused++;
+            }
+        }
+        next += interval_us;
+        int64_t wait = next - esp_timer_get_time();
+        if (wait > 0) {
+            usleep((useconds_t)wait);
+        }
+    }
+}
+
+// An operator calling setChannels and waiting for the answer, over and over
+static void method_caller_thread(void) {
+    static const char payload[] = "{\"WHITE\":128,\"VERDE\":\"ON\"}";
+    char topic[64];
+    for (uint32_t rid = 1; load_running.load(); rid++) {
+        snprintf(topic, sizeof(topic), "$iothub/methods/POST/setChannels/?$rid=%x", rid);
+        mock_mqtt_deliver(topic, payload, sizeof(payload) - 1);
+        usleep(SOAK_METHOD_PERIOD_MS * 1000);
+    }
+}
+
+static int http_request(uint16_t port, http_req_kind_t kind, int n) {
+    char req[512];
+    static const char* const levels[] = { "ON", "OFF", "128", "17" };
+    const char* level = levels[n & 3];
+    int len;
+    switch (kind) {
+        case HTTP_REQ_LED:
+            len = snprintf(req, sizeof(req), "GET /led?channel=%s&state=%s HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n\r\n",
+                           LED_CHANNELS[n % LED_CHANNEL_COUNT].name, level);
+            break;
+        case HTTP_REQ_LED_BATCH:
+            len = snprintf(req, sizeof(req), "GET /led?cmd=RGB:%s,WHITE:%s HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n\r\n",
+                           level, levels[(n + 1) & 3]);
+            break;
+        case HTTP_REQ_API_POST: {
+            char body[96];
+            int body_len = snprintf(body, sizeof(body), "{\"%s\":\"%s\",\"VERDE\":%d}",
+                                    LED_CHANNELS[n % LED_CHANNEL_COUNT].name, level, n & 0xFF);
+            len = snprintf(req, sizeof(req), "POST /api/channels HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n"
+                           "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s", body_len, body);
+            break;
+        }
+        case HTTP_REQ_API_GET:
+            len = snprintf(req, sizeof(req), "GET /api/channels HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n\r\n");
+            break;
+        case HTTP_REQ_METRICS:
+            len = snprintf(req, sizeof(req), "GET /metrics HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n\r\n");
+            break;
+        default:
+            len = snprintf(req, sizeof(req), "GET /channels.json HTTP/1.1\r\nHost: soak\r\nConnection: close\r\n\r\n");
+            break;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct timeval timeout = { SOAK_HTTP_TIMEOUT_S, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    int status = -1;
+    char head[64];
+    char sink[1024];
+    size_t got = 0;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && send(fd, req, (size_t)len, MSG_NOSIGNAL) == len) {
+        // Connection: close - the response ends when the server closes the socket.
+        // Only the status line is kept.
+        for (;;) {
+            char* dst = got < sizeof(head) ? head + got : sink;
+            ssize_t r = recv(fd, dst, got < sizeof(head) ? sizeof(head) - got : sizeof(sink), 0);
+            if (r <= 0) {
+                if (r == 0 && got >= 12) {
+                    status = atoi(head + 9);
+                }
+                break;
+            }
+            got += (size_t)r;
+        }
+    }
+    close(fd);
+    return status;
+}
+
+static void http_client_thread(int id) {
+    uint16_t port = mock_httpd_bound_port();
+    for (int n = id; load_running.load(); n++) {
+        http_req_kind_t kind = (http_req_kind_t)(n % HTTP_REQ_COUNT);
+        bool command = kind == HTTP_REQ_LED || kind == HTTP_REQ_LED_BATCH || kind == HTTP_REQ_API_POST;
+        int64_t start = esp_timer_get_time();
+        int status = http_request(port, kind, n);
+        if (status < 0) {
+            http_io_errors++;
+            if (command) {
+                http_commands_unanswered++;
+            }
+            continue;
+        }
+        hist_add(&http_latency, esp_timer_get_time() - start);
+        if (status >= 200 && status < 300) {
+            http_ok++;
+        } else {
+            http_status_errors++;
+        }
+        if (command) {
+            http_commands++;
+        }
+    }
+}
+
+// Report
+
+static FILE* report = stdout;
+
+// /metrics as the web server streams it, one string per chunk
+static void collect_metrics_chunk(const char* text, size_t len, void* ctx) {
+    ((std::vector<std::string>*)ctx)->emplace_back(text, len);
+}
+
+static void print_hist(const char* name, const latency_hist_t* h) {
+    fprintf(report, "  %-28s %9llu %9lld %9lld %9lld\n", name, (unsigned long long)h->count.load(),
+            (long long)hist_percentile(h, 0.50), (long long)hist_percentile(h, 0.99), (long long)h->max.load());
+}
+
+int main(int argc, char** argv) {
+    uint32_t seconds = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 30;
+    uint32_t rate = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 2000;
+    int clients = argc > 3 ? atoi(argv[3]) : 16;
+    int fragment = argc > 4 ? atoi(argv[4]) : 1024;
+    if (seconds == 0) {
+        seconds = 1;
+    }
+
+    // Keep the report readable: the firmware's console goes to a file
+    int report_fd = dup(STDOUT_FILENO);
+    report = fdopen(report_fd, "w");
+    if (freopen("soak_console.log", "w", stdout) == NULL) {
+        report = stdout;
+    }
+
+    mock_clock_use_wall_time();
+    mock_httpd_set_port(0);
+    mock_mqtt_set_fragment_size(fragment);
+    mock_mqtt_set_ingest_hook(ingest_hook);
+    mock_partition_add(TELEMETRY_SPOOL_PARTITION, SOAK_SPOOL_SIZE);
+
+    // Same bring-up order as app_main, minus WiFi
+    app_events_init();
+    binlog_start();
+    ESP_ERROR_CHECK(nvs_flash_init());
+    led_channels_init();
+    ESP_ERROR_CHECK(actuator_start());
+    ESP_ERROR_CHECK(task_topology_start());
+    actuator_add_listener(actuation_listener);
+    led_state_restore();
+    ESP_ERROR_CHECK(led_state_start());
+    ESP_ERROR_CHECK(schedule_start());
+    ESP_ERROR_CHECK(ramp_start());
+    schedule_on_time_set();   // the host clock stands in for SNTP
+    telemetry_spool_init();
+    ESP_ERROR_CHECK(web_server_start());
+    // Provisioned like a factory NVS image would be
+    ESP_ERROR_CHECK(sas_token_provision_key(SOAK_DEVICE_KEY));
+    ESP_ERROR_CHECK(azure_iot_mqtt_init());
+    telemetry_set_rate(100, 4);
+    telemetry_start();
+    ESP_ERROR_CHECK(azure_iot_mqtt_start());
+    app_events_wait(APP_EVENT_MQTT_CONNECTED, portMAX_DELAY);
+    int topology_mismatches = task_topology_check();
+    metrics_init();
+
+    size_t heap_baseline = mock_heap_in_use();
+    uint64_t allocs_baseline = mock_heap_allocations();
+    mock_heap_reset_peak();
+
+    // Above MQTT_REASSEMBLY_MAX_MESSAGE / 2 so it always spans fragments at the default buffer size
+    std::string large = "{\"RGB\":\"ON\",";
+    large.append(1400, ' ');
+    large += "\"WHITE\":64,\"VERDE\":\"OFF\"}";
+
+    fprintf(report, "\nsoak: %us, %u C2D/s in bursts of %u, %d HTTP clients, MQTT buffer %d bytes, httpd port %u\n",
+            seconds, rate, rate / SOAK_BURSTS_PER_SEC, clients, fragment, mock_httpd_bound_port());
+    fflush(report);
+
+    // A full day's table for FAR_RED squeezed into the run, uploaded like the cloud does
+    int schedule_edges = upload_schedule(seconds);
+    bool twin_sent = mock_mqtt_deliver(twin_desired_topic, twin_desired, sizeof(twin_desired) - 1);
+
+    std::vector<std::thread> threads;
+    threads.emplace_back(broker_thread, rate, &large);
+    threads.emplace_back(method_caller_thread);
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(http_client_thread, i);
+    }
+
+    // Broker sits on its PUBACKs from 10% to 35% of the run: the outbox fills to its budget.
+    // Outage from 40% to 55%: telemetry spools to flash, then replays.
+    int64_t start_us = esp_timer_get_time();
+    int64_t stall_start = start_us + seconds * 100000LL;
+    int64_t stall_end = start_us + seconds * 350000LL;
+    int64_t outage_start = start_us + seconds * 400000LL;
+    int64_t outage_end = start_us + seconds * 550000LL;
+    bool stalled = false;
+    bool offline = false;
+    size_t heap_before_stall = 0;
+    size_t heap_stall_peak = 0;
+    for (int64_t now = start_us; now < start_us + seconds * 1000000LL; now = esp_timer_get_time()) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        if (!stalled && now >= stall_start && now < stall_end) {
+            heap_before_stall = mock_heap_in_use();
+            mock_mqtt_hold_acks(true);
+            stalled = true;
+        } else if (stalled && now >= stall_end) {
+            mock_mqtt_hold_acks(false);
+            stalled = false;
+        }
+        if (stalled && mock_heap_in_use() > heap_stall_peak) {
+            heap_stall_peak = mock_heap_in_use();
+        }
+        if (!offline && now >= outage_start && now < outage_end) {
+            mock_mqtt_drop_connection();
+            offline = true;
+        } else if (offline && now >= outage_end) {
+            mock_mqtt_restore_connection();
+            offline = false;
+        }
+    }
+    size_t heap_end_of_load = mock_heap_in_use();
+    uint64_t allocs_end_of_load = mock_heap_allocations();
+
+    load_running = false;
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    // Let the actuator and the spool drain before reading the counters, with a sunrise/sunset meanwhile
+    bool ramp_sent = mock_mqtt_deliver(ramp_topic, ramp_text, sizeof(ramp_text) - 1);
+    vTaskDelay(pdMS_TO_TICKS(SOAK_RAMP_MS + 1000));
+    fflush(stdout);
+
+    actuator_stats_t act;
+    actuator_get_stats(&act);
+    mock_mqtt_stats_t mqtt;
+    mock_mqtt_get_stats(&mqtt);
+    mock_httpd_stats_t httpd;
+    mock_httpd_get_stats(&httpd);
+    telemetry_spool_stats_t spool;
+    telemetry_spool_get_stats(&spool);
+    schedule_stats_t sched;
+    schedule_get_stats(&sched);
+    ramp_stats_t ramp;
+    ramp_get_stats(&ramp);
+    device_twin_stats_t twin;
+    device_twin_get_stats(&twin);
+    direct_methods_stats_t methods;
+    direct_methods_get_stats(&methods);
+    azure_iot_stats_t hub;
+    azure_iot_get_stats(&hub);
+    outbox_pool_stats_t outbox;
+    outbox_pool_get_stats(&outbox);
+    latency_trace_stats_t trace;
+    latency_trace_get_stats(&trace);
+    task_topology_stats_t topology;
+    task_topology_get_stats(&topology);
+
+    fprintf(report, "\nlatency (us)                       count       p50       p99       max\n");
+    print_hist("C2D broker -> queued", &ingest_latency);
+    print_hist("queued -> hardware write", &actuation_latency);
+    print_hist("HTTP request (client side)", &http_latency);
+
+    // Each accepted upload applies the levels in effect, then one batch per edge
+    uint32_t submitted = c2d_valid.load() + http_commands.load() + sched.uploads + sched.edges + ramp.fades +
+                         twin.desired_patches + methods.commands;
+    uint32_t accounted = act.applied + act.superseded + act.dropped;
+    fprintf(report, "\ncommands\n");
+    fprintf(report, "  C2D delivered %u (%.0f/s), valid %u, refused while offline %u\n", c2d_sent.load(),
+            (double)c2d_sent.load() / seconds, c2d_valid.load(), c2d_refused.load());
+    fprintf(report, "  MQTT_EVENT_DATA %u, most events waiting for the MQTT task %zu\n", mqtt.fragments,
+            mqtt.inbox_peak);
+    fprintf(report, "  actuator applied %u, dropped (lane full) %u, superseded by ALL:OFF %u\n", act.applied,
+            act.dropped, act.superseded);
+    uint32_t unanswered = http_commands_unanswered.load();
+    fprintf(report, "  lost between parser and actuator %d (%u HTTP commands got no answer and may have applied)\n",
+            (int)(submitted - accounted), unanswered);
+    fprintf(report, "  LED state saved to NVS %u times\n", mock_nvs_write_count());
+    fprintf(report, "  schedule edges applied %u of %d, timing error last %d ms, worst %d ms\n", sched.edges,
+            schedule_edges, sched.last_error_ms, sched.max_error_ms);
+    fprintf(report, "  ramp %s: %u hardware fades over %u timer wakeups, channels finished %u, cut short %u\n",
+            ramp_sent ? "sent" : "NOT sent", ramp.fades, ramp.wakeups, ramp.finished, ramp.cancelled);
+
+    fprintf(report, "\nhttp\n");
+    fprintf(report, "  2xx %u, other status %u, connect/read errors %u (%.0f req/s)\n", http_ok.load(),
+            http_status_errors.load(), http_io_errors.load(),
+            (double)(http_ok.load() + http_status_errors.load()) / seconds);
+    fprintf(report, "  accepted %u, handled %u, rejected %u, handler errors %u, most sockets open %u of 7\n",
+            httpd.accepted, httpd.requests, httpd.rejected, httpd.handler_errors, httpd.open_peak);
+
+    fprintf(report, "\ntelemetry\n");
+    fprintf(report, "  published %u (with twin and method answers), acked %u, outbox peak %zu bytes\n", mqtt.published, mqtt.acked,
+            mqtt.outbox_peak_bytes);
+    fprintf(report, "  spool stored %u, replayed %u, dropped %u, pending %u\n", spool.stored, spool.replayed,
+            spool.dropped, spool.pending);
+    fprintf(report, "  outbox (budget %d bytes) peak %u bytes, evicted %u (%u bytes), refused %u, held now %u\n",
+            OUTBOX_BUDGET_BYTES, outbox.peak_bytes, outbox.evicted, outbox.evicted_bytes, outbox.refused,
+            outbox.items);
+    fprintf(report, "  heap while PUBACKs were held: %+zd bytes at most\n",
+            (ssize_t)(heap_stall_peak - heap_before_stall));
+
+    fprintf(report, "\ndevice twin\n");
+    fprintf(report, "  desired patch %s, applied %u (version %u), rejected %u\n", twin_sent ? "sent" : "NOT sent",
+            twin.desired_patches, twin.desired_version, twin.desired_errors);
+    fprintf(report, "  reported %u patches for %u actuator writes\n", twin.reported_patches, twin.reported_changes);
+
+    fprintf(report, "\ndirect methods\n");
+    fprintf(report, "  requests %u, answered from the actuator %u, errors %u (of which 504, superseded or timed out, %u)\n",
+            methods.requests, methods.applied, methods.errors, methods.timeouts);
+    fprintf(report, "  request -> hardware write last %u us, worst %u us\n", methods.last_latency_us,
+            methods.max_latency_us);
+
+    fprintf(report, "\nconnection\n");
+    fprintf(report, "  connects %u, disconnects %u, SAS token renewals %u (%u without a quiet window)\n",
+            hub.connects, hub.disconnects, hub.token_renewals, hub.forced_renewals);
+    fprintf(report, "  renewal blackout last %u us, worst %u us; broker saw %u new passwords\n",
+            hub.last_blackout_us, hub.max_blackout_us, mqtt.password_changes);
+    fprintf(report, "  connect (TCP, TLS, CONNACK) last %u ms, worst %u ms\n", hub.last_connect_ms, hub.max_connect_ms);
+
+    fprintf(report, "\nc2d latency trace\n");
+    fprintf(report, "  traced %u, untraced %u, sample records %u\n", trace.traced, trace.untraced, trace.sampled);
+    for (int st = 0; st < TRACE_STAGE_COUNT; st++) {
+        uint32_t count = 0;
+        for (int b = 0; b <= LATENCY_TRACE_BUCKETS; b++) {
+            count += trace.buckets[st][b];
+        }
+        fprintf(report, "  %-9s count %6u, mean %8llu us\n", latency_trace_stage_name((trace_stage_t)st), count,
+                count ? (unsigned long long)(trace.sum_us[st] / count) : 0ULL);
+    }
+
+    // Host threads have no cores to pin: this is the probe's own noise floor, not the profile's effect
+    fprintf(report, "\ntask topology (%s)\n", task_topology_profile_name());
+    fprintf(report, "  tasks off the table %d; control jitter over %u wakeups: mean %llu us, worst %u us\n",
+            topology_mismatches, topology.samples,
+            topology.samples ? (unsigned long long)(topology.total_us / topology.samples) : 0ULL, topology.max_us);
+
+    std::vector<std::string> chunks;
+    metrics_format(collect_metrics_chunk, &chunks);
+    std::string exposition;
+    for (const std::string& chunk : chunks) {
+        exposition += chunk;
+    }
+    size_t series = 0;
+    for (size_t at = 0; at < exposition.size(); at = exposition.find('\n', at) + 1) {
+        series += exposition[at] != '#';
+    }
+    static const char count_series[] = "picapica_command_latency_seconds_count ";
+    const char* hist_count = strstr(exposition.c_str(), count_series);
+    fprintf(report, "\nmetrics\n");
+    fprintf(report, "  %zu series, %zu bytes in %zu chunks; one in %d HTTP requests was a scrape\n", series,
+            exposition.size(), chunks.size(), (int)HTTP_REQ_COUNT);
+    unsigned long hist_applied = hist_count ? strtoul(hist_count + sizeof(count_series) - 1, NULL, 10) : 0UL;
+    fprintf(report, "  latency histogram count %lu, actuator applied %u\n", hist_applied, act.applied);
+    // Timers still run: the actuator may apply a few more between its snapshot and the scrape
+    actuator_stats_t act_after;
+    actuator_get_stats(&act_after);
+
+    fprintf(report, "\nheap%s\n", mock_heap_tracking() ? "" : " (not tracked on this host)");
+    // The baseline is mostly the host's own (stdio, threads, the RAM flash); growth under load is the firmware's
+    fprintf(report, "  in use after start %zu bytes, peak +%zu under load, +%zd at end of load\n", heap_baseline,
+            mock_heap_peak() - heap_baseline, (ssize_t)(heap_end_of_load - heap_baseline));
+    fprintf(report, "  allocations during load %llu\n", (unsigned long long)(allocs_end_of_load - allocs_baseline));
+    fprintf(report, "  binlog records lost %u\n\n", (unsigned)binlog_lost());
+
+    int failures = 0;
+    if (accounted < submitted || accounted > submitted + unanswered) {
+        fprintf(report, "FAIL: %d commands lost between parser and actuator\n", (int)(submitted - accounted));
+        failures++;
+    }
+    if (hist_applied < act.applied || hist_applied > act_after.applied) {
+        fprintf(report, "FAIL: latency histogram counts %lu commands, actuator applied %u-%u\n", hist_applied,
+                act.applied, act_after.applied);
+        failures++;
+    }
+    if (spool.pending != 0) {
+        fprintf(report, "FAIL: %u spooled records never drained\n", spool.pending);
+        failures++;
+    }
+    if (hub.max_blackout_us > SOAK_MAX_BLACKOUT_MS * 1000u) {
+        fprintf(report, "FAIL: a token renewal blacked the session out for %u ms\n", hub.max_blackout_us / 1000);
+        failures++;
+    }
+    fprintf(report, "%s\n", failures ? "soak FAILED" : "soak passed");
+    fflush(report);
+
+    // Firmware tasks never return; leave without running their destructors
+    _exit(failures ? 1 : 0);
+}
@@ -0,0 +1,236 @@
+#include "actuator.h"
+#include "app_events.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+
+static const char *TAG = "ACTUATOR";
+
+static const char* const source_names[CMD_SOURCE_COUNT] = { "MQTT", "WEB", "LOCAL", "SCHEDULE", "RAMP" };
+
+static cmd_ring_slot_t normal_slots[ACTUATOR_QUEUE_DEPTH];
+static cmd_ring_slot_t priority_slots[ACTUATOR_PRIORITY_DEPTH];
+static cmd_ring_t normal_lane;
+static cmd_ring_t priority_lane;
+static TaskHandle_t actuator_task_handle = NULL;
+
+// Slots are filled before the count is published, so the task never sees a half-written entry
+static actuator_listener_fn listeners[ACTUATOR_MAX_LISTENERS];
+static std::atomic<int> listener_count{0};
+static actuator_listener_fn discard_listeners[ACTUATOR_MAX_DISCARD_LISTENERS];
+static std::atomic<int> discard_listener_count{0};
+
+// Written by the actuator task only, except dropped (any producer)
+static std::atomic<uint32_t> stat_applied{0};
+static std::atomic<uint32_t> stat_priority{0};
+static std::atomic<uint32_t> stat_dropped{0};
+static std::atomic<uint32_t> stat_superseded{0};
+static std::atomic<uint32_t> stat_last_latency_us{0};
+static std::atomic<uint32_t> stat_max_latency_us{0};
+static std::atomic<uint64_t> stat_total_latency_us{0};
+static std::atomic<uint32_t> stat_by_source[CMD_SOURCE_COUNT];
+static std::atomic<uint32_t> stat_latency_buckets[ACTUATOR_LATENCY_BUCKETS + 1];
+
+const uint32_t ACTUATOR_LATENCY_BOUNDS_US[ACTUATOR_LATENCY_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 10000, 50000, 250000,
+};
+
+static int latency_bucket(uint32_t latency_us) {
+    int i = 0;
+    while (i < ACTUATOR_LATENCY_BUCKETS && latency_us > ACTUATOR_LATENCY_BOUNDS_US[i]) {
+        i++;
+    }
+    return i;
+}
+
+static bool is_all_off(const led_batch_t* batch) {
+    if (batch->mask != LED_CHANNELS_ALL) {
+        return false;
+    }
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if (batch->level[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void apply_record(const cmd_record_t* record) {
+    if (record->fade_ms == 0) {
+        led_channels_apply(&record->batch);
+    } else {
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+            if (record->batch.mask & (1u << i)) {
+                led_channel_fade_to(i, record->batch.level[i], (unsigned)record->fade_ms);
+            }
+        }
+    }
+
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - record->enqueue_us);
+    stat_applied.fetch_add(1, std::memory_order_relaxed);
+    if (record->source < CMD_SOURCE_COUNT) {
+        stat_by_source[record->source].fetch_add(1, std::memory_order_relaxed);
+    }
+    stat_latency_buckets[latency_bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+    stat_last_latency_us.store(latency, std::memory_order_relaxed);
+    stat_total_latency_us.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > stat_max_latency_us.load(std::memory_order_relaxed)) {
+        stat_max_latency_us.store(latency, std::memory_order_relaxed);
+    }
+
+    int n = listener_count.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        listeners[i](record);
+    }
+
+    // End of the cold-start timeline: a network command reached the LEDs
+    static bool first_command_applied = false;
+    if (!first_command_applied && (record->source == CMD_SOURCE_MQTT || record->source == CMD_SOURCE_HTTP)) {
+        first_command_applied = true;
+        app_events_set(APP_EVENT_FIRST_COMMAND);
+    }
+
+    // Logged after the hardware write, into the deferred log - never the UART directly
+    const char* source = record->source < CMD_SOURCE_COUNT ? source_names[record->source] : "?";
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if (record->batch.mask & (1u << i)) {
+            if (record->fade_ms) {
+                BLOGI(TAG, "%s: Canal %s nivel %d en %u ms", source, LED_CHANNELS[i].name,
+                      record->batch.level[i], (unsigned)record->fade_ms);
+            } else {
+                BLOGI(TAG, "%s: Canal %s nivel %d (%u us)", source, LED_CHANNELS[i].name,
+                      record->batch.level[i], (unsigned)latency);
+            }
+        }
+    }
+}
+
+static void actuator_task(void* arg) {
+    cmd_record_t record;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;) {
+            if (cmd_ring_pop(&priority_lane, &record)) {
+                apply_record(&record);
+                stat_priority.fetch_add(1, std::memory_order_relaxed);
+
+                // Anything queued before the safety command must not switch channels back on
+                cmd_record_t stale;
+                while (cmd_ring_pop(&normal_lane, &stale)) {
+                    if (stale.enqueue_us > record.enqueue_us) {
+                        apply_record(&stale);
+                        break;
+                    }
+                    stat_superseded.fetch_add(1, std::memory_order_relaxed);
+                    int n = discard_listener_count.load(std::memory_order_acquire);
+                    for (int i = 0; i < n; i++) {
+                        discard_listeners[i](&stale);
+                    }
+                }
+                continue;
+            }
+            if (cmd_ring_pop(&normal_lane, &record)) {
+                apply_record(&record);
+                continue;
+            }
+            break;
+        }
+    }
+}
+
+esp_err_t actuator_start(void) {
+    cmd_ring_init(&normal_lane, normal_slots, ACTUATOR_QUEUE_DEPTH);
+    cmd_ring_init(&priority_lane, priority_slots, ACTUATOR_PRIORITY_DEPTH);
+
+    BaseType_t ok = task_topology_create(TASK_ROLE_ACTUATOR, actuator_task, NULL, &actuator_task_handle);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create actuator task");
+        return ESP_ERR_NO_MEM;
+    }
+    printf("[ACT] Actuator task started\n");
+    ESP_LOGI(TAG, "Actuator task started");
+    return ESP_OK;
+}
+
+static esp_err_t submit_record(const led_batch_t* batch, uint32_t fade_ms, cmd_source_t source, uint32_t tag) {
+    if (actuator_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    cmd_record_t record;
+    record.batch = *batch;
+    record.enqueue_us = esp_timer_get_time();
+    record.fade_ms = fade_ms;
+    record.tag = tag;
+    record.source = (uint8_t)source;
+
+    cmd_ring_t* lane = (fade_ms == 0 && is_all_off(batch)) ? &priority_lane : &normal_lane;
+    if (!cmd_ring_push(lane, &record)) {
+        stat_dropped.fetch_add(1, std::memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(actuator_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t actuator_submit(const led_batch_t* batch, cmd_source_t source) {
+    return submit_record(batch, 0, source, 0);
+}
+
+esp_err_t actuator_submit_tagged(const led_batch_t* batch, cmd_source_t source, uint32_t tag) {
+    return submit_record(batch, 0, source, tag);
+}
+
+esp_err_t actuator_submit_fade(const led_batch_t* batch, uint32_t fade_ms, cmd_source_t source) {
+    return submit_record(batch, fade_ms, source, 0);
+}
+
+esp_err_t actuator_all_off(cmd_source_t source) {
+    led_batch_t batch = {};
+    batch.mask = LED_CHANNELS_ALL;
+    return actuator_submit(&batch, source);
+}
+
+void actuator_get_stats(actuator_stats_t* stats) {
+    stats->applied = stat_applied.load(std::memory_order_relaxed);
+    stats->priority = stat_priority.load(std::memory_order_relaxed);
+    stats->dropped = stat_dropped.load(std::memory_order_relaxed);
+    stats->superseded = stat_superseded.load(std::memory_order_relaxed);
+    stats->last_latency_us = stat_last_latency_us.load(std::memory_order_relaxed);
+    stats->max_latency_us = stat_max_latency_us.load(std::memory_order_relaxed);
+    stats->total_latency_us = stat_total_latency_us.load(std::memory_order_relaxed);
+    for (int i = 0; i < CMD_SOURCE_COUNT; i++) {
+        stats->applied_by_source[i] = stat_by_source[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i <= ACTUATOR_LATENCY_BUCKETS; i++) {
+        stats->latency_buckets[i] = stat_latency_buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+esp_err_t actuator_add_listener(actuator_listener_fn listener) {
+    int n = listener_count.load(std::memory_order_relaxed);
+    if (n >= ACTUATOR_MAX_LISTENERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    listeners[n] = listener;
+    listener_count.store(n + 1, std::memory_order_release);
+    return ESP_OK;
+}
+
+esp_err_t actuator_add_discard_listener(actuator_listener_fn listener) {
+    int n = discard_listener_count.load(std::memory_order_relaxed);
+    if (n >= ACTUATOR_MAX_DISCARD_LISTENERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    discard_listeners[n] = listener;
+    discard_listener_count.store(n + 1, std::memory_order_release);
+    return ESP_OK;
+}
@@ -0,0 +1,92 @@
+#include "app_events.h"
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *TAG = "APP_EVENTS";
+
+static const char* const phase_names[APP_EVENT_COUNT] = {
+    "leds_ready", "web_ready", "wifi_started", "wifi_connected", "mqtt_connected", "first_command",
+    "time_synced",
+};
+
+static EventGroupHandle_t app_event_group = NULL;
+
+// First-set times, written once per bit. seen gates the (rare) slow path so
+// that setting a connectivity bit again on reconnect costs one atomic load.
+static int64_t first_set_us[APP_EVENT_COUNT];
+static std::atomic<uint32_t> seen{0};
+
+void app_events_init(void) {
+    app_event_group = xEventGroupCreate();
+    if (app_event_group == NULL) {
+        ESP_LOGE(TAG, "Failed to create event group");
+        abort();
+    }
+    for (int i = 0; i < APP_EVENT_COUNT; i++) {
+        first_set_us[i] = -1;
+    }
+    printf("[BOOT] %-15s %6lu ms\n", "app_main", (unsigned long)(esp_timer_get_time() / 1000));
+}
+
+static void record_first_set(EventBits_t bits) {
+    uint32_t fresh = bits & ~seen.fetch_or(bits, std::memory_order_acq_rel);
+    if (fresh == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < APP_EVENT_COUNT; i++) {
+        if (fresh & (1u << i)) {
+            first_set_us[i] = now;
+            // Deferred log: bits are set from the network and actuator tasks
+            BLOGI(TAG, "Boot phase %s at %u ms", phase_names[i], (unsigned)(now / 1000));
+        }
+    }
+}
+
+void app_events_set(EventBits_t bits) {
+    if ((bits & ~seen.load(std::memory_order_acquire)) != 0) {
+        record_first_set(bits);
+    }
+    xEventGroupSetBits(app_event_group, bits);
+}
+
+void app_events_clear(EventBits_t bits) {
+    xEventGroupClearBits(app_event_group, bits);
+}
+
+EventBits_t app_events_get(void) {
+    return app_event_group ? xEventGroupGetBits(app_event_group) : 0;
+}
+
+EventBits_t app_events_wait(EventBits_t bits, TickType_t timeout) {
+    return xEventGroupWaitBits(app_event_group, bits, pdFALSE, pdTRUE, timeout);
+}
+
+int64_t app_events_first_set_us(EventBits_t bit) {
+    for (int i = 0; i < APP_EVENT_COUNT; i++) {
+        if (bit == (1u << i)) {
+            return (seen.load(std::memory_order_acquire) & bit) ? first_set_us[i] : -1;
+        }
+    }
+    return -1;
+}
+
+void app_events_print_boot_profile(void) {
+    uint32_t reached = seen.load(std::memory_order_acquire);
+    int64_t previous = 0;
+    printf("[BOOT] Startup profile (ms since boot, +ms since previous phase):\n");
+    for (int i = 0; i < APP_EVENT_COUNT; i++) {
+        if (!(reached & (1u << i))) {
+            printf("[BOOT]   %-15s      -\n", phase_names[i]);
+            continue;
+        }
+        int64_t t = first_set_us[i];
+        printf("[BOOT]   %-15s %6lu   +%lu\n", phase_names[i], (unsigned long)(t / 1000),
+               (unsigned long)(t > previous ? (t - previous) / 1000 : 0));
+        previous = t > previous ? t : previous;
+    }
+}
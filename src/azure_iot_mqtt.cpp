@@ -1,15 +1,159 @@
 #include "azure_iot_mqtt.h"
 #include "azure_config.h"
-#include "led_channels.h"
+#include "app_events.h"
+#include "actuator.h"
+#include "c2d_properties.h"
+#include "command_parser.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "latency_trace.h"
+#include "mqtt_reassembly.h"
+#include "ramp.h"
+#include "sas_token.h"
+#include "schedule.h"
+#include "binlog.h"
+#include "telemetry_spool.h"
+#include "task_topology.h"
+#include "time_sync.h"
+#include "tls_transport.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_crt_bundle.h"
 #include "mqtt_client.h"
 #include "esp_event.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <atomic>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 static const char *TAG = "AZURE_IOT_MQTT";
 static esp_mqtt_client_handle_t mqtt_client = NULL;
-static bool mqtt_connected = false;
+
+// Kept for esp_mqtt_set_config(), which re-applies every field
+static esp_mqtt_client_config_t mqtt_cfg;
+static char mqtt_uri[256];
+static char client_id[128];
+static char username[256];
+
+// Signed credentials; device_key_len is 0 when the static SAS_TOKEN is used
+static uint8_t device_key[SAS_KEY_MAX];
+static size_t device_key_len = 0;
+static char sas_resource[160];
+static char sas_password[SAS_TOKEN_MAX];
+static uint32_t token_issued = 0;      // wall clock; under token_lock
+static SemaphoreHandle_t token_lock = NULL;
+static TaskHandle_t renewal_handle = NULL;
+static std::atomic<int64_t> last_rx_us{0};
+static std::atomic<int64_t> renewal_started_us{0};
+static std::atomic<int64_t> connect_started_us{0};
+
+static std::atomic<uint32_t> stat_connects{0};
+static std::atomic<uint32_t> stat_disconnects{0};
+static std::atomic<uint32_t> stat_published{0};
+static std::atomic<uint32_t> stat_renewals{0};
+static std::atomic<uint32_t> stat_forced_renewals{0};
+static std::atomic<uint32_t> stat_token_expiry{0};
+static std::atomic<uint32_t> stat_last_blackout_us{0};
+static std::atomic<uint32_t> stat_max_blackout_us{0};
+static std::atomic<uint32_t> stat_last_connect_ms{0};
+static std::atomic<uint32_t> stat_max_connect_ms{0};
+
+// C2D messages are assembled here, outside the MQTT task stack
+static mqtt_reassembly_t c2d_rx;
+static int64_t c2d_event_us = 0;   // first fragment's MQTT_EVENT_DATA, MQTT task only
+static int64_t c2d_tls_rx_us = 0;
+
+// Parse a complete cloud-to-device command and queue it as one batch
+// Format: "CHANNEL:STATE[,CHANNEL:STATE...]" (e.g., "RGB:ON", "RGB:ON,WHITE:OFF,VERDE:128"),
+// "ALL:OFF", "MASK:0B" or a JSON object ({"RGB":"ON","VERDE":128})
+// Or simple "ON"/"OFF" for backward compatibility (controls RGB channel)
+static void process_c2d_command(const char* topic, size_t topic_len, const char* message, size_t len) {
+    led_batch_t batch;
+    cmd_token_t bad_token;
+    cmd_parse_result_t result = command_parse(message, len, &batch, &bad_token);
+    if (result != CMD_PARSE_OK) {
+        BLOGW(TAG, "%s at byte %d of %d (expected CHANNEL:STATE[,CHANNEL:STATE])",
+              command_parse_result_str(result), (int)(bad_token.ptr - message), (int)len);
+        return;
+    }
+
+    // Actuation and its logging happen on the actuator task; the trace follows it there
+    uint32_t trace_tag = latency_trace_begin(topic, topic_len, c2d_tls_rx_us, c2d_event_us);
+    if (actuator_submit_tagged(&batch, CMD_SOURCE_MQTT, trace_tag) != ESP_OK) {
+        latency_trace_cancel(trace_tag);
+        BLOGE(TAG, "Actuator queue full, command dropped");
+    }
+}
+
+// Sign a token valid from now and hand it to the client for the next CONNECT
+static esp_err_t refresh_token(void) {
+    time_t now = time(NULL);
+    if (now < CLOCK_VALID_AFTER) {
+        ESP_LOGW(TAG, "Wall clock not set, cannot sign a SAS token yet");
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t expiry = (uint32_t)now + SAS_TOKEN_TTL_S;
+    xSemaphoreTake(token_lock, portMAX_DELAY);
+    esp_err_t err = sas_token_build(sas_resource, device_key, device_key_len, expiry, sas_password,
+                                    sizeof(sas_password));
+    if (err == ESP_OK) {
+        mqtt_cfg.credentials.authentication.password = sas_password;
+        err = esp_mqtt_set_config(mqtt_client, &mqtt_cfg);
+    }
+    if (err == ESP_OK) {
+        token_issued = (uint32_t)now;
+        stat_token_expiry.store(expiry, std::memory_order_relaxed);
+    }
+    xSemaphoreGive(token_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SAS token not renewed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static uint32_t token_age_point(int percent) {
+    xSemaphoreTake(token_lock, portMAX_DELAY);
+    uint32_t point = token_issued + (uint32_t)SAS_TOKEN_TTL_S * percent / 100;
+    xSemaphoreGive(token_lock);
+    return point;
+}
+
+// Sleeps until the token in use is due, waits for a lull in incoming
+// messages, then reconnects with a token signed beforehand. Connects wake it.
+static void renewal_task(void* arg) {
+    for (;;) {
+        if (!azure_iot_is_connected()) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        uint32_t now = (uint32_t)time(NULL);
+        uint32_t renew_at = token_age_point(SAS_RENEW_PERCENT);
+        if (now < renew_at) {
+            // Re-checked at least every minute, in case SNTP moved the clock
+            uint32_t wait_s = renew_at - now < 60 ? renew_at - now : 60;
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_s * 1000));
+            continue;
+        }
+        bool quiet = esp_timer_get_time() - last_rx_us.load(std::memory_order_relaxed) >= SAS_QUIET_MS * 1000LL;
+        if (!quiet && now < token_age_point(SAS_RENEW_DEADLINE_PERCENT)) {
+            vTaskDelay(pdMS_TO_TICKS(SAS_QUIET_MS / 4));
+            continue;
+        }
+        if (refresh_token() != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(SAS_QUIET_MS));
+            continue;
+        }
+        if (!quiet) {
+            stat_forced_renewals.fetch_add(1, std::memory_order_relaxed);
+        }
+        BLOGI(TAG, "SAS token renewed, reconnecting");
+        renewal_started_us.store(esp_timer_get_time(), std::memory_order_relaxed);
+        // Only asks the MQTT task to disconnect; the reconnect follows from MQTT_EVENT_DISCONNECTED
+        esp_mqtt_client_disconnect(mqtt_client);
+    }
+}
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                 int32_t event_id, void *event_data) {
@@ -20,7 +164,31 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             {
                 printf("[MQTT] *** CONNECTED to Azure IoT Hub ***\n");
                 ESP_LOGI(TAG, "MQTT Connected to Azure IoT Hub");
-                mqtt_connected = true;
+                app_events_set(APP_EVENT_MQTT_CONNECTED);
+                stat_connects.fetch_add(1, std::memory_order_relaxed);
+                int64_t connect_us = connect_started_us.exchange(0, std::memory_order_relaxed);
+                if (connect_us != 0) {
+                    uint32_t connect_ms = (uint32_t)((esp_timer_get_time() - connect_us) / 1000);
+                    stat_last_connect_ms.store(connect_ms, std::memory_order_relaxed);
+                    if (connect_ms > stat_max_connect_ms.load(std::memory_order_relaxed)) {
+                        stat_max_connect_ms.store(connect_ms, std::memory_order_relaxed);
+                    }
+                    printf("[MQTT] Connect took %u ms\n", (unsigned)connect_ms);
+                }
+                int64_t renewal_us = renewal_started_us.exchange(0, std::memory_order_relaxed);
+                if (renewal_us != 0) {
+                    uint32_t blackout = (uint32_t)(esp_timer_get_time() - renewal_us);
+                    stat_renewals.fetch_add(1, std::memory_order_relaxed);
+                    stat_last_blackout_us.store(blackout, std::memory_order_relaxed);
+                    if (blackout > stat_max_blackout_us.load(std::memory_order_relaxed)) {
+                        stat_max_blackout_us.store(blackout, std::memory_order_relaxed);
+                    }
+                    BLOGI(TAG, "Reconnected with the new token after %u us", (unsigned)blackout);
+                }
+                if (renewal_handle != NULL) {
+                    xTaskNotifyGive(renewal_handle);
+                }
+                telemetry_spool_on_connected();
                 
                 // Subscribe to cloud-to-device messages
                 // Topic format: devices/{deviceId}/messages/devicebound/#
@@ -34,115 +202,94 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                     printf("[MQTT] ERROR: Failed to subscribe to cloud-to-device messages\n");
                     ESP_LOGE(TAG, "Failed to subscribe");
                 }
+
+                // Device twin: desired property patches and responses to our requests
+                if (esp_mqtt_client_subscribe(mqtt_client, TWIN_TOPIC_PREFIX "PATCH/properties/desired/#", 1) < 0 ||
+                    esp_mqtt_client_subscribe(mqtt_client, TWIN_TOPIC_PREFIX "res/#", 1) < 0) {
+                    ESP_LOGE(TAG, "Failed to subscribe to device twin topics");
+                }
+                // Direct methods: answered from the actuator, see direct_methods.h
+                if (esp_mqtt_client_subscribe(mqtt_client, METHOD_TOPIC_PREFIX "POST/#", 0) < 0) {
+                    ESP_LOGE(TAG, "Failed to subscribe to direct methods");
+                }
+                device_twin_on_connected();
             }
             break;
             
         case MQTT_EVENT_DISCONNECTED:
             printf("[MQTT] Disconnected from Azure IoT Hub\n");
             ESP_LOGI(TAG, "MQTT Disconnected");
-            mqtt_connected = false;
+            app_events_clear(APP_EVENT_MQTT_CONNECTED);
+            stat_disconnects.fetch_add(1, std::memory_order_relaxed);
+            telemetry_spool_on_disconnected();
+            device_twin_on_disconnected();
+            // A renewal: reconnect now rather than after network.reconnect_timeout_ms.
+            // esp-mqtt only accepts this in WAIT_RECONNECT, the state it dispatches this event in.
+            if (renewal_started_us.load(std::memory_order_relaxed) != 0 &&
+                esp_mqtt_client_reconnect(mqtt_client) != ESP_OK) {
+                BLOGW(TAG, "Immediate reconnect refused, waiting for the reconnect timeout");
+            }
             break;
 
         case MQTT_EVENT_PUBLISHED:
-            printf("[MQTT] Message published successfully, msg_id=%d\n", event->msg_id);
-            ESP_LOGI(TAG, "MQTT Published, msg_id=%d", event->msg_id);
+            BLOGI(TAG, "Published, msg_id=%d", event->msg_id);
+            stat_published.fetch_add(1, std::memory_order_relaxed);
+            telemetry_spool_on_published(event->msg_id);
             break;
 
         case MQTT_EVENT_DATA:
             {
-                printf("\n========================================\n");
-                printf("RECIBIDO MENSAJE\n");
-                printf("========================================\n");
-                printf("[MQTT] Topic: %.*s\n", event->topic_len, event->topic);
-                printf("[MQTT] Data length: %d bytes\n", event->data_len);
-                
-                // Process the message content
-                if (event->data_len > 0) {
-                    // Create a null-terminated string from the message
-                    char message[256];
-                    int len = (event->data_len < sizeof(message) - 1) ? event->data_len : sizeof(message) - 1;
-                    memcpy(message, event->data, len);
-                    message[len] = '\0';
-                    
-                    printf("[MQTT] Message content: %s\n", message);
-                    
-                    // Remove trailing whitespace/newlines
-                    while (len > 0 && (message[len-1] == '\n' || message[len-1] == '\r' || message[len-1] == ' ')) {
-                        message[len-1] = '\0';
-                        len--;
-                    }
-                    
-                    // Control LED channels based on message
-                    // Format: "CHANNEL:STATE" (e.g., "RGB:ON", "WHITE:OFF", "VERDE:ON", "FAR_RED:OFF")
-                    // Or simple "ON"/"OFF" for backward compatibility (controls RGB channel)
-                    char* colon = strchr(message, ':');
-                    if (colon != NULL) {
-                        // Format: CHANNEL:STATE
-                        *colon = '\0';
-                        char* channel = message;
-                        char* state = colon + 1;
-                        
-                        gpio_num_t pin;
-                        const char* channel_name = NULL;
-                        
-                        // Map channel name to GPIO pin
-                        if (strcmp(channel, "RGB") == 0) {
-                            pin = CHANNEL_RGB_PIN;
-                            channel_name = "RGB";
-                        } else if (strcmp(channel, "WHITE") == 0) {
-                            pin = CHANNEL_WHITE_PIN;
-                            channel_name = "WHITE";
-                        } else if (strcmp(channel, "VERDE") == 0) {
-                            pin = CHANNEL_VERDE_PIN;
-                            channel_name = "VERDE";
-                        } else if (strcmp(channel, "FAR_RED") == 0) {
-                            pin = CHANNEL_FAR_RED_PIN;
-                            channel_name = "FAR_RED";
-                        } else {
-                            printf("[MQTT] Canal desconocido: %s (Use: RGB, WHITE, VERDE, FAR_RED)\n", channel);
-                            break;
-                        }
-                        
-                        // Set channel state
-                        if (strcmp(state, "ON") == 0) {
-                            led_channel_set(pin, 1);
-                            printf("[MQTT] Canal %s (Pin %d) encendido\n", channel_name, pin);
-                            ESP_LOGI(TAG, "Channel %s turned ON", channel_name);
-                        } else if (strcmp(state, "OFF") == 0) {
-                            led_channel_set(pin, 0);
-                            printf("[MQTT] Canal %s (Pin %d) apagado\n", channel_name, pin);
-                            ESP_LOGI(TAG, "Channel %s turned OFF", channel_name);
-                        } else {
-                            printf("[MQTT] Estado desconocido: %s (Use: ON u OFF)\n", state);
-                        }
-                    } else {
-                        // Backward compatibility: simple ON/OFF controls RGB channel
-                        if (strcmp(message, "ON") == 0) {
-                            printf("[MQTT] Comando ON recibido - Encendiendo canal RGB\n");
-                            led_channel_set(CHANNEL_RGB_PIN, 1);
-                            ESP_LOGI(TAG, "RGB channel turned ON (backward compatibility)");
-                        } else if (strcmp(message, "OFF") == 0) {
-                            printf("[MQTT] Comando OFF recibido - Apagando canal RGB\n");
-                            led_channel_set(CHANNEL_RGB_PIN, 0);
-                            ESP_LOGI(TAG, "RGB channel turned OFF (backward compatibility)");
-                        } else {
-                            printf("[MQTT] Mensaje desconocido: %s\n", message);
-                            printf("[MQTT] Formato esperado: CHANNEL:STATE (ej: RGB:ON, WHITE:OFF)\n");
-                            printf("[MQTT] O simplemente ON/OFF para controlar RGB\n");
-                        }
-                    }
+                int64_t rx_us = esp_timer_get_time();
+                last_rx_us.store(rx_us, std::memory_order_relaxed);
+                if (event->current_data_offset == 0) {
+                    c2d_event_us = rx_us;
+                    c2d_tls_rx_us = tls_transport_last_rx_us();
                 }
-                
-                // If message is chunked, print chunk info
-                if (event->total_data_len != event->data_len) {
-                    printf("[MQTT] Chunked message: %d/%d bytes\n", 
-                           event->data_len, event->total_data_len);
+                mqtt_reassembly_status_t status = mqtt_reassembly_feed(&c2d_rx, event->msg_id,
+                                                                       event->topic, event->topic_len,
+                                                                       event->data, event->data_len,
+                                                                       event->current_data_offset,
+                                                                       event->total_data_len);
+                if (status == MQTT_REASSEMBLY_PENDING) {
+                    break;
+                }
+                if (status == MQTT_REASSEMBLY_TOO_LARGE) {
+                    BLOGE(TAG, "C2D message of %d bytes discarded (max %d)",
+                          event->total_data_len, MQTT_REASSEMBLY_MAX_MESSAGE);
+                    break;
+                }
+                if (status == MQTT_REASSEMBLY_OUT_OF_ORDER) {
+                    BLOGE(TAG, "C2D fragment out of order (msg_id=%d, offset=%d), message discarded",
+                          event->msg_id, event->current_data_offset);
+                    break;
+                }
+                if (c2d_rx.topic_truncated) {
+                    // A cut-off property list could route the payload to the wrong parser
+                    BLOGE(TAG, "Topic of msg_id=%d longer than %d bytes, message discarded", event->msg_id,
+                          MQTT_REASSEMBLY_MAX_TOPIC);
+                    break;
+                }
+
+                if (c2d_rx.topic_len > sizeof(TWIN_TOPIC_PREFIX) - 1 &&
+                    memcmp(c2d_rx.topic, TWIN_TOPIC_PREFIX, sizeof(TWIN_TOPIC_PREFIX) - 1) == 0) {
+                    device_twin_on_message(c2d_rx.topic, c2d_rx.topic_len, c2d_rx.data, c2d_rx.data_len);
+                    break;
+                }
+                if (c2d_rx.topic_len > sizeof(METHOD_TOPIC_PREFIX) - 1 &&
+                    memcmp(c2d_rx.topic, METHOD_TOPIC_PREFIX, sizeof(METHOD_TOPIC_PREFIX) - 1) == 0) {
+                    direct_methods_on_request(c2d_rx.topic, c2d_rx.topic_len, c2d_rx.data, c2d_rx.data_len);
+                    break;
+                }
+                BLOGI(TAG, "C2D message received, %d bytes, msg_id=%d", (int)c2d_rx.data_len, event->msg_id);
+                if (c2d_property_equals(c2d_rx.topic, c2d_rx.topic_len, "type", "schedule")) {
+                    // Photoperiod tables run on the device; see schedule.h for the format
+                    schedule_set(c2d_rx.data, c2d_rx.data_len);
+                } else if (c2d_property_equals(c2d_rx.topic, c2d_rx.topic_len, "type", "ramp")) {
+                    // Sunrise/sunset keyframes, interpolated on the device; see ramp.h
+                    ramp_set(c2d_rx.data, c2d_rx.data_len);
+                } else {
+                    process_c2d_command(c2d_rx.topic, c2d_rx.topic_len, c2d_rx.data, c2d_rx.data_len);
                 }
-                
-                printf("========================================\n\n");
-                
-                ESP_LOGI(TAG, "Received message on topic: %.*s", event->topic_len, event->topic);
-                ESP_LOGI(TAG, "Data: %.*s", event->data_len, event->data);
             }
             break;
 
@@ -175,6 +322,11 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         case MQTT_EVENT_BEFORE_CONNECT:
             printf("[MQTT] Before connect event\n");
             ESP_LOGI(TAG, "Before connect");
+            connect_started_us.store(esp_timer_get_time(), std::memory_order_relaxed);
+            // After an outage the token may be due; a fresh one goes into this CONNECT
+            if (device_key_len > 0 && (uint32_t)time(NULL) >= token_age_point(SAS_RENEW_PERCENT)) {
+                refresh_token();
+            }
             break;
 
         case MQTT_EVENT_DELETED:
@@ -200,17 +352,74 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     }
 }
 
+// Message property values travel URL-encoded in the topic; '/' is the only
+// reserved character that shows up in a MIME type
+static int url_encode_property(const char* value, char* out, size_t size) {
+    size_t n = 0;
+    for (; *value && n + 3 < size; value++) {
+        if (*value == '/') {
+            memcpy(out + n, "%2F", 3);
+            n += 3;
+        } else {
+            out[n++] = *value;
+        }
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+// Topic: devices/{device_id}/messages/events/[$.ct=<content type>&$.ce=utf-8]
+static void build_telemetry_topic(char* topic, size_t size, const char* content_type) {
+    int n = snprintf(topic, size, "devices/%s/messages/events/", DEVICE_ID);
+    if (content_type != NULL) {
+        n += snprintf(topic + n, size - n, "$.ct=");
+        n += url_encode_property(content_type, topic + n, size - n);
+        if (strcmp(content_type, "application/json") == 0) {
+            snprintf(topic + n, size - n, "&$.ce=utf-8");
+        }
+    }
+}
+
+// Publish hook for spool replay. Enqueued rather than published, so the MQTT
+// task does the network write and the replay task never holds the client
+// while the socket is busy.
+static int spool_publish(const void* data, size_t len, const char* content_type) {
+    if (!azure_iot_is_connected() || mqtt_client == NULL) {
+        return -1;
+    }
+    if (esp_mqtt_client_get_outbox_size(mqtt_client) > TELEMETRY_SPOOL_OUTBOX_BUDGET) {
+        return TELEMETRY_SPOOL_BUSY;
+    }
+    char topic[256];
+    build_telemetry_topic(topic, sizeof(topic), content_type);
+    return esp_mqtt_client_enqueue(mqtt_client, topic, (const char*)data, (int)len, 1, 0, true);
+}
+
+// Publish hook for device twin requests, reported patches and method responses,
+// enqueued for the same reason
+static int twin_publish(const char* topic, const char* data, size_t len) {
+    if (!azure_iot_is_connected() || mqtt_client == NULL) {
+        return -1;
+    }
+    return esp_mqtt_client_enqueue(mqtt_client, topic, data, (int)len, 1, 0, true);
+}
+
+// Method responses are only useful while the caller waits: QoS 0, never stored
+static int method_publish(const char* topic, const char* data, size_t len) {
+    if (!azure_iot_is_connected() || mqtt_client == NULL) {
+        return -1;
+    }
+    return esp_mqtt_client_enqueue(mqtt_client, topic, data, (int)len, 0, 0, true);
+}
+
 esp_err_t azure_iot_mqtt_init(void) {
     // Build MQTT URI: mqtts://{hostname}:8883
-    char mqtt_uri[256];
     snprintf(mqtt_uri, sizeof(mqtt_uri), "mqtts://%s:8883", IOT_HUB_HOSTNAME);
     
     // Build client ID: {device_id}
-    char client_id[128];
     snprintf(client_id, sizeof(client_id), "%s", DEVICE_ID);
     
     // Build username: {hostname}/{device_id}/?api-version=2021-04-12
-    char username[256];
     snprintf(username, sizeof(username), "%s/%s/?api-version=2021-04-12", 
              IOT_HUB_HOSTNAME, DEVICE_ID);
     
@@ -223,24 +432,53 @@ esp_err_t azure_iot_mqtt_init(void) {
     ESP_LOGI(TAG, "  Client ID: %s", client_id);
     ESP_LOGI(TAG, "  Username: %s", username);
 
+    // A device key in NVS signs tokens on the device; DEVICE_KEY provisions it on first boot
+    token_lock = xSemaphoreCreateMutex();
+    esp_err_t key_err = sas_token_load_key(device_key, &device_key_len);
+#ifdef DEVICE_KEY
+    if (key_err == ESP_ERR_NVS_NOT_FOUND && sas_token_provision_key(DEVICE_KEY) == ESP_OK) {
+        key_err = sas_token_load_key(device_key, &device_key_len);
+    }
+#endif
+    if (key_err != ESP_OK || token_lock == NULL) {
+        device_key_len = 0;
+    }
+
     printf("[MQTT] Configuring MQTT client...\n");
-    esp_mqtt_client_config_t mqtt_cfg = {};
+    mqtt_cfg = {};
     mqtt_cfg.broker.address.uri = mqtt_uri;
     mqtt_cfg.credentials.client_id = client_id;
     mqtt_cfg.credentials.username = username;
-    mqtt_cfg.credentials.authentication.password = SAS_TOKEN;
+    if (device_key_len > 0) {
+        // Signed in azure_iot_mqtt_start(), once the clock is set
+        snprintf(sas_resource, sizeof(sas_resource), "%s/devices/%s", IOT_HUB_HOSTNAME, DEVICE_ID);
+        printf("[MQTT]   Auth: SAS tokens signed on the device (%d-byte key, valid %d s)\n",
+               (int)device_key_len, SAS_TOKEN_TTL_S);
+    } else {
+#ifdef SAS_TOKEN
+        printf("[MQTT]   Auth: static SAS_TOKEN from azure_config.h\n");
+        mqtt_cfg.credentials.authentication.password = SAS_TOKEN;
+#else
+        printf("[MQTT] ERROR: No device key in NVS and no SAS_TOKEN configured\n");
+        ESP_LOGE(TAG, "No credentials: provision a device key or define SAS_TOKEN");
+#endif
+    }
     mqtt_cfg.session.keepalive = 60;
+    // Priority and stack from the topology table; the core comes from sdkconfig
+    mqtt_cfg.task.priority = task_topology_spec(TASK_ROLE_MQTT)->priority;
+    mqtt_cfg.task.stack_size = task_topology_spec(TASK_ROLE_MQTT)->stack;
     
-    // Configure SSL/TLS - skip certificate verification (for development)
-    // With CONFIG_ESP_TLS_INSECURE=y and CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY=y
-    // we need to explicitly configure the verification settings
-    mqtt_cfg.broker.verification.skip_cert_common_name_check = true;
-    // Don't use global CA store when in insecure mode
-    mqtt_cfg.broker.verification.use_global_ca_store = false;
-    mqtt_cfg.broker.verification.certificate = NULL;
-    
-    printf("[MQTT] SSL/TLS configured (insecure mode - certificate verification disabled)\n");
-    printf("[MQTT] Using CONFIG_ESP_TLS_INSECURE and CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY\n");
+    // TLS: the hub is verified against the certificate bundle, and the
+    // transport keeps the session so reconnects skip the full handshake
+    mqtt_cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    mqtt_cfg.network.transport = tls_transport_create();
+    if (mqtt_cfg.network.transport == NULL) {
+        printf("[MQTT] WARNING: No session-caching transport, using the default TLS transport\n");
+        ESP_LOGW(TAG, "TLS transport not created, falling back to mqtts");
+    }
+    printf("[MQTT] SSL/TLS configured (server verified against the certificate bundle)\n");
+    mqtt_reassembly_reset(&c2d_rx);
+
     printf("[MQTT] Initializing MQTT client...\n");
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (mqtt_client == NULL) {
@@ -257,8 +495,44 @@ esp_err_t azure_iot_mqtt_init(void) {
     esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_PUBLISHED, mqtt_event_handler, NULL);
     esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_DATA, mqtt_event_handler, NULL);
     esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_ERROR, mqtt_event_handler, NULL);
+    esp_mqtt_client_register_event(mqtt_client, MQTT_EVENT_BEFORE_CONNECT, mqtt_event_handler, NULL);
     printf("[MQTT] Event handlers registered (including cloud-to-device message handler)\n");
     
+    // Replay of spooled telemetry follows the connection state from here on
+    if (telemetry_spool_start(spool_publish) != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry spool not available, offline telemetry is dropped");
+    }
+    if (device_twin_start(twin_publish) != ESP_OK) {
+        ESP_LOGW(TAG, "Device twin not available");
+    }
+    if (direct_methods_start(method_publish) != ESP_OK) {
+        ESP_LOGW(TAG, "Direct methods not available");
+    }
+    if (latency_trace_start() != ESP_OK) {
+        ESP_LOGW(TAG, "C2D latency tracing not available");
+    }
+    if (device_key_len > 0 &&
+        task_topology_create(TASK_ROLE_SAS_RENEW, renewal_task, NULL, &renewal_handle) != pdPASS) {
+        ESP_LOGW(TAG, "SAS renewal task not created, the hub will drop the session at expiry");
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t azure_iot_mqtt_start(void) {
+    if (mqtt_client == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Signing needs the wall clock: the token carries its expiry
+    if (device_key_len > 0) {
+        if (time(NULL) < CLOCK_VALID_AFTER) {
+            printf("[MQTT] Waiting for SNTP before signing the SAS token...\n");
+            app_events_wait(APP_EVENT_TIME_SYNCED, pdMS_TO_TICKS(SAS_CLOCK_WAIT_MS));
+        }
+        // If it fails, every connect attempt tries again (MQTT_EVENT_BEFORE_CONNECT)
+        refresh_token();
+    }
+
     printf("[MQTT] Starting MQTT client...\n");
     esp_err_t err = esp_mqtt_client_start(mqtt_client);
     
@@ -273,32 +547,49 @@ esp_err_t azure_iot_mqtt_init(void) {
 }
 
 esp_err_t azure_iot_send_telemetry(const char* data) {
-    if (!mqtt_connected || mqtt_client == NULL) {
-        printf("[MQTT] WARNING: MQTT not connected, cannot send telemetry\n");
-        ESP_LOGW(TAG, "MQTT not connected, cannot send telemetry");
-        return ESP_ERR_INVALID_STATE;
+    return azure_iot_send_telemetry_bytes(data, strlen(data), NULL);
+}
+
+esp_err_t azure_iot_send_telemetry_bytes(const void* data, size_t len, const char* content_type) {
+    int msg_id = -1;
+    if (azure_iot_is_connected() && mqtt_client != NULL) {
+        char topic[256];
+        build_telemetry_topic(topic, sizeof(topic), content_type);
+        msg_id = esp_mqtt_client_publish(mqtt_client, topic, (const char*)data, (int)len, 1, 0);
     }
     
-    // Build topic: devices/{device_id}/messages/events/
-    char topic[256];
-    snprintf(topic, sizeof(topic), "devices/%s/messages/events/", DEVICE_ID);
-    
-    printf("[MQTT] Publishing to topic: %s\n", topic);
-    printf("[MQTT] Data: %s\n", data);
-    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, 0, 1, 0);
-    
     if (msg_id < 0) {
-        printf("[MQTT] ERROR: Failed to publish message (msg_id=%d)\n", msg_id);
-        ESP_LOGE(TAG, "Failed to publish message");
+        // Offline or rejected: keep it in flash until the connection is back
+        if (telemetry_spool_append(data, len, content_type) == ESP_OK) {
+            BLOGI(TAG, "Telemetry spooled, %d bytes", (int)len);
+            return ESP_OK;
+        }
+        if (!azure_iot_is_connected()) {
+            BLOGW(TAG, "MQTT not connected, cannot send telemetry");
+            return ESP_ERR_INVALID_STATE;
+        }
+        BLOGE(TAG, "Failed to publish telemetry");
         return ESP_FAIL;
     }
     
-    printf("[MQTT] Telemetry sent successfully (msg_id=%d)\n", msg_id);
-    ESP_LOGI(TAG, "Telemetry sent: %s", data);
+    BLOGI(TAG, "Telemetry queued, %d bytes, msg_id=%d", (int)len, msg_id);
     return ESP_OK;
 }
 
 bool azure_iot_is_connected(void) {
-    return mqtt_connected;
+    return (app_events_get() & APP_EVENT_MQTT_CONNECTED) != 0;
 }
 
+
+void azure_iot_get_stats(azure_iot_stats_t* stats) {
+    stats->connects = stat_connects.load(std::memory_order_relaxed);
+    stats->disconnects = stat_disconnects.load(std::memory_order_relaxed);
+    stats->published = stat_published.load(std::memory_order_relaxed);
+    stats->token_renewals = stat_renewals.load(std::memory_order_relaxed);
+    stats->forced_renewals = stat_forced_renewals.load(std::memory_order_relaxed);
+    stats->token_expiry = stat_token_expiry.load(std::memory_order_relaxed);
+    stats->last_blackout_us = stat_last_blackout_us.load(std::memory_order_relaxed);
+    stats->max_blackout_us = stat_max_blackout_us.load(std::memory_order_relaxed);
+    stats->last_connect_ms = stat_last_connect_ms.load(std::memory_order_relaxed);
+    stats->max_connect_ms = stat_max_connect_ms.load(std::memory_order_relaxed);
+}
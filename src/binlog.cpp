@@ -0,0 +1,132 @@
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+
+static const char *TAG = "BINLOG";
+
+#define BINLOG_LINE_MAX       160
+#define BINLOG_DRAIN_PERIOD   pdMS_TO_TICKS(50)
+
+static_assert((BINLOG_CAPACITY & (BINLOG_CAPACITY - 1)) == 0, "BINLOG_CAPACITY must be a power of two");
+
+// History ring. write_seq counts every record ever written; the slot for a
+// sequence number is seq % BINLOG_CAPACITY, so the newest record overwrites
+// the oldest. The lock only covers a record copy and never the formatting.
+static binlog_record_t records[BINLOG_CAPACITY];
+static uint32_t write_seq = 0;
+static uint32_t drain_seq = 0;
+static std::atomic<uint32_t> lost_records{0};
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char level_chars[] = { 'N', 'E', 'W', 'I', 'D' };
+
+void binlog_write(uint8_t level, const char* tag, const char* fmt, const uintptr_t* args, uint8_t nargs) {
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    portENTER_CRITICAL_SAFE(&ring_lock);
+    binlog_record_t* r = &records[write_seq & (BINLOG_CAPACITY - 1)];
+    r->time_ms = now_ms;
+    r->tag = tag;
+    r->fmt = fmt;
+    r->level = level;
+    r->nargs = nargs;
+    for (uint8_t i = 0; i < nargs; i++) {
+        r->args[i] = args[i];
+    }
+    write_seq++;
+    portEXIT_CRITICAL_SAFE(&ring_lock);
+}
+
+static size_t format_record(const binlog_record_t* r, char* line, size_t size) {
+    char level = r->level < sizeof(level_chars) ? level_chars[r->level] : '?';
+    int n = snprintf(line, size, "%c (%lu) %s: ", level, (unsigned long)r->time_ms, r->tag);
+    if (n < 0 || (size_t)n >= size) {
+        return size - 1;
+    }
+    // Unused argument slots are zero; printf ignores arguments the format does not consume
+    int m = snprintf(line + n, size - n, r->fmt, r->args[0], r->args[1], r->args[2], r->args[3]);
+    if (m < 0) {
+        return (size_t)n;
+    }
+    return ((size_t)(n + m) < size) ? (size_t)(n + m) : size - 1;
+}
+
+// Copy the record with sequence number seq. Fails if it has already been overwritten.
+static bool read_record(uint32_t seq, binlog_record_t* out) {
+    bool ok = false;
+    portENTER_CRITICAL(&ring_lock);
+    if (write_seq - seq <= BINLOG_CAPACITY && seq != write_seq) {
+        *out = records[seq & (BINLOG_CAPACITY - 1)];
+        ok = true;
+    }
+    portEXIT_CRITICAL(&ring_lock);
+    return ok;
+}
+
+static void binlog_task(void* arg) {
+    char line[BINLOG_LINE_MAX];
+    binlog_record_t record;
+
+    for (;;) {
+        portENTER_CRITICAL(&ring_lock);
+        uint32_t head = write_seq;
+        portEXIT_CRITICAL(&ring_lock);
+
+        if (head - drain_seq > BINLOG_CAPACITY) {
+            uint32_t skipped = head - drain_seq - BINLOG_CAPACITY;
+            lost_records.fetch_add(skipped, std::memory_order_relaxed);
+            printf("W BINLOG: %lu records lost\n", (unsigned long)skipped);
+            drain_seq = head - BINLOG_CAPACITY;
+        }
+
+        while (drain_seq != head) {
+            if (read_record(drain_seq, &record)) {
+                size_t len = format_record(&record, line, sizeof(line));
+                line[len] = '\n';
+                fwrite(line, 1, len + 1, stdout);
+            } else {
+                lost_records.fetch_add(1, std::memory_order_relaxed);
+            }
+            drain_seq++;
+        }
+
+        vTaskDelay(BINLOG_DRAIN_PERIOD);
+    }
+}
+
+void binlog_start(void) {
+    if (task_topology_create(TASK_ROLE_BINLOG, binlog_task, NULL, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create binlog task");
+    }
+}
+
+size_t binlog_dump(binlog_emit_fn emit, void* ctx) {
+    char line[BINLOG_LINE_MAX];
+    binlog_record_t record;
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t head = write_seq;
+    portEXIT_CRITICAL(&ring_lock);
+
+    uint32_t seq = head > BINLOG_CAPACITY ? head - BINLOG_CAPACITY : 0;
+    size_t emitted = 0;
+    for (; seq != head; seq++) {
+        if (!read_record(seq, &record)) {
+            continue;   // overwritten while we were emitting
+        }
+        size_t len = format_record(&record, line, sizeof(line) - 1);
+        line[len++] = '\n';
+        emit(line, len, ctx);
+        emitted++;
+    }
+    return emitted;
+}
+
+uint32_t binlog_lost(void) {
+    return lost_records.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,33 @@
+#include "c2d_properties.h"
+#include <string.h>
+
+bool c2d_property_find(const char* topic, size_t len, const char* name, const char** value, size_t* value_len) {
+    static const char marker[] = "/devicebound/";
+    const char* end = topic + len;
+    const char* p = NULL;
+    for (const char* t = topic; t + sizeof(marker) - 1 <= end; t++) {
+        if (memcmp(t, marker, sizeof(marker) - 1) == 0) {
+            p = t + sizeof(marker) - 1;
+            break;
+        }
+    }
+    size_t name_len = strlen(name);
+    while (p != NULL && p < end) {
+        const char* amp = (const char*)memchr(p, '&', (size_t)(end - p));
+        const char* item_end = amp ? amp : end;
+        if ((size_t)(item_end - p) > name_len && memcmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            *value = p + name_len + 1;
+            *value_len = (size_t)(item_end - *value);
+            return true;
+        }
+        p = amp ? amp + 1 : NULL;
+    }
+    return false;
+}
+
+bool c2d_property_equals(const char* topic, size_t len, const char* name, const char* value) {
+    const char* found;
+    size_t found_len;
+    return c2d_property_find(topic, len, name, &found, &found_len) && found_len == strlen(value) &&
+           memcmp(found, value, found_len) == 0;
+}
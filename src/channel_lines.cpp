@@ -0,0 +1,91 @@
+#include "channel_lines.h"
+#include "led_channels.h"
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static channel_lines_result_t fail(cmd_token_t* error_token, channel_lines_result_t result, const char* ptr,
+                                   size_t len) {
+    error_token->ptr = ptr;
+    error_token->len = len;
+    return result;
+}
+
+// CHANNEL [KEY=STATE ...]
+static channel_lines_result_t parse_line(const char* p, const char* end, const channel_lines_ops_t* ops,
+                                         uint32_t* mask, cmd_token_t* error_token) {
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    if (p == end) {
+        return CHANNEL_LINES_OK;   // blank line
+    }
+    const char* name = p;
+    while (p < end && !is_space(*p)) {
+        p++;
+    }
+    int channel = led_channel_find(name, (size_t)(p - name));
+    if (channel < 0) {
+        return fail(error_token, CHANNEL_LINES_UNKNOWN_CHANNEL, name, (size_t)(p - name));
+    }
+    if (!(*mask & (1u << channel))) {
+        ops->clear(ops->ctx, channel);   // first mention in this upload replaces the channel's entries
+        *mask |= 1u << channel;
+    }
+
+    for (;;) {
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+        if (p == end) {
+            return CHANNEL_LINES_OK;
+        }
+        const char* item = p;
+        const char* eq = NULL;
+        while (p < end && !is_space(*p)) {
+            if (*p == '=' && eq == NULL) {
+                eq = p;
+            }
+            p++;
+        }
+        if (eq == NULL) {
+            return fail(error_token, CHANNEL_LINES_SYNTAX, item, (size_t)(p - item));
+        }
+        uint32_t key;
+        uint8_t level;
+        if (ops->parse_key(item, (size_t)(eq - item), &key) != 0) {
+            return fail(error_token, CHANNEL_LINES_BAD_KEY, item, (size_t)(eq - item));
+        }
+        if (command_parse_level(eq + 1, (size_t)(p - eq - 1), &level) != 0) {
+            return fail(error_token, CHANNEL_LINES_BAD_STATE, eq + 1, (size_t)(p - eq - 1));
+        }
+        if (!ops->insert(ops->ctx, channel, key, level)) {
+            return fail(error_token, CHANNEL_LINES_TOO_MANY, item, (size_t)(p - item));
+        }
+    }
+}
+
+channel_lines_result_t channel_lines_parse(const char* data, size_t len, const channel_lines_ops_t* ops,
+                                           uint32_t* mask, cmd_token_t* error_token) {
+    const char* p = data;
+    const char* end = data + len;
+    *mask = 0;
+    while (p < end) {
+        const char* line = p;
+        while (p < end && *p != '\n' && *p != ';') {
+            p++;
+        }
+        channel_lines_result_t result = parse_line(line, p, ops, mask, error_token);
+        if (result != CHANNEL_LINES_OK) {
+            return result;
+        }
+        if (p < end) {
+            p++;
+        }
+    }
+    if (*mask == 0) {
+        return fail(error_token, CHANNEL_LINES_EMPTY, data, len);
+    }
+    return CHANNEL_LINES_OK;
+}
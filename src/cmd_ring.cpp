@@ -0,0 +1,51 @@
+#include "cmd_ring.h"
+
+void cmd_ring_init(cmd_ring_t* ring, cmd_ring_slot_t* slots, size_t capacity) {
+    ring->slots = slots;
+    ring->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->head = 0;
+}
+
+bool cmd_ring_push(cmd_ring_t* ring, const cmd_record_t* record) {
+    size_t pos = ring->tail.load(std::memory_order_relaxed);
+    cmd_ring_slot_t* slot;
+
+    for (;;) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t seq = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // Slot is free for this position; claim it
+            if (ring->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;   // consumer has not freed this slot yet: full
+        } else {
+            pos = ring->tail.load(std::memory_order_relaxed);   // another producer won the race
+        }
+    }
+
+    slot->record = *record;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool cmd_ring_pop(cmd_ring_t* ring, cmd_record_t* record) {
+    size_t pos = ring->head;
+    cmd_ring_slot_t* slot = &ring->slots[pos & ring->mask];
+    size_t seq = slot->seq.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+        return false;
+    }
+
+    *record = slot->record;
+    ring->head = pos + 1;
+    // Hand the slot back to producers one lap ahead
+    slot->seq.store(pos + ring->mask + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,324 @@
+#include "command_parser.h"
+#include "led_channels.h"
+#include <atomic>
+
+// Counted on the error path only
+static std::atomic<uint32_t> stat_errors[CMD_PARSE_RESULT_COUNT];
+
+// Read position over the input; tokens are slices between p and end
+typedef struct {
+    const char* p;
+    const char* end;
+} cursor_t;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool token_is(const char* token, size_t len, const char* literal) {
+    return led_name_equals(token, len, literal);
+}
+
+static void skip_space(cursor_t* cur) {
+    while (cur->p < cur->end && is_space(*cur->p)) {
+        cur->p++;
+    }
+}
+
+static void trim(const char** token, size_t* len) {
+    while (*len > 0 && is_space(**token)) {
+        (*token)++;
+        (*len)--;
+    }
+    while (*len > 0 && is_space((*token)[*len - 1])) {
+        (*len)--;
+    }
+}
+
+static cmd_parse_result_t fail(cmd_token_t* error_token, cmd_parse_result_t result, const char* ptr, size_t len) {
+    error_token->ptr = ptr;
+    error_token->len = len;
+    return result;
+}
+
+static void batch_set(led_batch_t* batch, int channel, uint8_t level) {
+    batch->mask |= 1u << channel;
+    batch->level[channel] = level;
+}
+
+static void batch_set_all(led_batch_t* batch, uint8_t level) {
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        batch_set(batch, i, level);
+    }
+}
+
+static int parse_hex_mask(const char* token, size_t len, uint32_t* mask) {
+    if (len > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) {
+        token += 2;
+        len -= 2;
+    }
+    if (len == 0 || len > 8) {
+        return -1;
+    }
+    uint32_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = token[i];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = (uint32_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = (uint32_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = (uint32_t)(c - 'A' + 10);
+        } else {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    if (value & ~LED_CHANNELS_ALL) {
+        return -1;
+    }
+    *mask = value;
+    return 0;
+}
+
+int command_parse_level(const char* token, size_t len, uint8_t* level) {
+    if (token_is(token, len, "ON")) {
+        *level = LED_LEVEL_MAX;
+        return 0;
+    }
+    if (token_is(token, len, "OFF")) {
+        *level = 0;
+        return 0;
+    }
+    if (len == 0 || len > 3) {
+        return -1;
+    }
+
+    unsigned value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (token[i] < '0' || token[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (unsigned)(token[i] - '0');
+    }
+    if (value > LED_LEVEL_MAX) {
+        return -1;
+    }
+    *level = (uint8_t)value;
+    return 0;
+}
+
+// One "NAME:VALUE" entry of the text form
+static cmd_parse_result_t parse_entry(const char* name, size_t name_len, const char* value, size_t value_len,
+                                      led_batch_t* batch, cmd_token_t* error_token) {
+    trim(&name, &name_len);
+    trim(&value, &value_len);
+
+    if (token_is(name, name_len, "MASK")) {
+        uint32_t mask;
+        if (parse_hex_mask(value, value_len, &mask) != 0) {
+            return fail(error_token, CMD_PARSE_BAD_STATE, value, value_len);
+        }
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+            batch_set(batch, i, (mask >> i) & 1 ? LED_LEVEL_MAX : 0);
+        }
+        return CMD_PARSE_OK;
+    }
+
+    uint8_t level;
+    if (token_is(name, name_len, "ALL")) {
+        if (command_parse_level(value, value_len, &level) != 0) {
+            return fail(error_token, CMD_PARSE_BAD_STATE, value, value_len);
+        }
+        batch_set_all(batch, level);
+        return CMD_PARSE_OK;
+    }
+
+    int channel = led_channel_find(name, name_len);
+    if (channel < 0) {
+        return fail(error_token, CMD_PARSE_UNKNOWN_CHANNEL, name, name_len);
+    }
+    if (command_parse_level(value, value_len, &level) != 0) {
+        return fail(error_token, CMD_PARSE_BAD_STATE, value, value_len);
+    }
+    batch_set(batch, channel, level);
+    return CMD_PARSE_OK;
+}
+
+// CHANNEL:STATE entries separated by ',' or ';', or a single bare STATE
+static cmd_parse_result_t parse_text(cursor_t* cur, led_batch_t* batch, cmd_token_t* error_token) {
+    const char* message = cur->p;
+
+    while (cur->p < cur->end) {
+        const char* entry = cur->p;
+        const char* colon = NULL;
+        while (cur->p < cur->end && *cur->p != ',' && *cur->p != ';') {
+            if (*cur->p == ':' && colon == NULL) {
+                colon = cur->p;
+            }
+            cur->p++;
+        }
+        const char* entry_end = cur->p;
+        if (cur->p < cur->end) {
+            cur->p++;   // separator
+        }
+
+        if (colon == NULL) {
+            const char* state = entry;
+            size_t state_len = (size_t)(entry_end - entry);
+            trim(&state, &state_len);
+            if (state_len == 0) {
+                continue;   // tolerate empty entries such as a trailing comma
+            }
+            // Bare STATE only makes sense as the whole message
+            uint8_t level;
+            if (entry != message || entry_end != cur->end) {
+                return fail(error_token, CMD_PARSE_SYNTAX, state, state_len);
+            }
+            if (command_parse_level(state, state_len, &level) != 0) {
+                return fail(error_token, CMD_PARSE_BAD_STATE, state, state_len);
+            }
+            batch_set(batch, LED_CHANNEL_DEFAULT, level);
+            continue;
+        }
+
+        cmd_parse_result_t result = parse_entry(entry, (size_t)(colon - entry), colon + 1,
+                                                (size_t)(entry_end - colon - 1), batch, error_token);
+        if (result != CMD_PARSE_OK) {
+            return result;
+        }
+    }
+
+    if (batch->mask == 0) {
+        return fail(error_token, CMD_PARSE_EMPTY, message, (size_t)(cur->end - message));
+    }
+    return CMD_PARSE_OK;
+}
+
+// {"CHANNEL": "ON" | "OFF" | 0-255 | true | false, ...} - flat object, no escapes
+static cmd_parse_result_t parse_json(cursor_t* cur, led_batch_t* batch, cmd_token_t* error_token) {
+    const char* object = cur->p;
+    cur->p++;   // '{'
+
+    for (;;) {
+        skip_space(cur);
+        if (cur->p < cur->end && *cur->p == '}') {
+            cur->p++;
+            break;
+        }
+
+        // Key
+        if (cur->p >= cur->end || *cur->p != '"') {
+            return fail(error_token, CMD_PARSE_SYNTAX, cur->p, (size_t)(cur->end - cur->p));
+        }
+        const char* key = ++cur->p;
+        while (cur->p < cur->end && *cur->p != '"' && *cur->p != '\\') {
+            cur->p++;
+        }
+        if (cur->p >= cur->end || *cur->p != '"') {
+            return fail(error_token, CMD_PARSE_SYNTAX, key, (size_t)(cur->p - key));
+        }
+        size_t key_len = (size_t)(cur->p - key);
+        cur->p++;
+
+        skip_space(cur);
+        if (cur->p >= cur->end || *cur->p != ':') {
+            return fail(error_token, CMD_PARSE_SYNTAX, key, key_len);
+        }
+        cur->p++;
+        skip_space(cur);
+
+        // Value: quoted state, bare number or boolean
+        const char* value = cur->p;
+        size_t value_len;
+        if (cur->p < cur->end && *cur->p == '"') {
+            value = ++cur->p;
+            while (cur->p < cur->end && *cur->p != '"') {
+                cur->p++;
+            }
+            if (cur->p >= cur->end) {
+                return fail(error_token, CMD_PARSE_SYNTAX, value - 1, (size_t)(cur->p - value + 1));
+            }
+            value_len = (size_t)(cur->p - value);
+            cur->p++;
+        } else {
+            while (cur->p < cur->end && *cur->p != ',' && *cur->p != '}' && !is_space(*cur->p)) {
+                cur->p++;
+            }
+            value_len = (size_t)(cur->p - value);
+            if (token_is(value, value_len, "true")) {
+                value = "ON";
+                value_len = 2;
+            } else if (token_is(value, value_len, "false")) {
+                value = "OFF";
+                value_len = 3;
+            }
+        }
+
+        cmd_parse_result_t result = parse_entry(key, key_len, value, value_len, batch, error_token);
+        if (result != CMD_PARSE_OK) {
+            return result;
+        }
+
+        skip_space(cur);
+        if (cur->p < cur->end && *cur->p == ',') {
+            cur->p++;
+        } else if (cur->p >= cur->end || *cur->p != '}') {
+            return fail(error_token, CMD_PARSE_SYNTAX, object, (size_t)(cur->end - object));
+        }
+    }
+
+    skip_space(cur);
+    if (cur->p != cur->end) {
+        return fail(error_token, CMD_PARSE_SYNTAX, cur->p, (size_t)(cur->end - cur->p));
+    }
+    if (batch->mask == 0) {
+        return fail(error_token, CMD_PARSE_EMPTY, object, (size_t)(cur->end - object));
+    }
+    return CMD_PARSE_OK;
+}
+
+static cmd_parse_result_t parse_command(const char* data, size_t len, led_batch_t* batch, cmd_token_t* error_token) {
+    cursor_t cur = { data, data + len };
+
+    // Trim surrounding whitespace/newlines
+    skip_space(&cur);
+    while (cur.end > cur.p && is_space(cur.end[-1])) {
+        cur.end--;
+    }
+
+    batch->mask = 0;
+    if (cur.p == cur.end) {
+        return fail(error_token, CMD_PARSE_EMPTY, cur.p, 0);
+    }
+    if (*cur.p == '{') {
+        return parse_json(&cur, batch, error_token);
+    }
+    return parse_text(&cur, batch, error_token);
+}
+
+cmd_parse_result_t command_parse(const char* data, size_t len, led_batch_t* batch, cmd_token_t* error_token) {
+    cmd_parse_result_t result = parse_command(data, len, batch, error_token);
+    if (result != CMD_PARSE_OK) {
+        stat_errors[result].fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+const char* command_parse_result_str(cmd_parse_result_t result) {
+    switch (result) {
+        case CMD_PARSE_OK:              return "OK";
+        case CMD_PARSE_EMPTY:           return "Mensaje vacio";
+        case CMD_PARSE_UNKNOWN_CHANNEL: return "Canal desconocido";
+        case CMD_PARSE_BAD_STATE:       return "Estado desconocido (Use: ON, OFF o 0-255)";
+        case CMD_PARSE_SYNTAX:          return "Formato invalido";
+        default:                        return "Error";
+    }
+}
+
+void command_parse_get_stats(cmd_parse_stats_t* stats) {
+    for (int i = 0; i < CMD_PARSE_RESULT_COUNT; i++) {
+        stats->errors[i] = stat_errors[i].load(std::memory_order_relaxed);
+    }
+}
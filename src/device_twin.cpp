@@ -0,0 +1,424 @@
+#include "device_twin.h"
+#include "actuator.h"
+#include "command_parser.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TWIN";
+
+#define TWIN_NAMESPACE   "picapica"
+#define TWIN_VERSION_KEY "twin_ver"       // desired $version last applied
+
+static device_twin_publish_fn publish_fn = NULL;
+static TaskHandle_t twin_task_handle = NULL;
+
+static std::atomic<bool> connected{false};
+static std::atomic<uint32_t> dirty_mask{0};      // channels to report
+static std::atomic<bool> version_dirty{false};   // desired_version to report
+static std::atomic<uint32_t> next_rid{1};
+static std::atomic<uint32_t> get_rid{0};         // rid of the outstanding full-twin GET
+
+// Desired documents arrive on the MQTT task only
+static uint32_t applied_version = 0;
+
+static std::atomic<uint32_t> stat_desired_patches{0};
+static std::atomic<uint32_t> stat_desired_errors{0};
+static std::atomic<uint32_t> stat_reported_patches{0};
+static std::atomic<uint32_t> stat_reported_changes{0};
+static std::atomic<uint32_t> stat_reported_errors{0};
+static std::atomic<uint32_t> stat_desired_version{0};
+
+// Formatted on the twin task only
+static char report_buf[48 + LED_CHANNEL_COUNT * 24];
+
+// ---------------------------------------------------------------------------
+// Minimal JSON walking over the received bytes: enough to find members of an
+// object and skip whatever they hold. Nothing is copied or allocated.
+
+typedef struct {
+    const char* ptr;
+    size_t len;
+} json_slice_t;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char* skip_space(const char* p, const char* end) {
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// End of the value starting at p, or NULL if it is cut short
+static const char* skip_value(const char* p, const char* end) {
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        for (p++; p < end && *p != '"'; p++) {
+            if (*p == '\\') {
+                p++;
+            }
+        }
+        return p < end ? p + 1 : NULL;
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (p < end) {
+            if (*p == '"') {
+                p = skip_value(p, end);
+                if (p == NULL) {
+                    return NULL;
+                }
+                continue;
+            }
+            if (*p == '{' || *p == '[') {
+                depth++;
+            } else if ((*p == '}' || *p == ']') && --depth == 0) {
+                return p + 1;
+            }
+            p++;
+        }
+        return NULL;
+    }
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && !is_space(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Next "key": value of an object. *p starts just inside '{'. Returns 1 for a
+// member, 0 at the closing brace, -1 on malformed input.
+static int next_member(const char** p, const char* end, json_slice_t* key, json_slice_t* value) {
+    const char* q = skip_space(*p, end);
+    if (q < end && *q == ',') {
+        q = skip_space(q + 1, end);
+    }
+    if (q < end && *q == '}') {
+        *p = q + 1;
+        return 0;
+    }
+    if (q >= end || *q != '"') {
+        return -1;
+    }
+    const char* key_end = skip_value(q, end);
+    if (key_end == NULL) {
+        return -1;
+    }
+    key->ptr = q + 1;
+    key->len = (size_t)(key_end - q - 2);
+    q = skip_space(key_end, end);
+    if (q >= end || *q != ':') {
+        return -1;
+    }
+    q = skip_space(q + 1, end);
+    const char* value_end = skip_value(q, end);
+    if (value_end == NULL) {
+        return -1;
+    }
+    value->ptr = q;
+    value->len = (size_t)(value_end - q);
+    *p = value_end;
+    return 1;
+}
+
+static bool slice_is(const json_slice_t* s, const char* text) {
+    size_t len = strlen(text);
+    return s->len == len && memcmp(s->ptr, text, len) == 0;
+}
+
+// Value of a top-level member of the object in `object`
+static bool find_member(const json_slice_t* object, const char* name, json_slice_t* value) {
+    const char* end = object->ptr + object->len;
+    const char* p = skip_space(object->ptr, end);
+    if (p >= end || *p != '{') {
+        return false;
+    }
+    p++;
+    json_slice_t key;
+    while (next_member(&p, end, &key, value) == 1) {
+        if (slice_is(&key, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// {"RGB": 128, "WHITE": "ON", "VERDE": false, "FAR_RED": null}
+static bool parse_channels(const json_slice_t* object, led_batch_t* batch) {
+    const char* end = object->ptr + object->len;
+    const char* p = skip_space(object->ptr, end);
+    batch->mask = 0;
+    if (p >= end || *p != '{') {
+        return false;
+    }
+    p++;
+    json_slice_t key;
+    json_slice_t value;
+    int status;
+    while ((status = next_member(&p, end, &key, &value)) == 1) {
+        int channel = led_channel_find(key.ptr, key.len);
+        if (channel < 0) {
+            BLOGW(TAG, "Unknown desired channel at byte %d", (int)(key.ptr - object->ptr));
+            return false;
+        }
+        if (slice_is(&value, "null")) {
+            continue;   // removed from desired: keep whatever the channel has
+        }
+        const char* state = value.ptr;
+        size_t state_len = value.len;
+        if (slice_is(&value, "true")) {
+            state = "ON";
+            state_len = 2;
+        } else if (slice_is(&value, "false")) {
+            state = "OFF";
+            state_len = 3;
+        } else if (state_len >= 2 && state[0] == '"') {
+            state++;
+            state_len -= 2;
+        }
+        uint8_t level;
+        if (command_parse_level(state, state_len, &level) != 0) {
+            BLOGW(TAG, "Desired state for %s invalid", LED_CHANNELS[channel].name);
+            return false;
+        }
+        batch->mask |= 1u << channel;
+        batch->level[channel] = level;
+    }
+    return status == 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static void save_version(uint32_t version) {
+    nvs_handle_t handle;
+    if (nvs_open(TWIN_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_u32(handle, TWIN_VERSION_KEY, version) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+// desired: the desired section, from a PATCH or a full twin. On the MQTT task.
+static void apply_desired(const json_slice_t* desired, bool full_twin) {
+    json_slice_t member;
+    uint32_t version = 0;
+    if (find_member(desired, "$version", &member)) {
+        version = (uint32_t)strtoul(member.ptr, NULL, 10);
+    }
+    if (full_twin && version == applied_version) {
+        return;   // nothing changed since we last applied it
+    }
+
+    if (find_member(desired, "channels", &member)) {
+        led_batch_t batch;
+        if (!parse_channels(&member, &batch)) {
+            stat_desired_errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (batch.mask != 0 && actuator_submit(&batch, CMD_SOURCE_MQTT) != ESP_OK) {
+            BLOGE(TAG, "Actuator queue full, desired state dropped");
+            return;   // not acknowledged; the next full twin retries it
+        }
+        stat_desired_patches.fetch_add(1, std::memory_order_relaxed);
+        BLOGI(TAG, "Desired version %u applied, channel mask 0x%x", (unsigned)version, (unsigned)batch.mask);
+    }
+
+    if (version != applied_version) {
+        applied_version = version;
+        stat_desired_version.store(version, std::memory_order_relaxed);
+        save_version(version);
+        version_dirty.store(true);
+        xTaskNotifyGive(twin_task_handle);
+    }
+}
+
+static size_t format_report(uint32_t mask, bool with_version) {
+    size_t n = 0;
+    n += snprintf(report_buf + n, sizeof(report_buf) - n, "{");
+    if (mask != 0) {
+        n += snprintf(report_buf + n, sizeof(report_buf) - n, "\"channels\":{");
+        bool first = true;
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+            if (mask & (1u << i)) {
+                n += snprintf(report_buf + n, sizeof(report_buf) - n, "%s\"%s\":%d", first ? "" : ",",
+                              LED_CHANNELS[i].name, led_channel_get_level(i));
+                first = false;
+            }
+        }
+        n += snprintf(report_buf + n, sizeof(report_buf) - n, "}");
+    }
+    if (with_version) {
+        n += snprintf(report_buf + n, sizeof(report_buf) - n, "%s\"desired_version\":%u", mask ? "," : "",
+                      (unsigned)stat_desired_version.load(std::memory_order_relaxed));
+    }
+    n += snprintf(report_buf + n, sizeof(report_buf) - n, "}");
+    return n < sizeof(report_buf) ? n : sizeof(report_buf) - 1;
+}
+
+static void twin_task(void* arg) {
+    char topic[64];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!connected.load()) {
+            continue;   // stays dirty until device_twin_on_connected()
+        }
+        uint32_t mask = dirty_mask.exchange(0);
+        bool with_version = version_dirty.exchange(false);
+        if (mask == 0 && !with_version) {
+            continue;
+        }
+
+        size_t len = format_report(mask, with_version);
+        snprintf(topic, sizeof(topic), TWIN_TOPIC_PREFIX "PATCH/properties/reported/?$rid=%u",
+                 (unsigned)next_rid.fetch_add(1));
+        if (publish_fn(topic, report_buf, len) < 0) {
+            // Try again after the interval
+            dirty_mask.fetch_or(mask);
+            if (with_version) {
+                version_dirty.store(true);
+            }
+            xTaskNotifyGive(twin_task_handle);
+        } else {
+            stat_reported_patches.fetch_add(1, std::memory_order_relaxed);
+            BLOGD(TAG, "Reported %u bytes, channel mask 0x%x", (unsigned)len, (unsigned)mask);
+        }
+
+        // Changes arriving meanwhile pile up in dirty_mask and go out as one patch
+        vTaskDelay(pdMS_TO_TICKS(TWIN_REPORT_INTERVAL_MS));
+    }
+}
+
+// Actuator listener: runs on the actuator task, only marks channels dirty
+static void twin_listener(const cmd_record_t* record) {
+    dirty_mask.fetch_or(record->batch.mask);
+    stat_reported_changes.fetch_add(1, std::memory_order_relaxed);
+    xTaskNotifyGive(twin_task_handle);
+}
+
+esp_err_t device_twin_start(device_twin_publish_fn publish) {
+    publish_fn = publish;
+
+    nvs_handle_t handle;
+    if (nvs_open(TWIN_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, TWIN_VERSION_KEY, &applied_version);
+        nvs_close(handle);
+    }
+    stat_desired_version.store(applied_version, std::memory_order_relaxed);
+
+    if (task_topology_create(TASK_ROLE_TWIN, twin_task, NULL, &twin_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create twin task");
+        return ESP_ERR_NO_MEM;
+    }
+    return actuator_add_listener(twin_listener);
+}
+
+void device_twin_on_connected(void) {
+    if (twin_task_handle == NULL) {
+        return;
+    }
+    connected.store(true);
+
+    // Desired changes made while offline come with the full twin
+    char topic[48];
+    uint32_t rid = next_rid.fetch_add(1);
+    get_rid.store(rid);
+    snprintf(topic, sizeof(topic), TWIN_TOPIC_PREFIX "GET/?$rid=%u", (unsigned)rid);
+    if (publish_fn(topic, "", 0) < 0) {
+        BLOGW(TAG, "Twin request not queued");
+    }
+
+    // The hub may have missed reports while we were away: send everything once
+    dirty_mask.fetch_or(LED_CHANNELS_ALL);
+    version_dirty.store(true);
+    xTaskNotifyGive(twin_task_handle);
+}
+
+void device_twin_on_disconnected(void) {
+    connected.store(false);
+}
+
+// $iothub/twin/res/{status}/?$rid={rid}[&$version=...]
+static bool parse_response_topic(const char* topic, size_t len, int* status, uint32_t* rid) {
+    static const char prefix[] = TWIN_TOPIC_PREFIX "res/";
+    if (len <= sizeof(prefix) - 1 || memcmp(topic, prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    const char* p = topic + sizeof(prefix) - 1;
+    const char* end = topic + len;
+    *status = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        *status = *status * 10 + (*p++ - '0');
+    }
+    *rid = 0;
+    for (; p + 5 <= end; p++) {
+        if (memcmp(p, "$rid=", 5) == 0) {
+            for (p += 5; p < end && *p >= '0' && *p <= '9'; p++) {
+                *rid = *rid * 10 + (uint32_t)(*p - '0');
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+void device_twin_on_message(const char* topic, size_t topic_len, const char* data, size_t len) {
+    static const char desired_prefix[] = TWIN_TOPIC_PREFIX "PATCH/properties/desired/";
+    json_slice_t body = { data, len };
+    if (twin_task_handle == NULL) {
+        return;
+    }
+
+    if (topic_len >= sizeof(desired_prefix) - 1 && memcmp(topic, desired_prefix, sizeof(desired_prefix) - 1) == 0) {
+        apply_desired(&body, false);
+        return;
+    }
+
+    int status;
+    uint32_t rid;
+    if (!parse_response_topic(topic, topic_len, &status, &rid)) {
+        BLOGW(TAG, "Unexpected twin topic, %d bytes", (int)topic_len);
+        return;
+    }
+    if (rid == get_rid.load()) {
+        json_slice_t desired;
+        if (status == 200 && find_member(&body, "desired", &desired)) {
+            apply_desired(&desired, true);
+        } else {
+            stat_desired_errors.fetch_add(1, std::memory_order_relaxed);
+            BLOGW(TAG, "Twin request failed, status %d", status);
+        }
+        return;
+    }
+    if (status >= 300) {
+        // Throttled (429) or rejected: send the full state again after the interval
+        stat_reported_errors.fetch_add(1, std::memory_order_relaxed);
+        BLOGW(TAG, "Reported patch rid %u failed, status %d", (unsigned)rid, status);
+        dirty_mask.fetch_or(LED_CHANNELS_ALL);
+        version_dirty.store(true);
+        xTaskNotifyGive(twin_task_handle);
+    }
+}
+
+void device_twin_get_stats(device_twin_stats_t* stats) {
+    stats->desired_patches = stat_desired_patches.load(std::memory_order_relaxed);
+    stats->desired_version = stat_desired_version.load(std::memory_order_relaxed);
+    stats->desired_errors = stat_desired_errors.load(std::memory_order_relaxed);
+    stats->reported_patches = stat_reported_patches.load(std::memory_order_relaxed);
+    stats->reported_changes = stat_reported_changes.load(std::memory_order_relaxed);
+    stats->reported_errors = stat_reported_errors.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,284 @@
+#include "direct_methods.h"
+#include "actuator.h"
+#include "command_parser.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "METHODS";
+
+#define METHOD_RID_MAX 16
+
+// Slot life cycle: FREE -> PENDING (MQTT task) -> STAMPING -> DONE or SUPERSEDED
+// (actuator task) -> FREE (responder). STAMPING holds the slot while the
+// listener writes the timestamps, so the responder never reads them half-set.
+enum {
+    SLOT_FREE = 0,
+    SLOT_PENDING,
+    SLOT_STAMPING,
+    SLOT_DONE,
+    SLOT_SUPERSEDED,
+};
+
+typedef struct {
+    std::atomic<uint8_t> state;
+    uint32_t tag;                  // actuator record tag
+    uint32_t channels;             // channels addressed, for the answer
+    char rid[METHOD_RID_MAX];
+    int64_t received_us;           // request handed to us
+    int64_t enqueue_us;            // written in STAMPING
+    int64_t applied_us;
+} method_slot_t;
+
+static method_slot_t slots[METHOD_MAX_PENDING];
+static direct_methods_publish_fn publish_fn = NULL;
+static TaskHandle_t responder_handle = NULL;
+static uint32_t next_tag = 1;      // MQTT task only
+
+static std::atomic<uint32_t> stat_requests{0};
+static std::atomic<uint32_t> stat_commands{0};
+static std::atomic<uint32_t> stat_applied{0};
+static std::atomic<uint32_t> stat_errors{0};
+static std::atomic<uint32_t> stat_timeouts{0};
+static std::atomic<uint32_t> stat_last_latency_us{0};
+static std::atomic<uint32_t> stat_max_latency_us{0};
+
+static void respond(const char* rid, int status, const char* body) {
+    char topic[64];
+    snprintf(topic, sizeof(topic), METHOD_TOPIC_PREFIX "res/%d/?$rid=%s", status, rid);
+    if (status >= 400) {
+        stat_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (publish_fn(topic, body, strlen(body)) < 0) {
+        BLOGW(TAG, "Method response %d not queued", status);
+    }
+}
+
+static void respond_error(const char* rid, int status, const char* message) {
+    char body[96];
+    snprintf(body, sizeof(body), "{\"ok\":false,\"error\":\"%s\"}", message);
+    respond(rid, status, body);
+}
+
+// Responder task: answers applied commands and times out the rest
+static void responder_task(void* arg) {
+    char body[128];
+
+    for (;;) {
+        bool waiting = false;
+        int64_t now_us = esp_timer_get_time();
+        for (int i = 0; i < METHOD_MAX_PENDING; i++) {
+            method_slot_t* slot = &slots[i];
+            uint8_t state = slot->state.load(std::memory_order_acquire);
+            if (state == SLOT_DONE) {
+                uint32_t latency = (uint32_t)(slot->applied_us - slot->received_us);
+                snprintf(body, sizeof(body), "{\"ok\":true,\"channels\":%d,\"latency_us\":%u,\"queue_us\":%u}",
+                         __builtin_popcount(slot->channels), (unsigned)latency,
+                         (unsigned)(slot->applied_us - slot->enqueue_us));
+                respond(slot->rid, 200, body);
+                stat_applied.fetch_add(1, std::memory_order_relaxed);
+                stat_last_latency_us.store(latency, std::memory_order_relaxed);
+                if (latency > stat_max_latency_us.load(std::memory_order_relaxed)) {
+                    stat_max_latency_us.store(latency, std::memory_order_relaxed);
+                }
+                slot->state.store(SLOT_FREE, std::memory_order_release);
+            } else if (state == SLOT_SUPERSEDED) {
+                stat_timeouts.fetch_add(1, std::memory_order_relaxed);
+                respond_error(slot->rid, 504, "Comando reemplazado por un apagado");
+                slot->state.store(SLOT_FREE, std::memory_order_release);
+            } else if (state == SLOT_STAMPING) {
+                waiting = true;   // the listener is finishing it
+            } else if (state == SLOT_PENDING) {
+                if (now_us - slot->received_us < (int64_t)METHOD_TIMEOUT_MS * 1000) {
+                    waiting = true;
+                    continue;
+                }
+                // The listener may complete it right now; only one side wins
+                uint8_t expected = SLOT_PENDING;
+                if (slot->state.compare_exchange_strong(expected, SLOT_FREE)) {
+                    stat_timeouts.fetch_add(1, std::memory_order_relaxed);
+                    respond_error(slot->rid, 504, "Comando no aplicado");
+                } else {
+                    xTaskNotifyGive(responder_handle);   // the listener took it: next pass
+                }
+            }
+        }
+        // Sweep for timeouts only while something is outstanding
+        ulTaskNotifyTake(pdTRUE, waiting ? pdMS_TO_TICKS(METHOD_TIMEOUT_MS / 10) : portMAX_DELAY);
+    }
+}
+
+// The PENDING slot waiting for this record, claimed for the actuator task
+static method_slot_t* claim_for_record(const cmd_record_t* record) {
+    if (record->tag == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < METHOD_MAX_PENDING; i++) {
+        method_slot_t* slot = &slots[i];
+        // State first: the tag is only stable once the slot is published as PENDING
+        if (slot->state.load(std::memory_order_acquire) != SLOT_PENDING || slot->tag != record->tag) {
+            continue;
+        }
+        // Claimed before anything is written: the responder may time it out meanwhile
+        uint8_t expected = SLOT_PENDING;
+        return slot->state.compare_exchange_strong(expected, SLOT_STAMPING, std::memory_order_acq_rel) ? slot
+                                                                                                       : NULL;
+    }
+    return NULL;
+}
+
+// Actuator listener: stamp the request at the hardware write, answer on the responder
+static void method_listener(const cmd_record_t* record) {
+    int64_t now_us = esp_timer_get_time();
+    method_slot_t* slot = claim_for_record(record);
+    if (slot == NULL) {
+        return;
+    }
+    slot->applied_us = now_us;
+    slot->enqueue_us = record->enqueue_us;
+    slot->state.store(SLOT_DONE, std::memory_order_release);
+    xTaskNotifyGive(responder_handle);
+}
+
+// Actuator discard listener: an ALL:OFF dropped the command, answer 504 now
+static void method_discard_listener(const cmd_record_t* record) {
+    method_slot_t* slot = claim_for_record(record);
+    if (slot == NULL) {
+        return;
+    }
+    slot->state.store(SLOT_SUPERSEDED, std::memory_order_release);
+    xTaskNotifyGive(responder_handle);
+}
+
+static method_slot_t* claim_slot(void) {
+    for (int i = 0; i < METHOD_MAX_PENDING; i++) {
+        if (slots[i].state.load(std::memory_order_acquire) == SLOT_FREE) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void submit_command(const char* rid, const led_batch_t* batch, int64_t received_us) {
+    method_slot_t* slot = claim_slot();
+    if (slot == NULL) {
+        respond_error(rid, 503, "Demasiados metodos en curso");
+        return;
+    }
+    slot->tag = next_tag++;
+    if (next_tag & ACTUATOR_TAG_TRACE) {
+        next_tag = 1;   // 0 means untagged, the top bit is latency_trace's
+    }
+    slot->channels = batch->mask;
+    snprintf(slot->rid, sizeof(slot->rid), "%s", rid);
+    slot->received_us = received_us;
+    slot->state.store(SLOT_PENDING, std::memory_order_release);
+
+    stat_commands.fetch_add(1, std::memory_order_relaxed);
+    if (actuator_submit_tagged(batch, CMD_SOURCE_MQTT, slot->tag) != ESP_OK) {
+        slot->state.store(SLOT_FREE, std::memory_order_release);
+        respond_error(rid, 503, "Cola de comandos llena");
+        return;
+    }
+    xTaskNotifyGive(responder_handle);   // start the timeout sweep
+}
+
+static void get_channels(const char* rid) {
+    char body[32 + LED_CHANNEL_COUNT * 24];
+    size_t n = snprintf(body, sizeof(body), "{\"channels\":{");
+    for (int i = 0; i < LED_CHANNEL_COUNT && n < sizeof(body); i++) {
+        n += snprintf(body + n, sizeof(body) - n, "%s\"%s\":%d", i ? "," : "", LED_CHANNELS[i].name,
+                      led_channel_get_level(i));
+    }
+    if (n < sizeof(body)) {
+        snprintf(body + n, sizeof(body) - n, "}}");
+    }
+    respond(rid, 200, body);
+}
+
+static bool name_is(const char* name, size_t len, const char* expected) {
+    return strlen(expected) == len && memcmp(name, expected, len) == 0;
+}
+
+// $iothub/methods/POST/{method}/?$rid={rid}
+void direct_methods_on_request(const char* topic, size_t topic_len, const char* data, size_t len) {
+    static const char prefix[] = METHOD_TOPIC_PREFIX "POST/";
+    int64_t received_us = esp_timer_get_time();
+    if (responder_handle == NULL || topic_len <= sizeof(prefix) - 1 ||
+        memcmp(topic, prefix, sizeof(prefix) - 1) != 0) {
+        return;
+    }
+    stat_requests.fetch_add(1, std::memory_order_relaxed);
+
+    const char* name = topic + sizeof(prefix) - 1;
+    const char* end = topic + topic_len;
+    const char* slash = (const char*)memchr(name, '/', (size_t)(end - name));
+    char rid[METHOD_RID_MAX] = "";
+    for (const char* p = slash; p != NULL && p + 5 <= end; p++) {
+        if (memcmp(p, "$rid=", 5) == 0) {
+            p += 5;
+            size_t n = 0;
+            while (p < end && *p != '&' && n < sizeof(rid) - 1) {
+                rid[n++] = *p++;
+            }
+            rid[n] = '\0';
+            break;
+        }
+    }
+    if (slash == NULL || rid[0] == '\0') {
+        BLOGW(TAG, "Method request without $rid, %d bytes of topic", (int)topic_len);
+        return;   // nothing to answer to
+    }
+    size_t name_len = (size_t)(slash - name);
+
+    if (name_is(name, name_len, "setChannels")) {
+        // The payload is JSON: an object, or a quoted text command
+        if (len >= 2 && data[0] == '"' && data[len - 1] == '"') {
+            data++;
+            len -= 2;
+        }
+        led_batch_t batch;
+        cmd_token_t bad_token;
+        cmd_parse_result_t result = command_parse(data, len, &batch, &bad_token);
+        if (result != CMD_PARSE_OK) {
+            respond_error(rid, 400, command_parse_result_str(result));
+            return;
+        }
+        submit_command(rid, &batch, received_us);
+    } else if (name_is(name, name_len, "allOff")) {
+        led_batch_t batch = {};
+        batch.mask = LED_CHANNELS_ALL;
+        submit_command(rid, &batch, received_us);
+    } else if (name_is(name, name_len, "getChannels")) {
+        get_channels(rid);
+    } else {
+        respond_error(rid, 404, "Metodo desconocido");
+    }
+}
+
+esp_err_t direct_methods_start(direct_methods_publish_fn publish) {
+    publish_fn = publish;
+    if (task_topology_create(TASK_ROLE_METHODS, responder_task, NULL, &responder_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create method responder task");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = actuator_add_listener(method_listener);
+    return err == ESP_OK ? actuator_add_discard_listener(method_discard_listener) : err;
+}
+
+void direct_methods_get_stats(direct_methods_stats_t* stats) {
+    stats->requests = stat_requests.load(std::memory_order_relaxed);
+    stats->commands = stat_commands.load(std::memory_order_relaxed);
+    stats->applied = stat_applied.load(std::memory_order_relaxed);
+    stats->errors = stat_errors.load(std::memory_order_relaxed);
+    stats->timeouts = stat_timeouts.load(std::memory_order_relaxed);
+    stats->last_latency_us = stat_last_latency_us.load(std::memory_order_relaxed);
+    stats->max_latency_us = stat_max_latency_us.load(std::memory_order_relaxed);
+}
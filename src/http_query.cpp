@@ -0,0 +1,108 @@
+#include "http_query.h"
+#include <string.h>
+
+bool http_query_find(const char* query, size_t len, const char* key, cmd_token_t* value) {
+    size_t key_len = strlen(key);
+    const char* end = query + len;
+    const char* p = query;
+
+    while (p < end) {
+        const char* amp = (const char*)memchr(p, '&', end - p);
+        const char* pair_end = amp ? amp : end;
+        const char* eq = (const char*)memchr(p, '=', pair_end - p);
+        const char* name_end = eq ? eq : pair_end;
+
+        if ((size_t)(name_end - p) == key_len && memcmp(p, key, key_len) == 0) {
+            value->ptr = eq ? eq + 1 : pair_end;
+            value->len = pair_end - value->ptr;
+            return true;
+        }
+        p = pair_end + 1;
+    }
+    return false;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int http_query_decode(const char* value, size_t len, char* out, size_t out_size) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (n == out_size) {
+            return -1;
+        }
+        char c = value[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < len) {
+            int hi = hex_digit(value[i + 1]);
+            int lo = hex_digit(value[i + 2]);
+            if (hi >= 0 && lo >= 0) {
+                c = (char)(hi << 4 | lo);
+                i += 2;
+            }
+        }
+        out[n++] = c;
+    }
+    return (int)n;
+}
+
+// Decodes `value` into the query's buffer at `*used`; the token points there
+static bool decode_value(led_query_t* out, size_t* used, cmd_token_t* value) {
+    int n = http_query_decode(value->ptr, value->len, out->decoded + *used, sizeof(out->decoded) - *used);
+    if (n < 0) {
+        return false;
+    }
+    value->ptr = out->decoded + *used;
+    value->len = (size_t)n;
+    *used += (size_t)n;
+    return true;
+}
+
+led_query_result_t led_query_parse(const char* query, size_t len, led_query_t* out) {
+    cmd_token_t value;
+    size_t used = 0;
+
+    // Batch form: /led?cmd=RGB:ON,WHITE:OFF,VERDE:128 (same syntax as the MQTT commands)
+    if (http_query_find(query, len, "cmd", &value)) {
+        out->batch_form = true;
+        if (!decode_value(out, &used, &value)) {
+            out->cmd_result = CMD_PARSE_SYNTAX;
+            out->token.ptr = "";
+            out->token.len = 0;
+            return LED_QUERY_BAD_COMMAND;
+        }
+        out->cmd_result = command_parse(value.ptr, value.len, &out->batch, &out->token);
+        return out->cmd_result == CMD_PARSE_OK ? LED_QUERY_OK : LED_QUERY_BAD_COMMAND;
+    }
+
+    out->batch_form = false;
+    if (!http_query_find(query, len, "channel", &out->token)) {
+        return LED_QUERY_NO_CHANNEL;
+    }
+    if (!http_query_find(query, len, "state", &value)) {
+        return LED_QUERY_NO_STATE;
+    }
+    // Both values are found in the raw query before either is decoded: a
+    // decoded '&' must not split a pair
+    if (!decode_value(out, &used, &out->token) || !decode_value(out, &used, &value)) {
+        return LED_QUERY_BAD_STATE;
+    }
+    out->channel = led_channel_find(out->token.ptr, out->token.len);
+    if (out->channel < 0) {
+        return LED_QUERY_UNKNOWN_CHANNEL;
+    }
+
+    uint8_t level;
+    if (command_parse_level(value.ptr, value.len, &level) != 0) {
+        out->token = value;
+        return LED_QUERY_BAD_STATE;
+    }
+    out->batch.mask = 1u << out->channel;
+    out->batch.level[out->channel] = level;
+    return LED_QUERY_OK;
+}
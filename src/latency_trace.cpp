@@ -0,0 +1,328 @@
+#include "latency_trace.h"
+#include "actuator.h"
+#include "binlog.h"
+#include "c2d_properties.h"
+#include "esp_timer.h"
+#include "time_sync.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const char *TAG = "TRACE";
+
+const uint32_t LATENCY_TRACE_BOUNDS_US[LATENCY_TRACE_BUCKETS] = {
+    100, 1000, 10000, 50000, 100000, 250000, 500000, 1000000, 5000000,
+};
+
+static const char* const stage_names[TRACE_STAGE_COUNT] = { "cloud", "mqtt", "handler", "actuator", "total" };
+
+// tag 0 = free. Only the MQTT task claims a slot; the listener frees it by
+// swapping its own tag for 0, so a slot reclaimed and reused meanwhile is
+// never finished with the wrong stamps.
+typedef struct {
+    std::atomic<uint32_t> tag;
+    int64_t base_us;               // where the cloud stage ended: TLS read, else the event
+    int64_t parsed_us;
+    int64_t cloud_us;              // -1 = unknown
+    int64_t mqtt_us;               // -1 = unknown
+    int64_t handler_us;
+    char mid[LATENCY_TRACE_MID_MAX];
+} trace_slot_t;
+
+typedef struct {
+    int64_t stage_us[TRACE_STAGE_COUNT];   // -1 = unknown
+    char mid[LATENCY_TRACE_MID_MAX];
+} trace_sample_t;
+
+static trace_slot_t slots[LATENCY_TRACE_SLOTS];
+static uint32_t next_tag = 1;      // MQTT task only
+
+// Written by the actuator task while !sample_ready, read by the telemetry task while set
+static trace_sample_t sample;
+static std::atomic<bool> sample_ready{false};
+
+static std::atomic<uint32_t> stat_traced{0};
+static std::atomic<uint32_t> stat_untraced{0};
+static std::atomic<uint32_t> stat_sampled{0};
+static std::atomic<uint32_t> stat_buckets[TRACE_STAGE_COUNT][LATENCY_TRACE_BUCKETS + 1];
+static std::atomic<uint64_t> stat_sum_us[TRACE_STAGE_COUNT];
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static size_t url_decode(const char* in, size_t len, char* out, size_t size) {
+    size_t n = 0;
+    for (size_t i = 0; i < len && n + 1 < size; i++) {
+        if (in[i] == '%' && i + 2 < len && hex_digit(in[i + 1]) >= 0 && hex_digit(in[i + 2]) >= 0) {
+            out[n++] = (char)(hex_digit(in[i + 1]) << 4 | hex_digit(in[i + 2]));
+            i += 2;
+        } else {
+            out[n++] = in[i];
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static bool read_number(const char** p, int digits, int* value) {
+    *value = 0;
+    for (int i = 0; i < digits; i++, (*p)++) {
+        if (**p < '0' || **p > '9') {
+            return false;
+        }
+        *value = *value * 10 + (**p - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+// "2024-05-01T10:20:30.1234567Z" or epoch milliseconds; 0 if neither
+static int64_t parse_time_ms(const char* text) {
+    const char* p = text;
+    int year, month, day, hour, minute, second;
+    if (strlen(text) >= 12 && strspn(text, "0123456789") == strlen(text)) {
+        int64_t ms = 0;
+        for (; *p; p++) {
+            ms = ms * 10 + (*p - '0');
+        }
+        return ms;
+    }
+    if (!read_number(&p, 4, &year) || *p++ != '-' || !read_number(&p, 2, &month) || *p++ != '-' ||
+        !read_number(&p, 2, &day) || *p++ != 'T' || !read_number(&p, 2, &hour) || *p++ != ':' ||
+        !read_number(&p, 2, &minute) || *p++ != ':' || !read_number(&p, 2, &second)) {
+        return 0;
+    }
+    int ms = 0;
+    if (*p == '.') {
+        p++;
+        for (int scale = 100; *p >= '0' && *p <= '9'; p++, scale /= 10) {
+            ms += (*p - '0') * scale;
+        }
+    }
+    if (*p != '\0' && *p != 'Z') {
+        return 0;   // offsets other than UTC are not used by the hub
+    }
+    int64_t days = days_from_civil(year, month, day);
+    return ((days * 24 + hour) * 60 + minute) * 60000LL + second * 1000LL + ms;
+}
+
+static int64_t enqueue_time_ms(const char* topic, size_t len) {
+    static const char* const names[] = { "iothub-enqueuedtime", "%24.ctime" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const char* value;
+        size_t value_len;
+        if (c2d_property_find(topic, len, names[i], &value, &value_len)) {
+            char text[48];
+            url_decode(value, value_len, text, sizeof(text));
+            return parse_time_ms(text);
+        }
+    }
+    return 0;
+}
+
+// Message id for the sample, kept to characters that need no JSON escaping
+static void copy_mid(const char* topic, size_t len, char* out) {
+    const char* value;
+    size_t value_len;
+    size_t n = 0;
+    if (c2d_property_find(topic, len, "%24.mid", &value, &value_len)) {
+        for (size_t i = 0; i < value_len && n + 1 < LATENCY_TRACE_MID_MAX; i++) {
+            char c = value[i];
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' ||
+                c == '_' || c == '.') {
+                out[n++] = c;
+            }
+        }
+    }
+    out[n] = '\0';
+}
+
+static trace_slot_t* claim_slot(int64_t now_us) {
+    for (int i = 0; i < LATENCY_TRACE_SLOTS; i++) {
+        uint32_t tag = slots[i].tag.load(std::memory_order_acquire);
+        if (tag == 0) {
+            return &slots[i];
+        }
+        // Nothing applied since (actuator stalled): take it back unless the listener is finishing it
+        if (now_us - slots[i].parsed_us > LATENCY_TRACE_TIMEOUT_MS * 1000LL &&
+            slots[i].tag.compare_exchange_strong(tag, 0, std::memory_order_acq_rel)) {
+            stat_untraced.fetch_add(1, std::memory_order_relaxed);
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+uint32_t latency_trace_begin(const char* topic, size_t topic_len, int64_t tls_rx_us, int64_t event_us) {
+    int64_t parsed_us = esp_timer_get_time();
+    trace_slot_t* slot = claim_slot(parsed_us);
+    if (slot == NULL) {
+        stat_untraced.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    bool have_read = tls_rx_us > 0 && tls_rx_us <= event_us;
+    slot->base_us = have_read ? tls_rx_us : event_us;
+    slot->parsed_us = parsed_us;
+    slot->mqtt_us = have_read ? event_us - tls_rx_us : -1;
+    slot->handler_us = parsed_us - event_us;
+    slot->cloud_us = -1;
+    int64_t enqueue_ms = enqueue_time_ms(topic, topic_len);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (enqueue_ms > 0 && tv.tv_sec >= CLOCK_VALID_AFTER) {
+        // Wall time of base_us: now, less what passed on the device since
+        int64_t base_wall_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (parsed_us - slot->base_us);
+        int64_t cloud_us = base_wall_us - enqueue_ms * 1000;
+        slot->cloud_us = cloud_us > 0 ? cloud_us : 0;   // clock error larger than the delay
+    }
+    copy_mid(topic, topic_len, slot->mid);
+
+    uint32_t tag = next_tag++ | ACTUATOR_TAG_TRACE;
+    if (next_tag & ACTUATOR_TAG_TRACE) {
+        next_tag = 1;
+    }
+    slot->tag.store(tag, std::memory_order_release);
+    return tag;
+}
+
+void latency_trace_cancel(uint32_t tag) {
+    if (tag == 0) {
+        return;
+    }
+    for (int i = 0; i < LATENCY_TRACE_SLOTS; i++) {
+        uint32_t expected = tag;
+        if (slots[i].tag.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+            stat_untraced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+static void add_stage(trace_stage_t stage, int64_t us) {
+    int i = 0;
+    while (i < LATENCY_TRACE_BUCKETS && us > LATENCY_TRACE_BOUNDS_US[i]) {
+        i++;
+    }
+    stat_buckets[stage][i].fetch_add(1, std::memory_order_relaxed);
+    stat_sum_us[stage].fetch_add((uint64_t)us, std::memory_order_relaxed);
+}
+
+// Each lane is applied in order, and an ALL:OFF drops what was queued before
+// it: once a record enqueued at enqueue_us is applied, every trace begun
+// earlier was applied or superseded. (A record stamped earlier but pushed
+// later by another task can lose its trace here; it is counted as untraced.)
+static void drop_before(int64_t enqueue_us) {
+    for (int i = 0; i < LATENCY_TRACE_SLOTS; i++) {
+        uint32_t tag = slots[i].tag.load(std::memory_order_acquire);
+        if (tag != 0 && slots[i].parsed_us < enqueue_us &&
+            slots[i].tag.compare_exchange_strong(tag, 0, std::memory_order_acq_rel)) {
+            stat_untraced.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void finish(const cmd_record_t* record, int64_t applied_us) {
+    for (int i = 0; i < LATENCY_TRACE_SLOTS; i++) {
+        trace_slot_t* slot = &slots[i];
+        if (slot->tag.load(std::memory_order_acquire) != record->tag) {
+            continue;
+        }
+        trace_sample_t t;
+        t.stage_us[TRACE_STAGE_CLOUD] = slot->cloud_us;
+        t.stage_us[TRACE_STAGE_MQTT] = slot->mqtt_us;
+        t.stage_us[TRACE_STAGE_HANDLER] = slot->handler_us;
+        t.stage_us[TRACE_STAGE_ACTUATOR] = applied_us - record->enqueue_us;
+        t.stage_us[TRACE_STAGE_TOTAL] = slot->cloud_us >= 0 ? slot->cloud_us + (applied_us - slot->base_us) : -1;
+        memcpy(t.mid, slot->mid, sizeof(t.mid));
+        uint32_t expected = record->tag;
+        if (!slot->tag.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+            return;   // reclaimed meanwhile; the copy may be torn
+        }
+
+        for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+            if (t.stage_us[s] >= 0) {
+                add_stage((trace_stage_t)s, t.stage_us[s]);
+            }
+        }
+        uint32_t traced = stat_traced.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (traced % LATENCY_TRACE_SAMPLE_EVERY == 0 && !sample_ready.load(std::memory_order_acquire)) {
+            sample = t;
+            sample_ready.store(true, std::memory_order_release);
+        }
+        return;
+    }
+}
+
+// Actuator listener: runs right after every hardware write, must not block
+static void trace_listener(const cmd_record_t* record) {
+    if (record->tag & ACTUATOR_TAG_TRACE) {
+        finish(record, esp_timer_get_time());
+    }
+    drop_before(record->enqueue_us);
+}
+
+size_t latency_trace_take_sample(char* out, size_t size) {
+    if (!sample_ready.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    const int64_t* us = sample.stage_us;
+    int n = snprintf(out, size, "{\"type\":\"trace\",\"mid\":\"%s\"", sample.mid);
+    if (us[TRACE_STAGE_CLOUD] >= 0 && n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, ",\"cloud_ms\":%lld", (long long)(us[TRACE_STAGE_CLOUD] / 1000));
+    }
+    if (us[TRACE_STAGE_MQTT] >= 0 && n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, ",\"mqtt_us\":%lld", (long long)us[TRACE_STAGE_MQTT]);
+    }
+    if (n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, ",\"handler_us\":%lld,\"actuator_us\":%lld",
+                      (long long)us[TRACE_STAGE_HANDLER], (long long)us[TRACE_STAGE_ACTUATOR]);
+    }
+    if (us[TRACE_STAGE_TOTAL] >= 0 && n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, ",\"total_ms\":%lld", (long long)(us[TRACE_STAGE_TOTAL] / 1000));
+    }
+    if (n > 0 && (size_t)n < size) {
+        n += snprintf(out + n, size - n, "}");
+    }
+    sample_ready.store(false, std::memory_order_release);
+    if (n <= 0 || (size_t)n >= size) {
+        BLOGW(TAG, "Trace record does not fit in %d bytes", (int)size);
+        return 0;
+    }
+    stat_sampled.fetch_add(1, std::memory_order_relaxed);
+    return (size_t)n;
+}
+
+const char* latency_trace_stage_name(trace_stage_t stage) {
+    return stage < TRACE_STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+esp_err_t latency_trace_start(void) {
+    return actuator_add_listener(trace_listener);
+}
+
+void latency_trace_get_stats(latency_trace_stats_t* stats) {
+    stats->traced = stat_traced.load(std::memory_order_relaxed);
+    stats->untraced = stat_untraced.load(std::memory_order_relaxed);
+    stats->sampled = stat_sampled.load(std::memory_order_relaxed);
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        for (int i = 0; i <= LATENCY_TRACE_BUCKETS; i++) {
+            stats->buckets[s][i] = stat_buckets[s][i].load(std::memory_order_relaxed);
+        }
+        stats->sum_us[s] = stat_sum_us[s].load(std::memory_order_relaxed);
+    }
+}
@@ -1,38 +1,259 @@
 #include "led_channels.h"
 #include "esp_log.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/soc.h"
 #include <stdio.h>
 
 static const char *TAG = "LED_CHANNELS";
 
+// Runtime PWM state. Frequency and resolution live with the LEDC timer;
+// levels with the channel.
+typedef struct {
+    uint32_t freq_hz;
+    ledc_timer_bit_t resolution;
+} led_pwm_timer_t;
+
+static led_pwm_timer_t pwm_timers[LEDC_TIMER_MAX];
+static uint8_t channel_levels[LED_CHANNEL_COUNT];
+
+// Channels whose pin is currently routed to its LEDC output. The others are
+// parked on the plain GPIO output register at fully ON or OFF.
+static uint32_t ledc_routed;
+
+// Perceptual brightness table (CIE 1931 lightness -> relative luminance), 16-bit fixed point.
+// Built at compile time so a level change is a table read plus a shift at runtime.
+typedef struct {
+    uint16_t luminance[LED_LEVEL_MAX + 1];
+} led_gamma_table_t;
+
+static constexpr led_gamma_table_t make_gamma_table(void) {
+    led_gamma_table_t table = {};
+    for (int i = 0; i <= LED_LEVEL_MAX; i++) {
+        double lightness = i * 100.0 / LED_LEVEL_MAX;
+        double t = (lightness + 16.0) / 116.0;
+        double y = (lightness <= 8.0) ? lightness / 903.3 : t * t * t;
+        table.luminance[i] = (uint16_t)(y * 65535.0 + 0.5);
+    }
+    return table;
+}
+
+static constexpr led_gamma_table_t gamma_table = make_gamma_table();
+
+static_assert(gamma_table.luminance[0] == 0, "level 0 must be fully off");
+static_assert(gamma_table.luminance[LED_LEVEL_MAX] == 65535, "max level must be fully on");
+
+static bool valid_channel(int channel) {
+    return channel >= 0 && channel < LED_CHANNEL_COUNT;
+}
+
+static ledc_timer_bit_t channel_resolution(int channel) {
+    return pwm_timers[LED_CHANNELS[channel].ledc_timer].resolution;
+}
+
+static void route_to_ledc(int channel) {
+    const led_channel_def_t* def = &LED_CHANNELS[channel];
+    ledc_set_pin(def->pin, LED_PWM_SPEED_MODE, def->ledc_channel);
+    ledc_routed |= 1u << channel;
+}
+
+static void route_to_gpio(int channel) {
+    esp_rom_gpio_connect_out_signal(LED_CHANNELS[channel].pin, SIG_GPIO_OUT_IDX, false, false);
+    ledc_routed &= ~(1u << channel);
+}
+
+uint32_t led_level_to_duty(uint8_t level, ledc_timer_bit_t resolution) {
+    // LEDC accepts duty in [0, 2^resolution]; 2^resolution keeps the output constantly high.
+    uint64_t full_scale = 1ULL << resolution;
+    return (uint32_t)((gamma_table.luminance[level] * full_scale + 32767) / 65535);
+}
+
+static esp_err_t configure_timer(ledc_timer_t timer) {
+    ledc_timer_config_t timer_cfg = {};
+    timer_cfg.speed_mode = LED_PWM_SPEED_MODE;
+    timer_cfg.duty_resolution = pwm_timers[timer].resolution;
+    timer_cfg.timer_num = timer;
+    timer_cfg.freq_hz = pwm_timers[timer].freq_hz;
+    timer_cfg.clk_cfg = LEDC_AUTO_CLK;
+    return ledc_timer_config(&timer_cfg);
+}
+
 void led_channels_init(void) {
-    printf("[LED] Initializing LED channels...\n");
-    
-    // Configure all channel pins as outputs
-    gpio_set_direction(CHANNEL_RGB_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CHANNEL_WHITE_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CHANNEL_VERDE_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CHANNEL_FAR_RED_PIN, GPIO_MODE_OUTPUT);
-    
-    // Set all channels to OFF initially
-    gpio_set_level(CHANNEL_RGB_PIN, 0);
-    gpio_set_level(CHANNEL_WHITE_PIN, 0);
-    gpio_set_level(CHANNEL_VERDE_PIN, 0);
-    gpio_set_level(CHANNEL_FAR_RED_PIN, 0);
-    
-    printf("[LED] Channel RGB (Pin 17) configured\n");
-    printf("[LED] Channel WHITE (Pin 16) configured\n");
-    printf("[LED] Channel VERDE (Pin 4) configured\n");
-    printf("[LED] Channel FAR_RED (Pin 12) configured\n");
+    printf("[LED] Initializing LED channels (LEDC PWM)...\n");
+
+    for (int i = 0; i < LEDC_TIMER_MAX; i++) {
+        pwm_timers[i].freq_hz = LED_PWM_DEFAULT_FREQ_HZ;
+        pwm_timers[i].resolution = LED_PWM_DEFAULT_RESOLUTION;
+    }
+
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        const led_channel_def_t* def = &LED_CHANNELS[i];
+        ESP_ERROR_CHECK(configure_timer(def->ledc_timer));
+
+        // Start every channel at duty 0 (OFF)
+        ledc_channel_config_t channel_cfg = {};
+        channel_cfg.gpio_num = def->pin;
+        channel_cfg.speed_mode = LED_PWM_SPEED_MODE;
+        channel_cfg.channel = def->ledc_channel;
+        channel_cfg.intr_type = LEDC_INTR_DISABLE;
+        channel_cfg.timer_sel = def->ledc_timer;
+        channel_cfg.duty = 0;
+        channel_cfg.hpoint = 0;
+        ESP_ERROR_CHECK(ledc_channel_config(&channel_cfg));
+        channel_levels[i] = 0;
+
+        printf("[LED] Channel %s (Pin %d) configured: %lu Hz, %d-bit\n", def->name, def->pin,
+               (unsigned long)pwm_timers[def->ledc_timer].freq_hz, pwm_timers[def->ledc_timer].resolution);
+    }
+
+    // Hardware fades run in the LEDC peripheral; the ISR only fires at fade end
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+
+    // ledc_channel_config routed every pin to LEDC; park them all OFF on the GPIO register
+    ledc_routed = LED_CHANNELS_ALL;
+    led_batch_t all_off = {};
+    all_off.mask = LED_CHANNELS_ALL;
+    led_channels_apply(&all_off);
+
     printf("[LED] All channels initialized and set to OFF\n");
-    
     ESP_LOGI(TAG, "All LED channels initialized");
 }
 
-void led_channel_set(gpio_num_t pin, int level) {
-    gpio_set_level(pin, level);
+esp_err_t led_channel_configure(int channel, uint32_t freq_hz, ledc_timer_bit_t resolution) {
+    if (!valid_channel(channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const led_channel_def_t* def = &LED_CHANNELS[channel];
+    led_pwm_timer_t previous = pwm_timers[def->ledc_timer];
+    pwm_timers[def->ledc_timer].freq_hz = freq_hz;
+    pwm_timers[def->ledc_timer].resolution = resolution;
+    esp_err_t err = configure_timer(def->ledc_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Channel %s: %lu Hz / %d-bit not supported", def->name, (unsigned long)freq_hz, resolution);
+        pwm_timers[def->ledc_timer] = previous;
+        return err;
+    }
+
+    // Duty scale changed with the resolution; re-apply the level of every channel on this timer
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if (LED_CHANNELS[i].ledc_timer == def->ledc_timer && (ledc_routed & (1u << i))) {
+            ledc_fade_stop(LED_PWM_SPEED_MODE, LED_CHANNELS[i].ledc_channel);
+            ledc_set_duty_and_update(LED_PWM_SPEED_MODE, LED_CHANNELS[i].ledc_channel,
+                                     led_level_to_duty(channel_levels[i], resolution), 0);
+        }
+    }
+    return ESP_OK;
 }
 
-int led_channel_get(gpio_num_t pin) {
-    return gpio_get_level(pin);
+esp_err_t led_channels_apply(const led_batch_t* batch) {
+    if (batch->mask & ~LED_CHANNELS_ALL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t set_pins = 0;
+    uint32_t clear_pins = 0;
+    uint32_t park = 0;
+    uint32_t dimmed = 0;
+
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        if (!(batch->mask & bit)) {
+            continue;
+        }
+        uint8_t level = batch->level[i];
+        channel_levels[i] = level;
+
+        if (level == 0 || level == LED_LEVEL_MAX) {
+            if (level) {
+                set_pins |= 1u << LED_CHANNELS[i].pin;
+            } else {
+                clear_pins |= 1u << LED_CHANNELS[i].pin;
+            }
+            if (ledc_routed & bit) {
+                ledc_fade_stop(LED_PWM_SPEED_MODE, LED_CHANNELS[i].ledc_channel);
+                park |= bit;
+            }
+        } else {
+            dimmed |= bit;
+        }
+    }
+
+    // Every ON/OFF edge of the parked channels in one set and one clear write
+    if (set_pins) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, set_pins);
+    }
+    if (clear_pins) {
+        REG_WRITE(GPIO_OUT_W1TC_REG, clear_pins);
+    }
+
+    // Channels leaving PWM switch over to the level preset above
+    for (int i = 0; park; i++) {
+        if (park & (1u << i)) {
+            route_to_gpio(i);
+            park &= ~(1u << i);
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    for (int i = 0; dimmed; i++) {
+        uint32_t bit = 1u << i;
+        if (!(dimmed & bit)) {
+            continue;
+        }
+        ledc_channel_t ledc_channel = LED_CHANNELS[i].ledc_channel;
+        ledc_fade_stop(LED_PWM_SPEED_MODE, ledc_channel);
+        esp_err_t ch_err = ledc_set_duty_and_update(LED_PWM_SPEED_MODE, ledc_channel,
+                                                    led_level_to_duty(batch->level[i], channel_resolution(i)), 0);
+        if (ch_err != ESP_OK) {
+            err = ch_err;
+        } else if (!(ledc_routed & bit)) {
+            route_to_ledc(i);
+        }
+        dimmed &= ~bit;
+    }
+    return err;
+}
+
+esp_err_t led_channel_set_level(int channel, uint8_t level) {
+    if (!valid_channel(channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    led_batch_t batch;
+    batch.mask = 1u << channel;
+    batch.level[channel] = level;
+    return led_channels_apply(&batch);
 }
 
+esp_err_t led_channel_fade_to(int channel, uint8_t level, uint32_t fade_ms) {
+    if (fade_ms == 0) {
+        return led_channel_set_level(channel, level);
+    }
+    if (!valid_channel(channel)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A new fade replaces the running one from wherever the duty currently is
+    ledc_channel_t ledc_channel = LED_CHANNELS[channel].ledc_channel;
+    if (ledc_routed & (1u << channel)) {
+        ledc_fade_stop(LED_PWM_SPEED_MODE, ledc_channel);
+    } else {
+        // Parked at ON/OFF: start the LEDC output from the same level, then take over the pin
+        ledc_set_duty_and_update(LED_PWM_SPEED_MODE, ledc_channel,
+                                 led_level_to_duty(channel_levels[channel], channel_resolution(channel)), 0);
+        route_to_ledc(channel);
+    }
+    channel_levels[channel] = level;
+    esp_err_t err = ledc_set_fade_with_time(LED_PWM_SPEED_MODE, ledc_channel,
+                                            led_level_to_duty(level, channel_resolution(channel)), (int)fade_ms);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return ledc_fade_start(LED_PWM_SPEED_MODE, ledc_channel, LEDC_FADE_NO_WAIT);
+}
+
+uint8_t led_channel_get_level(int channel) {
+    return valid_channel(channel) ? channel_levels[channel] : 0;
+}
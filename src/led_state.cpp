@@ -0,0 +1,105 @@
+#include "led_state.h"
+#include "actuator.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "LED_STATE";
+
+#define LED_STATE_NAMESPACE "picapica"
+#define LED_STATE_KEY       "levels"
+
+static TaskHandle_t saver_task_handle = NULL;
+
+// Levels as last written to flash, so a change that was undone is not rewritten
+static uint8_t saved_levels[LED_CHANNEL_COUNT];
+
+static esp_err_t save_levels(const uint8_t* levels) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LED_STATE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, LED_STATE_KEY, levels, LED_CHANNEL_COUNT);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t led_state_restore(void) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LED_STATE_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        // The namespace only exists once something was saved
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t len = sizeof(saved_levels);
+    err = nvs_get_blob(handle, LED_STATE_KEY, saved_levels, &len);
+    nvs_close(handle);
+    if (err != ESP_OK || len != sizeof(saved_levels)) {
+        // Missing, or saved by a firmware with a different channel table
+        memset(saved_levels, 0, sizeof(saved_levels));
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    led_batch_t batch = {};
+    batch.mask = LED_CHANNELS_ALL;
+    memcpy(batch.level, saved_levels, sizeof(saved_levels));
+    printf("[LED_STATE] Restaurando niveles guardados\n");
+    return actuator_submit(&batch, CMD_SOURCE_LOCAL);
+}
+
+// Runs on the actuator task: only wake the saver
+static void state_listener(const cmd_record_t* record) {
+    xTaskNotifyGive(saver_task_handle);
+}
+
+static void saver_task(void* arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait for the changes to settle, but not forever
+        TickType_t first = xTaskGetTickCount();
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LED_STATE_SAVE_DELAY_MS)) != 0) {
+            if (xTaskGetTickCount() - first >= pdMS_TO_TICKS(LED_STATE_SAVE_MAX_MS)) {
+                break;
+            }
+        }
+
+        uint8_t levels[LED_CHANNEL_COUNT];
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+            levels[i] = led_channel_get_level(i);
+        }
+        if (memcmp(levels, saved_levels, sizeof(levels)) == 0) {
+            continue;
+        }
+        esp_err_t err = save_levels(levels);
+        if (err == ESP_OK) {
+            memcpy(saved_levels, levels, sizeof(levels));
+            BLOGD(TAG, "Levels saved");
+        } else {
+            BLOGW(TAG, "Failed to save levels: 0x%x", err);
+        }
+    }
+}
+
+esp_err_t led_state_start(void) {
+    BaseType_t ok = task_topology_create(TASK_ROLE_LED_STATE, saver_task, NULL, &saver_task_handle);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create saver task");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = actuator_add_listener(state_listener);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No free actuator listener slot");
+    }
+    return err;
+}
@@ -6,60 +6,128 @@
 #include "azure_iot_mqtt.h"
 #include "web_server.h"
 #include "led_channels.h"
+#include "actuator.h"
+#include "binlog.h"
+#include "telemetry.h"
+#include "telemetry_spool.h"
 #include "azure_config.h"
 #include "esp_netif.h"
-#include <cJSON.h>
+#include "esp_event.h"
+#include "nvs_flash.h"
+#include "app_events.h"
+#include "led_state.h"
+#include "metrics.h"
+#include "ramp.h"
+#include "schedule.h"
+#include "task_topology.h"
+#include "time_sync.h"
 #include <stdio.h>
 
 static const char *TAG = "MAIN";
 
+// How long a boot phase may take before app_main starts complaining. It keeps
+// waiting either way: the LEDs and the web UI already work without the cloud.
+#define BOOT_PHASE_WARN_MS 30000
+
+static void nvs_init(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        printf("[MAIN] Erasing NVS...\n");
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+}
+
+static void wait_for_phase(EventBits_t bit, const char* what) {
+    int waited_s = 0;
+    while (!(app_events_wait(bit, pdMS_TO_TICKS(BOOT_PHASE_WARN_MS)) & bit)) {
+        waited_s += BOOT_PHASE_WARN_MS / 1000;
+        printf("[MAIN] WARNING: Still waiting for %s (%d s)\n", what, waited_s);
+        ESP_LOGW(TAG, "Still waiting for %s (%d s)", what, waited_s);
+    }
+}
+
 extern "C" void app_main(void) {
-    // Small delay to ensure UART is ready
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    
+    // Boot phases are timed from here; set first so every module can report
+    app_events_init();
+
     printf("\n\n========================================\n");
     printf("[MAIN] Starting ESP32 Azure IoT Hub application...\n");
     printf("========================================\n");
-    fflush(stdout);  // Force flush to ensure output is sent immediately
     ESP_LOGI(TAG, "Starting ESP32 Azure IoT Hub application...");
     
-    // Initialize all LED channels
+    // Deferred logger first, so hot paths can log from the start
+    binlog_start();
+    
+    nvs_init();
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    
+    // Lights first: restore the last levels before anything touches the network
     printf("[MAIN] Initializing LED channels...\n");
     led_channels_init();
-    printf("[MAIN] All LED channels configured\n");
+    ESP_ERROR_CHECK(actuator_start());
+    if (task_topology_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Control core jitter will not be measured");
+    }
+    if (led_state_restore() != ESP_OK) {
+        printf("[MAIN] No saved LED state, starting with all channels off\n");
+    }
+    if (led_state_start() != ESP_OK) {
+        ESP_LOGW(TAG, "LED state will not be saved");
+    }
+    // Photoperiod tables wait for SNTP, then run without the cloud
+    if (schedule_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Scheduler not available");
+    }
+    if (ramp_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Ramps not available");
+    }
+    app_events_set(APP_EVENT_LEDS_READY);
+    
+    // Telemetry recorded during earlier outages is replayed once MQTT connects
+    telemetry_spool_init();
     
-    // Initialize WiFi
+    // The server binds to all interfaces, so it can listen before there is an IP
+    printf("[MAIN] Starting web server...\n");
+    esp_err_t ret = web_server_start();
+    if (ret != ESP_OK) {
+        printf("[MAIN] WARNING: Web server failed to start (error: %d)\n", ret);
+        ESP_LOGW(TAG, "Web server failed to start");
+    } else {
+        app_events_set(APP_EVENT_WEB_READY);
+    }
+    
+    // Association runs in the background from here
     printf("[MAIN] Initializing WiFi...\n");
     printf("[MAIN] SSID: %s\n", WIFI_SSID);
     ESP_LOGI(TAG, "Initializing WiFi...");
-    esp_err_t ret = wifi_init_sta(WIFI_SSID, WIFI_PASSWORD);
+    ret = wifi_init_sta(WIFI_SSID, WIFI_PASSWORD);
     if (ret != ESP_OK) {
         printf("[MAIN] ERROR: WiFi initialization failed (error: %d)\n", ret);
         ESP_LOGE(TAG, "WiFi initialization failed");
-        return;
     }
-    printf("[MAIN] WiFi initialization OK\n");
+    time_sync_start();
     
-    // Wait for WiFi connection
-    printf("[MAIN] Waiting for WiFi connection...\n");
-    ESP_LOGI(TAG, "Waiting for WiFi connection...");
-    int wifi_timeout = 30; // 30 seconds timeout
-    while (!wifi_is_connected() && wifi_timeout > 0) {
-        printf("[MAIN] WiFi connecting... (%d seconds remaining)\n", wifi_timeout);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        wifi_timeout--;
+    // MQTT client setup needs no network, so it overlaps association
+    printf("[MAIN] Initializing Azure IoT Hub MQTT connection...\n");
+    printf("[MAIN] IoT Hub: %s\n", IOT_HUB_HOSTNAME);
+    printf("[MAIN] Device ID: %s\n", DEVICE_ID);
+    ret = azure_iot_mqtt_init();
+    if (ret != ESP_OK) {
+        printf("[MAIN] ERROR: Azure IoT Hub initialization failed (error: %d)\n", ret);
+        ESP_LOGE(TAG, "Azure IoT Hub initialization failed");
     }
     
-    if (!wifi_is_connected()) {
-        printf("[MAIN] ERROR: WiFi connection timeout!\n");
-        ESP_LOGE(TAG, "WiFi connection timeout");
-        return;
+    // Periodic telemetry runs in its own task; until MQTT is up it goes to the spool
+    ret = telemetry_start();
+    if (ret != ESP_OK) {
+        printf("[MAIN] WARNING: Telemetry failed to start (error: %d)\n", ret);
     }
     
-    printf("[MAIN] WiFi CONNECTED! IP obtained.\n");
-    ESP_LOGI(TAG, "WiFi connected! Initializing Azure IoT Hub connection...");
+    wait_for_phase(APP_EVENT_WIFI_CONNECTED, "WiFi");
     
-    // Get and print IP address
     esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
     if (netif) {
         esp_netif_ip_info_t ip_info;
@@ -72,79 +140,22 @@ extern "C" void app_main(void) {
         }
     }
     
-    // Start web server
-    printf("[MAIN] Starting web server...\n");
-    ret = web_server_start();
+    ret = azure_iot_mqtt_start();
     if (ret != ESP_OK) {
-        printf("[MAIN] WARNING: Web server failed to start (error: %d)\n", ret);
-        ESP_LOGW(TAG, "Web server failed to start");
-    } else {
-        printf("[MAIN] Web server started successfully\n");
-    }
-    
-    // Initialize Azure IoT Hub MQTT
-    printf("[MAIN] Initializing Azure IoT Hub MQTT connection...\n");
-    printf("[MAIN] IoT Hub: %s\n", IOT_HUB_HOSTNAME);
-    printf("[MAIN] Device ID: %s\n", DEVICE_ID);
-    ret = azure_iot_mqtt_init();
-    if (ret != ESP_OK) {
-        printf("[MAIN] ERROR: Azure IoT Hub initialization failed (error: %d)\n", ret);
-        ESP_LOGE(TAG, "Azure IoT Hub initialization failed");
-        return;
-    }
-    printf("[MAIN] Azure IoT Hub MQTT client initialized\n");
-    
-    // Wait for MQTT connection
-    printf("[MAIN] Waiting for Azure IoT Hub connection...\n");
-    ESP_LOGI(TAG, "Waiting for Azure IoT Hub connection...");
-    int mqtt_timeout = 30; // 30 seconds timeout
-    while (!azure_iot_is_connected() && mqtt_timeout > 0) {
-        printf("[MAIN] MQTT connecting... (%d seconds remaining)\n", mqtt_timeout);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        mqtt_timeout--;
-    }
-    
-    if (!azure_iot_is_connected()) {
-        printf("[MAIN] ERROR: Azure IoT Hub connection timeout!\n");
-        ESP_LOGE(TAG, "Azure IoT Hub connection timeout");
+        printf("[MAIN] ERROR: Azure IoT Hub connection could not start (error: %d)\n", ret);
+        ESP_LOGE(TAG, "Azure IoT Hub connection could not start");
+        app_events_print_boot_profile();
         return;
     }
     
+    wait_for_phase(APP_EVENT_MQTT_CONNECTED, "Azure IoT Hub");
     printf("[MAIN] Azure IoT Hub CONNECTED!\n");
-    printf("[MAIN] Starting main loop...\n");
-    ESP_LOGI(TAG, "Connected to Azure IoT Hub! Starting main loop...");
+    ESP_LOGI(TAG, "Connected to Azure IoT Hub");
+    app_events_print_boot_profile();
+    // Every task exists by now
+    task_topology_check();
+    metrics_init();
     
-    // Main loop: wait and process messages
-    // LED control is now handled via MQTT messages (ON/OFF commands)
-    while (1) {
-        // LED blinking disabled - LED is now controlled via MQTT messages
-        // gpio_set_level(LED_PIN, 1);
-        // vTaskDelay(1000 / portTICK_PERIOD_MS);
-        // gpio_set_level(LED_PIN, 0);
-        // vTaskDelay(1000 / portTICK_PERIOD_MS);
-        
-        // Telemetry sending disabled for now
-        // counter++;
-        // if (counter >= 5 && azure_iot_is_connected()) {
-        //     printf("[MAIN] Sending telemetry (counter: %d)...\n", counter);
-        //     // Create JSON telemetry message
-        //     cJSON *json = cJSON_CreateObject();
-        //     cJSON_AddNumberToObject(json, "led_state", gpio_get_level(LED_PIN));
-        //     cJSON_AddNumberToObject(json, "counter", counter);
-        //     cJSON_AddStringToObject(json, "device_id", DEVICE_ID);
-        //     
-        //     char *json_string = cJSON_Print(json);
-        //     if (json_string != NULL) {
-        //         printf("[MAIN] Telemetry JSON: %s\n", json_string);
-        //         azure_iot_send_telemetry(json_string);
-        //         free(json_string);
-        //     }
-        //     cJSON_Delete(json);
-        //     
-        //     counter = 0;
-        // }
-        
-        // Just wait and let MQTT event handler process messages
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
-}
\ No newline at end of file
+    // Everything from here on is event driven (MQTT, httpd and actuator tasks);
+    // returning ends the main task and frees its stack.
+}
@@ -0,0 +1,237 @@
+#include "metrics.h"
+#include "actuator.h"
+#include "azure_iot_mqtt.h"
+#include "command_parser.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "latency_trace.h"
+#include "outbox_pool.h"
+#include "task_topology.h"
+#include "telemetry_spool.h"
+#include "tls_transport.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "METRICS";
+
+// Label values, in enum order
+static const char* const source_labels[CMD_SOURCE_COUNT] = { "mqtt", "http", "local", "schedule", "ramp" };
+static const char* const parse_error_labels[CMD_PARSE_RESULT_COUNT] = {
+    "ok", "empty", "unknown_channel", "bad_state", "syntax",
+};
+
+// Besides the topology's own tasks, the system ones. Looked up by name once, in
+// metrics_init(); tasks that did not exist then are skipped.
+static const char* const system_tasks[] = { "sys_evt", "tiT", "wifi", "esp_timer" };
+
+#define STACK_TASK_COUNT (TASK_ROLE_COUNT + sizeof(system_tasks) / sizeof(system_tasks[0]))
+
+static TaskHandle_t stack_tasks[STACK_TASK_COUNT];
+static std::atomic<bool> stack_tasks_ready{false};
+
+typedef struct {
+    metrics_write_fn write;
+    void* ctx;
+    size_t len;
+    char buf[METRICS_CHUNK_SIZE];
+} emitter_t;
+
+static void flush(emitter_t* e) {
+    if (e->len > 0) {
+        e->write(e->buf, e->len, e->ctx);
+        e->len = 0;
+    }
+}
+
+static void emit(emitter_t* e, const char* fmt, ...) {
+    char line[METRICS_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n <= 0) {
+        return;
+    }
+    // A cut line would be a malformed sample: leave it out
+    if ((size_t)n >= sizeof(line)) {
+        ESP_LOGW(TAG, "Line of %d bytes dropped, METRICS_LINE_MAX is %d", n, METRICS_LINE_MAX);
+        return;
+    }
+    size_t len = (size_t)n;
+    if (e->len + len > sizeof(e->buf)) {
+        flush(e);
+    }
+    memcpy(e->buf + e->len, line, len);
+    e->len += len;
+}
+
+static void header(emitter_t* e, const char* name, const char* type, const char* help) {
+    emit(e, "# HELP picapica_%s %s\n# TYPE picapica_%s %s\n", name, help, name, type);
+}
+
+static void single(emitter_t* e, const char* name, const char* type, const char* help, long long value) {
+    header(e, name, type, help);
+    emit(e, "picapica_%s %lld\n", name, value);
+}
+
+// Microsecond bounds and sum as seconds, without floating-point printf. Prometheus
+// buckets are cumulative; buckets[count] holds everything above the last bound
+static void histogram(emitter_t* e, const char* name, const char* labels, const uint32_t* bounds_us,
+                      const uint32_t* buckets, int count, uint64_t sum_us) {
+    const char* sep = labels[0] ? "," : "";
+    uint64_t cumulative = 0;
+    for (int i = 0; i < count; i++) {
+        cumulative += buckets[i];
+        emit(e, "picapica_%s_bucket{%s%sle=\"%u.%06u\"} %llu\n", name, labels, sep, (unsigned)(bounds_us[i] / 1000000),
+             (unsigned)(bounds_us[i] % 1000000), (unsigned long long)cumulative);
+    }
+    cumulative += buckets[count];
+    emit(e, "picapica_%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)cumulative);
+    emit(e, "picapica_%s_sum%s%s%s %llu.%06u\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+         (unsigned long long)(sum_us / 1000000), (unsigned)(sum_us % 1000000));
+    emit(e, "picapica_%s_count%s%s%s %llu\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+         (unsigned long long)cumulative);
+}
+
+static void format_commands(emitter_t* e) {
+    actuator_stats_t act;
+    actuator_get_stats(&act);
+    header(e, "commands_total", "counter", "Commands applied to the LEDs, by source.");
+    for (int i = 0; i < CMD_SOURCE_COUNT; i++) {
+        emit(e, "picapica_commands_total{source=\"%s\"} %u\n", source_labels[i], act.applied_by_source[i]);
+    }
+    single(e, "commands_dropped_total", "counter", "Commands rejected because the actuator queue was full.",
+           act.dropped);
+    single(e, "commands_superseded_total", "counter", "Queued commands discarded by an all-off command.",
+           act.superseded);
+
+    cmd_parse_stats_t parse;
+    command_parse_get_stats(&parse);
+    header(e, "command_parse_errors_total", "counter", "Commands that did not parse, by reason.");
+    for (int i = CMD_PARSE_OK + 1; i < CMD_PARSE_RESULT_COUNT; i++) {
+        emit(e, "picapica_command_parse_errors_total{reason=\"%s\"} %u\n", parse_error_labels[i], parse.errors[i]);
+    }
+
+    header(e, "command_latency_seconds", "histogram", "Command enqueue to hardware write.");
+    histogram(e, "command_latency_seconds", "", ACTUATOR_LATENCY_BOUNDS_US, act.latency_buckets,
+              ACTUATOR_LATENCY_BUCKETS, act.total_latency_us);
+}
+
+static void format_trace(emitter_t* e) {
+    latency_trace_stats_t trace;
+    latency_trace_get_stats(&trace);
+    header(e, "c2d_latency_seconds", "histogram", "C2D command latency by stage, hub enqueue to hardware write.");
+    for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", latency_trace_stage_name((trace_stage_t)s));
+        histogram(e, "c2d_latency_seconds", labels, LATENCY_TRACE_BOUNDS_US, trace.buckets[s],
+                  LATENCY_TRACE_BUCKETS, trace.sum_us[s]);
+    }
+    single(e, "c2d_traced_total", "counter", "C2D commands followed to the hardware write.", trace.traced);
+    single(e, "c2d_untraced_total", "counter", "C2D commands not traced or never applied.", trace.untraced);
+}
+
+static void format_cloud(emitter_t* e) {
+    azure_iot_stats_t hub;
+    azure_iot_get_stats(&hub);
+    single(e, "mqtt_connected", "gauge", "1 while connected to the IoT hub.", azure_iot_is_connected() ? 1 : 0);
+    single(e, "mqtt_connects_total", "counter", "MQTT connections established.", hub.connects);
+    single(e, "mqtt_disconnects_total", "counter", "MQTT connections lost or closed.", hub.disconnects);
+    single(e, "mqtt_publish_acks_total", "counter", "QoS 1 publishes acknowledged by the hub.", hub.published);
+    single(e, "mqtt_token_renewals_total", "counter", "Reconnects with a renewed SAS token.", hub.token_renewals);
+    single(e, "mqtt_connect_last_ms", "gauge", "Last connect, TCP to CONNACK.", hub.last_connect_ms);
+
+    tls_transport_stats_t tls;
+    tls_transport_get_stats(&tls);
+    header(e, "tls_handshakes_total", "counter", "Successful TLS handshakes, by session.");
+    emit(e, "picapica_tls_handshakes_total{session=\"full\"} %u\n", tls.handshakes - tls.resumed);
+    emit(e, "picapica_tls_handshakes_total{session=\"resumed\"} %u\n", tls.resumed);
+    single(e, "tls_failures_total", "counter", "Failed TLS connections.", tls.failures);
+
+    outbox_pool_stats_t outbox;
+    outbox_pool_get_stats(&outbox);
+    single(e, "mqtt_outbox_bytes", "gauge", "Bytes waiting in the MQTT outbox.", outbox.bytes);
+    single(e, "mqtt_outbox_evicted_total", "counter", "Telemetry evicted from the full outbox.", outbox.evicted);
+
+    telemetry_spool_stats_t spool;
+    telemetry_spool_get_stats(&spool);
+    single(e, "spool_pending", "gauge", "Telemetry records in flash awaiting acknowledgement.", spool.pending);
+    single(e, "spool_dropped_total", "counter", "Spooled records overwritten before they were sent.",
+           spool.dropped);
+
+    direct_methods_stats_t methods;
+    direct_methods_get_stats(&methods);
+    single(e, "method_requests_total", "counter", "Direct method requests.", methods.requests);
+    single(e, "method_errors_total", "counter", "Direct methods answered with an error status.", methods.errors);
+
+    device_twin_stats_t twin;
+    device_twin_get_stats(&twin);
+    single(e, "twin_desired_patches_total", "counter", "Desired twin batches applied.", twin.desired_patches);
+    single(e, "twin_desired_errors_total", "counter", "Desired twin documents that did not parse.",
+           twin.desired_errors);
+}
+
+static const char* stack_task_name(size_t i) {
+    return i < TASK_ROLE_COUNT ? task_topology_spec((task_role_t)i)->name : system_tasks[i - TASK_ROLE_COUNT];
+}
+
+static void format_system(emitter_t* e) {
+    single(e, "uptime_seconds", "gauge", "Time since boot.", esp_timer_get_time() / 1000000);
+    single(e, "heap_free_bytes", "gauge", "Free heap.", esp_get_free_heap_size());
+    single(e, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.", esp_get_minimum_free_heap_size());
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        single(e, "wifi_rssi_dbm", "gauge", "Signal strength of the associated AP.", ap.rssi);
+    }
+
+    header(e, "task_stack_min_free_bytes", "gauge", "Stack high-water mark: least free stack seen, per task.");
+    if (stack_tasks_ready.load(std::memory_order_acquire)) {
+        for (size_t i = 0; i < STACK_TASK_COUNT; i++) {
+            if (stack_tasks[i] != NULL) {
+                emit(e, "picapica_task_stack_min_free_bytes{task=\"%s\"} %u\n", stack_task_name(i),
+                     (unsigned)uxTaskGetStackHighWaterMark(stack_tasks[i]));
+            }
+        }
+    }
+
+    header(e, "task_topology_info", "gauge", "Task topology profile in use.");
+    emit(e, "picapica_task_topology_info{profile=\"%s\"} 1\n", task_topology_profile_name());
+    task_topology_stats_t topology;
+    task_topology_get_stats(&topology);
+    header(e, "control_jitter_seconds", "histogram", "Wakeup jitter of a probe task at actuator priority and core.");
+    histogram(e, "control_jitter_seconds", "", TOPOLOGY_JITTER_BOUNDS_US, topology.buckets, TOPOLOGY_JITTER_BUCKETS,
+              topology.total_us);
+}
+
+// xTaskGetHandle() walks every task list with the scheduler suspended, so it
+// runs here once instead of on each scrape
+void metrics_init(void) {
+    if (stack_tasks_ready.load(std::memory_order_relaxed)) {
+        return;
+    }
+    for (size_t i = 0; i < STACK_TASK_COUNT; i++) {
+        stack_tasks[i] = xTaskGetHandle(stack_task_name(i));
+    }
+    stack_tasks_ready.store(true, std::memory_order_release);
+}
+
+void metrics_format(metrics_write_fn write, void* ctx) {
+    emitter_t e;
+    e.write = write;
+    e.ctx = ctx;
+    e.len = 0;
+    format_commands(&e);
+    format_trace(&e);
+    format_cloud(&e);
+    format_system(&e);
+    flush(&e);
+}
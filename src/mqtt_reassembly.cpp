@@ -0,0 +1,61 @@
+#include "mqtt_reassembly.h"
+#include <string.h>
+
+void mqtt_reassembly_reset(mqtt_reassembly_t* r) {
+    r->data_len = 0;
+    r->topic_len = 0;
+    r->total_len = 0;
+    r->msg_id = -1;
+    r->in_progress = false;
+    r->discarding = false;
+    r->topic_truncated = false;
+    r->data[0] = '\0';
+    r->topic[0] = '\0';
+}
+
+mqtt_reassembly_status_t mqtt_reassembly_feed(mqtt_reassembly_t* r, int msg_id,
+                                              const char* topic, size_t topic_len,
+                                              const char* data, size_t data_len,
+                                              size_t offset, size_t total_len) {
+    if (offset == 0) {
+        // First fragment of a new message; anything half-assembled is abandoned
+        mqtt_reassembly_reset(r);
+        r->msg_id = msg_id;
+        r->total_len = total_len;
+
+        if (total_len > MQTT_REASSEMBLY_MAX_MESSAGE) {
+            r->discarding = data_len < total_len;
+            return MQTT_REASSEMBLY_TOO_LARGE;
+        }
+
+        r->topic_truncated = topic_len > MQTT_REASSEMBLY_MAX_TOPIC;
+        r->topic_len = r->topic_truncated ? MQTT_REASSEMBLY_MAX_TOPIC : topic_len;
+        memcpy(r->topic, topic, r->topic_len);
+        r->topic[r->topic_len] = '\0';
+        r->in_progress = true;
+    } else if (r->discarding && msg_id == r->msg_id) {
+        // Tail of an oversized message, already reported by its first fragment: drop
+        if (offset + data_len >= r->total_len) {
+            r->discarding = false;
+        }
+        return MQTT_REASSEMBLY_PENDING;
+    } else if (!r->in_progress || msg_id != r->msg_id || offset != r->data_len || total_len != r->total_len) {
+        mqtt_reassembly_reset(r);
+        return MQTT_REASSEMBLY_OUT_OF_ORDER;
+    }
+
+    if (data_len > r->total_len - r->data_len) {
+        mqtt_reassembly_reset(r);
+        return MQTT_REASSEMBLY_OUT_OF_ORDER;
+    }
+    memcpy(r->data + r->data_len, data, data_len);
+    r->data_len += data_len;
+
+    if (r->data_len < r->total_len) {
+        return MQTT_REASSEMBLY_PENDING;
+    }
+
+    r->data[r->data_len] = '\0';
+    r->in_progress = false;
+    return MQTT_REASSEMBLY_COMPLETE;
+}
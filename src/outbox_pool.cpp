@@ -0,0 +1,326 @@
+#include "outbox_pool.h"
+extern "C" {
+#include "mqtt_outbox.h"   // esp-mqtt's private C interface
+}
+#include "binlog.h"
+#include <atomic>
+#include <string.h>
+
+static const char *TAG = "OUTBOX";
+
+#define OUTBOX_SLOTS        (OUTBOX_SMALL_SLOTS + OUTBOX_MEDIUM_SLOTS + OUTBOX_LARGE_SLOTS)
+#define MQTT_TYPE_PUBLISH   3
+
+struct outbox_item {
+    outbox_item* prev;
+    outbox_item* next;
+    uint8_t* buffer;               // this item's slot, fixed
+    size_t capacity;
+    size_t len;
+    int msg_id;
+    int msg_type;
+    int msg_qos;
+    outbox_tick_t tick;
+    pending_state_t pending;
+    bool telemetry;
+    bool in_use;
+};
+
+struct outbox_t {
+    outbox_item* head;             // oldest first
+    outbox_item* tail;
+    uint64_t bytes;
+};
+
+static uint8_t small_pool[OUTBOX_SMALL_SLOTS][OUTBOX_SMALL_SLOT];
+static uint8_t medium_pool[OUTBOX_MEDIUM_SLOTS][OUTBOX_MEDIUM_SLOT];
+static uint8_t large_pool[OUTBOX_LARGE_SLOTS][OUTBOX_LARGE_SLOT];
+
+// Item i owns slot i; smaller slots first, so a first-fit scan takes the smallest that fits
+static outbox_item items[OUTBOX_SLOTS];
+static outbox_t the_outbox;
+static bool outbox_in_use = false;
+
+static std::atomic<uint32_t> stat_items{0};
+static std::atomic<uint32_t> stat_bytes{0};
+static std::atomic<uint32_t> stat_peak_bytes{0};
+static std::atomic<uint32_t> stat_evicted{0};
+static std::atomic<uint32_t> stat_evicted_bytes{0};
+static std::atomic<uint32_t> stat_refused{0};
+
+// PUBLISH on devices/{id}/messages/events/: fixed header, remaining length
+// (1-4 bytes), topic length, topic
+static bool is_telemetry(const uint8_t* data, size_t len) {
+    static const char prefix[] = "devices/";
+    static const char events[] = "/messages/events/";
+    if (len < 2 || (data[0] >> 4) != MQTT_TYPE_PUBLISH) {
+        return false;
+    }
+    size_t i = 1;
+    while (i < len && i < 4 && (data[i] & 0x80)) {
+        i++;
+    }
+    i++;
+    if (i + 2 > len) {
+        return false;
+    }
+    size_t topic_len = (size_t)data[i] << 8 | data[i + 1];
+    const char* topic = (const char*)data + i + 2;
+    if (i + 2 + topic_len > len || topic_len < sizeof(prefix) - 1 ||
+        memcmp(topic, prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    for (size_t p = sizeof(prefix) - 1; p + sizeof(events) - 1 <= topic_len; p++) {
+        if (memcmp(topic + p, events, sizeof(events) - 1) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static outbox_item* claim_slot(size_t len) {
+    for (int i = 0; i < OUTBOX_SLOTS; i++) {
+        if (!items[i].in_use && items[i].capacity >= len) {
+            items[i].in_use = true;
+            return &items[i];
+        }
+    }
+    return NULL;
+}
+
+static void unlink_item(outbox_handle_t outbox, outbox_item* item) {
+    if (item->prev) {
+        item->prev->next = item->next;
+    } else {
+        outbox->head = item->next;
+    }
+    if (item->next) {
+        item->next->prev = item->prev;
+    } else {
+        outbox->tail = item->prev;
+    }
+    outbox->bytes -= item->len;
+    item->prev = NULL;
+    item->next = NULL;
+    item->in_use = false;
+    stat_items.fetch_sub(1, std::memory_order_relaxed);
+    stat_bytes.store((uint32_t)outbox->bytes, std::memory_order_relaxed);
+}
+
+static bool evict_oldest_telemetry(outbox_handle_t outbox) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        // A TRANSMITTED item is waiting for its PUBACK; dropping it would
+        // leave the spool's in-flight slot for that msg_id stuck
+        if (item->telemetry && item->pending != TRANSMITTED) {
+            BLOGW(TAG, "Outbox full, telemetry msg_id=%d (%d bytes) evicted", item->msg_id, (int)item->len);
+            stat_evicted.fetch_add(1, std::memory_order_relaxed);
+            stat_evicted_bytes.fetch_add((uint32_t)item->len, std::memory_order_relaxed);
+            unlink_item(outbox, item);
+            return true;
+        }
+    }
+    return false;
+}
+
+outbox_handle_t outbox_init(void) {
+    if (outbox_in_use) {
+        return NULL;   // one client, one pool
+    }
+    uint8_t* slots[OUTBOX_SLOTS];
+    size_t n = 0;
+    for (int i = 0; i < OUTBOX_SMALL_SLOTS; i++) {
+        items[n].capacity = OUTBOX_SMALL_SLOT;
+        slots[n++] = small_pool[i];
+    }
+    for (int i = 0; i < OUTBOX_MEDIUM_SLOTS; i++) {
+        items[n].capacity = OUTBOX_MEDIUM_SLOT;
+        slots[n++] = medium_pool[i];
+    }
+    for (int i = 0; i < OUTBOX_LARGE_SLOTS; i++) {
+        items[n].capacity = OUTBOX_LARGE_SLOT;
+        slots[n++] = large_pool[i];
+    }
+    for (int i = 0; i < OUTBOX_SLOTS; i++) {
+        items[i].buffer = slots[i];
+        items[i].in_use = false;
+    }
+    the_outbox = {};
+    outbox_in_use = true;
+    return &the_outbox;
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, outbox_tick_t tick) {
+    size_t len = (size_t)message->len + (size_t)message->remaining_len;
+    bool telemetry = is_telemetry(message->data, (size_t)message->len);
+
+    // Telemetry stays within the budget by pushing out older telemetry
+    if (telemetry) {
+        while (outbox->bytes + len > OUTBOX_BUDGET_BYTES && evict_oldest_telemetry(outbox)) {
+        }
+    }
+    outbox_item* item = NULL;
+    if (!telemetry || outbox->bytes + len <= OUTBOX_BUDGET_BYTES) {
+        item = claim_slot(len);
+        while (item == NULL && evict_oldest_telemetry(outbox)) {
+            item = claim_slot(len);
+        }
+    }
+    if (item == NULL) {
+        stat_refused.fetch_add(1, std::memory_order_relaxed);
+        BLOGW(TAG, "Outbox full, %d-byte message (type %d) refused", (int)len, message->msg_type);
+        return NULL;
+    }
+
+    memcpy(item->buffer, message->data, (size_t)message->len);
+    if (message->remaining_len > 0) {
+        memcpy(item->buffer + message->len, message->remaining_data, (size_t)message->remaining_len);
+    }
+    item->len = len;
+    item->msg_id = message->msg_id;
+    item->msg_type = message->msg_type;
+    item->msg_qos = message->msg_qos;
+    item->tick = tick;
+    item->pending = QUEUED;
+    item->telemetry = telemetry;
+    item->next = NULL;
+    item->prev = outbox->tail;
+    if (outbox->tail) {
+        outbox->tail->next = item;
+    } else {
+        outbox->head = item;
+    }
+    outbox->tail = item;
+    outbox->bytes += len;
+
+    stat_items.fetch_add(1, std::memory_order_relaxed);
+    stat_bytes.store((uint32_t)outbox->bytes, std::memory_order_relaxed);
+    if (outbox->bytes > stat_peak_bytes.load(std::memory_order_relaxed)) {
+        stat_peak_bytes.store((uint32_t)outbox->bytes, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        if (item->msg_id == msg_id) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, outbox_tick_t* tick) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        if (item->pending == pending) {
+            if (tick) {
+                *tick = item->tick;
+            }
+            return item;
+        }
+    }
+    return NULL;
+}
+
+uint8_t* outbox_item_get_data(outbox_item_handle_t item, size_t* len, uint16_t* msg_id, int* msg_type, int* qos) {
+    if (item == NULL) {
+        return NULL;
+    }
+    *len = item->len;
+    *msg_id = (uint16_t)item->msg_id;
+    *msg_type = item->msg_type;
+    *qos = item->msg_qos;
+    return item->buffer;
+}
+
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item_to_delete) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        if (item == item_to_delete) {
+            unlink_item(outbox, item);
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        if (item->msg_id == msg_id && item->msg_type == msg_type) {
+            unlink_item(outbox, item);
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;   // acknowledged after it was evicted
+}
+
+int outbox_delete_single_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout) {
+    for (outbox_item* item = outbox->head; item != NULL; item = item->next) {
+        if (current_tick - item->tick > timeout) {
+            int msg_id = item->msg_id;
+            unlink_item(outbox, item);
+            return msg_id;
+        }
+    }
+    return -1;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout) {
+    int deleted = 0;
+    outbox_item* item = outbox->head;
+    while (item != NULL) {
+        outbox_item* next = item->next;
+        if (current_tick - item->tick > timeout) {
+            unlink_item(outbox, item);
+            deleted++;
+        }
+        item = next;
+    }
+    return deleted;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending) {
+    outbox_item* item = outbox_get(outbox, msg_id);
+    if (item == NULL) {
+        return ESP_FAIL;
+    }
+    item->pending = pending;
+    return ESP_OK;
+}
+
+pending_state_t outbox_item_get_pending(outbox_item_handle_t item) {
+    return item ? item->pending : QUEUED;
+}
+
+esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, outbox_tick_t tick) {
+    outbox_item* item = outbox_get(outbox, msg_id);
+    if (item == NULL) {
+        return ESP_FAIL;
+    }
+    item->tick = tick;
+    return ESP_OK;
+}
+
+uint64_t outbox_get_size(outbox_handle_t outbox) {
+    return outbox->bytes;
+}
+
+void outbox_delete_all_items(outbox_handle_t outbox) {
+    while (outbox->head != NULL) {
+        unlink_item(outbox, outbox->head);
+    }
+}
+
+void outbox_destroy(outbox_handle_t outbox) {
+    outbox_delete_all_items(outbox);
+    outbox_in_use = false;
+}
+
+void outbox_pool_get_stats(outbox_pool_stats_t* stats) {
+    uint32_t items_held = stat_items.load(std::memory_order_relaxed);
+    stats->items = items_held;
+    stats->bytes = stat_bytes.load(std::memory_order_relaxed);
+    stats->peak_bytes = stat_peak_bytes.load(std::memory_order_relaxed);
+    stats->slots_free = OUTBOX_SLOTS - items_held;
+    stats->evicted = stat_evicted.load(std::memory_order_relaxed);
+    stats->evicted_bytes = stat_evicted_bytes.load(std::memory_order_relaxed);
+    stats->refused = stat_refused.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,346 @@
+#include "ramp.h"
+#include "actuator.h"
+#include "channel_lines.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "RAMP";
+
+// ---------------------------------------------------------------------------
+// Parsing and interpolation (no hardware, no RTOS)
+
+// DIGITS[ms|s|m|h] -> milliseconds; bare numbers are seconds
+static int parse_offset(const char* token, size_t len, uint32_t* offset_ms) {
+    const char* p = token;
+    const char* end = token + len;
+    uint64_t value = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 9) {
+        value = value * 10 + (uint64_t)(*p - '0');
+        p++;
+        digits++;
+    }
+    if (digits == 0) {
+        return -1;
+    }
+    size_t unit_len = (size_t)(end - p);
+    uint64_t scale;
+    if (unit_len == 0 || (unit_len == 1 && *p == 's')) {
+        scale = 1000;
+    } else if (unit_len == 2 && p[0] == 'm' && p[1] == 's') {
+        scale = 1;
+    } else if (unit_len == 1 && *p == 'm') {
+        scale = 60 * 1000;
+    } else if (unit_len == 1 && *p == 'h') {
+        scale = 3600 * 1000;
+    } else {
+        return -1;
+    }
+    value *= scale;
+    if (value > RAMP_MAX_MS) {
+        return -1;
+    }
+    *offset_ms = (uint32_t)value;
+    return 0;
+}
+
+static void track_clear(void* ctx, int channel) {
+    ((ramp_track_t*)ctx)[channel].count = 0;
+}
+
+static bool track_insert(void* ctx, int channel, uint32_t offset_ms, uint8_t level) {
+    ramp_track_t* track = &((ramp_track_t*)ctx)[channel];
+    return channel_lines_insert(track->key, &track->count, RAMP_MAX_KEYFRAMES, &ramp_keyframe_t::offset_ms,
+                                offset_ms, level);
+}
+
+static_assert((int)RAMP_PARSE_BAD_OFFSET == (int)CHANNEL_LINES_BAD_KEY &&
+                  (int)RAMP_PARSE_SYNTAX == (int)CHANNEL_LINES_SYNTAX,
+              "ramp_parse_result_t follows channel_lines_result_t");
+
+ramp_parse_result_t ramp_parse(const char* data, size_t len, ramp_track_t* tracks, uint32_t* mask,
+                               cmd_token_t* error_token) {
+    const channel_lines_ops_t ops = { parse_offset, track_clear, track_insert, tracks };
+    return (ramp_parse_result_t)channel_lines_parse(data, len, &ops, mask, error_token);
+}
+
+const char* ramp_parse_result_str(ramp_parse_result_t result) {
+    switch (result) {
+        case RAMP_PARSE_OK:              return "OK";
+        case RAMP_PARSE_EMPTY:           return "Rampa vacia";
+        case RAMP_PARSE_UNKNOWN_CHANNEL: return "Canal desconocido";
+        case RAMP_PARSE_BAD_OFFSET:      return "Tiempo invalido (N, Nms, Ns, Nm o Nh)";
+        case RAMP_PARSE_BAD_STATE:       return "Estado invalido";
+        case RAMP_PARSE_TOO_MANY:        return "Demasiados puntos para un canal";
+        case RAMP_PARSE_SYNTAX:          return "Error de sintaxis";
+        default:                         return "?";
+    }
+}
+
+uint32_t ramp_level_q16(const ramp_track_t* track, uint32_t offset_ms) {
+    if (track->count == 0) {
+        return 0;
+    }
+    if (offset_ms <= track->key[0].offset_ms) {
+        return (uint32_t)track->key[0].level << 16;
+    }
+    for (int i = 1; i < track->count; i++) {
+        const ramp_keyframe_t* k0 = &track->key[i - 1];
+        const ramp_keyframe_t* k1 = &track->key[i];
+        if (offset_ms < k1->offset_ms) {
+            int64_t l0 = (int64_t)k0->level << 16;
+            int64_t l1 = (int64_t)k1->level << 16;
+            return (uint32_t)(l0 + (l1 - l0) * (int64_t)(offset_ms - k0->offset_ms) /
+                                       (int64_t)(k1->offset_ms - k0->offset_ms));
+        }
+    }
+    return (uint32_t)track->key[track->count - 1].level << 16;
+}
+
+uint32_t ramp_chunk_end(const ramp_track_t* track, uint32_t offset_ms) {
+    if (track->count == 0 || offset_ms >= track->key[track->count - 1].offset_ms) {
+        return UINT32_MAX;
+    }
+    int i = 0;
+    while (track->key[i].offset_ms <= offset_ms) {
+        i++;
+    }
+    if (i == 0) {
+        return track->key[0].offset_ms;   // before the first keyframe: hold
+    }
+    const ramp_keyframe_t* k0 = &track->key[i - 1];
+    const ramp_keyframe_t* k1 = &track->key[i];
+    uint32_t levels = k1->level > k0->level ? k1->level - k0->level : k0->level - k1->level;
+    if (levels == 0) {
+        return k1->offset_ms;   // flat: one wakeup at the end of the segment
+    }
+    uint64_t chunk = (uint64_t)RAMP_CHUNK_LEVELS * (k1->offset_ms - k0->offset_ms) / levels;
+    if (chunk < RAMP_MIN_CHUNK_MS) {
+        chunk = RAMP_MIN_CHUNK_MS;
+    }
+    uint64_t chunk_end = (uint64_t)offset_ms + chunk;
+    return chunk_end < k1->offset_ms ? (uint32_t)chunk_end : k1->offset_ms;
+}
+
+// ---------------------------------------------------------------------------
+// Runtime
+
+typedef struct {
+    ramp_track_t track;
+    int64_t start_us;          // esp_timer time of offset 0
+    int64_t next_us;           // end of the fade in progress
+    uint8_t target;            // level the last fade was sent to
+} ramp_channel_t;
+
+static ramp_channel_t channels[LED_CHANNEL_COUNT];
+static SemaphoreHandle_t ramp_lock = NULL;
+static esp_timer_handle_t ramp_timer = NULL;
+static esp_timer_handle_t cancel_timer = NULL;   // fires at once; same callback as ramp_timer
+
+static ramp_stats_t stats;
+// Written under ramp_lock; read without it by the listener on every command
+static std::atomic<uint32_t> active_mask{0};
+// Set by the listener, applied by the timer callback under ramp_lock. The
+// enqueue time (low 32 bits, in us) of the latest command per channel decides
+// whether it came before or after the ramp started.
+static std::atomic<uint32_t> cancel_mask{0};
+static std::atomic<uint32_t> cancel_enqueue_us[LED_CHANNEL_COUNT];
+
+static uint8_t q16_to_level(uint32_t q16) {
+    uint32_t level = (q16 + 0x8000) >> 16;
+    return level > LED_LEVEL_MAX ? LED_LEVEL_MAX : (uint8_t)level;
+}
+
+// Caller holds ramp_lock. Hands the channel's next chunk to the hardware.
+static void service_locked(int channel, int64_t now_us) {
+    ramp_channel_t* ch = &channels[channel];
+    uint32_t offset_ms = (uint32_t)((now_us - ch->start_us) / 1000);
+    uint32_t chunk_end = ramp_chunk_end(&ch->track, offset_ms);
+    if (chunk_end == UINT32_MAX) {
+        active_mask.fetch_and(~(1u << channel));
+        stats.finished++;
+        BLOGI(TAG, "Rampa de %s terminada en nivel %d", LED_CHANNELS[channel].name, ch->target);
+        return;
+    }
+
+    uint8_t target = q16_to_level(ramp_level_q16(&ch->track, chunk_end));
+    if (target != ch->target) {
+        led_batch_t batch = {};
+        batch.mask = 1u << channel;
+        batch.level[channel] = target;
+        if (actuator_submit_fade(&batch, chunk_end - offset_ms, CMD_SOURCE_RAMP) == ESP_OK) {
+            ch->target = target;
+            stats.fades++;
+        } else {
+            BLOGE(TAG, "Actuator queue full, ramp step dropped");
+        }
+    }
+    ch->next_us = ch->start_us + (int64_t)chunk_end * 1000;
+}
+
+// Caller holds ramp_lock. One timer for every channel, armed for the earliest chunk end.
+static void arm_locked(int64_t now_us) {
+    esp_timer_stop(ramp_timer);
+    int64_t next_us = INT64_MAX;
+    uint32_t active = active_mask.load();
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if ((active & (1u << i)) && channels[i].next_us < next_us) {
+            next_us = channels[i].next_us;
+        }
+    }
+    if (next_us == INT64_MAX) {
+        return;   // idle: no wakeups at all
+    }
+    int64_t delay_us = next_us - now_us;
+    esp_timer_start_once(ramp_timer, delay_us > 0 ? (uint64_t)delay_us : 1);
+}
+
+// Caller holds ramp_lock
+static void service_due_locked(int64_t now_us) {
+    int64_t horizon_us = now_us + RAMP_COALESCE_MS * 1000;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if ((active_mask.load() & (1u << i)) && channels[i].next_us <= horizon_us) {
+            service_locked(i, now_us);
+        }
+    }
+    arm_locked(now_us);
+}
+
+// Caller holds ramp_lock. Ends the ramps the listener asked to cancel.
+static void apply_cancels_locked(void) {
+    uint32_t pending = cancel_mask.exchange(0);
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        // Commands queued before the ramp started do not end it
+        if ((pending & active_mask.load() & bit) &&
+            (int32_t)(cancel_enqueue_us[i].load() - (uint32_t)channels[i].start_us) >= 0) {
+            active_mask.fetch_and(~bit);
+            stats.cancelled++;
+        }
+    }
+}
+
+// esp_timer task, for both timers
+static void ramp_timer_cb(void* arg) {
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    apply_cancels_locked();
+    if (arg == NULL) {
+        stats.wakeups++;
+    }
+    service_due_locked(esp_timer_get_time());
+    xSemaphoreGive(ramp_lock);
+}
+
+// Actuator listener: a command from anywhere else takes the channel over.
+// Runs on the actuator task, so it only flags the channels and wakes the
+// timer callback, which ends the ramps under ramp_lock.
+static void ramp_listener(const cmd_record_t* record) {
+    uint32_t channel_mask = record->batch.mask & active_mask.load();
+    if (record->source == CMD_SOURCE_RAMP || channel_mask == 0) {
+        return;
+    }
+    uint32_t enqueue_us = (uint32_t)record->enqueue_us;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if (!(channel_mask & (1u << i))) {
+            continue;
+        }
+        // Keep the latest: the safety lane can overtake older commands
+        uint32_t seen = cancel_enqueue_us[i].load();
+        while ((int32_t)(enqueue_us - seen) > 0 && !cancel_enqueue_us[i].compare_exchange_weak(seen, enqueue_us)) {
+        }
+    }
+    cancel_mask.fetch_or(channel_mask);
+    // Already pending if it fails: that run picks this mask up as well
+    esp_timer_start_once(cancel_timer, 0);
+}
+
+esp_err_t ramp_start(void) {
+    ramp_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timer_args = {
+        .callback = ramp_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ramp",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create_args_t cancel_args = timer_args;
+    cancel_args.arg = &cancel_timer;
+    cancel_args.name = "ramp_cancel";
+    if (ramp_lock == NULL || esp_timer_create(&timer_args, &ramp_timer) != ESP_OK ||
+        esp_timer_create(&cancel_args, &cancel_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create ramp engine");
+        return ESP_ERR_NO_MEM;
+    }
+    return actuator_add_listener(ramp_listener);
+}
+
+esp_err_t ramp_set(const char* data, size_t len) {
+    static ramp_track_t parsed[LED_CHANNEL_COUNT];
+    uint32_t mask;
+    cmd_token_t bad_token;
+
+    memset(parsed, 0, sizeof(parsed));
+    ramp_parse_result_t result = ramp_parse(data, len, parsed, &mask, &bad_token);
+    if (result != RAMP_PARSE_OK) {
+        BLOGW(TAG, "%s at byte %d of %d", ramp_parse_result_str(result), (int)(bad_token.ptr - data), (int)len);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Channels with a keyframe at 0 jump there first, together
+    led_batch_t start = {};
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    int64_t now_us = esp_timer_get_time();
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        if (!(mask & bit)) {
+            continue;
+        }
+        ramp_channel_t* ch = &channels[i];
+        ch->track = parsed[i];
+        if (ch->track.count == 0) {
+            active_mask.fetch_and(~bit);   // the fade in progress still completes
+            continue;
+        }
+        if (ch->track.key[0].offset_ms > 0) {
+            // Implicit starting point at the current level (a running fade's target)
+            memmove(&ch->track.key[1], &ch->track.key[0], ch->track.count * sizeof(ramp_keyframe_t));
+            ch->track.key[0].offset_ms = 0;
+            ch->track.key[0].level = led_channel_get_level(i);
+            ch->track.count++;
+        } else {
+            start.mask |= bit;
+            start.level[i] = ch->track.key[0].level;
+        }
+        ch->start_us = now_us;
+        ch->next_us = now_us;
+        ch->target = ch->track.key[0].level;
+        active_mask.fetch_or(bit);
+    }
+    if (start.mask != 0 && actuator_submit(&start, CMD_SOURCE_RAMP) != ESP_OK) {
+        BLOGE(TAG, "Actuator queue full, ramp start dropped");
+    }
+    stats.uploads++;
+    service_due_locked(now_us);
+    xSemaphoreGive(ramp_lock);
+
+    BLOGI(TAG, "Ramp started, channel mask 0x%x", (unsigned)mask);
+    return ESP_OK;
+}
+
+void ramp_get_stats(ramp_stats_t* out) {
+    if (ramp_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(ramp_lock, portMAX_DELAY);
+    *out = stats;
+    out->active_mask = active_mask.load();
+    xSemaphoreGive(ramp_lock);
+}
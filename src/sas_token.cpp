@@ -0,0 +1,108 @@
+#include "sas_token.h"
+#include "esp_log.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/md.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SAS";
+
+// RFC 3986 percent-encoding: everything but unreserved characters. Returns
+// the encoded length, or -1 if it does not fit.
+static int url_encode(const char* in, size_t len, char* out, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)in[i];
+        bool plain = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                     c == '-' || c == '_' || c == '.' || c == '~';
+        if (n + (plain ? 1 : 3) >= size) {
+            return -1;
+        }
+        if (plain) {
+            out[n++] = (char)c;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[c >> 4];
+            out[n++] = hex[c & 0x0f];
+        }
+    }
+    out[n] = '\0';
+    return (int)n;
+}
+
+esp_err_t sas_token_build(const char* resource_uri, const uint8_t* key, size_t key_len, uint32_t expiry,
+                          char* out, size_t size) {
+    char resource[128];
+    int resource_len = url_encode(resource_uri, strlen(resource_uri), resource, sizeof(resource));
+    if (resource_len < 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // String to sign: "{encoded resource}\n{expiry}"
+    char to_sign[sizeof(resource) + 12];
+    int sign_len = snprintf(to_sign, sizeof(to_sign), "%s\n%u", resource, (unsigned)expiry);
+
+    uint8_t mac[32];
+    const mbedtls_md_info_t* sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (sha256 == NULL ||
+        mbedtls_md_hmac(sha256, key, key_len, (const unsigned char*)to_sign, (size_t)sign_len, mac) != 0) {
+        ESP_LOGE(TAG, "HMAC-SHA256 failed");
+        return ESP_FAIL;
+    }
+
+    unsigned char signature[48];   // base64 of 32 bytes is 44
+    size_t signature_len = 0;
+    if (mbedtls_base64_encode(signature, sizeof(signature), &signature_len, mac, sizeof(mac)) != 0) {
+        return ESP_FAIL;
+    }
+    char encoded_signature[3 * sizeof(signature)];
+    if (url_encode((const char*)signature, signature_len, encoded_signature, sizeof(encoded_signature)) < 0) {
+        return ESP_FAIL;
+    }
+
+    int n = snprintf(out, size, "SharedAccessSignature sr=%s&sig=%s&se=%u", resource, encoded_signature,
+                     (unsigned)expiry);
+    return (n > 0 && (size_t)n < size) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t sas_token_load_key(uint8_t* key, size_t* key_len) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SAS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t len = SAS_KEY_MAX;
+    err = nvs_get_blob(handle, SAS_KEY_NVS_KEY, key, &len);
+    nvs_close(handle);
+    if (err == ESP_OK && len == 0) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (err == ESP_OK) {
+        *key_len = len;
+    }
+    return err;
+}
+
+esp_err_t sas_token_provision_key(const char* key_base64) {
+    uint8_t key[SAS_KEY_MAX];
+    size_t len = 0;
+    if (mbedtls_base64_decode(key, sizeof(key), &len, (const unsigned char*)key_base64, strlen(key_base64)) != 0 ||
+        len == 0) {
+        ESP_LOGE(TAG, "Device key is not valid base64 (max %d bytes)", SAS_KEY_MAX);
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SAS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, SAS_KEY_NVS_KEY, key, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    memset(key, 0, sizeof(key));
+    return err;
+}
@@ -0,0 +1,392 @@
+#include "schedule.h"
+#include "actuator.h"
+#include "channel_lines.h"
+#include "led_channels.h"
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const char *TAG = "SCHEDULE";
+
+#define SCHEDULE_NAMESPACE "schedule"      // one blob per channel, keyed by channel name
+
+// An edge firing further than this from its time means the clock jumped
+// under the timer: re-apply everything instead of just the edge
+#define SCHEDULE_RESYNC_MS 1000
+
+// ---------------------------------------------------------------------------
+// Parsing and table lookups (no hardware, no RTOS)
+
+// Up to max_digits decimal digits at *p. Returns -1 if there are none.
+static int parse_number(const char** p, const char* end, int max_digits) {
+    int value = 0;
+    int digits = 0;
+    while (*p < end && digits < max_digits && **p >= '0' && **p <= '9') {
+        value = value * 10 + (**p - '0');
+        (*p)++;
+        digits++;
+    }
+    return digits > 0 ? value : -1;
+}
+
+// HH:MM[:SS[.mmm]] -> milliseconds since midnight
+static int parse_time(const char* token, size_t len, uint32_t* time_ms) {
+    const char* p = token;
+    const char* end = token + len;
+    int h = parse_number(&p, end, 2);
+    if (h < 0 || h > 23 || p >= end || *p++ != ':') {
+        return -1;
+    }
+    int m = parse_number(&p, end, 2);
+    if (m < 0 || m > 59) {
+        return -1;
+    }
+    int s = 0;
+    int ms = 0;
+    if (p < end && *p == ':') {
+        p++;
+        s = parse_number(&p, end, 2);
+        if (s < 0 || s > 59) {
+            return -1;
+        }
+        if (p < end && *p == '.') {
+            p++;
+            const char* frac = p;
+            ms = parse_number(&p, end, 3);
+            if (ms < 0) {
+                return -1;
+            }
+            for (long digits = p - frac; digits < 3; digits++) {
+                ms *= 10;   // ".5" is 500 ms
+            }
+        }
+    }
+    if (p != end) {
+        return -1;
+    }
+    *time_ms = (uint32_t)(((h * 60 + m) * 60 + s) * 1000 + ms);
+    return 0;
+}
+
+static void table_clear(void* ctx, int channel) {
+    ((schedule_table_t*)ctx)[channel].count = 0;
+}
+
+static bool table_insert(void* ctx, int channel, uint32_t time_ms, uint8_t level) {
+    schedule_table_t* table = &((schedule_table_t*)ctx)[channel];
+    return channel_lines_insert(table->entry, &table->count, SCHEDULE_MAX_ENTRIES, &schedule_entry_t::time_ms,
+                                time_ms, level);
+}
+
+static_assert((int)SCHEDULE_PARSE_BAD_TIME == (int)CHANNEL_LINES_BAD_KEY &&
+                  (int)SCHEDULE_PARSE_SYNTAX == (int)CHANNEL_LINES_SYNTAX,
+              "schedule_parse_result_t follows channel_lines_result_t");
+
+schedule_parse_result_t schedule_parse(const char* data, size_t len, schedule_table_t* tables,
+                                       uint32_t* mask, cmd_token_t* error_token) {
+    const channel_lines_ops_t ops = { parse_time, table_clear, table_insert, tables };
+    return (schedule_parse_result_t)channel_lines_parse(data, len, &ops, mask, error_token);
+}
+
+const char* schedule_parse_result_str(schedule_parse_result_t result) {
+    switch (result) {
+        case SCHEDULE_PARSE_OK:              return "OK";
+        case SCHEDULE_PARSE_EMPTY:           return "Horario vacio";
+        case SCHEDULE_PARSE_UNKNOWN_CHANNEL: return "Canal desconocido";
+        case SCHEDULE_PARSE_BAD_TIME:        return "Hora invalida (HH:MM[:SS[.mmm]])";
+        case SCHEDULE_PARSE_BAD_STATE:       return "Estado invalido";
+        case SCHEDULE_PARSE_TOO_MANY:        return "Demasiados cambios para un canal";
+        case SCHEDULE_PARSE_SYNTAX:          return "Error de sintaxis";
+        default:                             return "?";
+    }
+}
+
+int schedule_level_at(const schedule_table_t* table, uint32_t time_ms) {
+    if (table->count == 0) {
+        return -1;
+    }
+    int level = table->entry[table->count - 1].level;   // yesterday's last edge
+    for (int i = 0; i < table->count && table->entry[i].time_ms <= time_ms; i++) {
+        level = table->entry[i].level;
+    }
+    return level;
+}
+
+uint32_t schedule_ms_until_next(const schedule_table_t* table, uint32_t time_ms) {
+    if (table->count == 0) {
+        return UINT32_MAX;
+    }
+    for (int i = 0; i < table->count; i++) {
+        if (table->entry[i].time_ms > time_ms) {
+            return table->entry[i].time_ms - time_ms;
+        }
+    }
+    return SCHEDULE_DAY_MS - time_ms + table->entry[0].time_ms;
+}
+
+// ---------------------------------------------------------------------------
+// Runtime
+
+static schedule_table_t tables[LED_CHANNEL_COUNT];
+static SemaphoreHandle_t schedule_lock = NULL;
+static esp_timer_handle_t edge_timer = NULL;
+static bool time_valid = false;
+static uint32_t armed_edge_ms = 0;          // time of day the edge timer is armed for
+
+static schedule_stats_t stats;
+
+static uint32_t local_time_of_day_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    time_t seconds = tv.tv_sec;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    return (uint32_t)((local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec) * 1000 + tv.tv_usec / 1000);
+}
+
+// Caller holds schedule_lock. Arms the timer for the first edge after time_ms.
+static void arm_next_locked(uint32_t now_ms, uint32_t after_ms) {
+    esp_timer_stop(edge_timer);
+    uint32_t wait = UINT32_MAX;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        uint32_t w = schedule_ms_until_next(&tables[i], after_ms);
+        wait = w < wait ? w : wait;
+    }
+    if (wait == UINT32_MAX) {
+        return;   // nothing scheduled
+    }
+    armed_edge_ms = (after_ms + wait) % SCHEDULE_DAY_MS;
+    // From now, not from after_ms: the two differ when the timer fired early or late.
+    // A late wakeup can leave the next edge already behind now; up to
+    // SCHEDULE_RESYNC_MS it is due right away instead of a day later.
+    uint32_t delay_ms = (armed_edge_ms + SCHEDULE_DAY_MS - now_ms) % SCHEDULE_DAY_MS;
+    if (delay_ms > SCHEDULE_DAY_MS - SCHEDULE_RESYNC_MS) {
+        delay_ms = 0;
+    }
+    esp_timer_start_once(edge_timer, (uint64_t)delay_ms * 1000);
+}
+
+// Caller holds schedule_lock. Levels of every scheduled channel in effect at time_ms.
+static void levels_at_locked(uint32_t time_ms, led_batch_t* batch) {
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        int level = schedule_level_at(&tables[i], time_ms);
+        if (level >= 0) {
+            batch->mask |= 1u << i;
+            batch->level[i] = (uint8_t)level;
+        }
+    }
+}
+
+static void submit(const led_batch_t* batch) {
+    if (batch->mask != 0 && actuator_submit(batch, CMD_SOURCE_SCHEDULE) != ESP_OK) {
+        BLOGE(TAG, "Actuator queue full, scheduled change dropped");
+    }
+}
+
+// esp_timer task
+static void edge_timer_cb(void* arg) {
+    led_batch_t batch = {};
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    uint32_t now_ms = local_time_of_day_ms();
+    uint32_t edge_ms = armed_edge_ms;
+
+    // Signed distance on the 24 h circle, so 23:59:59.999 vs 00:00 is -1 ms
+    int32_t error_ms = (int32_t)((now_ms + SCHEDULE_DAY_MS - edge_ms) % SCHEDULE_DAY_MS);
+    if (error_ms > (int32_t)(SCHEDULE_DAY_MS / 2)) {
+        error_ms -= (int32_t)SCHEDULE_DAY_MS;
+    }
+
+    if (error_ms > SCHEDULE_RESYNC_MS || error_ms < -SCHEDULE_RESYNC_MS) {
+        // DST change or a clock step: catch up with whatever is in effect now
+        levels_at_locked(now_ms, &batch);
+        arm_next_locked(now_ms, now_ms);
+        stats.resyncs++;
+    } else {
+        for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+            const schedule_table_t* table = &tables[i];
+            for (int e = 0; e < table->count; e++) {
+                if (table->entry[e].time_ms == edge_ms) {
+                    batch.mask |= 1u << i;
+                    batch.level[i] = table->entry[e].level;
+                }
+            }
+        }
+        arm_next_locked(now_ms, edge_ms);
+        stats.edges++;
+        stats.last_error_ms = error_ms;
+        int32_t magnitude = error_ms < 0 ? -error_ms : error_ms;
+        if (magnitude > stats.max_error_ms) {
+            stats.max_error_ms = magnitude;
+        }
+    }
+    xSemaphoreGive(schedule_lock);
+
+    submit(&batch);
+    BLOGD(TAG, "Edge %u ms applied, error %d ms", (unsigned)edge_ms, (int)error_ms);
+}
+
+// Caller holds schedule_lock
+static void apply_now_locked(led_batch_t* batch) {
+    if (!time_valid) {
+        return;   // tables wait for the clock
+    }
+    uint32_t now_ms = local_time_of_day_ms();
+    levels_at_locked(now_ms, batch);
+    arm_next_locked(now_ms, now_ms);
+}
+
+static void channel_key(int channel, char* key, size_t size) {
+    // NVS keys are at most 15 characters
+    snprintf(key, size, "%.15s", LED_CHANNELS[channel].name);
+}
+
+esp_err_t schedule_start(void) {
+    schedule_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t timer_args = {
+        .callback = edge_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "schedule",
+        .skip_unhandled_events = true,
+    };
+    if (schedule_lock == NULL || esp_timer_create(&timer_args, &edge_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create scheduler");
+        return ESP_ERR_NO_MEM;
+    }
+
+    nvs_handle_t handle;
+    if (nvs_open(SCHEDULE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return ESP_OK;   // nothing uploaded yet
+    }
+    int edges = 0;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        char key[16];
+        channel_key(i, key, sizeof(key));
+        size_t len = sizeof(tables[i]);
+        if (nvs_get_blob(handle, key, &tables[i], &len) != ESP_OK || len != sizeof(tables[i]) ||
+            tables[i].count > SCHEDULE_MAX_ENTRIES) {
+            tables[i].count = 0;
+            continue;
+        }
+        stats.scheduled_mask |= tables[i].count ? 1u << i : 0;
+        edges += tables[i].count;
+    }
+    nvs_close(handle);
+    printf("[SCHEDULE] %d cambios diarios cargados, esperando la hora\n", edges);
+    return ESP_OK;
+}
+
+// Writes the changed channels' tables to NVS. Called without schedule_lock:
+// flash writes stall for milliseconds and the edge timer must not wait on them.
+static esp_err_t save_tables(const schedule_table_t* saved, uint32_t changed) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SCHEDULE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < LED_CHANNEL_COUNT && err == ESP_OK; i++) {
+        if (!(changed & (1u << i))) {
+            continue;
+        }
+        char key[16];
+        channel_key(i, key, sizeof(key));
+        if (saved[i].count == 0) {
+            err = nvs_erase_key(handle, key);
+            err = err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+        } else {
+            err = nvs_set_blob(handle, key, &saved[i], sizeof(saved[i]));
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+// Called from the MQTT task only: `parsed` is reused between uploads
+esp_err_t schedule_set(const char* data, size_t len) {
+    // Parsed into a copy: a bad upload leaves the running tables untouched
+    static schedule_table_t parsed[LED_CHANNEL_COUNT];
+    uint32_t mask;
+    cmd_token_t bad_token;
+
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    memcpy(parsed, tables, sizeof(parsed));
+    schedule_parse_result_t result = schedule_parse(data, len, parsed, &mask, &bad_token);
+    if (result != SCHEDULE_PARSE_OK) {
+        xSemaphoreGive(schedule_lock);
+        BLOGW(TAG, "%s at byte %d of %d", schedule_parse_result_str(result),
+              (int)(bad_token.ptr - data), (int)len);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t changed = 0;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        // Unused entries zeroed so equal tables compare equal next time
+        memset(&parsed[i].entry[parsed[i].count], 0,
+               (SCHEDULE_MAX_ENTRIES - parsed[i].count) * sizeof(schedule_entry_t));
+        if (memcmp(&parsed[i], &tables[i], sizeof(parsed[i])) != 0) {
+            changed |= 1u << i;   // only channels that changed cost a flash write
+        }
+    }
+
+    memcpy(tables, parsed, sizeof(tables));
+    stats.uploads++;
+    stats.scheduled_mask = 0;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        stats.scheduled_mask |= tables[i].count ? 1u << i : 0;
+    }
+    led_batch_t batch = {};
+    apply_now_locked(&batch);
+    xSemaphoreGive(schedule_lock);
+
+    submit(&batch);
+
+    esp_err_t err = changed ? save_tables(parsed, changed) : ESP_OK;
+    if (err != ESP_OK) {
+        // Still run the new tables; they are lost on the next reboot
+        BLOGW(TAG, "Failed to save schedule: 0x%x", err);
+    }
+    BLOGI(TAG, "Schedule updated, channel mask 0x%x", (unsigned)mask);
+    return ESP_OK;
+}
+
+void schedule_on_time_set(void) {
+    if (schedule_lock == NULL) {
+        return;
+    }
+    led_batch_t batch = {};
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    if (!time_valid) {
+        // First time: bring the channels to where the schedule says they are now
+        time_valid = true;
+        apply_now_locked(&batch);
+    } else {
+        // Periodic resync: only re-arm, so manual changes survive until the next edge
+        uint32_t now_ms = local_time_of_day_ms();
+        arm_next_locked(now_ms, now_ms);
+    }
+    xSemaphoreGive(schedule_lock);
+    submit(&batch);
+}
+
+void schedule_get_stats(schedule_stats_t* out) {
+    if (schedule_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(schedule_lock);
+}
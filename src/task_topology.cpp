@@ -0,0 +1,139 @@
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <atomic>
+#include <stdio.h>
+
+static const char *TAG = "TOPOLOGY";
+
+#if TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SPLIT && !CONFIG_FREERTOS_UNICORE
+#define NETWORK TOPOLOGY_NETWORK_CORE
+#define CONTROL TOPOLOGY_CONTROL_CORE
+#elif TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SPLIT || TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SHARED
+#define NETWORK tskNO_AFFINITY
+#define CONTROL tskNO_AFFINITY
+#else
+#error "TASK_TOPOLOGY_PROFILE must be TASK_TOPOLOGY_SHARED or TASK_TOPOLOGY_SPLIT"
+#endif
+
+// esp-mqtt places its task from sdkconfig alone; each profile has its own
+// sdkconfig (sdkconfig.esp32doit-devkit-v1 and sdkconfig.esp32doit-devkit-v1-shared)
+#if defined(ESP_PLATFORM) && TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SPLIT && !CONFIG_FREERTOS_UNICORE && \
+    !(CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED && CONFIG_MQTT_USE_CORE_0)
+#warning "The split topology expects the MQTT task on core 0: set MQTT_TASK_CORE_SELECTION to core 0 in menuconfig"
+#endif
+#if defined(ESP_PLATFORM) && TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SHARED && CONFIG_MQTT_TASK_CORE_SELECTION_ENABLED
+#warning "The shared topology expects the MQTT task unpinned: disable MQTT_TASK_CORE_SELECTION_ENABLED in menuconfig"
+#endif
+
+// In task_role_t order. Priorities: the actuator above the MQTT and httpd tasks
+// (5), everything that only moves data in the background below them.
+static const task_spec_t specs[TASK_ROLE_COUNT] = {
+    { "actuator",  4096, 6, CONTROL },
+    { "jitter",    2048, 6, CONTROL },   // same priority and core as the actuator
+    { "mqtt_task", 6144, 5, NETWORK },
+    { "httpd",     4096, 5, NETWORK },
+    { "methods",   3072, 5, NETWORK },   // same as the MQTT task
+    { "twin",      3072, 2, NETWORK },
+    { "sas_renew", 3072, 3, NETWORK },
+    { "telemetry", 3072, 2, NETWORK },
+    { "tlm_spool", 4096, 2, NETWORK },
+    { "led_state", 3072, 1, NETWORK },   // NVS writes, debounced
+    { "binlog",    3072, 1, NETWORK },   // UART
+};
+
+const uint32_t TOPOLOGY_JITTER_BOUNDS_US[TOPOLOGY_JITTER_BUCKETS] = {
+    10, 50, 100, 500, 1000, 5000, 10000,
+};
+
+static std::atomic<uint32_t> stat_samples{0};
+static std::atomic<uint32_t> stat_last_us{0};
+static std::atomic<uint32_t> stat_max_us{0};
+static std::atomic<uint64_t> stat_total_us{0};
+static std::atomic<uint32_t> stat_buckets[TOPOLOGY_JITTER_BUCKETS + 1];
+
+const task_spec_t* task_topology_spec(task_role_t role) {
+    return role < TASK_ROLE_COUNT ? &specs[role] : NULL;
+}
+
+BaseType_t task_topology_create(task_role_t role, TaskFunction_t fn, void* arg, TaskHandle_t* handle) {
+    const task_spec_t* spec = task_topology_spec(role);
+    if (spec == NULL) {
+        return pdFAIL;
+    }
+    return xTaskCreatePinnedToCore(fn, spec->name, spec->stack, arg, spec->priority, handle, spec->core);
+}
+
+const char* task_topology_profile_name(void) {
+    return TASK_TOPOLOGY_PROFILE == TASK_TOPOLOGY_SPLIT ? "split" : "shared";
+}
+
+static void record_jitter(uint32_t jitter_us) {
+    int i = 0;
+    while (i < TOPOLOGY_JITTER_BUCKETS && jitter_us > TOPOLOGY_JITTER_BOUNDS_US[i]) {
+        i++;
+    }
+    stat_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    stat_samples.fetch_add(1, std::memory_order_relaxed);
+    stat_last_us.store(jitter_us, std::memory_order_relaxed);
+    stat_total_us.fetch_add(jitter_us, std::memory_order_relaxed);
+    if (jitter_us > stat_max_us.load(std::memory_order_relaxed)) {
+        stat_max_us.store(jitter_us, std::memory_order_relaxed);
+    }
+}
+
+// Interval between wakeups against the period, so the tick and esp_timer
+// clocks drifting apart does not add up over time
+static void probe_task(void* arg) {
+    const int64_t period_us = pdMS_TO_TICKS(TOPOLOGY_PROBE_PERIOD_MS) * portTICK_PERIOD_MS * 1000LL;
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t previous_us = 0;
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TOPOLOGY_PROBE_PERIOD_MS));
+        int64_t now_us = esp_timer_get_time();
+        if (previous_us != 0) {
+            int64_t jitter_us = now_us - previous_us - period_us;
+            record_jitter((uint32_t)(jitter_us < 0 ? -jitter_us : jitter_us));
+        }
+        previous_us = now_us;
+    }
+}
+
+esp_err_t task_topology_start(void) {
+    printf("[TOPOLOGY] Profile %s\n", task_topology_profile_name());
+    ESP_LOGI(TAG, "Profile %s", task_topology_profile_name());
+    if (task_topology_create(TASK_ROLE_JITTER_PROBE, probe_task, NULL, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create jitter probe task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+int task_topology_check(void) {
+    int mismatches = 0;
+    for (int i = 0; i < TASK_ROLE_COUNT; i++) {
+        TaskHandle_t task = xTaskGetHandle(specs[i].name);
+        if (task == NULL) {
+            continue;   // not started in this configuration
+        }
+        UBaseType_t priority = uxTaskPriorityGet(task);
+        BaseType_t core = xTaskGetCoreID(task);
+        if (priority != specs[i].priority || core != specs[i].core) {
+            mismatches++;
+            ESP_LOGW(TAG, "%s: priority %u on core %d, the %s profile wants %u on core %d", specs[i].name,
+                     (unsigned)priority, core == tskNO_AFFINITY ? -1 : (int)core, task_topology_profile_name(),
+                     (unsigned)specs[i].priority, specs[i].core == tskNO_AFFINITY ? -1 : (int)specs[i].core);
+        }
+    }
+    return mismatches;
+}
+
+void task_topology_get_stats(task_topology_stats_t* stats) {
+    stats->samples = stat_samples.load(std::memory_order_relaxed);
+    stats->last_us = stat_last_us.load(std::memory_order_relaxed);
+    stats->max_us = stat_max_us.load(std::memory_order_relaxed);
+    stats->total_us = stat_total_us.load(std::memory_order_relaxed);
+    for (int i = 0; i <= TOPOLOGY_JITTER_BUCKETS; i++) {
+        stats->buckets[i] = stat_buckets[i].load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,110 @@
+#include "telemetry.h"
+#include "azure_iot_mqtt.h"
+#include "azure_config.h"
+#include "led_channels.h"
+#include "latency_trace.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TELEMETRY";
+
+// Owned by the telemetry task
+static telemetry_sample_t samples[TELEMETRY_MAX_SAMPLES];
+static size_t sample_count = 0;
+static uint32_t next_seq = 0;
+static uint8_t payload[TELEMETRY_BUFFER_SIZE];
+
+static std::atomic<uint32_t> sample_period_ms{TELEMETRY_SAMPLE_PERIOD_MS};
+static std::atomic<uint32_t> samples_per_publish{TELEMETRY_SAMPLES_PER_PUBLISH};
+
+static void take_sample(void) {
+    if (sample_count == TELEMETRY_MAX_SAMPLES) {
+        // Nowhere to put them (offline without a spool): keep the most recent samples
+        memmove(&samples[0], &samples[1], (TELEMETRY_MAX_SAMPLES - 1) * sizeof(samples[0]));
+        sample_count--;
+    }
+
+    telemetry_sample_t* s = &samples[sample_count++];
+    s->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    s->seq = next_seq++;
+    s->free_heap = esp_get_free_heap_size();
+    s->channel_count = LED_CHANNEL_COUNT;
+    for (int i = 0; i < LED_CHANNEL_COUNT; i++) {
+        s->level[i] = led_channel_get_level(i);
+    }
+}
+
+static void publish_samples(void) {
+    size_t sent = 0;
+    while (sent < sample_count) {
+        size_t len = 0;
+        size_t n = telemetry_encode(TELEMETRY_FORMAT, DEVICE_ID, &samples[sent], sample_count - sent,
+                                    payload, sizeof(payload), &len);
+        if (n == 0) {
+            BLOGE(TAG, "Sample %u does not fit in %u bytes, dropped", (unsigned)samples[sent].seq,
+                  (unsigned)sizeof(payload));
+            sent++;
+            continue;
+        }
+        if (azure_iot_send_telemetry_bytes(payload, len, telemetry_content_type(TELEMETRY_FORMAT)) != ESP_OK) {
+            break;
+        }
+        BLOGD(TAG, "Published %u samples, %u bytes", (unsigned)n, (unsigned)len);
+        sent += n;
+    }
+
+    // Whatever was not accepted stays queued for the next attempt
+    memmove(&samples[0], &samples[sent], (sample_count - sent) * sizeof(samples[0]));
+    sample_count -= sent;
+}
+
+// Sampled C2D latency trace, if one is waiting. Not spooled: only useful live.
+static void publish_trace(void) {
+    char trace[LATENCY_TRACE_JSON_MAX];
+    size_t len = latency_trace_take_sample(trace, sizeof(trace));
+    if (len > 0 && azure_iot_is_connected()) {
+        azure_iot_send_telemetry_bytes(trace, len, NULL);
+    }
+}
+
+static void telemetry_task(void* arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        TickType_t period = pdMS_TO_TICKS(sample_period_ms.load(std::memory_order_relaxed));
+        vTaskDelayUntil(&last_wake, period ? period : 1);
+
+        take_sample();
+        if (sample_count >= samples_per_publish.load(std::memory_order_relaxed)) {
+            publish_samples();
+        }
+        publish_trace();
+    }
+}
+
+esp_err_t telemetry_set_rate(uint32_t period_ms, uint8_t per_publish) {
+    if (period_ms == 0 || per_publish == 0 || per_publish > TELEMETRY_MAX_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sample_period_ms.store(period_ms, std::memory_order_relaxed);
+    samples_per_publish.store(per_publish, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Sampling every %lu ms, %u samples per message", (unsigned long)period_ms, per_publish);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_start(void) {
+    if (task_topology_create(TASK_ROLE_TELEMETRY, telemetry_task, NULL, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create telemetry task");
+        return ESP_ERR_NO_MEM;
+    }
+    printf("[TELEMETRY] Sampling every %d ms, %d samples per message (%s)\n", TELEMETRY_SAMPLE_PERIOD_MS,
+           TELEMETRY_SAMPLES_PER_PUBLISH, telemetry_content_type(TELEMETRY_FORMAT));
+    return ESP_OK;
+}
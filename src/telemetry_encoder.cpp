@@ -0,0 +1,175 @@
+#include "telemetry_encoder.h"
+#include <string.h>
+
+// Output cursor; overflow latches and every later write becomes a no-op
+typedef struct {
+    uint8_t* buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} tlm_writer_t;
+
+static void put_bytes(tlm_writer_t* w, const void* data, size_t n) {
+    if (w->overflow || n > w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_byte(tlm_writer_t* w, uint8_t b) {
+    put_bytes(w, &b, 1);
+}
+
+static void put_literal(tlm_writer_t* w, const char* s) {
+    put_bytes(w, s, strlen(s));
+}
+
+// JSON primitives
+
+static void json_uint(tlm_writer_t* w, uint32_t value) {
+    char digits[10];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    put_bytes(w, digits + sizeof(digits) - n, n);
+}
+
+static void json_string(tlm_writer_t* w, const char* s) {
+    put_byte(w, '"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            put_byte(w, '\\');
+        }
+        put_byte(w, (uint8_t)*s);
+    }
+    put_byte(w, '"');
+}
+
+static void json_sample(tlm_writer_t* w, const telemetry_sample_t* s) {
+    put_literal(w, "{\"t\":");
+    json_uint(w, s->uptime_ms);
+    put_literal(w, ",\"seq\":");
+    json_uint(w, s->seq);
+    put_literal(w, ",\"heap\":");
+    json_uint(w, s->free_heap);
+    put_literal(w, ",\"ch\":[");
+    for (uint8_t i = 0; i < s->channel_count; i++) {
+        if (i) {
+            put_byte(w, ',');
+        }
+        json_uint(w, s->level[i]);
+    }
+    put_literal(w, "]}");
+}
+
+// CBOR primitives (RFC 8949)
+
+#define CBOR_UINT   0x00
+#define CBOR_TEXT   0x60
+#define CBOR_ARRAY  0x80
+#define CBOR_MAP    0xA0
+#define CBOR_ARRAY_INDEFINITE 0x9F
+#define CBOR_BREAK  0xFF
+
+static void cbor_head(tlm_writer_t* w, uint8_t major, uint32_t value) {
+    if (value < 24) {
+        put_byte(w, (uint8_t)(major | value));
+    } else if (value <= 0xFF) {
+        uint8_t b[2] = { (uint8_t)(major | 24), (uint8_t)value };
+        put_bytes(w, b, sizeof(b));
+    } else if (value <= 0xFFFF) {
+        uint8_t b[3] = { (uint8_t)(major | 25), (uint8_t)(value >> 8), (uint8_t)value };
+        put_bytes(w, b, sizeof(b));
+    } else {
+        uint8_t b[5] = { (uint8_t)(major | 26), (uint8_t)(value >> 24), (uint8_t)(value >> 16),
+                         (uint8_t)(value >> 8), (uint8_t)value };
+        put_bytes(w, b, sizeof(b));
+    }
+}
+
+static void cbor_text(tlm_writer_t* w, const char* s) {
+    size_t n = strlen(s);
+    cbor_head(w, CBOR_TEXT, (uint32_t)n);
+    put_bytes(w, s, n);
+}
+
+static void cbor_sample(tlm_writer_t* w, const telemetry_sample_t* s) {
+    cbor_head(w, CBOR_MAP, 4);
+    cbor_text(w, "t");
+    cbor_head(w, CBOR_UINT, s->uptime_ms);
+    cbor_text(w, "seq");
+    cbor_head(w, CBOR_UINT, s->seq);
+    cbor_text(w, "heap");
+    cbor_head(w, CBOR_UINT, s->free_heap);
+    cbor_text(w, "ch");
+    cbor_head(w, CBOR_ARRAY, s->channel_count);
+    for (uint8_t i = 0; i < s->channel_count; i++) {
+        cbor_head(w, CBOR_UINT, s->level[i]);
+    }
+}
+
+size_t telemetry_encode(telemetry_format_t format, const char* device_id,
+                        const telemetry_sample_t* samples, size_t count,
+                        uint8_t* buf, size_t size, size_t* out_len) {
+    // Keep room for the closing bytes ("]}" or the CBOR break) while adding samples
+    size_t trailer = (format == TELEMETRY_FORMAT_JSON) ? 2 : 1;
+    *out_len = 0;
+    if (size <= trailer) {
+        return 0;
+    }
+    tlm_writer_t w = { buf, size - trailer, 0, false };
+
+    if (format == TELEMETRY_FORMAT_JSON) {
+        put_literal(&w, "{\"device_id\":");
+        json_string(&w, device_id);
+        put_literal(&w, ",\"samples\":[");
+    } else {
+        cbor_head(&w, CBOR_MAP, 2);
+        cbor_text(&w, "device_id");
+        cbor_text(&w, device_id);
+        cbor_text(&w, "samples");
+        put_byte(&w, CBOR_ARRAY_INDEFINITE);
+    }
+    if (w.overflow) {
+        return 0;
+    }
+
+    size_t encoded = 0;
+    for (; encoded < count; encoded++) {
+        size_t mark = w.len;
+        if (format == TELEMETRY_FORMAT_JSON) {
+            if (encoded) {
+                put_byte(&w, ',');
+            }
+            json_sample(&w, &samples[encoded]);
+        } else {
+            cbor_sample(&w, &samples[encoded]);
+        }
+        if (w.overflow) {
+            // Roll back the partial sample; the rest goes in the next payload
+            w.len = mark;
+            w.overflow = false;
+            break;
+        }
+    }
+    if (encoded == 0) {
+        return 0;
+    }
+
+    w.size += trailer;
+    if (format == TELEMETRY_FORMAT_JSON) {
+        put_literal(&w, "]}");
+    } else {
+        put_byte(&w, CBOR_BREAK);
+    }
+    *out_len = w.len;
+    return encoded;
+}
+
+const char* telemetry_content_type(telemetry_format_t format) {
+    return format == TELEMETRY_FORMAT_CBOR ? "application/cbor" : "application/json";
+}
@@ -0,0 +1,549 @@
+#include "telemetry_spool.h"
+#include "binlog.h"
+#include "task_topology.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SPOOL";
+
+// Flash layout: every 4 KB sector starts with {magic, sequence}; records follow
+// back to back, 4-byte aligned. A record is one header word then the content
+// type and payload bytes:
+//
+//   bits  0-15  content type + payload length
+//   bits 16-23  content type length
+//   bits 24-31  state: VALID when written, CONSUMED once acknowledged
+//
+// The body is written before the header, so a record torn by a power cut has
+// no header and is never seen. Consuming a record only clears bits of its
+// header word, which NOR flash allows without an erase.
+#define SPOOL_SECTOR_SIZE    4096
+#define SPOOL_SECTOR_MAGIC   0x4C4F4F53u   // "SOOL"
+#define SPOOL_SECTOR_HEADER  8
+#define SPOOL_RECORD_HEADER  4
+#define SPOOL_STATE_VALID    0xA5u
+#define SPOOL_STATE_CONSUMED 0x00u
+#define SPOOL_ERASED         0xFFFFFFFFu
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+} spool_sector_header_t;
+
+typedef struct {
+    uint16_t sector;
+    uint16_t offset;
+} spool_pos_t;
+
+typedef struct {
+    int msg_id;
+    spool_pos_t pos;
+} spool_inflight_t;
+
+static const esp_partition_t* partition = NULL;
+static uint16_t sector_count;
+static uint32_t next_sector_seq;
+
+// Guarded by spool_lock
+static spool_pos_t read_pos;    // oldest record not yet acknowledged
+static spool_pos_t send_pos;    // next record to replay
+static spool_pos_t write_pos;   // next free byte
+static spool_inflight_t inflight[TELEMETRY_SPOOL_INFLIGHT];
+static int inflight_count;
+static telemetry_spool_stats_t stats;
+static SemaphoreHandle_t spool_lock = NULL;
+
+// Replay task
+static TaskHandle_t drain_task_handle = NULL;
+static QueueHandle_t ack_queue = NULL;             // PUBACKs of inflight records only
+static std::atomic<int> inflight_ids[TELEMETRY_SPOOL_INFLIGHT];   // written by the replay task, -1 = free
+static std::atomic<bool> publishing{false};       // a PUBACK can beat track_inflight() while set
+static std::atomic<bool> ack_overflow{false};
+static telemetry_spool_publish_fn publish_fn = NULL;
+static std::atomic<bool> connected{false};
+static std::atomic<uint32_t> connect_gen{0};
+static uint8_t record_buf[TELEMETRY_SPOOL_RECORD_MAX];
+
+static uint16_t next_sector(uint16_t sector) {
+    return (uint16_t)((sector + 1) % sector_count);
+}
+
+static size_t pos_addr(spool_pos_t pos) {
+    return (size_t)pos.sector * SPOOL_SECTOR_SIZE + pos.offset;
+}
+
+static bool pos_equal(spool_pos_t a, spool_pos_t b) {
+    return a.sector == b.sector && a.offset == b.offset;
+}
+
+static uint32_t record_state(uint32_t header) {
+    return header >> 24;
+}
+
+static uint32_t record_size(uint32_t header) {
+    return SPOOL_RECORD_HEADER + (((header & 0xFFFF) + 3) & ~3u);
+}
+
+// Header of the record at pos, or SPOOL_ERASED at the end of the sector's data
+static uint32_t read_record_header(spool_pos_t pos) {
+    if (pos.offset + SPOOL_RECORD_HEADER > SPOOL_SECTOR_SIZE) {
+        return SPOOL_ERASED;
+    }
+    uint32_t header;
+    if (esp_partition_read(partition, pos_addr(pos), &header, sizeof(header)) != ESP_OK) {
+        return SPOOL_ERASED;
+    }
+    uint32_t state = record_state(header);
+    if ((state != SPOOL_STATE_VALID && state != SPOOL_STATE_CONSUMED) ||
+        pos.offset + record_size(header) > SPOOL_SECTOR_SIZE) {
+        return SPOOL_ERASED;
+    }
+    return header;
+}
+
+// Move pos to the next record at or after it, crossing into following sectors.
+// Returns false when pos reaches the write position.
+static bool seek_record(spool_pos_t* pos, uint32_t* header) {
+    for (int hops = 0; hops <= sector_count && !pos_equal(*pos, write_pos); ) {
+        uint32_t h = read_record_header(*pos);
+        if (h != SPOOL_ERASED) {
+            *header = h;
+            return true;
+        }
+        pos->sector = next_sector(pos->sector);
+        pos->offset = SPOOL_SECTOR_HEADER;
+        hops++;
+    }
+    return false;
+}
+
+// Like seek_record, skipping records that were already acknowledged
+static bool seek_pending(spool_pos_t* pos, uint32_t* header) {
+    while (seek_record(pos, header)) {
+        if (record_state(*header) == SPOOL_STATE_VALID) {
+            return true;
+        }
+        pos->offset += record_size(*header);
+    }
+    return false;
+}
+
+static esp_err_t open_sector(uint16_t sector) {
+    // The ring wrapped onto the oldest sector: whatever it still holds is lost
+    if (stats.pending && read_pos.sector == sector) {
+        uint32_t lost = 0;
+        spool_pos_t pos = read_pos;
+        for (uint32_t h; (h = read_record_header(pos)) != SPOOL_ERASED; pos.offset += record_size(h)) {
+            if (record_state(h) == SPOOL_STATE_VALID) {
+                lost++;
+            }
+        }
+        stats.dropped += lost;
+        stats.pending -= lost;
+        read_pos.sector = next_sector(sector);
+        read_pos.offset = SPOOL_SECTOR_HEADER;
+        if (send_pos.sector == sector) {
+            send_pos = read_pos;
+        }
+        for (int i = 0; i < inflight_count; ) {
+            if (inflight[i].pos.sector == sector) {
+                inflight[i] = inflight[--inflight_count];
+            } else {
+                i++;
+            }
+        }
+        BLOGW(TAG, "Spool full, %u records dropped", (unsigned)lost);
+    }
+
+    esp_err_t err = esp_partition_erase_range(partition, (size_t)sector * SPOOL_SECTOR_SIZE, SPOOL_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    spool_sector_header_t header = { SPOOL_SECTOR_MAGIC, next_sector_seq++ };
+    err = esp_partition_write(partition, (size_t)sector * SPOOL_SECTOR_SIZE, &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    write_pos.sector = sector;
+    write_pos.offset = SPOOL_SECTOR_HEADER;
+    if (stats.pending == 0) {
+        read_pos = write_pos;
+        send_pos = write_pos;
+    }
+    return ESP_OK;
+}
+
+static bool sector_tail_erased(spool_pos_t pos) {
+    uint32_t word;
+    for (; pos.offset + sizeof(word) <= SPOOL_SECTOR_SIZE; pos.offset += sizeof(word)) {
+        if (esp_partition_read(partition, pos_addr(pos), &word, sizeof(word)) != ESP_OK || word != SPOOL_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t recover(void) {
+    // Oldest and newest sectors by sequence number; sequences only grow, so
+    // the sectors in between follow in ring order
+    int oldest = -1;
+    int newest = -1;
+    uint32_t oldest_seq = 0;
+    uint32_t newest_seq = 0;
+    for (uint16_t s = 0; s < sector_count; s++) {
+        spool_sector_header_t header;
+        if (esp_partition_read(partition, (size_t)s * SPOOL_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK ||
+            header.magic != SPOOL_SECTOR_MAGIC) {
+            continue;
+        }
+        if (oldest < 0 || header.seq < oldest_seq) {
+            oldest = s;
+            oldest_seq = header.seq;
+        }
+        if (newest < 0 || header.seq > newest_seq) {
+            newest = s;
+            newest_seq = header.seq;
+        }
+    }
+
+    if (newest < 0) {
+        next_sector_seq = 1;
+        return open_sector(0);
+    }
+    next_sector_seq = newest_seq + 1;
+
+    // End of the newest sector's data
+    uint32_t h;
+    write_pos.sector = (uint16_t)newest;
+    write_pos.offset = SPOOL_SECTOR_HEADER;
+    while ((h = read_record_header(write_pos)) != SPOOL_ERASED) {
+        write_pos.offset += record_size(h);
+    }
+
+    // Count what is still unsent, from the oldest sector up to the write position
+    read_pos.sector = (uint16_t)oldest;
+    read_pos.offset = SPOOL_SECTOR_HEADER;
+    stats.pending = 0;
+    if (seek_pending(&read_pos, &h)) {
+        spool_pos_t pos = read_pos;
+        while (seek_pending(&pos, &h)) {
+            stats.pending++;
+            pos.offset += record_size(h);
+        }
+    } else {
+        read_pos = write_pos;
+    }
+    send_pos = read_pos;
+
+    // A write cut short by a reset leaves bytes past the last header; start a fresh sector
+    if (!sector_tail_erased(write_pos)) {
+        return open_sector(next_sector(write_pos.sector));
+    }
+    return ESP_OK;
+}
+
+esp_err_t telemetry_spool_init(void) {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         TELEMETRY_SPOOL_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, telemetry is not spooled", TELEMETRY_SPOOL_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    sector_count = (uint16_t)(partition->size / SPOOL_SECTOR_SIZE);
+    if (sector_count > TELEMETRY_SPOOL_MAX_SECTORS) {
+        sector_count = TELEMETRY_SPOOL_MAX_SECTORS;
+    }
+    if (sector_count < 2) {
+        partition = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    spool_lock = xSemaphoreCreateMutex();
+    if (spool_lock == NULL) {
+        partition = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = recover();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Spool recovery failed: %s", esp_err_to_name(err));
+        partition = NULL;
+        return err;
+    }
+
+    printf("[SPOOL] %u KB telemetry spool, %lu records pending\n", (unsigned)(sector_count * SPOOL_SECTOR_SIZE / 1024),
+           (unsigned long)stats.pending);
+    ESP_LOGI(TAG, "Spool ready: %u sectors, %lu pending", sector_count, (unsigned long)stats.pending);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_spool_append(const void* data, size_t len, const char* content_type) {
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t ct_len = content_type ? strlen(content_type) : 0;
+    size_t body = ct_len + len;
+    size_t size = SPOOL_RECORD_HEADER + ((body + 3) & ~(size_t)3);
+    if (ct_len > TELEMETRY_SPOOL_CONTENT_TYPE_MAX || body > TELEMETRY_SPOOL_RECORD_MAX ||
+        size > SPOOL_SECTOR_SIZE - SPOOL_SECTOR_HEADER) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    if (write_pos.offset + size > SPOOL_SECTOR_SIZE) {
+        err = open_sector(next_sector(write_pos.sector));
+    }
+
+    // Body first, header last: the record appears atomically
+    size_t addr = pos_addr(write_pos);
+    if (err == ESP_OK && ct_len) {
+        err = esp_partition_write(partition, addr + SPOOL_RECORD_HEADER, content_type, ct_len);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition, addr + SPOOL_RECORD_HEADER + ct_len, data, len);
+    }
+    if (err == ESP_OK) {
+        uint32_t header = (uint32_t)body | ((uint32_t)ct_len << 16) | (SPOOL_STATE_VALID << 24);
+        err = esp_partition_write(partition, addr, &header, sizeof(header));
+    }
+    if (err == ESP_OK) {
+        write_pos.offset += size;
+        stats.stored++;
+        stats.pending++;
+    } else {
+        // Skip the rest of this sector rather than write over a partial record
+        write_pos.offset = SPOOL_SECTOR_SIZE;
+    }
+    xSemaphoreGive(spool_lock);
+
+    if (err != ESP_OK) {
+        BLOGE(TAG, "Spool write failed (%d)", err);
+    } else if (drain_task_handle != NULL && connected.load(std::memory_order_relaxed)) {
+        // Publish failed while connected: let the replay task retry it
+        xTaskNotifyGive(drain_task_handle);
+    }
+    return err;
+}
+
+// Caller holds spool_lock
+static void consume(spool_pos_t pos) {
+    uint32_t header = read_record_header(pos);
+    if (header == SPOOL_ERASED || record_state(header) != SPOOL_STATE_VALID) {
+        return;
+    }
+    header = (header & 0x00FFFFFFu) | (SPOOL_STATE_CONSUMED << 24);
+    esp_partition_write(partition, pos_addr(pos), &header, sizeof(header));
+    stats.pending--;
+    stats.replayed++;
+
+    // Advance the read position over the acknowledged prefix
+    if (!seek_pending(&read_pos, &header)) {
+        read_pos = write_pos;
+    }
+}
+
+// The MQTT task checks these without taking spool_lock
+static void track_inflight(int msg_id) {
+    for (int i = 0; i < TELEMETRY_SPOOL_INFLIGHT; i++) {
+        if (inflight_ids[i].load(std::memory_order_relaxed) == -1) {
+            inflight_ids[i].store(msg_id);
+            return;
+        }
+    }
+}
+
+static void untrack_inflight(int msg_id) {
+    for (int i = 0; i < TELEMETRY_SPOOL_INFLIGHT; i++) {
+        if (msg_id == -1 || inflight_ids[i].load(std::memory_order_relaxed) == msg_id) {
+            inflight_ids[i].store(-1, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void handle_ack(int msg_id) {
+    untrack_inflight(msg_id);
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    for (int i = 0; i < inflight_count; i++) {
+        if (inflight[i].msg_id == msg_id) {
+            consume(inflight[i].pos);
+            inflight[i] = inflight[--inflight_count];
+            break;
+        }
+    }
+    xSemaphoreGive(spool_lock);
+}
+
+// Publish the next pending record. Returns false when there is nothing to send
+// or the outbox is over budget.
+static bool replay_next(void) {
+    char content_type[TELEMETRY_SPOOL_CONTENT_TYPE_MAX + 1];
+    bool sent = false;
+
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    spool_pos_t pos = send_pos;
+    uint32_t header;
+    if (inflight_count < TELEMETRY_SPOOL_INFLIGHT && seek_pending(&pos, &header)) {
+        size_t body = header & 0xFFFF;
+        size_t ct_len = (header >> 16) & 0xFF;
+        if (esp_partition_read(partition, pos_addr(pos) + SPOOL_RECORD_HEADER, record_buf, body) == ESP_OK &&
+            ct_len <= TELEMETRY_SPOOL_CONTENT_TYPE_MAX) {
+            memcpy(content_type, record_buf, ct_len);
+            content_type[ct_len] = '\0';
+            publishing.store(true);
+            int msg_id = publish_fn(record_buf + ct_len, body - ct_len, ct_len ? content_type : NULL);
+            if (msg_id >= 0) {
+                track_inflight(msg_id);
+            }
+            publishing.store(false);
+            if (msg_id >= 0) {
+                inflight[inflight_count].msg_id = msg_id;
+                inflight[inflight_count].pos = pos;
+                inflight_count++;
+                pos.offset += record_size(header);
+                send_pos = pos;
+                sent = true;
+            }
+        }
+    }
+    xSemaphoreGive(spool_lock);
+    return sent;
+}
+
+// Returns the records still pending
+static uint32_t restart_replay(void) {
+    untrack_inflight(-1);
+    ack_overflow.store(false, std::memory_order_relaxed);
+    xQueueReset(ack_queue);
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    inflight_count = 0;
+    send_pos = read_pos;
+    uint32_t pending = stats.pending;
+    xSemaphoreGive(spool_lock);
+    return pending;
+}
+
+static bool drained(void) {
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    bool empty = stats.pending == 0;
+    xSemaphoreGive(spool_lock);
+    return empty;
+}
+
+static void drain_task(void* arg) {
+    uint32_t seen_gen = 0;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        TickType_t last_progress = xTaskGetTickCount();
+        while (connected.load(std::memory_order_acquire)) {
+            uint32_t gen = connect_gen.load(std::memory_order_acquire);
+            if (gen != seen_gen) {
+                // New session: anything unacknowledged from the last one is sent again
+                seen_gen = gen;
+                uint32_t pending = restart_replay();
+                BLOGI(TAG, "Replaying %u spooled records", (unsigned)pending);
+            }
+            if (ack_overflow.load(std::memory_order_relaxed)) {
+                // A PUBACK was lost on the way here: the window can no longer be trusted
+                BLOGW(TAG, "PUBACK queue overflow, resending from the oldest record");
+                restart_replay();
+                last_progress = xTaskGetTickCount();
+            }
+
+            int msg_id;
+            while (xQueueReceive(ack_queue, &msg_id, 0) == pdTRUE) {
+                handle_ack(msg_id);
+                last_progress = xTaskGetTickCount();
+            }
+
+            if (replay_next()) {
+                continue;
+            }
+            if (drained()) {
+                BLOGI(TAG, "Spool drained");
+                break;
+            }
+
+            // Window full or outbox over budget: wait for a PUBACK
+            if (xQueueReceive(ack_queue, &msg_id, pdMS_TO_TICKS(100)) == pdTRUE) {
+                handle_ack(msg_id);
+                last_progress = xTaskGetTickCount();
+            } else if (xTaskGetTickCount() - last_progress > pdMS_TO_TICKS(TELEMETRY_SPOOL_ACK_TIMEOUT_MS)) {
+                BLOGW(TAG, "No PUBACK for %d ms, resending from the oldest record", TELEMETRY_SPOOL_ACK_TIMEOUT_MS);
+                restart_replay();
+                last_progress = xTaskGetTickCount();
+            }
+        }
+    }
+}
+
+esp_err_t telemetry_spool_start(telemetry_spool_publish_fn publish) {
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    publish_fn = publish;
+    untrack_inflight(-1);
+    // Only PUBACKs of inflight records are queued: one per slot, plus one that
+    // arrived while its publish was still returning
+    ack_queue = xQueueCreate(TELEMETRY_SPOOL_INFLIGHT + 1, sizeof(int));
+    if (ack_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (task_topology_create(TASK_ROLE_SPOOL, drain_task, NULL, &drain_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create spool task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void telemetry_spool_on_connected(void) {
+    if (drain_task_handle == NULL) {
+        return;
+    }
+    connect_gen.fetch_add(1, std::memory_order_release);
+    connected.store(true, std::memory_order_release);
+    xTaskNotifyGive(drain_task_handle);
+}
+
+void telemetry_spool_on_disconnected(void) {
+    connected.store(false, std::memory_order_release);
+}
+
+void telemetry_spool_on_published(int msg_id) {
+    if (ack_queue == NULL || !connected.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // Read before the ids: once it is clear, the id of the last publish is visible
+    bool maybe_ours = publishing.load();
+    for (int i = 0; i < TELEMETRY_SPOOL_INFLIGHT && !maybe_ours; i++) {
+        maybe_ours = inflight_ids[i].load() == msg_id;
+    }
+    if (!maybe_ours) {
+        return;
+    }
+    // Never blocks the MQTT task; a full queue makes the replay task resend the window
+    if (xQueueSend(ack_queue, &msg_id, 0) != pdTRUE) {
+        ack_overflow.store(true, std::memory_order_relaxed);
+        xTaskNotifyGive(drain_task_handle);
+    }
+}
+
+void telemetry_spool_get_stats(telemetry_spool_stats_t* out) {
+    if (spool_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(spool_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(spool_lock);
+}
@@ -0,0 +1,44 @@
+#include "time_sync.h"
+#include "app_events.h"
+#include "schedule.h"
+#include "binlog.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const char *TAG = "TIME_SYNC";
+
+// Runs on the lwIP thread: keep it short
+static void on_time_synced(struct timeval* tv) {
+    bool first = !(app_events_get() & APP_EVENT_TIME_SYNCED);
+    app_events_set(APP_EVENT_TIME_SYNCED);
+    schedule_on_time_set();
+    if (first) {
+        time_t now = tv->tv_sec;
+        struct tm local;
+        localtime_r(&now, &local);
+        BLOGI(TAG, "Clock set: %02d:%02d:%02d local", local.tm_hour, local.tm_min, local.tm_sec);
+    }
+}
+
+esp_err_t time_sync_start(void) {
+    setenv("TZ", TIME_SYNC_TIMEZONE, 1);
+    tzset();
+
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(TIME_SYNC_SERVER);
+    config.sync_cb = on_time_synced;
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start SNTP: %s", esp_err_to_name(err));
+        return err;
+    }
+    printf("[TIME] SNTP started (%s, TZ %s)\n", TIME_SYNC_SERVER, TIME_SYNC_TIMEZONE);
+    return ESP_OK;
+}
+
+bool time_sync_is_valid(void) {
+    return (app_events_get() & APP_EVENT_TIME_SYNCED) != 0;
+}
@@ -0,0 +1,210 @@
+#include "tls_transport.h"
+#include "esp_crt_bundle.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "mbedtls/md.h"
+#include "mbedtls/ssl.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <sys/select.h>
+
+static const char *TAG = "TLS_TRANSPORT";
+
+typedef struct {
+    esp_tls_t* tls;
+} tls_connection_t;
+
+// One MQTT client, one connection. Both only touched from the MQTT task.
+static tls_connection_t connection;
+static esp_tls_client_session_t* cached_session = NULL;
+static uint8_t cached_fingerprint[32];   // of cached_session's master secret
+
+static std::atomic<uint32_t> stat_handshakes{0};
+static std::atomic<uint32_t> stat_resumed{0};
+static std::atomic<uint32_t> stat_failures{0};
+static std::atomic<uint32_t> stat_last_full_ms{0};
+static std::atomic<uint32_t> stat_last_resumed_ms{0};
+static std::atomic<int64_t> last_rx_us{0};
+
+static void forget_session(void) {
+    if (cached_session != NULL) {
+        esp_tls_free_client_session(cached_session);
+        cached_session = NULL;
+    }
+}
+
+// SHA-256 of the master secret the handshake ended with. A resumed session
+// keeps the secret it was created with; a full handshake always derives a new
+// one, also when the server turned down the session we offered.
+static bool session_fingerprint(esp_tls_t* tls, uint8_t out[32]) {
+    const mbedtls_ssl_context* ssl = (const mbedtls_ssl_context*)esp_tls_get_ssl_context(tls);
+    if (ssl == NULL || ssl->MBEDTLS_PRIVATE(session) == NULL) {
+        return false;
+    }
+    const mbedtls_ssl_session* session = ssl->MBEDTLS_PRIVATE(session);
+    return mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), session->MBEDTLS_PRIVATE(master),
+                      sizeof(session->MBEDTLS_PRIVATE(master)), out) == 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char* host, int port, int timeout_ms) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    conn->tls = esp_tls_init();
+    if (conn->tls == NULL) {
+        return -1;
+    }
+    esp_tls_cfg_t cfg = {};
+    cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    cfg.timeout_ms = timeout_ms;
+    cfg.client_session = cached_session;
+    bool offered = cached_session != NULL;
+
+    int64_t start_us = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(host, (int)strlen(host), port, &cfg, conn->tls) != 1) {
+        stat_failures.fetch_add(1, std::memory_order_relaxed);
+        printf("[TLS] Connection to %s:%d failed%s\n", host, port, offered ? ", dropping the cached session" : "");
+        ESP_LOGE(TAG, "TLS connection to %s:%d failed", host, port);
+        if (offered) {
+            forget_session();   // a rejected ticket would fail every retry
+        }
+        esp_tls_conn_destroy(conn->tls);
+        conn->tls = NULL;
+        return -1;
+    }
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+    // Offering a session is not resuming it: the server may answer with a full handshake
+    uint8_t fingerprint[32];
+    bool have_fingerprint = session_fingerprint(conn->tls, fingerprint);
+    bool resumed = offered && have_fingerprint && memcmp(fingerprint, cached_fingerprint, sizeof(fingerprint)) == 0;
+
+    // This connection's session (and ticket) is the one to offer next time
+    esp_tls_client_session_t* session = esp_tls_get_client_session(conn->tls);
+    forget_session();
+    if (session != NULL && have_fingerprint) {
+        cached_session = session;
+        memcpy(cached_fingerprint, fingerprint, sizeof(cached_fingerprint));
+    } else if (session != NULL) {
+        esp_tls_free_client_session(session);   // could not tell a resumption from it later
+    }
+
+    stat_handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (resumed) {
+        stat_resumed.fetch_add(1, std::memory_order_relaxed);
+        stat_last_resumed_ms.store(elapsed_ms, std::memory_order_relaxed);
+    } else {
+        stat_last_full_ms.store(elapsed_ms, std::memory_order_relaxed);
+    }
+    const char* kind = resumed ? "session resumed" : offered ? "full handshake, cached session rejected" : "full handshake";
+    printf("[TLS] Connected to %s in %u ms (%s)\n", host, (unsigned)elapsed_ms, kind);
+    ESP_LOGI(TAG, "Connected in %u ms, %s", (unsigned)elapsed_ms, kind);
+    return 0;
+}
+
+// select() on the socket; >0 ready, 0 timeout, -1 error
+static int wait_socket(esp_tls_t* tls, bool for_write, int timeout_ms) {
+    int sock = -1;
+    if (tls == NULL || esp_tls_get_conn_sockfd(tls, &sock) != ESP_OK || sock < 0) {
+        return -1;
+    }
+    fd_set ready;
+    fd_set errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(sock, &ready);
+    FD_SET(sock, &errors);
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    int ret = select(sock + 1, for_write ? NULL : &ready, for_write ? &ready : NULL, &errors,
+                     timeout_ms < 0 ? NULL : &tv);
+    if (ret > 0 && FD_ISSET(sock, &errors)) {
+        return -1;
+    }
+    return ret;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    // Records already decrypted by mbedTLS never show up on the socket
+    if (conn->tls != NULL && esp_tls_get_bytes_avail(conn->tls) > 0) {
+        return 1;
+    }
+    return wait_socket(conn->tls, false, timeout_ms);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    return wait_socket(conn->tls, true, timeout_ms);
+}
+
+static int tls_read(esp_transport_handle_t t, char* buffer, int len, int timeout_ms) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    int poll = tls_poll_read(t, timeout_ms);
+    if (poll <= 0) {
+        return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    ssize_t n = esp_tls_conn_read(conn->tls, buffer, (size_t)len);
+    if (n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (n == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    if (n < 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    last_rx_us.store(esp_timer_get_time(), std::memory_order_relaxed);
+    return (int)n;
+}
+
+static int tls_write(esp_transport_handle_t t, const char* buffer, int len, int timeout_ms) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    int poll = tls_poll_write(t, timeout_ms);
+    if (poll <= 0) {
+        return poll;
+    }
+    ssize_t n = esp_tls_conn_write(conn->tls, buffer, (size_t)len);
+    if (n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+    return n < 0 ? -1 : (int)n;
+}
+
+static int tls_close(esp_transport_handle_t t) {
+    tls_connection_t* conn = (tls_connection_t*)esp_transport_get_context_data(t);
+    if (conn->tls != NULL) {
+        esp_tls_conn_destroy(conn->tls);
+        conn->tls = NULL;
+    }
+    return 0;
+}
+
+static int tls_destroy(esp_transport_handle_t t) {
+    tls_close(t);
+    forget_session();
+    return 0;
+}
+
+esp_transport_handle_t tls_transport_create(void) {
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        return NULL;
+    }
+    esp_transport_set_context_data(t, &connection);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close, tls_poll_read, tls_poll_write,
+                           tls_destroy);
+    esp_transport_set_default_port(t, TLS_TRANSPORT_DEFAULT_PORT);
+    return t;
+}
+
+void tls_transport_get_stats(tls_transport_stats_t* stats) {
+    stats->handshakes = stat_handshakes.load(std::memory_order_relaxed);
+    stats->resumed = stat_resumed.load(std::memory_order_relaxed);
+    stats->failures = stat_failures.load(std::memory_order_relaxed);
+    stats->last_full_ms = stat_last_full_ms.load(std::memory_order_relaxed);
+    stats->last_resumed_ms = stat_last_resumed_ms.load(std::memory_order_relaxed);
+}
+
+int64_t tls_transport_last_rx_us(void) {
+    return last_rx_us.load(std::memory_order_relaxed);
+}
@@ -1,9 +1,17 @@
 #include "web_server.h"
-#include "led_channels.h"
+#include "actuator.h"
+#include "command_parser.h"
+#include "http_query.h"
+#include "metrics.h"
+#include "binlog.h"
+#include "task_topology.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
 #include "esp_netif_ip_addr.h"
+#include <atomic>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 
 static const char *TAG = "WEB_SERVER";
@@ -12,218 +20,192 @@ static httpd_handle_t server_handle = NULL;
 
 // Forward declarations
 static esp_err_t root_handler(httpd_req_t *req);
+static esp_err_t channels_handler(httpd_req_t *req);
 static esp_err_t led_control_handler(httpd_req_t *req);
+static esp_err_t logs_handler(httpd_req_t *req);
+static esp_err_t metrics_handler(httpd_req_t *req);
+static esp_err_t ws_handler(httpd_req_t *req);
+static esp_err_t api_channels_get_handler(httpd_req_t *req);
+static esp_err_t api_channels_post_handler(httpd_req_t *req);
 
-// HTML page with buttons to control LED
-static const char html_page[] = 
-"<!DOCTYPE html>"
-"<html>"
-"<head>"
-"<meta charset=\"UTF-8\">"
-"<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">"
-"<title>ESP32 LED Control</title>"
-"<style>"
-"body {"
-"font-family: Arial, sans-serif;"
-"display: flex;"
-"justify-content: center;"
-"align-items: center;"
-"min-height: 100vh;"
-"margin: 0;"
-"background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);"
-"}"
-".container {"
-"background: white;"
-"padding: 40px;"
-"border-radius: 20px;"
-"box-shadow: 0 10px 40px rgba(0,0,0,0.2);"
-"text-align: center;"
-"}"
-"h1 {"
-"color: #333;"
-"margin-bottom: 30px;"
-"}"
-".channel-control {"
-"display: grid;"
-"grid-template-columns: repeat(2, 1fr);"
-"gap: 20px;"
-"margin-bottom: 20px;"
-"}"
-".channel {"
-"background: #f8f9fa;"
-"padding: 20px;"
-"border-radius: 10px;"
-"border: 2px solid #e9ecef;"
-"}"
-".channel h3 {"
-"margin-top: 0;"
-"color: #495057;"
-"font-size: 16px;"
-"}"
-".button-group {"
-"display: flex;"
-"gap: 10px;"
-"justify-content: center;"
-"}"
-"button {"
-"padding: 15px 40px;"
-"font-size: 18px;"
-"border: none;"
-"border-radius: 10px;"
-"cursor: pointer;"
-"transition: all 0.3s;"
-"font-weight: bold;"
-"}"
-".btn-on {"
-"background: #4CAF50;"
-"color: white;"
-"}"
-".btn-on:hover {"
-"background: #45a049;"
-"transform: scale(1.05);"
-"}"
-".btn-off {"
-"background: #f44336;"
-"color: white;"
-"}"
-".btn-off:hover {"
-"background: #da190b;"
-"transform: scale(1.05);"
-"}"
-".status {"
-"margin-top: 30px;"
-"padding: 15px;"
-"border-radius: 10px;"
-"font-weight: bold;"
-"}"
-".status-success {"
-"background: #d4edda;"
-"color: #155724;"
-"}"
-"</style>"
-"</head>"
-"<body>"
-"<div class=\"container\">"
-"<h1>ESP32 LED Control - 4 Canales</h1>"
-"<div class=\"channel-control\">"
-"<div class=\"channel\">"
-"<h3>RGB (Pin 17)</h3>"
-"<div class=\"button-group\">"
-"<button class=\"btn-on\" onclick=\"controlChannel('RGB', 'ON')\">ON</button>"
-"<button class=\"btn-off\" onclick=\"controlChannel('RGB', 'OFF')\">OFF</button>"
-"</div>"
-"</div>"
-"<div class=\"channel\">"
-"<h3>WHITE (Pin 16)</h3>"
-"<div class=\"button-group\">"
-"<button class=\"btn-on\" onclick=\"controlChannel('WHITE', 'ON')\">ON</button>"
-"<button class=\"btn-off\" onclick=\"controlChannel('WHITE', 'OFF')\">OFF</button>"
-"</div>"
-"</div>"
-"<div class=\"channel\">"
-"<h3>VERDE (Pin 4)</h3>"
-"<div class=\"button-group\">"
-"<button class=\"btn-on\" onclick=\"controlChannel('VERDE', 'ON')\">ON</button>"
-"<button class=\"btn-off\" onclick=\"controlChannel('VERDE', 'OFF')\">OFF</button>"
-"</div>"
-"</div>"
-"<div class=\"channel\">"
-"<h3>FAR RED (Pin 12)</h3>"
-"<div class=\"button-group\">"
-"<button class=\"btn-on\" onclick=\"controlChannel('FAR_RED', 'ON')\">ON</button>"
-"<button class=\"btn-off\" onclick=\"controlChannel('FAR_RED', 'OFF')\">OFF</button>"
-"</div>"
-"</div>"
-"</div>"
-"<div id=\"status\"></div>"
-"</div>"
-"<script>"
-"function controlChannel(channel, command) {"
-"var statusDiv = document.getElementById('status');"
-"statusDiv.innerHTML = '<div class=\"status\">Enviando comando a ' + channel + '...</div>';"
-"fetch('/led?channel=' + channel + '&state=' + command, {"
-"method: 'GET'"
-"})"
-".then(function(response) { return response.text(); })"
-".then(function(data) {"
-"statusDiv.innerHTML = '<div class=\"status status-success\">' + data + '</div>';"
-"})"
-".catch(function(error) {"
-"statusDiv.innerHTML = '<div class=\"status\" style=\"background:#f8d7da;color:#721c24;\">Error: ' + error + '</div>';"
-"});"
-"}"
-"</script>"
-"</body>"
-"</html>";
-
-// Handler for root path - serves HTML page
+// The UI shell (web/index.html) is gzipped at build time by tools/gzip_web.py
+// and linked into the firmware; it is sent exactly as stored.
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+
+// Static response with a strong validator. Browsers revalidate on every load
+// (no-cache) and get a bodiless 304 while the firmware is unchanged.
+typedef struct {
+    const char* data;
+    size_t len;
+    const char* type;
+    bool gzip;
+    char etag[20];   // "<16 hex digits>"
+} web_asset_t;
+
+static web_asset_t index_asset;
+static web_asset_t index_plain_asset;
+static web_asset_t channels_asset;
+
+// What a client without gzip (plain curl, scripts) gets at /: only the
+// compressed UI is in flash, so a short uncompressed page pointing at the API
+static const char index_plain_html[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>PicaPica</title></head><body>"
+    "<p>La interfaz se sirve comprimida: abre esta p&aacute;gina en un navegador.</p>"
+    "<ul><li>GET /led?channel=RGB&amp;state=ON</li><li>GET /channels.json</li>"
+    "<li>GET/POST /api/channels</li><li>GET /metrics</li></ul></body></html>";
+
+// Channel list for the UI, generated once from LED_CHANNELS
+static char channels_json[64 + LED_CHANNEL_COUNT * 48];
+
+static void web_asset_init(web_asset_t* asset, const void* data, size_t len, const char* type, bool gzip) {
+    // FNV-1a over the exact bytes sent: the tag changes only when the content does
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= ((const uint8_t*)data)[i];
+        h *= 1099511628211ULL;
+    }
+    asset->data = (const char*)data;
+    asset->len = len;
+    asset->type = type;
+    asset->gzip = gzip;
+    snprintf(asset->etag, sizeof(asset->etag), "\"%016llx\"", (unsigned long long)h);
+}
+
+static void build_channels_json(void) {
+    size_t n = snprintf(channels_json, sizeof(channels_json), "{\"channels\":[");
+    for (int i = 0; i < LED_CHANNEL_COUNT && n < sizeof(channels_json); i++) {
+        n += snprintf(channels_json + n, sizeof(channels_json) - n, "%s{\"name\":\"%s\",\"pin\":%d}",
+                      i ? "," : "", LED_CHANNELS[i].name, LED_CHANNELS[i].pin);
+    }
+    if (n < sizeof(channels_json)) {
+        n += snprintf(channels_json + n, sizeof(channels_json) - n, "]}");
+    }
+    web_asset_init(&channels_asset, channels_json, strlen(channels_json), "application/json", false);
+}
+
+static bool etag_matches(httpd_req_t *req, const char* etag) {
+    char if_none_match[128];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) != ESP_OK) {
+        return false;
+    }
+    return strstr(if_none_match, etag) != NULL || strcmp(if_none_match, "*") == 0;
+}
+
+// True if Accept-Encoding lists gzip (or *) without q=0. A request without
+// the header gets no gzip either: plain curl and scripts would store the
+// compressed bytes as the page.
+static bool accepts_gzip(httpd_req_t *req) {
+    char accept[128];
+    if (httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept, sizeof(accept)) != ESP_OK) {
+        return false;
+    }
+    for (char* p = accept; *p != '\0';) {
+        char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        while (len > 0 && *p == ' ') {
+            p++;
+            len--;
+        }
+        const char* semi = (const char*)memchr(p, ';', len);
+        size_t name_len = semi ? (size_t)(semi - p) : len;
+        while (name_len > 0 && p[name_len - 1] == ' ') {
+            name_len--;
+        }
+        bool named = (name_len == 4 && strncasecmp(p, "gzip", 4) == 0) || (name_len == 1 && *p == '*');
+        if (named) {
+            const char* q = semi ? strstr(semi, "q=") : NULL;
+            if (q == NULL || q >= p + len || strtod(q + 2, NULL) > 0) {
+                return true;
+            }
+        }
+        if (end == NULL) {
+            break;
+        }
+        p = end + 1;
+    }
+    return false;
+}
+
+static esp_err_t send_asset(httpd_req_t *req, const web_asset_t* asset) {
+    bool compressed = asset->gzip;
+    // Only the compressed UI is in flash; without gzip the client gets its plain stand-in
+    if (asset == &index_asset && !accepts_gzip(req)) {
+        asset = &index_plain_asset;
+    }
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (compressed) {
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+
+    if (etag_matches(req, asset->etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, asset->type);
+    if (asset->gzip) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+    return httpd_resp_send(req, asset->data, asset->len);
+}
+
+// Handler for root path - serves the precompressed UI shell
 static esp_err_t root_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, html_page, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    return send_asset(req, &index_asset);
+}
+
+// Handler for /channels.json - channel registry the UI renders its blocks from
+static esp_err_t channels_handler(httpd_req_t *req) {
+    return send_asset(req, &channels_asset);
 }
 
 // Handler for LED control endpoint
 static esp_err_t led_control_handler(httpd_req_t *req) {
-    char query[128];
+    char query[HTTP_QUERY_MAX];
     char response[256];
     
     // Get query string
     if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
-        char channel[20];
-        char state[10];
-        gpio_num_t pin;
-        const char* channel_name = NULL;
-        
-        // Get channel parameter
-        if (httpd_query_key_value(query, "channel", channel, sizeof(channel)) != ESP_OK) {
-            snprintf(response, sizeof(response), "Error: parametro 'channel' no encontrado");
-            httpd_resp_set_type(req, "text/plain");
-            httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-            return ESP_OK;
-        }
+        led_query_t q;
+        led_query_result_t result = led_query_parse(query, strlen(query), &q);
         
-        // Get state parameter
-        if (httpd_query_key_value(query, "state", state, sizeof(state)) != ESP_OK) {
-            snprintf(response, sizeof(response), "Error: parametro 'state' no encontrado");
-            httpd_resp_set_type(req, "text/plain");
-            httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-            return ESP_OK;
-        }
-        
-        // Map channel name to GPIO pin
-        if (strcmp(channel, "RGB") == 0) {
-            pin = CHANNEL_RGB_PIN;
-            channel_name = "RGB";
-        } else if (strcmp(channel, "WHITE") == 0) {
-            pin = CHANNEL_WHITE_PIN;
-            channel_name = "WHITE";
-        } else if (strcmp(channel, "VERDE") == 0) {
-            pin = CHANNEL_VERDE_PIN;
-            channel_name = "VERDE";
-        } else if (strcmp(channel, "FAR_RED") == 0) {
-            pin = CHANNEL_FAR_RED_PIN;
-            channel_name = "FAR_RED";
-        } else {
-            snprintf(response, sizeof(response), "Error: Canal desconocido. Use: RGB, WHITE, VERDE, o FAR_RED");
-            httpd_resp_set_type(req, "text/plain");
-            httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-            return ESP_OK;
-        }
-        
-        // Set channel state
-        if (strcmp(state, "ON") == 0) {
-            led_channel_set(pin, 1);
-            snprintf(response, sizeof(response), "Canal %s (Pin %d) encendido correctamente", channel_name, pin);
-            printf("[WEB] Channel %s (Pin %d) turned ON via web interface\n", channel_name, pin);
-            ESP_LOGI(TAG, "Channel %s turned ON via web", channel_name);
-        } else if (strcmp(state, "OFF") == 0) {
-            led_channel_set(pin, 0);
-            snprintf(response, sizeof(response), "Canal %s (Pin %d) apagado correctamente", channel_name, pin);
-            printf("[WEB] Channel %s (Pin %d) turned OFF via web interface\n", channel_name, pin);
-            ESP_LOGI(TAG, "Channel %s turned OFF via web", channel_name);
-        } else {
-            snprintf(response, sizeof(response), "Error: Comando invalido. Use ON u OFF");
+        switch (result) {
+            case LED_QUERY_NO_CHANNEL:
+                snprintf(response, sizeof(response), "Error: parametro 'channel' no encontrado");
+                break;
+            case LED_QUERY_NO_STATE:
+                snprintf(response, sizeof(response), "Error: parametro 'state' no encontrado");
+                break;
+            case LED_QUERY_UNKNOWN_CHANNEL:
+                snprintf(response, sizeof(response), "Error: Canal desconocido: %.*s", (int)q.token.len, q.token.ptr);
+                break;
+            case LED_QUERY_BAD_STATE:
+                snprintf(response, sizeof(response), "Error: Comando invalido. Use ON, OFF o 0-255");
+                break;
+            case LED_QUERY_BAD_COMMAND:
+                snprintf(response, sizeof(response), "Error: %s: %.*s",
+                         command_parse_result_str(q.cmd_result), (int)q.token.len, q.token.ptr);
+                break;
+            case LED_QUERY_OK:
+                if (actuator_submit(&q.batch, CMD_SOURCE_HTTP) != ESP_OK) {
+                    snprintf(response, sizeof(response), "Error: cola de comandos llena, intente de nuevo");
+                } else if (q.batch_form) {
+                    snprintf(response, sizeof(response), "Comando aplicado a %d canales", __builtin_popcount(q.batch.mask));
+                } else {
+                    const char* channel_name = LED_CHANNELS[q.channel].name;
+                    int pin = LED_CHANNELS[q.channel].pin;
+                    uint8_t level = q.batch.level[q.channel];
+                    if (level == LED_LEVEL_MAX) {
+                        snprintf(response, sizeof(response), "Canal %s (Pin %d) encendido correctamente", channel_name, pin);
+                    } else if (level == 0) {
+                        snprintf(response, sizeof(response), "Canal %s (Pin %d) apagado correctamente", channel_name, pin);
+                    } else {
+                        snprintf(response, sizeof(response), "Canal %s (Pin %d) ajustado a nivel %d", channel_name, pin, level);
+                    }
+                }
+                break;
         }
     } else {
         snprintf(response, sizeof(response), "Error al procesar la peticion");
@@ -234,10 +216,268 @@ static esp_err_t led_control_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// Offending input echoed back in JSON errors: at most TOKEN_ECHO_MAX bytes,
+// with quotes, backslashes, control and non-ASCII bytes escaped as \uXXXX
+#define TOKEN_ECHO_MAX 32
+#define TOKEN_ECHO_SIZE (TOKEN_ECHO_MAX * 6 + 1)
+
+static const char* json_escape_token(const cmd_token_t* token, char* out) {
+    size_t len = token->len < TOKEN_ECHO_MAX ? token->len : TOKEN_ECHO_MAX;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)token->ptr[i];
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = (char)c;
+        } else if (c < 0x20 || c >= 0x7F) {
+            n += snprintf(out + n, TOKEN_ECHO_SIZE - n, "\\u%04x", c);
+        } else {
+            out[n++] = (char)c;
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
+
+// REST API: /api/channels
+//
+//   GET  -> {"channels":[{"name":"RGB","state":"ON","level":255},...]}
+//   POST <- any command form the parser accepts, typically a JSON object:
+//           {"RGB":"ON","WHITE":128,"VERDE":false}
+//
+// Both directions use fixed buffers; the request body is streamed in with
+// httpd_req_recv and never held by the server beyond API_BODY_MAX bytes.
+#define API_BODY_MAX 512
+
+static char api_channels_buf[32 + LED_CHANNEL_COUNT * 56];
+
+static esp_err_t api_send_json(httpd_req_t *req, const char* status, const char* json) {
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t api_channels_get_handler(httpd_req_t *req) {
+    // Formatted on the httpd task only, so one static buffer is enough
+    size_t n = snprintf(api_channels_buf, sizeof(api_channels_buf), "{\"channels\":[");
+    for (int i = 0; i < LED_CHANNEL_COUNT && n < sizeof(api_channels_buf); i++) {
+        uint8_t level = led_channel_get_level(i);
+        n += snprintf(api_channels_buf + n, sizeof(api_channels_buf) - n,
+                      "%s{\"name\":\"%s\",\"state\":\"%s\",\"level\":%d}",
+                      i ? "," : "", LED_CHANNELS[i].name, level ? "ON" : "OFF", level);
+    }
+    if (n < sizeof(api_channels_buf)) {
+        snprintf(api_channels_buf + n, sizeof(api_channels_buf) - n, "]}");
+    }
+    return api_send_json(req, "200 OK", api_channels_buf);
+}
+
+static esp_err_t api_channels_post_handler(httpd_req_t *req) {
+    char body[API_BODY_MAX];
+    char response[64 + TOKEN_ECHO_SIZE];
+
+    if (req->content_len == 0) {
+        return api_send_json(req, "400 Bad Request", "{\"ok\":false,\"error\":\"Cuerpo vacio\"}");
+    }
+    if (req->content_len > sizeof(body)) {
+        return api_send_json(req, "413 Payload Too Large", "{\"ok\":false,\"error\":\"Cuerpo demasiado grande\"}");
+    }
+
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            return ESP_FAIL;   // connection lost; httpd closes the socket
+        }
+        received += ret;
+    }
+
+    led_batch_t batch;
+    cmd_token_t bad_token;
+    cmd_parse_result_t result = command_parse(body, received, &batch, &bad_token);
+    if (result != CMD_PARSE_OK) {
+        char escaped[TOKEN_ECHO_SIZE];
+        snprintf(response, sizeof(response), "{\"ok\":false,\"error\":\"%s\",\"token\":\"%s\"}",
+                 command_parse_result_str(result), json_escape_token(&bad_token, escaped));
+        return api_send_json(req, "400 Bad Request", response);
+    }
+    if (actuator_submit(&batch, CMD_SOURCE_HTTP) != ESP_OK) {
+        return api_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"Cola de comandos llena\"}");
+    }
+
+    snprintf(response, sizeof(response), "{\"ok\":true,\"channels\":%d}", __builtin_popcount(batch.mask));
+    return api_send_json(req, "202 Accepted", response);
+}
+
+static void send_text_chunk(const char* text, size_t len, void* ctx) {
+    httpd_resp_send_chunk((httpd_req_t*)ctx, text, len);
+}
+
+// Handler for /logs - recent deferred log records, oldest first
+static esp_err_t logs_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    binlog_dump(send_text_chunk, req);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// Handler for /metrics - Prometheus text format, streamed in chunks
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    metrics_format(send_text_chunk, req);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+// WebSocket /ws - live channel state and commands over one connection.
+//
+// The actuator reports every hardware write through ws_state_listener, which
+// only accumulates the changed channels. A single work item on the httpd task
+// then formats one delta for all of them and sends it to every WebSocket
+// client, so bursts of commands collapse into few frames and no other task
+// ever writes to the sockets.
+#define WS_MAX_CLIENTS 7          // max_open_sockets
+#define WS_RX_MAX      256
+
+static std::atomic<uint32_t> ws_dirty{0};
+static std::atomic<bool> ws_queued{false};
+static char ws_tx[32 + LED_CHANNEL_COUNT * 24];
+
+// {"type":"state","channels":{"RGB":255,"WHITE":0}}
+static size_t format_state(char* out, size_t size, uint32_t mask) {
+    size_t n = snprintf(out, size, "{\"type\":\"state\",\"channels\":{");
+    bool first = true;
+    for (int i = 0; i < LED_CHANNEL_COUNT && n < size; i++) {
+        if (mask & (1u << i)) {
+            n += snprintf(out + n, size - n, "%s\"%s\":%d", first ? "" : ",", LED_CHANNELS[i].name,
+                          led_channel_get_level(i));
+            first = false;
+        }
+    }
+    if (n < size) {
+        n += snprintf(out + n, size - n, "}}");
+    }
+    return n < size ? n : size - 1;
+}
+
+static void ws_send_text(int fd, const char* text, size_t len) {
+    httpd_ws_frame_t frame = {};
+    frame.final = true;
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t*)text;
+    frame.len = len;
+    httpd_ws_send_frame_async(server_handle, fd, &frame);
+}
+
+// Runs on the httpd task
+static void ws_broadcast(void* arg) {
+    // Clear the flag first: a change racing with this send queues another round
+    ws_queued.store(false, std::memory_order_release);
+    uint32_t mask = ws_dirty.exchange(0, std::memory_order_acq_rel);
+    if (mask == 0) {
+        return;
+    }
+
+    size_t fd_count = WS_MAX_CLIENTS;
+    int fds[WS_MAX_CLIENTS];
+    if (httpd_get_client_list(server_handle, &fd_count, fds) != ESP_OK) {
+        return;
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < fd_count; i++) {
+        if (httpd_ws_get_fd_info(server_handle, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            continue;
+        }
+        if (len == 0) {
+            len = format_state(ws_tx, sizeof(ws_tx), mask);
+        }
+        ws_send_text(fds[i], ws_tx, len);
+    }
+}
+
+// Full snapshot for a client that just connected
+static void ws_send_snapshot(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    size_t len = format_state(ws_tx, sizeof(ws_tx), LED_CHANNELS_ALL);
+    ws_send_text(fd, ws_tx, len);
+}
+
+// Actuator listener: runs on the actuator task, must not block
+static void ws_state_listener(const cmd_record_t* record) {
+    ws_dirty.fetch_or(record->batch.mask, std::memory_order_acq_rel);
+    if (server_handle != NULL && !ws_queued.exchange(true, std::memory_order_acq_rel)) {
+        if (httpd_queue_work(server_handle, ws_broadcast, NULL) != ESP_OK) {
+            ws_queued.store(false, std::memory_order_release);
+        }
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // Handshake done; the snapshot goes out once the socket is a WebSocket
+        return httpd_queue_work(req->handle, ws_send_snapshot, (void*)(intptr_t)httpd_req_to_sockfd(req));
+    }
+
+    // Commands use the MQTT/`?cmd=` syntax: "RGB:ON,WHITE:128", "ALL:OFF", JSON...
+    char rx[WS_RX_MAX];
+    char reply[64 + TOKEN_ECHO_SIZE];
+    httpd_ws_frame_t frame = {};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.type != HTTPD_WS_TYPE_TEXT) {
+        return ESP_OK;
+    }
+    if (frame.len >= sizeof(rx)) {
+        snprintf(reply, sizeof(reply), "{\"type\":\"error\",\"message\":\"Comando demasiado largo\"}");
+    } else {
+        frame.payload = (uint8_t*)rx;
+        err = httpd_ws_recv_frame(req, &frame, sizeof(rx) - 1);
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        led_batch_t batch;
+        cmd_token_t bad_token;
+        cmd_parse_result_t result = command_parse(rx, frame.len, &batch, &bad_token);
+        if (result != CMD_PARSE_OK) {
+            char escaped[TOKEN_ECHO_SIZE];
+            snprintf(reply, sizeof(reply), "{\"type\":\"error\",\"message\":\"%s: %s\"}",
+                     command_parse_result_str(result), json_escape_token(&bad_token, escaped));
+        } else if (actuator_submit(&batch, CMD_SOURCE_HTTP) != ESP_OK) {
+            snprintf(reply, sizeof(reply), "{\"type\":\"error\",\"message\":\"Cola de comandos llena\"}");
+        } else {
+            // The new state arrives through the broadcast like everyone else's
+            return ESP_OK;
+        }
+    }
+
+    httpd_ws_frame_t out = {};
+    out.final = true;
+    out.type = HTTPD_WS_TYPE_TEXT;
+    out.payload = (uint8_t*)reply;
+    out.len = strlen(reply);
+    return httpd_ws_send_frame(req, &out);
+}
+
 esp_err_t web_server_start(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.max_uri_handlers = 10;
     config.max_open_sockets = 7;
+    config.task_priority = task_topology_spec(TASK_ROLE_HTTPD)->priority;
+    config.stack_size = task_topology_spec(TASK_ROLE_HTTPD)->stack;
+    config.core_id = task_topology_spec(TASK_ROLE_HTTPD)->core;
+    
+    web_asset_init(&index_asset, index_html_gz_start, index_html_gz_end - index_html_gz_start, "text/html", true);
+    web_asset_init(&index_plain_asset, index_plain_html, sizeof(index_plain_html) - 1, "text/html", false);
+    build_channels_json();
     
     printf("[WEB] Starting HTTP server on port %d...\n", config.server_port);
     ESP_LOGI(TAG, "Starting HTTP server on port %d", config.server_port);
@@ -252,6 +492,14 @@ esp_err_t web_server_start(void) {
         };
         httpd_register_uri_handler(server_handle, &root);
         
+        httpd_uri_t channels = {
+            .uri       = "/channels.json",
+            .method    = HTTP_GET,
+            .handler   = channels_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server_handle, &channels);
+        
         httpd_uri_t led_control = {
             .uri       = "/led",
             .method    = HTTP_GET,
@@ -260,6 +508,52 @@ esp_err_t web_server_start(void) {
         };
         httpd_register_uri_handler(server_handle, &led_control);
         
+        httpd_uri_t logs = {
+            .uri       = "/logs",
+            .method    = HTTP_GET,
+            .handler   = logs_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server_handle, &logs);
+        
+        httpd_uri_t metrics = {
+            .uri       = "/metrics",
+            .method    = HTTP_GET,
+            .handler   = metrics_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server_handle, &metrics);
+        
+        httpd_uri_t api_get = {
+            .uri       = "/api/channels",
+            .method    = HTTP_GET,
+            .handler   = api_channels_get_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server_handle, &api_get);
+        
+        httpd_uri_t api_post = {
+            .uri       = "/api/channels",
+            .method    = HTTP_POST,
+            .handler   = api_channels_post_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server_handle, &api_post);
+        
+        httpd_uri_t ws = {
+            .uri       = "/ws",
+            .method    = HTTP_GET,
+            .handler   = ws_handler,
+            .user_ctx  = NULL,
+            .is_websocket = true
+        };
+        httpd_register_uri_handler(server_handle, &ws);
+        
+        static bool ws_listening = false;
+        if (!ws_listening) {
+            ws_listening = actuator_add_listener(ws_state_listener) == ESP_OK;
+        }
+        
         printf("[WEB] HTTP server started successfully\n");
         printf("[WEB] Open http://<ESP32_IP>/ in your browser\n");
         ESP_LOGI(TAG, "HTTP server started successfully");
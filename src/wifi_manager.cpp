@@ -1,57 +1,239 @@
 #include "wifi_manager.h"
+#include "app_events.h"
+#include "azure_config.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
-#include "nvs_flash.h"
 #include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
 #include <stdio.h>
+#include <string.h>
 
 static const char *TAG = "WIFI_MANAGER";
-static bool wifi_connected = false;
+
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+#define WIFI_CACHE_KEY       "ap"
+#define WIFI_CACHE_VERSION   1
+
+// Last AP we got an IP from. Only used while the SSID matches the configured one.
+typedef struct {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    char ssid[33];
+} wifi_cache_t;
+
+static esp_netif_t* sta_netif = NULL;
+static esp_timer_handle_t reconnect_timer = NULL;
+static wifi_config_t sta_config;
+static wifi_cache_t cache;
+static bool cache_valid = false;
+
+// Event loop task only
+static bool fast_connect = false;       // sta_config pins the cached BSSID and channel
+static uint32_t attempt = 0;            // failed attempts since the last IP
+static int64_t link_lost_us = 0;        // start of the current outage, 0 while connected
+static int64_t start_us = 0;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static wifi_stats_t stats;
+
+static void load_cache(const char* ssid) {
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    size_t len = sizeof(cache);
+    esp_err_t err = nvs_get_blob(handle, WIFI_CACHE_KEY, &cache, &len);
+    nvs_close(handle);
+    cache_valid = err == ESP_OK && len == sizeof(cache) && cache.version == WIFI_CACHE_VERSION &&
+                  cache.channel != 0 && strncmp(cache.ssid, ssid, sizeof(cache.ssid)) == 0;
+}
+
+static void store_cache(const uint8_t* bssid, uint8_t channel) {
+    if (cache_valid && cache.channel == channel && memcmp(cache.bssid, bssid, 6) == 0) {
+        return;   // Unchanged: no flash write on every reconnect
+    }
+    cache.version = WIFI_CACHE_VERSION;
+    cache.channel = channel;
+    memcpy(cache.bssid, bssid, 6);
+    strncpy(cache.ssid, (const char*)sta_config.sta.ssid, sizeof(cache.ssid) - 1);
+    cache.ssid[sizeof(cache.ssid) - 1] = '\0';
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, WIFI_CACHE_KEY, &cache, sizeof(cache));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    cache_valid = err == ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to cache AP: %s", esp_err_to_name(err));
+    }
+}
+
+// Pin the cached AP (no scan) or go back to a full scan for the strongest AP
+static void apply_sta_config(bool use_cache) {
+    fast_connect = use_cache && cache_valid;
+    if (fast_connect) {
+        sta_config.sta.bssid_set = true;
+        memcpy(sta_config.sta.bssid, cache.bssid, 6);
+        sta_config.sta.channel = cache.channel;
+        sta_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        sta_config.sta.bssid_set = false;
+        sta_config.sta.channel = 0;
+        sta_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        sta_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+}
+
+#ifdef WIFI_STATIC_IP
+static void apply_static_ip(void) {
+    esp_netif_ip_info_t ip_info = {};
+    esp_netif_dns_info_t dns = {};
+    esp_netif_str_to_ip4(WIFI_STATIC_IP, &ip_info.ip);
+    esp_netif_str_to_ip4(WIFI_STATIC_NETMASK, &ip_info.netmask);
+    esp_netif_str_to_ip4(WIFI_STATIC_GATEWAY, &ip_info.gw);
+    esp_netif_str_to_ip4(WIFI_STATIC_DNS, &dns.ip.u_addr.ip4);
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+
+    esp_netif_dhcpc_stop(sta_netif);
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(sta_netif, &ip_info));
+    ESP_ERROR_CHECK(esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns));
+    printf("[WIFI] Static IP %s\n", WIFI_STATIC_IP);
+}
+#endif
+
+static void reconnect_timer_cb(void* arg) {
+    esp_wifi_connect();
+}
+
+// Jittered exponential backoff: the window doubles per failed attempt up to
+// WIFI_BACKOFF_MAX_MS and the delay is drawn from its upper half, so fixtures
+// that lost the AP together spread their retries out instead of stampeding it.
+static uint32_t backoff_ms(uint32_t failed) {
+    uint32_t window = WIFI_BACKOFF_FIRST_MS;
+    while (failed > 0 && window < WIFI_BACKOFF_MAX_MS) {
+        window *= 2;
+        failed--;
+    }
+    if (window > WIFI_BACKOFF_MAX_MS) {
+        window = WIFI_BACKOFF_MAX_MS;
+    }
+    return window / 2 + esp_random() % (window / 2 + 1);
+}
+
+static void on_disconnected(const wifi_event_sta_disconnected_t* event) {
+    int64_t now = esp_timer_get_time();
+    app_events_clear(APP_EVENT_WIFI_CONNECTED);
+    if (link_lost_us == 0 && stats.connects > 0) {
+        // Failed attempts before the first IP are boot, not an outage
+        link_lost_us = now;
+        portENTER_CRITICAL(&stats_lock);
+        stats.disconnects++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    attempt++;
+
+    if (fast_connect && attempt >= WIFI_FAST_CONNECT_ATTEMPTS) {
+        // The cached AP is gone or moved channel: forget it and scan
+        printf("[WIFI] Cached AP not reachable, falling back to full scan\n");
+        cache_valid = false;
+        apply_sta_config(false);
+    } else if (!fast_connect && attempt == 1 && cache_valid) {
+        // Lost the AP a scan found: the first retries go straight back to it.
+        // Not switched while connected, where set_config would drop the link.
+        apply_sta_config(true);
+    }
+
+    uint32_t delay = backoff_ms(attempt - 1);
+    printf("[WIFI] Disconnected (reason %d), retry %u in %u ms\n", event->reason, (unsigned)attempt,
+           (unsigned)delay);
+    ESP_LOGI(TAG, "Disconnected (reason %d), retry %u in %u ms", event->reason, (unsigned)attempt,
+             (unsigned)delay);
+    esp_timer_start_once(reconnect_timer, (uint64_t)delay * 1000);
+}
+
+static void on_got_ip(const ip_event_got_ip_t* event) {
+    int64_t now = esp_timer_get_time();
+    printf("[WIFI] Got IP address: " IPSTR "\n", IP2STR(&event->ip_info.ip));
+    ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.connects++;
+    if (fast_connect) {
+        stats.fast_connects++;
+    }
+    if (link_lost_us != 0) {
+        stats.last_reconnect_ms = (uint32_t)((now - link_lost_us) / 1000);
+        if (stats.last_reconnect_ms > stats.max_reconnect_ms) {
+            stats.max_reconnect_ms = stats.last_reconnect_ms;
+        }
+    } else if (stats.connects == 1) {
+        stats.first_connect_ms = (uint32_t)((now - start_us) / 1000);
+    }
+    uint32_t reconnect_ms = stats.last_reconnect_ms;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (link_lost_us != 0) {
+        printf("[WIFI] Reconnected in %u ms (%u attempts)\n", (unsigned)reconnect_ms, (unsigned)attempt);
+    }
+    link_lost_us = 0;
+    attempt = 0;
+    app_events_set(APP_EVENT_WIFI_CONNECTED);
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        printf("[WIFI] Station started, connecting...\n");
+        printf("[WIFI] Station started, connecting%s...\n", fast_connect ? " to cached AP" : "");
+        start_us = esp_timer_get_time();
+        app_events_set(APP_EVENT_WIFI_STARTED);
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t* event = (const wifi_event_sta_connected_t*)event_data;
+        store_cache(event->bssid, event->channel);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        wifi_connected = false;
-        printf("[WIFI] Disconnected, attempting to reconnect...\n");
-        ESP_LOGI(TAG, "WiFi disconnected, attempting to reconnect...");
-        esp_wifi_connect();
+        on_disconnected((const wifi_event_sta_disconnected_t*)event_data);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        printf("[WIFI] Got IP address: " IPSTR "\n", IP2STR(&event->ip_info.ip));
-        ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
-        wifi_connected = true;
+        on_got_ip((const ip_event_got_ip_t*)event_data);
     }
 }
 
 esp_err_t wifi_init_sta(const char* ssid, const char* password) {
-    printf("[WIFI] Initializing NVS...\n");
-    // Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        printf("[WIFI] Erasing NVS...\n");
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-    printf("[WIFI] NVS initialized\n");
-
+    // NVS, esp_netif and the default event loop are brought up by app_main
     printf("[WIFI] Initializing network interface...\n");
-    // Initialize network interface
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
+#ifdef WIFI_STATIC_IP
+    apply_static_ip();
+#endif
     printf("[WIFI] Network interface initialized\n");
 
     printf("[WIFI] Configuring WiFi...\n");
     // Configure WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // The config is ours (AP cache below); don't let the driver keep a second copy in flash
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     printf("[WIFI] WiFi initialized\n");
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_reconnect",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &reconnect_timer));
+
     // Register event handlers
     printf("[WIFI] Registering event handlers...\n");
     esp_event_handler_instance_t instance_any_id;
@@ -70,22 +252,34 @@ esp_err_t wifi_init_sta(const char* ssid, const char* password) {
 
     // Configure WiFi station
     printf("[WIFI] Setting WiFi credentials...\n");
-    wifi_config_t wifi_config = {};
-    strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char*)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
-    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    memset(&sta_config, 0, sizeof(sta_config));
+    strncpy((char*)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid) - 1);
+    strncpy((char*)sta_config.sta.password, password, sizeof(sta_config.sta.password) - 1);
+    sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+
+    load_cache(ssid);
+    if (cache_valid) {
+        printf("[WIFI] Cached AP %02x:%02x:%02x:%02x:%02x:%02x on channel %u\n", cache.bssid[0],
+               cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5],
+               cache.channel);
+    }
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    apply_sta_config(true);
     ESP_ERROR_CHECK(esp_wifi_start());
     printf("[WIFI] WiFi started, connecting to: %s\n", ssid);
 
     ESP_LOGI(TAG, "WiFi initialization finished. Connecting to %s...", ssid);
-    
+
     return ESP_OK;
 }
 
 bool wifi_is_connected(void) {
-    return wifi_connected;
+    return (app_events_get() & APP_EVENT_WIFI_CONNECTED) != 0;
 }
 
+void wifi_get_stats(wifi_stats_t* out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,103 @@
+// Dimming on the host: levels go through the gamma table and fades run in the
+// (mock) LEDC fade engine. The mock records every duty change the firmware asks
+// for, and the clock only moves when a test advances it.
+//   pio test -e native_test
+
+#include "led_channels.h"
+#include "host_mock.h"
+#include <unity.h>
+
+#define FULL_SCALE_13BIT 8192   // LEDC reaches 100% at duty 2^resolution
+#define CH 0   // RGB
+
+static ledc_channel_t ledc(int channel) {
+    return LED_CHANNELS[channel].ledc_channel;
+}
+
+static const mock_ledc_event_t* last_event(int channel) {
+    size_t count;
+    const mock_ledc_event_t* timeline = mock_ledc_timeline(&count);
+    for (size_t i = count; i > 0; i--) {
+        if (timeline[i - 1].channel == ledc(channel)) {
+            return &timeline[i - 1];
+        }
+    }
+    return NULL;
+}
+
+void setUp(void) {
+    mock_ledc_reset();
+    mock_gpio_reset();
+    mock_clock_set_us(0);
+    led_channels_init();
+}
+
+void tearDown(void) {
+}
+
+static void test_gamma_endpoints(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, led_level_to_duty(0, LEDC_TIMER_13_BIT));
+    TEST_ASSERT_EQUAL_UINT32(FULL_SCALE_13BIT, led_level_to_duty(LED_LEVEL_MAX, LEDC_TIMER_13_BIT));
+    TEST_ASSERT_EQUAL_UINT32(256, led_level_to_duty(LED_LEVEL_MAX, LEDC_TIMER_8_BIT));
+
+    uint32_t previous = 0;
+    for (int level = 1; level <= LED_LEVEL_MAX; level++) {
+        uint32_t duty = led_level_to_duty((uint8_t)level, LEDC_TIMER_13_BIT);
+        TEST_ASSERT_TRUE(duty >= previous);
+        previous = duty;
+    }
+    // Perceptual: half brightness is well under half the duty
+    TEST_ASSERT_TRUE(led_level_to_duty(128, LEDC_TIMER_13_BIT) < FULL_SCALE_13BIT / 4);
+}
+
+static void test_fade_curve(void) {
+    uint32_t from = led_level_to_duty(64, LEDC_TIMER_13_BIT);
+    uint32_t to = led_level_to_duty(192, LEDC_TIMER_13_BIT);
+
+    mock_clock_set_us(1000);
+    TEST_ASSERT_EQUAL(ESP_OK, led_channel_set_level(CH, 64));
+    mock_clock_set_us(2000);
+    TEST_ASSERT_EQUAL(ESP_OK, led_channel_fade_to(CH, 192, 1000));
+
+    const mock_ledc_event_t* fade = last_event(CH);
+    TEST_ASSERT_NOT_NULL(fade);
+    TEST_ASSERT_EQUAL_UINT32(to, fade->duty);
+    TEST_ASSERT_EQUAL_UINT32(1000, fade->fade_ms);
+
+    TEST_ASSERT_EQUAL_UINT32(from, mock_ledc_duty_at(ledc(CH), 2000));
+    TEST_ASSERT_UINT32_WITHIN(1, from + (to - from) / 2, mock_ledc_duty_at(ledc(CH), 2000 + 500000));
+    TEST_ASSERT_EQUAL_UINT32(to, mock_ledc_duty_at(ledc(CH), 2000 + 1000000));
+    TEST_ASSERT_EQUAL_UINT32(to, mock_ledc_duty_at(ledc(CH), 10000000));
+    TEST_ASSERT_EQUAL_UINT8(192, led_channel_get_level(CH));
+}
+
+static void test_fade_from_off_starts_at_zero(void) {
+    mock_clock_set_us(5000);
+    TEST_ASSERT_EQUAL(ESP_OK, led_channel_fade_to(CH, LED_LEVEL_MAX, 200));
+
+    TEST_ASSERT_EQUAL_UINT32(0, mock_ledc_duty_at(ledc(CH), 5000));
+    TEST_ASSERT_UINT32_WITHIN(1, FULL_SCALE_13BIT / 2, mock_ledc_duty_at(ledc(CH), 5000 + 100000));
+    TEST_ASSERT_EQUAL_UINT32(FULL_SCALE_13BIT, mock_ledc_duty_at(ledc(CH), 5000 + 200000));
+}
+
+static void test_new_fade_continues_from_current_duty(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, led_channel_fade_to(CH, LED_LEVEL_MAX, 2000));
+    // Halfway up, turn around and fade back to off over one second
+    mock_clock_set_us(1000000);
+    TEST_ASSERT_EQUAL(ESP_OK, led_channel_fade_to(CH, 1, 1000));
+
+    uint32_t halfway = mock_ledc_duty_at(ledc(CH), 1000000);
+    uint32_t bottom = led_level_to_duty(1, LEDC_TIMER_13_BIT);
+    TEST_ASSERT_UINT32_WITHIN(1, FULL_SCALE_13BIT / 2, halfway);
+    TEST_ASSERT_UINT32_WITHIN(1, bottom + (halfway - bottom) / 2, mock_ledc_duty_at(ledc(CH), 1500000));
+    TEST_ASSERT_EQUAL_UINT32(bottom, mock_ledc_duty_at(ledc(CH), 2000000));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_gamma_endpoints);
+    RUN_TEST(test_fade_curve);
+    RUN_TEST(test_fade_from_off_starts_at_zero);
+    RUN_TEST(test_new_fade_continues_from_current_duty);
+    return UNITY_END();
+}
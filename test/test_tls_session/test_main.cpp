@@ -0,0 +1,105 @@
+// TLS session reuse on the host: the esp-tls stand-in gives every connection
+// an mbedTLS session, resumes an offered one unless told to answer with a new
+// session, and counts what the transport offered.
+//   pio test -e native_test
+
+#include "tls_transport.h"
+#include "host_mock.h"
+#include <unity.h>
+
+#define HUB "hub.azure-devices.net"
+
+static esp_transport_handle_t transport;
+static tls_transport_stats_t before;
+static mock_tls_stats_t server_before;
+
+// Counters are process-wide; each test looks at what it added
+static tls_transport_stats_t added(void) {
+    tls_transport_stats_t now;
+    tls_transport_get_stats(&now);
+    now.handshakes -= before.handshakes;
+    now.resumed -= before.resumed;
+    now.failures -= before.failures;
+    return now;
+}
+
+static mock_tls_stats_t server_added(void) {
+    mock_tls_stats_t now;
+    mock_tls_get_stats(&now);
+    now.handshakes -= server_before.handshakes;
+    now.offered -= server_before.offered;
+    now.resumed -= server_before.resumed;
+    return now;
+}
+
+static void reconnect(void) {
+    esp_transport_close(transport);
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+}
+
+void setUp(void) {
+    mock_tls_set_resumption(true);
+    transport = tls_transport_create();   // no cached session yet
+    tls_transport_get_stats(&before);
+    mock_tls_get_stats(&server_before);
+}
+
+void tearDown(void) {
+    esp_transport_destroy(transport);
+}
+
+static void test_first_connection_is_a_full_handshake(void) {
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+
+    TEST_ASSERT_EQUAL_UINT32(1, added().handshakes);
+    TEST_ASSERT_EQUAL_UINT32(0, added().resumed);
+    TEST_ASSERT_EQUAL_UINT32(0, server_added().offered);
+}
+
+static void test_reconnect_resumes_the_session(void) {
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+    reconnect();
+    reconnect();
+
+    TEST_ASSERT_EQUAL_UINT32(3, added().handshakes);
+    TEST_ASSERT_EQUAL_UINT32(2, added().resumed);
+    TEST_ASSERT_EQUAL_UINT32(2, server_added().offered);
+    TEST_ASSERT_EQUAL_UINT32(2, server_added().resumed);
+}
+
+static void test_new_session_from_the_server_is_not_counted_as_resumed(void) {
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+
+    // Offered, but the server answers with a full handshake and a new session
+    mock_tls_set_resumption(false);
+    reconnect();
+    TEST_ASSERT_EQUAL_UINT32(1, server_added().offered);
+    TEST_ASSERT_EQUAL_UINT32(0, added().resumed);
+
+    // The new session is the one cached: resuming it counts
+    mock_tls_set_resumption(true);
+    reconnect();
+    TEST_ASSERT_EQUAL_UINT32(2, server_added().offered);
+    TEST_ASSERT_EQUAL_UINT32(1, server_added().resumed);
+    TEST_ASSERT_EQUAL_UINT32(1, added().resumed);
+    TEST_ASSERT_EQUAL_UINT32(3, added().handshakes);
+}
+
+static void test_destroy_forgets_the_session(void) {
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+    esp_transport_destroy(transport);
+
+    transport = tls_transport_create();
+    TEST_ASSERT_EQUAL_INT(0, esp_transport_connect(transport, HUB, 0, 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, server_added().offered);
+    TEST_ASSERT_EQUAL_UINT32(0, added().resumed);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_connection_is_a_full_handshake);
+    RUN_TEST(test_reconnect_resumes_the_session);
+    RUN_TEST(test_new_session_from_the_server_is_not_counted_as_resumed);
+    RUN_TEST(test_destroy_forgets_the_session);
+    return UNITY_END();
+}
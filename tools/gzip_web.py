@@ -0,0 +1,39 @@
+"""Gzip the web UI assets so the firmware can embed and serve them as-is.
+
+Runs as a PlatformIO pre-build script (extra_scripts = pre:tools/gzip_web.py)
+and can also be run by hand: python tools/gzip_web.py
+
+Output is deterministic (no timestamp, no file name in the gzip header), so
+the ETag the firmware derives from the embedded bytes only changes when the
+assets do.
+"""
+import gzip
+import os
+
+ASSETS = ["index.html"]
+
+
+def gzip_assets(project_dir):
+    web_dir = os.path.join(project_dir, "web")
+    dist_dir = os.path.join(web_dir, "dist")
+    os.makedirs(dist_dir, exist_ok=True)
+    for name in ASSETS:
+        src = os.path.join(web_dir, name)
+        dst = os.path.join(dist_dir, name + ".gz")
+        with open(src, "rb") as f:
+            data = f.read()
+        packed = gzip.compress(data, compresslevel=9, mtime=0)
+        if os.path.exists(dst):
+            with open(dst, "rb") as f:
+                if f.read() == packed:
+                    continue
+        with open(dst, "wb") as f:
+            f.write(packed)
+        print("[WEB] %s: %d -> %d bytes gzip" % (name, len(data), len(packed)))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    gzip_assets(env.subst("$PROJECT_DIR"))  # noqa: F821
+except NameError:
+    gzip_assets(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))